@@ -0,0 +1,106 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include "benchmark.hpp"
+
+namespace bbge::bench {
+
+    state::state(const run_settings& settings)
+      : m_settings(settings), m_samples(std::max<std::size_t>(settings.max_iterations, 1)), m_iterations(0),
+        m_items_per_iteration(1), m_total(0), m_paused(0), m_started(false) { }
+
+    bool state::keep_running() {
+
+        auto now = clock::now();
+
+        if (m_skipped) {
+            return false;
+        }
+
+        if (m_started) {
+            auto elapsed = now - m_iteration_start - m_paused;
+            m_samples.add(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+            m_total += elapsed;
+            ++m_iterations;
+        }
+        m_started = true;
+
+        bool enough = m_iterations >= m_settings.min_iterations && m_total >= m_settings.min_time;
+        if (enough || m_iterations >= m_settings.max_iterations) {
+            return false;
+        }
+
+        // start the clock last, so the bookkeeping isn't part of the next sample
+        m_paused = clock::duration::zero();
+        m_iteration_start = clock::now();
+        return true;
+    }
+
+    void state::pause_timing() noexcept {
+        m_pause_start = clock::now();
+    }
+
+    void state::resume_timing() noexcept {
+        m_paused += clock::now() - m_pause_start;
+    }
+
+    void state::set_items_per_iteration(std::size_t items) noexcept {
+        m_items_per_iteration = std::max<std::size_t>(items, 1);
+    }
+
+    void state::set_counter(const std::string& name, double value) {
+        m_counters[name] = value;
+    }
+
+    void state::skip(std::string reason) {
+        m_skipped = std::move(reason);
+    }
+
+    bool state::is_headless() const noexcept {
+        return m_settings.headless;
+    }
+
+    nlohmann::json state::to_json(std::string_view name) const {
+
+        nlohmann::json result;
+        result["name"] = name;
+        if (m_skipped) {
+            result["skipped"] = *m_skipped;
+            return result;
+        }
+
+        auto summary = m_samples.get_summary();
+        auto items = static_cast<double>(m_items_per_iteration);
+        result["iterations"] = m_iterations;
+        result["items_per_iteration"] = m_items_per_iteration;
+        result["min_ns"] = summary.min / items;
+        result["avg_ns"] = summary.avg / items;
+        result["p99_ns"] = summary.p99 / items;
+        result["max_ns"] = summary.max / items;
+        result["counters"] = m_counters;
+        return result;
+    }
+
+    std::vector<benchmark>& get_benchmarks() {
+        static std::vector<benchmark> benchmarks;
+        return benchmarks;
+    }
+
+    registrar::registrar(std::string_view name, benchmark_function function) {
+        get_benchmarks().push_back({ name, function });
+    }
+}
@@ -0,0 +1,152 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#ifndef BAMBOOENGINE_BENCHMARK_HPP
+#define BAMBOOENGINE_BENCHMARK_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <bamboo_engine/util/macros.hpp>
+#include <bamboo_engine/util/rolling_statistics.hpp>
+
+namespace bbge::bench {
+
+    /**
+     * @brief Keep the compiler from optimizing a value or the computation producing it away.
+     * @param value Value
+     */
+    template <class T>
+    inline void do_not_optimize(const T& value) noexcept {
+        #if defined(__GNUC__) || defined(__clang__)
+            asm volatile("" : : "r,m"(value) : "memory");
+        #else
+            static volatile const void* sink;
+            sink = &value;
+        #endif
+    }
+
+    struct run_settings {
+        std::size_t               min_iterations = 5;
+        std::size_t               max_iterations = 100'000;
+        std::chrono::milliseconds min_time { 500 };
+        bool                      headless       = true;    // no window, surface or swap chain
+    };
+
+    /**
+     * @brief Measures the iterations of one benchmark.
+     * Every call to keep_running() ends the previous iteration, so the loop body is what's timed:
+     * @code
+     * while (state.keep_running()) { work(); }
+     * @endcode
+     */
+    class state {
+    public:
+
+        using clock = std::chrono::steady_clock;
+
+        BBGE_NO_COPIES(state);
+        BBGE_NO_MOVES(state);
+
+        explicit state(const run_settings& settings);
+
+        /**
+         * @brief End the current iteration and check whether another one is needed.
+         * @return True until enough iterations ran for long enough
+         */
+        [[nodiscard]] bool keep_running();
+
+        /**
+         * @brief Exclude the following code from the iteration, e.g. per iteration setup.
+         */
+        void pause_timing() noexcept;
+        void resume_timing() noexcept;
+
+        /**
+         * @brief Set how many operations an iteration does, for operations too fast to time one by one.
+         * @param items Operations per iteration
+         */
+        void set_items_per_iteration(std::size_t items) noexcept;
+
+        /**
+         * @brief Report an additional value, e.g. a cache size.
+         * @param name Name in the output
+         * @param value Value
+         */
+        void set_counter(const std::string& name, double value);
+
+        /**
+         * @brief Mark the benchmark as not runnable in this configuration. Stops the iteration loop.
+         * @param reason Why, part of the output
+         */
+        void skip(std::string reason);
+
+        [[nodiscard]] bool is_headless() const noexcept;
+
+        /**
+         * @brief Summarize the run.
+         * @param name Name of the benchmark
+         * @return JSON object
+         */
+        [[nodiscard]] nlohmann::json to_json(std::string_view name) const;
+
+    private:
+
+        run_settings m_settings;
+        rolling_statistics m_samples;   // nanoseconds per iteration
+        std::size_t m_iterations;
+        std::size_t m_items_per_iteration;
+        clock::duration m_total;
+        clock::duration m_paused;
+        clock::time_point m_iteration_start;
+        clock::time_point m_pause_start;
+        bool m_started;
+        std::map<std::string, double> m_counters;
+        std::optional<std::string> m_skipped;
+    };
+
+    using benchmark_function = void (*)(state&);
+
+    struct benchmark {
+        std::string_view   name;
+        benchmark_function function;
+    };
+
+    /**
+     * @brief Get all benchmarks registered with BBGE_BENCHMARK.
+     * @return Benchmarks in registration order
+     */
+    [[nodiscard]] std::vector<benchmark>& get_benchmarks();
+
+    struct registrar {
+        registrar(std::string_view name, benchmark_function function);
+    };
+}
+
+/**
+ * @brief Define and register a benchmark: BBGE_BENCHMARK(name) { while (state.keep_running()) { ... } }
+ */
+#define BBGE_BENCHMARK(name)                                                                            \
+    static void bbge_benchmark_##name(::bbge::bench::state& state);                                     \
+    static const ::bbge::bench::registrar bbge_benchmark_registrar_##name { #name, &bbge_benchmark_##name }; \
+    static void bbge_benchmark_##name([[maybe_unused]] ::bbge::bench::state& state)
+
+#endif //BAMBOOENGINE_BENCHMARK_HPP
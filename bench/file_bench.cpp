@@ -0,0 +1,149 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <vector>
+#include <fmt/format.h>
+#include <bamboo_engine/util/mapped_file.hpp>
+#include <bamboo_engine/util/asset_archive.hpp>
+#include "benchmark.hpp"
+
+// Loading files from disk, mapped and streamed, and assets from an archive
+
+namespace {
+
+    constexpr std::size_t large_file_size = 16 * 1024 * 1024;
+    constexpr std::size_t asset_count = 256;
+    constexpr std::size_t asset_size = 4096;
+
+    /**
+     * @brief Generated files in the temp directory, removed again when the benchmark is done.
+     */
+    class temp_files {
+    public:
+
+        BBGE_NO_COPIES(temp_files);
+        BBGE_NO_MOVES(temp_files);
+
+        explicit temp_files(const std::string& name)
+          : m_root(std::filesystem::temp_directory_path() / fmt::format("bbge-bench-{}", name)) {
+            std::filesystem::create_directories(m_root);
+        }
+
+        ~temp_files() {
+            std::error_code ec;
+            std::filesystem::remove_all(m_root, ec);
+        }
+
+        [[nodiscard]] std::filesystem::path write(const std::string& name, const std::vector<std::byte>& contents) const {
+            auto p = m_root / name;
+            std::ofstream out(p, std::ios::binary);
+            out.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+            return p;
+        }
+
+        [[nodiscard]] const std::filesystem::path& get_root() const noexcept {
+            return m_root;
+        }
+
+    private:
+
+        std::filesystem::path m_root;
+    };
+
+    std::vector<std::byte> make_contents(std::size_t size, std::size_t seed) {
+        std::vector<std::byte> contents(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            contents[i] = static_cast<std::byte>((i * 31 + seed) & 0xFF);
+        }
+        return contents;
+    }
+
+    // reads one byte per page, so the pages are actually loaded
+    uint64_t touch_pages(const std::byte* data, std::size_t size) {
+        uint64_t sum = 0;
+        for (std::size_t i = 0; i < size; i += 4096) {
+            sum += static_cast<uint64_t>(data[i]);
+        }
+        return sum;
+    }
+}
+
+BBGE_BENCHMARK(file_mapped_open_and_read) {
+    temp_files files("mapped");
+    auto p = files.write("large.bin", make_contents(large_file_size, 0));
+    state.set_counter("bytes", static_cast<double>(large_file_size));
+
+    while (state.keep_running()) {
+        auto file = bbge::mapped_file::open(p).or_throw();
+        bbge::bench::do_not_optimize(touch_pages(file.data(), file.size()));
+    }
+}
+
+BBGE_BENCHMARK(file_stream_open_and_read) {
+    temp_files files("stream");
+    auto p = files.write("large.bin", make_contents(large_file_size, 0));
+    state.set_counter("bytes", static_cast<double>(large_file_size));
+
+    std::vector<std::byte> buffer(large_file_size);
+    while (state.keep_running()) {
+        std::ifstream in(p, std::ios::binary);
+        in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        bbge::bench::do_not_optimize(touch_pages(buffer.data(), static_cast<std::size_t>(in.gcount())));
+    }
+}
+
+BBGE_BENCHMARK(asset_archive_open) {
+    temp_files files("archive_open");
+    bbge::asset_archive_writer writer;
+    for (std::size_t i = 0; i < asset_count; ++i) {
+        writer.add(fmt::format("textures/asset_{}.bin", i), make_contents(asset_size, i));
+    }
+    auto p = files.get_root() / "assets.bba";
+    state.set_counter("bytes", static_cast<double>(writer.write(p).or_throw()));
+
+    while (state.keep_running()) {
+        auto archive = bbge::asset_archive::open(p).or_throw();
+        bbge::bench::do_not_optimize(archive.size());
+    }
+}
+
+BBGE_BENCHMARK(asset_archive_lookup) {
+    temp_files files("archive_lookup");
+    bbge::asset_archive_writer writer;
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < asset_count; ++i) {
+        names.push_back(fmt::format("textures/asset_{}.bin", i));
+        writer.add(names.back(), make_contents(asset_size, i));
+    }
+    auto p = files.get_root() / "assets.bba";
+    (void) writer.write(p).or_throw();
+    auto archive = bbge::asset_archive::open(p).or_throw();
+
+    state.set_items_per_iteration(names.size());
+    while (state.keep_running()) {
+        for (const auto& name : names) {
+            auto contents = archive.get_contents(name).or_throw();
+            bbge::bench::do_not_optimize(touch_pages(contents.data(), contents.size()));
+        }
+    }
+}
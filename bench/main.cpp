@@ -0,0 +1,145 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <cmake_config.hpp>
+#include <bamboo_engine/util/logging.hpp>
+#include <bamboo_engine/util/version.hpp>
+#include "benchmark.hpp"
+
+namespace {
+
+    struct options {
+        bbge::bench::run_settings settings;
+        std::string               filter;
+        std::string               out = "bench.json";
+        bool                      verbose = false;
+    };
+
+    void print_usage(const char* exe) {
+        fmt::print(stderr,
+            "Usage: {} [--windowed] [--filter <substring>] [--min-time <ms>] [--out <file>] [--verbose]\n"
+            "  --windowed   create a window, surface and swap chain, headless by default\n"
+            "  --filter     only run benchmarks whose name contains the substring\n"
+            "  --min-time   minimum time per benchmark in milliseconds, default 500\n"
+            "  --out        JSON results, default bench.json\n"
+            "  --verbose    keep engine log messages below warnings\n",
+            exe
+        );
+    }
+
+    bool parse_options(int argc, char** argv, options& opts) {
+
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            bool has_value = i + 1 < argc;
+
+            if (arg == "--windowed") {
+                opts.settings.headless = false;
+            }
+            else if (arg == "--verbose") {
+                opts.verbose = true;
+            }
+            else if (arg == "--filter" && has_value) {
+                opts.filter = argv[++i];
+            }
+            else if (arg == "--out" && has_value) {
+                opts.out = argv[++i];
+            }
+            else if (arg == "--min-time" && has_value) {
+                opts.settings.min_time = std::chrono::milliseconds { std::stoll(argv[++i]) };
+            }
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+// Runs the engine benchmarks and writes the results as JSON, e.g. for comparing CI runs
+int main(int argc, char** argv) {
+
+    using namespace bbge;
+
+    const char* exe = argc > 0 ? argv[0] : "bamboo-engine-bench";
+    options opts;
+    try {
+        if (!parse_options(argc, argv, opts)) {
+            print_usage(exe);
+            return 2;
+        }
+    }
+    catch (const std::exception&) {
+        print_usage(exe);
+        return 2;
+    }
+
+    logging logging_system { };
+    if (!opts.verbose) {
+        // device creation logs a lot, the summary should stay readable
+        spdlog::set_level(spdlog::level::warn);
+    }
+
+    nlohmann::json results;
+    results["version"] = version { BAMBOOENGINE_VERSION_MAJOR, BAMBOOENGINE_VERSION_MINOR }.string();
+    results["headless"] = opts.settings.headless;
+    results["benchmarks"] = nlohmann::json::array();
+
+    int exit_code = 0;
+    for (const auto& b : bench::get_benchmarks()) {
+        if (b.name.find(opts.filter) == std::string_view::npos) {
+            continue;
+        }
+
+        bench::state state(opts.settings);
+        try {
+            b.function(state);
+        }
+        catch (const std::exception& ex) {
+            state.skip(fmt::format("failed: {}", ex.what()));
+            exit_code = 1;
+        }
+
+        auto result = state.to_json(b.name);
+        if (result.contains("skipped")) {
+            fmt::print("{:<40} skipped ({})\n", b.name, result["skipped"].get<std::string>());
+        }
+        else {
+            fmt::print("{:<40} {:>14.1f} ns avg {:>14.1f} ns p99 {:>8} iterations\n", b.name,
+                       result["avg_ns"].get<double>(), result["p99_ns"].get<double>(),
+                       result["iterations"].get<std::size_t>());
+        }
+        results["benchmarks"].push_back(std::move(result));
+    }
+
+    std::ofstream out(opts.out);
+    out << results.dump(4) << '\n';
+    if (!out) {
+        fmt::print(stderr, "Failed to write '{}'\n", opts.out);
+        return 1;
+    }
+
+    return exit_code;
+}
@@ -0,0 +1,97 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstddef>
+#include <array>
+#include <numeric>
+#include <stdexcept>
+#include <bamboo_engine/util/result.hpp>
+#include "benchmark.hpp"
+
+// Overhead of result<> compared to plain return values on the paths the engine uses it for
+
+namespace {
+
+    constexpr std::size_t calls_per_iteration = 1000;
+
+    std::array<int, calls_per_iteration> make_inputs() {
+        std::array<int, calls_per_iteration> inputs { };
+        std::iota(inputs.begin(), inputs.end(), 0);
+        return inputs;
+    }
+
+    int plain_half(int value) {
+        return value / 2;
+    }
+
+    bbge::result<int, std::runtime_error> checked_half(int value) {
+        if (value < 0) {
+            return std::runtime_error("negative value");
+        }
+        return value / 2;
+    }
+}
+
+BBGE_BENCHMARK(result_plain_return) {
+    auto inputs = make_inputs();
+    state.set_items_per_iteration(inputs.size());
+    while (state.keep_running()) {
+        for (int value : inputs) {
+            bbge::bench::do_not_optimize(value);
+            bbge::bench::do_not_optimize(plain_half(value));
+        }
+    }
+}
+
+BBGE_BENCHMARK(result_ok) {
+    auto inputs = make_inputs();
+    state.set_items_per_iteration(inputs.size());
+    while (state.keep_running()) {
+        for (int value : inputs) {
+            bbge::bench::do_not_optimize(value);
+            auto r = checked_half(value);
+            bbge::bench::do_not_optimize(r.or_else(0));
+        }
+    }
+}
+
+BBGE_BENCHMARK(result_err) {
+    auto inputs = make_inputs();
+    state.set_items_per_iteration(inputs.size());
+    while (state.keep_running()) {
+        for (int value : inputs) {
+            value = -value - 1;
+            bbge::bench::do_not_optimize(value);
+            auto r = checked_half(value);
+            bbge::bench::do_not_optimize(r.is_err());
+        }
+    }
+}
+
+BBGE_BENCHMARK(result_and_then_chain) {
+    auto inputs = make_inputs();
+    state.set_items_per_iteration(inputs.size());
+    while (state.keep_running()) {
+        for (int value : inputs) {
+            bbge::bench::do_not_optimize(value);
+            auto r = checked_half(value)
+                .and_then(checked_half)
+                .map([](int v) { return v + 1; });
+            bbge::bench::do_not_optimize(r.or_else(0));
+        }
+    }
+}
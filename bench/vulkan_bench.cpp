@@ -0,0 +1,213 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <bamboo_engine/client/glfw.hpp>
+#include <bamboo_engine/client/window.hpp>
+#include <bamboo_engine/graphics/vulkan.hpp>
+#include <bamboo_engine/graphics/vulkan_command_buffer.hpp>
+#include <bamboo_engine/graphics/vulkan_pipeline.hpp>
+#include <bamboo_engine/graphics/vulkan_render_graph.hpp>
+#include <bamboo_engine/graphics/vulkan_offscreen_scheduler.hpp>
+#include "benchmark.hpp"
+
+// Start up and rendering costs. Headless runs skip everything that needs a window.
+
+namespace {
+
+    using namespace std::string_literals;
+
+    const bbge::version app_version { 0, 1, 0 };
+    const bbge::vulkan_pipeline::shader_module_paths shader_paths {
+        "shader/simple.vert.spv", "shader/simple.frag.spv"
+    };
+    constexpr VkExtent2D frame_extent { 1280, 720 };
+
+    /**
+     * @brief Window of a windowed run, nothing of a headless one.
+     */
+    struct presentation {
+        std::optional<bbge::glfw_api> glfw;
+        std::unique_ptr<bbge::glfw_window> window;
+
+        // glfw has to exist before the instance, it provides the surface extensions
+        explicit presentation(bool headless) {
+            if (!headless) {
+                glfw.emplace();
+                window = std::make_unique<bbge::glfw_window>("Bamboo Engine Bench"s, bbge::window::position_center,
+                                                             glm::ivec2 { 1024, 720 });
+            }
+        }
+
+        // store it after the instance, the surface has to be destroyed first
+        [[nodiscard]] std::unique_ptr<bbge::vulkan_surface> create_surface(VkInstance instance) const {
+            return window ? std::make_unique<bbge::vulkan_surface>(instance, *window) : nullptr;
+        }
+    };
+
+    // the bench keeps its own pipeline cache, so it never replaces or deletes the client's
+    std::filesystem::path get_cache_path() {
+        return std::filesystem::temp_directory_path() / "bamboo-engine-bench" / "pipelines.bin";
+    }
+
+    std::unique_ptr<bbge::vulkan_device> create_device(VkInstance instance, VkSurfaceKHR surface = VK_NULL_HANDLE) {
+        return std::make_unique<bbge::vulkan_device>(instance, surface, bbge::vulkan_device::selection_default,
+                                                     bbge::vulkan_device::pipeline_cache_blob { }, get_cache_path());
+    }
+
+    bool has_shaders() {
+        return std::filesystem::exists(shader_paths.vertex_shader) && std::filesystem::exists(shader_paths.fragment_shader);
+    }
+
+    std::unique_ptr<bbge::vulkan_pipeline> create_pipeline(const bbge::vulkan_device& device) {
+        return std::make_unique<bbge::vulkan_pipeline>(
+            "Bench"s, shader_paths, bbge::rendering_pipeline_settings { }, device, bbge::vulkan_offscreen_scheduler::default_format
+        );
+    }
+}
+
+BBGE_BENCHMARK(vulkan_instance_creation) {
+    presentation p(state.is_headless());
+    while (state.keep_running()) {
+        bbge::vulkan_instance instance("Bench", app_version, state.is_headless());
+        bbge::bench::do_not_optimize(instance.get_handle());
+    }
+}
+
+BBGE_BENCHMARK(vulkan_device_creation) {
+    presentation p(state.is_headless());
+    bbge::vulkan_instance instance("Bench", app_version, state.is_headless());
+    auto surface = p.create_surface(instance.get_handle());
+
+    while (state.keep_running()) {
+        auto device = create_device(instance.get_handle(), surface ? surface->get_handle() : VK_NULL_HANDLE);
+        bbge::bench::do_not_optimize(device->get_handle());
+    }
+}
+
+BBGE_BENCHMARK(vulkan_swap_chain_creation) {
+    if (state.is_headless()) {
+        state.skip("needs a window, run with --windowed");
+        return;
+    }
+
+    presentation p(false);
+    bbge::vulkan_instance instance("Bench", app_version);
+    auto surface = p.create_surface(instance.get_handle());
+    bbge::vulkan_device device(instance.get_handle(), surface->get_handle(), bbge::vulkan_device::selection_default, { }, get_cache_path());
+
+    while (state.keep_running()) {
+        bbge::vulkan_swap_chain swap_chain(
+            device.get_physical_device(), device.get_handle(), surface->get_handle(), *p.window,
+            device.get_queue_family_indices()
+        );
+        bbge::bench::do_not_optimize(swap_chain.get_handle());
+    }
+}
+
+// the device loads the pipeline cache from disk on creation, so a cold start needs a new device without the bench's file
+BBGE_BENCHMARK(vulkan_pipeline_creation_cold) {
+    if (!has_shaders()) {
+        state.skip("shader/simple.*.spv not found in the working directory");
+        return;
+    }
+
+    bbge::vulkan_instance instance("Bench", app_version, true);
+    while (state.keep_running()) {
+        state.pause_timing();
+        std::filesystem::remove(get_cache_path());
+        auto device = create_device(instance.get_handle());
+        state.resume_timing();
+
+        auto pipeline = create_pipeline(*device);
+
+        state.pause_timing();
+        pipeline.reset();
+        device.reset();
+        state.resume_timing();
+    }
+}
+
+BBGE_BENCHMARK(vulkan_pipeline_creation_warm) {
+    if (!has_shaders()) {
+        state.skip("shader/simple.*.spv not found in the working directory");
+        return;
+    }
+
+    bbge::vulkan_instance instance("Bench", app_version, true);
+    bbge::vulkan_device device(instance.get_handle(), VK_NULL_HANDLE, bbge::vulkan_device::selection_default, { }, get_cache_path());
+    create_pipeline(device).reset(); // fills the cache
+
+    while (state.keep_running()) {
+        auto pipeline = create_pipeline(device);
+        bbge::bench::do_not_optimize(pipeline->get_handle());
+    }
+}
+
+// CPU time per frame including waits for the GPU once all frames are in flight
+BBGE_BENCHMARK(vulkan_offscreen_frame) {
+    if (!has_shaders()) {
+        state.skip("shader/simple.*.spv not found in the working directory");
+        return;
+    }
+
+    bbge::vulkan_instance instance("Bench", app_version, true);
+    bbge::vulkan_device device(instance.get_handle(), VK_NULL_HANDLE, bbge::vulkan_device::selection_default, { }, get_cache_path());
+    bbge::vulkan_offscreen_scheduler scheduler(device, frame_extent);
+    std::unique_ptr<bbge::vulkan_pipeline> pipeline;
+
+    bbge::render_graph graph;
+    bbge::render_graph_image_desc color_desc { scheduler.get_format() };
+    color_desc.clear.color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+    bbge::render_graph_import target { };
+    target.final_layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; // where a screenshot would copy from
+    target.final_stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    target.final_access = VK_ACCESS_TRANSFER_READ_BIT;
+    auto color = graph.import_image("Offscreen"s, color_desc, target);
+
+    auto forward = graph.add_pass("Forward"s);
+    forward.color(color).record([&](const bbge::render_graph_context& ctx) {
+        bbge::vulkan_command_buffer cmd(ctx.command_buffer);
+        cmd.bind_pipeline(*pipeline);
+        cmd.set_viewport_and_scissor(ctx.extent);
+        cmd.draw(3, 1, 0, 0);
+    });
+    auto forward_pass = forward.get();
+    bbge::vulkan_render_graph vk_graph(device, std::move(graph));
+    vk_graph.resize(scheduler.get_extent(), scheduler.get_frames_in_flight());
+
+    bbge::rendering_pipeline_settings settings { };
+    settings.render_pass = vk_graph.get_subpass(forward_pass).render_pass;
+    settings.subpass = vk_graph.get_subpass(forward_pass).index;
+    pipeline = std::make_unique<bbge::vulkan_pipeline>("Bench"s, shader_paths, settings, device, scheduler.get_format());
+
+    state.set_counter("frames_in_flight", scheduler.get_frames_in_flight());
+    state.set_counter("graph_memory_bytes", static_cast<double>(vk_graph.get_memory_size()));
+    while (state.keep_running()) {
+        auto frame = scheduler.begin_frame();
+        vk_graph.set_image(color, scheduler.get_images()[frame.image_index], scheduler.get_image_views()[frame.image_index]);
+        vk_graph.execute(frame);
+        scheduler.end_frame(frame);
+    }
+
+    state.pause_timing();
+    scheduler.wait_idle();
+    state.resume_timing();
+}
@@ -0,0 +1,31 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : enable
+
+// must match indirect_draw_data of vulkan_indirect_renderer
+struct draw_data {
+    mat4 model;
+    uint material_id;
+};
+
+// buffer array of vulkan_bindless_set, binding 0 holds the textures
+layout(std430, set = 0, binding = 1) readonly buffer draws {
+    draw_data data[];
+} buffers[];
+
+// must match indirect_push_constants
+layout(push_constant) uniform constants {
+    uint draw_data_buffer;
+} pc;
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    // the renderer points each command's first instance at its draw data
+    draw_data d = buffers[pc.draw_data_buffer].data[gl_InstanceIndex];
+    gl_Position = d.model * vec4(position, 1.0);
+    fragColor = color;
+}
@@ -18,12 +18,21 @@
 //
 
 #include <iostream>
-#include <chrono>
-#include <thread>
 #include <bamboo_engine/client/window.hpp>
 #include <bamboo_engine/util/logging.hpp>
+#include <bamboo_engine/util/asset_archive.hpp>
+#include <bamboo_engine/util/job_system.hpp>
+#include <bamboo_engine/util/trace_recorder.hpp>
 #include <bamboo_engine/graphics/vulkan.hpp>
 #include <bamboo_engine/graphics/vulkan_pipeline.hpp>
+#include <bamboo_engine/graphics/vulkan_pipeline_builder.hpp>
+#include <bamboo_engine/graphics/vulkan_frame_scheduler.hpp>
+#include <bamboo_engine/graphics/vulkan_command_buffer.hpp>
+#include <bamboo_engine/graphics/vulkan_upload_service.hpp>
+#include <bamboo_engine/graphics/vulkan_parallel_recorder.hpp>
+#include <bamboo_engine/graphics/vulkan_render_targets.hpp>
+#include <bamboo_engine/graphics/vulkan_render_graph.hpp>
+#include <bamboo_engine/graphics/vulkan_profiler.hpp>
 #include "glfw.hpp"
 
 void print_gpl_notice() {
@@ -38,6 +47,18 @@ If not provided see <https://www.gnu.org/licenses/> for that purpose.
     std::cout << msg << std::endl;
 }
 
+void record_forward_pass(const bbge::render_graph_context& ctx, bbge::vulkan_parallel_recorder& recorder,
+                         const bbge::vulkan_pipeline& pipeline) {
+
+    // one item for now, every slice binds its own state
+    // viewport and scissor are dynamic, so they always follow the current swap chain extent
+    recorder.record(ctx.frame, ctx.render_pass, 1, [&](const bbge::vulkan_command_buffer& cmd, std::size_t first, std::size_t last) {
+        cmd.bind_pipeline(pipeline);
+        cmd.set_viewport_and_scissor(ctx.extent);
+        cmd.draw(3, static_cast<uint32_t>(last - first), 0, static_cast<uint32_t>(first));
+    });
+}
+
 int main(int argc, char** argv) {
 
     using namespace bbge;
@@ -47,35 +68,156 @@ int main(int argc, char** argv) {
 
     print_gpl_notice();
 
+    // every start up phase ends up in a Chrome trace, open it in chrome://tracing or Perfetto
+    trace_recorder startup_trace;
+    const auto traced = [&startup_trace](std::string name, auto&& f) {
+        trace_recorder::scope phase(startup_trace, std::move(name));
+        return f();
+    };
+
     try {
-        glfw_api glfw { };
-        std::unique_ptr<window> win = std::make_unique<glfw_window>(
-            "Bamboo Engine"s, window::position_center, glm::ivec2 { 1024, 720 }
-        );
-
-        vulkan_instance         vk_instance("Test", version { 0, 1, 1 });
-        vulkan_debug_messenger  vk_debug(vk_instance.get_handle());
-        vulkan_surface          vk_surface(vk_instance.get_handle(), dynamic_cast<glfw_window&>(*win));
-        vulkan_device           vk_device(vk_instance.get_handle(), vk_surface.get_handle());
-        vulkan_swap_chain       vk_swapchain(
-            vk_device.get_physical_device(), vk_device.get_handle(),
-            vk_surface.get_handle(), dynamic_cast<glfw_window&>(*win),
-            vk_device.get_queue_family_indices()
-        );
-
-        // pipeline
-        vulkan_pipeline::shader_module_paths paths { };
-        paths.vertex_shader = "shader/simple.vert.spv";
-        paths.fragment_shader = "shader/simple.frag.spv";
-        rendering_pipeline_settings pipeline_settings { };
-        pipeline_settings.viewport = {
-            0, 0,
-            static_cast<double>(vk_swapchain.get_extent().width),
-            static_cast<double>(vk_swapchain.get_extent().height)
-        };
-        vulkan_pipeline vk_pipeline("Main"s, paths, pipeline_settings, vk_device.get_handle(), vk_swapchain);
-
-        std::this_thread::sleep_for(std::chrono::seconds(5));
+        // compiled shaders, packed by the bamboo-engine-assets target
+        asset_archive assets = traced("Assets", [] { return asset_archive::open("assets.bba").or_throw(); });
+
+        // declared before the job system, so they outlive the jobs reading them even if start up throws
+        const vulkan_pipeline::shader_module_paths main_shaders { "shader/simple.vert.spv", "shader/simple.frag.spv" };
+        job_system jobs { };
+
+        // reading files doesn't need the GPU, so it overlaps with bringing up the window and the device
+        auto shader_code = jobs.submit([&] {
+            trace_recorder::scope phase(startup_trace, "Load shaders"s);
+            return vulkan_pipeline::load_shader_code(assets, main_shaders);
+        });
+        auto cache_blob = jobs.submit([&] {
+            trace_recorder::scope phase(startup_trace, "Load pipeline cache"s);
+            return vulkan_pipeline_cache::load_blob(vulkan_device::pipeline_cache_path);
+        });
+
+        glfw_api glfw = traced("GLFW", [] { return glfw_api { }; });
+        std::unique_ptr<window> win = traced("Window", [] {
+            return std::make_unique<glfw_window>("Bamboo Engine"s, window::position_center, glm::ivec2 { 1024, 720 });
+        });
+        auto& glfw_win = dynamic_cast<glfw_window&>(*win);
+
+        vulkan_instance vk_instance = traced("Instance", [] { return vulkan_instance("Test", version { 0, 1, 1 }); });
+        vulkan_debug_messenger vk_debug(vk_instance.get_handle());
+        vulkan_surface vk_surface = traced("Surface", [&] { return vulkan_surface(vk_instance.get_handle(), glfw_win); });
+        vulkan_device vk_device = traced("Device", [&] {
+            return vulkan_device(vk_instance.get_handle(), vk_surface.get_handle(), vulkan_device::selection_default,
+                                 std::move(cache_blob));
+        });
+        vulkan_swap_chain vk_swapchain = traced("Swap chain", [&] {
+            return vulkan_swap_chain(
+                vk_device.get_physical_device(), vk_device.get_handle(),
+                vk_surface.get_handle(), glfw_win,
+                vk_device.get_queue_family_indices(),
+                swap_chain_settings { present_policy::mailbox }
+            );
+        });
+
+        // waiting for the GPU before input is sampled keeps the wait out of the input latency
+        vulkan_frame_scheduler vk_scheduler(vk_device, vk_swapchain, vulkan_frame_scheduler::default_frames_in_flight,
+                                            frame_pacing_settings { frame_pacing::fence });
+        vulkan_upload_service  vk_uploads(vk_device, vk_scheduler.get_frames_in_flight());
+        vulkan_parallel_recorder vk_recorder(vk_device, jobs, vk_scheduler.get_frames_in_flight());
+        vulkan_profiler        vk_profiler(vk_device, vk_instance.get_handle(), vk_scheduler.get_frames_in_flight());
+
+        // frame graph, 4x MSAA color and depth stay in tile memory and resolve into the swap chain image
+        std::unique_ptr<vulkan_pipeline> vk_pipeline;
+        auto samples = vulkan_render_targets::pick_sample_count(vk_device.get_physical_device(), VK_SAMPLE_COUNT_4_BIT, true);
+
+        render_graph graph;
+        render_graph_image_desc color_desc { vk_swapchain.get_format() };
+        color_desc.clear.color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+        render_graph_import presented { };
+        presented.initial_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; // where the frame waits for the acquire
+        presented.final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        auto swap_chain_image = graph.import_image("Swap chain"s, color_desc, presented);
+
+        render_graph_image_desc depth_desc { vulkan_render_targets::pick_depth_format(vk_device.get_physical_device()) };
+        depth_desc.samples = samples;
+        depth_desc.clear.depthStencil = { 1.0f, 0 };
+        auto depth = graph.create_image("Depth"s, depth_desc);
+
+        auto forward = graph.add_pass("Forward"s);
+        if (samples != VK_SAMPLE_COUNT_1_BIT) {
+            color_desc.samples = samples;
+            auto color = graph.create_image("Color"s, color_desc);
+            forward.color(color).resolve(color, swap_chain_image);
+        }
+        else {
+            forward.color(swap_chain_image);
+        }
+        forward.depth(depth).secondary_command_buffers().record([&](const render_graph_context& ctx) {
+            record_forward_pass(ctx, vk_recorder, *vk_pipeline);
+        });
+        auto forward_pass = forward.get();
+        vulkan_render_graph vk_graph(vk_device, std::move(graph));
+
+        // pipelines, compiled in parallel
+        vulkan_pipeline_builder::description main_pipeline { };
+        main_pipeline.name = "Main"s;
+        main_pipeline.module_paths = main_shaders;
+        main_pipeline.code = std::make_shared<const vulkan_pipeline::shader_code>(shader_code.get().or_throw());
+        // dynamic viewport and scissor, rendering in the graph's forward pass
+        main_pipeline.settings.samples = msaa_samples::x4;
+        main_pipeline.settings.depth = depth_test { };
+        main_pipeline.settings.render_pass = vk_graph.get_subpass(forward_pass).render_pass;
+        main_pipeline.settings.subpass = vk_graph.get_subpass(forward_pass).index;
+
+        vulkan_pipeline_builder pipeline_builder(vk_device, vk_swapchain.get_format(), jobs);
+        std::vector<vulkan_pipeline_builder::description> pipeline_descs { main_pipeline };
+        traced("Pipelines", [&] {
+            auto pipeline_futures = pipeline_builder.build_all(pipeline_descs);
+            vk_pipeline = pipeline_futures[0].get();
+        });
+
+        auto trace_written = startup_trace.write("logs/startup.trace.json");
+        trace_written.log_err(spdlog::level::warn);
+
+        // main loop
+        VkSwapchainKHR graph_swap_chain = VK_NULL_HANDLE;
+        while (!glfw_win.should_close()) {
+            vk_scheduler.pace();
+            glfwPollEvents();
+
+            // nothing to render to while minimized
+            if (glfw_win.is_minimized()) {
+                glfwWaitEvents();
+                continue;
+            }
+            if (glfw_win.poll_resized()) {
+                vk_scheduler.request_swap_chain_recreation();
+            }
+
+            auto frame = vk_scheduler.begin_frame();
+            if (!frame) continue;
+            vk_profiler.begin_frame(*frame);
+
+            // the graph's framebuffers reference the swap chain images
+            vk_graph.release_retired();
+            if (vk_swapchain.get_handle() != graph_swap_chain) {
+                vk_graph.resize(vk_swapchain.get_extent(), vk_scheduler.get_frames_in_flight());
+                graph_swap_chain = vk_swapchain.get_handle();
+            }
+            vk_graph.set_image(swap_chain_image, vk_swapchain.get_images()[frame->image_index],
+                               vk_swapchain.get_image_views()[frame->image_index]);
+
+            // uploads have to be acquired before anything is drawn with them
+            std::vector<vulkan_frame_scheduler::wait_semaphore> waits;
+            if (auto upload_wait = vk_uploads.flush(*frame)) {
+                waits.push_back(*upload_wait);
+            }
+
+            {
+                // timestamps can't be written inside a render pass with secondary command buffers, so the scope wraps the graph
+                vulkan_profiler::scope main_pass(vk_profiler, *frame, "Main pass", true);
+                vk_graph.execute(*frame);
+            }
+            vk_scheduler.end_frame(*frame, waits);
+        }
+        vk_scheduler.wait_idle();
+        vk_profiler.log_statistics();
     }
     catch (const std::exception& ex) {
         SPDLOG_CRITICAL("EXCEPTION: {}", ex.what());
@@ -17,6 +17,7 @@
 // Created by Leon Suchy on 04.08.20.
 //
 
+#include <utility>
 #include "window.hpp"
 #include "../util/logging.hpp"
 #include "glfw.hpp"
@@ -25,12 +26,14 @@
 namespace bbge {
 
     glfw_window::glfw_window(std::string&& title, [[maybe_unused]] glm::ivec2 position, glm::ivec2 dimensions)
-        : m_handle(nullptr), m_title(std::move(title)) {
+        : m_handle(nullptr), m_title(std::move(title)), m_resized(false) {
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // for vulkan
         m_handle = glfwCreateWindow(dimensions.x, dimensions.y, title.c_str(), nullptr, nullptr);
         if (!m_handle) {
             throw glfw_error(fmt::format("Failed to open window '{}'.", title));
         }
+        glfwSetWindowUserPointer(m_handle, this);
+        glfwSetFramebufferSizeCallback(m_handle, &glfw_window::framebuffer_size_callback);
         SPDLOG_TRACE("Opened window '{}'.", m_title);
     }
 
@@ -44,4 +47,21 @@ namespace bbge {
     GLFWwindow* glfw_window::get_handle() const noexcept {
         return m_handle;
     }
+
+    bool glfw_window::should_close() const noexcept {
+        return glfwWindowShouldClose(m_handle) == GLFW_TRUE;
+    }
+
+    bool glfw_window::poll_resized() noexcept {
+        return std::exchange(m_resized, false);
+    }
+
+    bool glfw_window::is_minimized() const noexcept {
+        return glfwGetWindowAttrib(m_handle, GLFW_ICONIFIED) == GLFW_TRUE;
+    }
+
+    void glfw_window::framebuffer_size_callback(GLFWwindow* handle, [[maybe_unused]] int width, [[maybe_unused]] int height) {
+        auto* win = static_cast<glfw_window*>(glfwGetWindowUserPointer(handle));
+        if (win) win->m_resized = true;
+    }
 }
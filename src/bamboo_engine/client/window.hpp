@@ -48,10 +48,31 @@ namespace bbge {
 
         [[nodiscard]] GLFWwindow* get_handle() const noexcept;
 
+        /**
+         * @brief Check if the user requested to close the window.
+         * @return True if the window should close
+         */
+        [[nodiscard]] bool should_close() const noexcept;
+
+        /**
+         * @brief Check if the framebuffer was resized since the last call and reset the flag.
+         * @return True if the window was resized
+         */
+        [[nodiscard]] bool poll_resized() noexcept;
+
+        /**
+         * @brief Check if the window is minimized. Minimized windows have a zero sized framebuffer.
+         * @return True if minimized
+         */
+        [[nodiscard]] bool is_minimized() const noexcept;
+
     private:
 
         GLFWwindow* m_handle;
         std::string m_title;
+        bool m_resized;
+
+        static void framebuffer_size_callback(GLFWwindow* handle, int width, int height);
     };
 }
 
@@ -0,0 +1,722 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <utility>
+#include <fmt/format.h>
+#include "render_graph.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        constexpr VkAccessFlags write_access_mask =
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        constexpr VkPipelineStageFlags depth_stages =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+        constexpr std::array<render_graph_access_info, 10> access_infos {{
+            // color_attachment
+            { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+              VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true, true },
+            // depth_attachment
+            { depth_stages,
+              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true, true },
+            // depth_read
+            { depth_stages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+              VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, false, true },
+            // resolve_attachment
+            { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true, true },
+            // fragment_sampled
+            { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false, false },
+            // compute_sampled
+            { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false, false },
+            // storage_read
+            { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+              VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, false, false },
+            // storage_write
+            { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+              VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true, false },
+            // transfer_src
+            { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false, false },
+            // transfer_dst
+            { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, true, false }
+        }};
+
+        constexpr std::array<render_graph_pass_type, 10> access_pass_types {
+            render_graph_pass_type::graphics,   // color_attachment
+            render_graph_pass_type::graphics,   // depth_attachment
+            render_graph_pass_type::graphics,   // depth_read
+            render_graph_pass_type::graphics,   // resolve_attachment
+            render_graph_pass_type::graphics,   // fragment_sampled
+            render_graph_pass_type::compute,    // compute_sampled
+            render_graph_pass_type::compute,    // storage_read
+            render_graph_pass_type::compute,    // storage_write
+            render_graph_pass_type::transfer,   // transfer_src
+            render_graph_pass_type::transfer    // transfer_dst
+        };
+
+        // true if the access depends on what the image contained before
+        bool reads_contents(const render_graph::pass_access& a) noexcept {
+            const auto& info = get_access_info(a.access);
+            if (!info.write) {
+                return true;
+            }
+            return (a.access == render_graph_access::color_attachment || a.access == render_graph_access::depth_attachment)
+                && a.load == attachment_load::load;
+        }
+
+        bool same_size(const render_graph_image_desc& a, const render_graph_image_desc& b) noexcept {
+            return a.extent.width == b.extent.width && a.extent.height == b.extent.height && a.scale == b.scale;
+        }
+
+        VkAttachmentLoadOp to_load_op(const render_graph::pass_access& a) noexcept {
+            if (a.access == render_graph_access::resolve_attachment) {
+                return VK_ATTACHMENT_LOAD_OP_DONT_CARE; // completely overwritten by the resolve
+            }
+            if (a.access == render_graph_access::depth_read) {
+                return VK_ATTACHMENT_LOAD_OP_LOAD;
+            }
+            switch (a.load) {
+                case attachment_load::clear: return VK_ATTACHMENT_LOAD_OP_CLEAR;
+                case attachment_load::load: return VK_ATTACHMENT_LOAD_OP_LOAD;
+                default: return VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            }
+        }
+
+        struct image_state {
+            VkImageLayout        layout         = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags write_stages   = 0;
+            VkAccessFlags        write_access   = 0;
+            VkPipelineStageFlags read_stages    = 0;    // reads since the last write
+            VkPipelineStageFlags visible_stages = 0;    // stages the last write was made visible to
+            VkAccessFlags        visible_access = 0;
+            bool                 live           = false;
+        };
+
+        struct slot_state {
+            VkPipelineStageFlags stages = 0;
+            VkAccessFlags        access = 0;
+        };
+    }
+
+    const render_graph_access_info& get_access_info(render_graph_access access) noexcept {
+        auto v = static_cast<uint8_t>(access);
+        return access_infos[v];
+    }
+
+    constexpr std::array<std::string_view, 10> render_graph_access_names {
+        "color attachment", "depth attachment", "depth read", "resolve attachment", "fragment sampled",
+        "compute sampled", "storage read", "storage write", "transfer source", "transfer destination"
+    };
+
+    std::string_view to_string(render_graph_access access) {
+        auto v = static_cast<uint8_t>(access);
+        return render_graph_access_names[v];
+    }
+
+    constexpr std::array<std::string_view, 3> render_graph_pass_type_names {
+        "graphics", "compute", "transfer"
+    };
+
+    std::string_view to_string(render_graph_pass_type type) {
+        auto v = static_cast<uint8_t>(type);
+        return render_graph_pass_type_names[v];
+    }
+
+    render_graph::pass_builder::pass_builder(render_graph& graph, pass p) noexcept
+      : m_graph(graph), m_pass(p) { }
+
+    render_graph::pass_builder& render_graph::pass_builder::add(
+        resource image, render_graph_access access, attachment_load load, resource resolve_source) {
+
+        m_graph.m_passes[m_pass].accesses.push_back({ image, access, load, resolve_source });
+        m_graph.m_compiled = false;
+        return *this;
+    }
+
+    render_graph::pass_builder& render_graph::pass_builder::color(resource image, attachment_load load) {
+        return add(image, render_graph_access::color_attachment, load);
+    }
+
+    render_graph::pass_builder& render_graph::pass_builder::resolve(resource source, resource target) {
+        return add(target, render_graph_access::resolve_attachment, attachment_load::dont_care, source);
+    }
+
+    render_graph::pass_builder& render_graph::pass_builder::depth(resource image, attachment_load load) {
+        return add(image, render_graph_access::depth_attachment, load);
+    }
+
+    render_graph::pass_builder& render_graph::pass_builder::depth_read(resource image) {
+        return add(image, render_graph_access::depth_read, attachment_load::load);
+    }
+
+    render_graph::pass_builder& render_graph::pass_builder::sample(resource image) {
+        auto access = m_graph.m_passes[m_pass].type == render_graph_pass_type::compute
+            ? render_graph_access::compute_sampled
+            : render_graph_access::fragment_sampled;
+        return add(image, access, attachment_load::load);
+    }
+
+    render_graph::pass_builder& render_graph::pass_builder::storage_read(resource image) {
+        return add(image, render_graph_access::storage_read, attachment_load::load);
+    }
+
+    render_graph::pass_builder& render_graph::pass_builder::storage_write(resource image) {
+        return add(image, render_graph_access::storage_write, attachment_load::dont_care);
+    }
+
+    render_graph::pass_builder& render_graph::pass_builder::transfer_src(resource image) {
+        return add(image, render_graph_access::transfer_src, attachment_load::load);
+    }
+
+    render_graph::pass_builder& render_graph::pass_builder::transfer_dst(resource image) {
+        return add(image, render_graph_access::transfer_dst, attachment_load::dont_care);
+    }
+
+    render_graph::pass_builder& render_graph::pass_builder::secondary_command_buffers() {
+        m_graph.m_passes[m_pass].secondary_command_buffers = true;
+        m_graph.m_compiled = false;
+        return *this;
+    }
+
+    render_graph::pass_builder& render_graph::pass_builder::side_effects() {
+        m_graph.m_passes[m_pass].side_effects = true;
+        m_graph.m_compiled = false;
+        return *this;
+    }
+
+    render_graph::pass_builder& render_graph::pass_builder::record(record_function function) {
+        m_graph.m_passes[m_pass].record = std::move(function);
+        return *this;
+    }
+
+    render_graph::pass render_graph::pass_builder::get() const noexcept {
+        return m_pass;
+    }
+
+    render_graph::resource render_graph::create_image(std::string name, const render_graph_image_desc& desc) {
+        image_resource image;
+        image.name = std::move(name);
+        image.desc = desc;
+        m_images.push_back(std::move(image));
+        m_compiled = false;
+        return static_cast<resource>(m_images.size() - 1);
+    }
+
+    render_graph::resource render_graph::import_image(std::string name, const render_graph_image_desc& desc,
+                                                      const render_graph_import& import) {
+        auto r = create_image(std::move(name), desc);
+        m_images[r].import = import;
+        return r;
+    }
+
+    render_graph::pass_builder render_graph::add_pass(std::string name, render_graph_pass_type type) {
+        pass_info p;
+        p.name = std::move(name);
+        p.type = type;
+        m_passes.push_back(std::move(p));
+        m_compiled = false;
+        return pass_builder(*this, static_cast<pass>(m_passes.size() - 1));
+    }
+
+    void render_graph::compile() {
+
+        validate();
+
+        m_groups.clear();
+        m_final_barriers.clear();
+        m_alias_slots = 0;
+        for (auto& image : m_images) {
+            auto desc = image.desc;
+            auto import = image.import;
+            image = image_resource { std::move(image.name), desc, import };
+        }
+
+        cull();
+        merge();
+        find_lifetimes();
+        assign_alias_slots();
+        create_attachments();
+        create_barriers();
+
+        m_compiled = true;
+    }
+
+    bool render_graph::is_compiled() const noexcept {
+        return m_compiled;
+    }
+
+    const std::vector<render_graph::image_resource>& render_graph::get_images() const noexcept {
+        return m_images;
+    }
+
+    const std::vector<render_graph::pass_info>& render_graph::get_passes() const noexcept {
+        return m_passes;
+    }
+
+    const std::vector<render_graph_group>& render_graph::get_groups() const noexcept {
+        return m_groups;
+    }
+
+    const std::vector<render_graph_barrier>& render_graph::get_final_barriers() const noexcept {
+        return m_final_barriers;
+    }
+
+    uint32_t render_graph::get_alias_slot_count() const noexcept {
+        return m_alias_slots;
+    }
+
+    void render_graph::validate() const {
+
+        for (const auto& p : m_passes) {
+
+            const render_graph_image_desc* framebuffer = nullptr;
+            bool has_depth = false;
+
+            for (std::size_t i = 0; i < p.accesses.size(); ++i) {
+
+                const auto& a = p.accesses[i];
+                if (a.image >= m_images.size()) {
+                    throw std::invalid_argument(fmt::format("Pass '{}' accesses an unknown image.", p.name));
+                }
+
+                const auto& image = m_images[a.image];
+                const auto& info = get_access_info(a.access);
+                auto v = static_cast<uint8_t>(a.access);
+
+                if (access_pass_types[v] != p.type) {
+                    throw std::invalid_argument(fmt::format("The {} pass '{}' can't use '{}' as a {}.",
+                        to_string(p.type), p.name, image.name, to_string(a.access)));
+                }
+
+                // one layout per image and pass
+                for (std::size_t j = 0; j < i; ++j) {
+                    const auto& other = p.accesses[j];
+                    if (other.image == a.image && get_access_info(other.access).layout != info.layout) {
+                        throw std::invalid_argument(fmt::format("Pass '{}' uses '{}' as a {} and a {}.",
+                            p.name, image.name, to_string(other.access), to_string(a.access)));
+                    }
+                }
+
+                if (info.attachment) {
+                    if (framebuffer && !same_size(*framebuffer, image.desc)) {
+                        throw std::invalid_argument(fmt::format("The attachments of pass '{}' differ in size.", p.name));
+                    }
+                    framebuffer = &image.desc;
+                }
+
+                if (a.access == render_graph_access::depth_attachment || a.access == render_graph_access::depth_read) {
+                    if (has_depth) {
+                        throw std::invalid_argument(fmt::format("Pass '{}' has more than one depth attachment.", p.name));
+                    }
+                    has_depth = true;
+                }
+
+                if (a.access == render_graph_access::resolve_attachment) {
+                    auto source = std::find_if(p.accesses.begin(), p.accesses.begin() + i, [&] (const pass_access& other) {
+                        return other.image == a.resolve_source && other.access == render_graph_access::color_attachment;
+                    });
+                    if (source == p.accesses.begin() + i) {
+                        throw std::invalid_argument(fmt::format(
+                            "Pass '{}' resolves into '{}' from an image that isn't one of its color attachments.", p.name, image.name));
+                    }
+                    const auto& source_desc = m_images[a.resolve_source].desc;
+                    if (source_desc.samples == VK_SAMPLE_COUNT_1_BIT || image.desc.samples != VK_SAMPLE_COUNT_1_BIT
+                        || source_desc.format != image.desc.format) {
+                        throw std::invalid_argument(fmt::format(
+                            "Pass '{}' resolves into '{}' from an image that isn't a multisampled image of the same format.",
+                            p.name, image.name));
+                    }
+                }
+            }
+
+            if (p.type == render_graph_pass_type::graphics && !framebuffer) {
+                throw std::invalid_argument(fmt::format("The graphics pass '{}' has no attachments.", p.name));
+            }
+        }
+    }
+
+    void render_graph::cull() {
+
+        // images read before they are written keep their contents across frames
+        std::vector<bool> written(m_images.size(), false);
+        for (const auto& p : m_passes) {
+            for (const auto& a : p.accesses) {
+                auto& image = m_images[a.image];
+                if (!written[a.image] && !image.import && reads_contents(a)) {
+                    image.persistent = true;
+                }
+            }
+            for (const auto& a : p.accesses) {
+                written[a.image] = written[a.image] || get_access_info(a.access).write;
+            }
+        }
+
+        // walk backwards, a pass is needed if a later needed pass or the next frame reads what it writes
+        std::vector<bool> needed(m_images.size(), false);
+        for (std::size_t i = 0; i < m_images.size(); ++i) {
+            needed[i] = m_images[i].import.has_value() || m_images[i].persistent;
+        }
+
+        for (auto p = m_passes.rbegin(); p != m_passes.rend(); ++p) {
+
+            bool keep = p->side_effects;
+            for (const auto& a : p->accesses) {
+                keep = keep || (get_access_info(a.access).write && needed[a.image]);
+            }
+
+            p->culled = !keep;
+            if (!keep) {
+                continue;
+            }
+
+            for (const auto& a : p->accesses) {
+                if (get_access_info(a.access).write && !reads_contents(a)) {
+                    needed[a.image] = m_images[a.image].persistent;
+                }
+            }
+            for (const auto& a : p->accesses) {
+                if (reads_contents(a)) {
+                    needed[a.image] = true;
+                }
+            }
+        }
+    }
+
+    bool render_graph::can_merge(const render_graph_group& group, const pass_info& p) const {
+
+        auto framebuffer_of = [&] (const pass_info& q) -> const render_graph_image_desc& {
+            auto a = std::find_if(q.accesses.begin(), q.accesses.end(), [] (const pass_access& a) {
+                return get_access_info(a.access).attachment;
+            });
+            return m_images[a->image].desc;
+        };
+
+        if (!same_size(framebuffer_of(m_passes[group.passes.front()]), framebuffer_of(p))) {
+            return false;
+        }
+
+        // attachments keep one layout over the whole render pass and shaders can't read what it writes
+        for (const auto& a : p.accesses) {
+            const auto& info = get_access_info(a.access);
+            for (auto q : group.passes) {
+                for (const auto& b : m_passes[q].accesses) {
+                    if (b.image != a.image) {
+                        continue;
+                    }
+                    const auto& other = get_access_info(b.access);
+                    if (info.attachment != other.attachment) {
+                        return false;
+                    }
+                    if (info.attachment && info.layout != other.layout) {
+                        return false;
+                    }
+                    if (!info.attachment && (info.write || other.write)) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    void render_graph::merge() {
+        for (pass i = 0; i < m_passes.size(); ++i) {
+
+            auto& p = m_passes[i];
+            if (p.culled) {
+                continue;
+            }
+
+            bool merged = p.type == render_graph_pass_type::graphics && !p.secondary_command_buffers
+                && !m_groups.empty() && m_groups.back().type == render_graph_pass_type::graphics
+                && can_merge(m_groups.back(), p);
+
+            if (!merged) {
+                m_groups.push_back({ p.type, { }, { }, { } });
+            }
+
+            auto& group = m_groups.back();
+            p.group = static_cast<uint32_t>(m_groups.size() - 1);
+            p.subpass = static_cast<uint32_t>(group.passes.size());
+            group.passes.push_back(i);
+        }
+    }
+
+    void render_graph::find_lifetimes() {
+
+        for (const auto& p : m_passes) {
+            if (p.culled) {
+                continue;
+            }
+            for (const auto& a : p.accesses) {
+                auto& image = m_images[a.image];
+                image.first_group = std::min(image.first_group, p.group);
+                image.last_group = std::max(image.last_group, p.group);
+                image.usage |= get_access_info(a.access).usage;
+            }
+        }
+
+        for (auto& image : m_images) {
+            if (image.import || image.persistent || image.first_group != image.last_group) {
+                continue;
+            }
+            if (m_groups[image.first_group].type != render_graph_pass_type::graphics) {
+                continue;
+            }
+
+            // only attachments of a single render pass can stay in tile memory
+            bool attachment_only = true;
+            for (auto p : m_groups[image.first_group].passes) {
+                for (const auto& a : m_passes[p].accesses) {
+                    if (&m_images[a.image] == &image && !get_access_info(a.access).attachment) {
+                        attachment_only = false;
+                    }
+                }
+            }
+            image.lazy = attachment_only;
+        }
+    }
+
+    void render_graph::assign_alias_slots() {
+
+        std::vector<uint32_t> order;
+        for (uint32_t i = 0; i < m_images.size(); ++i) {
+            const auto& image = m_images[i];
+            if (!image.import && image.first_group <= image.last_group) {
+                order.push_back(i);
+            }
+        }
+        std::stable_sort(order.begin(), order.end(), [&] (uint32_t a, uint32_t b) {
+            return m_images[a].first_group < m_images[b].first_group;
+        });
+
+        // first fit over the slots' last uses, lazily allocated memory never shares a slot with regular memory
+        struct slot {
+            uint32_t last_group;
+            bool     lazy;
+            bool     reusable;
+        };
+        std::vector<slot> slots;
+
+        for (auto i : order) {
+            auto& image = m_images[i];
+            auto free = std::find_if(slots.begin(), slots.end(), [&] (const slot& s) {
+                return s.reusable && !image.persistent && s.lazy == image.lazy && s.last_group < image.first_group;
+            });
+            if (free == slots.end()) {
+                slots.push_back({ image.last_group, image.lazy, !image.persistent });
+                image.alias_slot = static_cast<uint32_t>(slots.size() - 1);
+            }
+            else {
+                free->last_group = image.last_group;
+                image.alias_slot = static_cast<uint32_t>(free - slots.begin());
+            }
+        }
+
+        m_alias_slots = static_cast<uint32_t>(slots.size());
+    }
+
+    void render_graph::create_attachments() {
+        for (uint32_t g = 0; g < m_groups.size(); ++g) {
+
+            auto& group = m_groups[g];
+            if (group.type != render_graph_pass_type::graphics) {
+                continue;
+            }
+
+            for (auto p : group.passes) {
+                for (const auto& a : m_passes[p].accesses) {
+
+                    const auto& info = get_access_info(a.access);
+                    if (!info.attachment) {
+                        continue;
+                    }
+                    auto existing = std::find_if(group.attachments.begin(), group.attachments.end(),
+                                                 [&] (const render_graph_attachment& at) { return at.image == a.image; });
+                    if (existing != group.attachments.end()) {
+                        continue;
+                    }
+
+                    const auto& image = m_images[a.image];
+                    bool used_later = image.import || image.persistent || image.last_group > g;
+                    group.attachments.push_back({
+                        a.image, to_load_op(a),
+                        used_later ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                        info.layout
+                    });
+                }
+            }
+        }
+    }
+
+    void render_graph::create_barriers() {
+
+        std::vector<image_state> images(m_images.size());
+        std::vector<slot_state> slots(m_alias_slots);
+
+        // a frame's first accesses depend on the previous frame's last ones, so simulate one frame to reach the steady state
+        auto simulate = [&] (bool record) {
+
+            for (std::size_t i = 0; i < m_images.size(); ++i) {
+                const auto& image = m_images[i];
+                auto& state = images[i];
+                if (image.import) {
+                    state = image_state { image.import->initial_layout, image.import->initial_stages,
+                                          image.import->initial_access, 0, 0, 0, true };
+                }
+                else if (!image.persistent) {
+                    state.live = false;
+                }
+            }
+
+            for (uint32_t g = 0; g < m_groups.size(); ++g) {
+
+                auto& group = m_groups[g];
+                std::vector<uint32_t> barrier_of(m_images.size(), std::numeric_limits<uint32_t>::max());
+                std::vector<bool> touched(m_images.size(), false);
+                std::vector<render_graph_barrier> barriers;
+
+                for (auto p : group.passes) {
+                    for (const auto& a : m_passes[p].accesses) {
+
+                        const auto& image = m_images[a.image];
+                        const auto& info = get_access_info(a.access);
+                        auto& state = images[a.image];
+                        auto written_access = info.access & write_access_mask;
+
+                        // later subpasses and repeated accesses are ordered by the subpass dependencies or the barrier
+                        if (touched[a.image]) {
+                            if (barrier_of[a.image] != std::numeric_limits<uint32_t>::max()) {
+                                auto& b = barriers[barrier_of[a.image]];
+                                b.dst_stages |= info.stages;
+                                b.dst_access |= info.access;
+                            }
+                            if (info.write) {
+                                state.write_stages |= info.stages;
+                                state.write_access |= written_access;
+                            }
+                            else {
+                                state.read_stages |= info.stages;
+                            }
+                            state.visible_stages |= info.stages;
+                            state.visible_access |= info.access;
+                            continue;
+                        }
+                        touched[a.image] = true;
+
+                        std::optional<render_graph_barrier> barrier;
+
+                        if (!state.live) {
+                            // the first use of a transient image, it only has to wait for the previous slot occupant
+                            const auto& slot = slots[image.alias_slot];
+                            barrier = render_graph_barrier { a.image, slot.stages, info.stages, slot.access, info.access,
+                                                             VK_IMAGE_LAYOUT_UNDEFINED, info.layout };
+                            state = image_state { };
+                            state.live = true;
+                        }
+                        else if (state.layout != info.layout) {
+                            barrier = render_graph_barrier { a.image, state.write_stages | state.read_stages, info.stages,
+                                                             state.write_access, info.access, state.layout, info.layout };
+                        }
+                        else if (info.write) {
+                            if (state.write_stages | state.read_stages) {
+                                barrier = render_graph_barrier { a.image, state.write_stages | state.read_stages, info.stages,
+                                                                 state.write_access, info.access, state.layout, info.layout };
+                            }
+                        }
+                        else if (state.write_stages && ((info.stages & ~state.visible_stages) || (info.access & ~state.visible_access))) {
+                            barrier = render_graph_barrier { a.image, state.write_stages, info.stages,
+                                                             state.write_access, info.access, state.layout, info.layout };
+                        }
+
+                        if (barrier) {
+                            barrier_of[a.image] = static_cast<uint32_t>(barriers.size());
+                            barriers.push_back(*barrier);
+                        }
+
+                        bool transition = barrier && barrier->old_layout != barrier->new_layout;
+                        if (info.write) {
+                            state.write_stages = info.stages;
+                            state.write_access = written_access;
+                            state.read_stages = 0;
+                            state.visible_stages = info.stages;
+                            state.visible_access = info.access;
+                        }
+                        else if (transition) {
+                            // the transition is a write the readers wait for
+                            state.write_stages = info.stages;
+                            state.write_access = 0;
+                            state.read_stages = info.stages;
+                            state.visible_stages = info.stages;
+                            state.visible_access = info.access;
+                        }
+                        else {
+                            state.read_stages |= info.stages;
+                            state.visible_stages |= barrier ? info.stages : 0;
+                            state.visible_access |= barrier ? info.access : 0;
+                        }
+                        state.layout = info.layout;
+                    }
+                }
+
+                // the next occupant of a slot waits for the last accesses of the current one
+                for (std::size_t i = 0; i < m_images.size(); ++i) {
+                    const auto& image = m_images[i];
+                    if (image.alias_slot != no_alias_slot && image.last_group == g) {
+                        slots[image.alias_slot] = { images[i].write_stages | images[i].read_stages, images[i].write_access };
+                    }
+                }
+
+                if (record) {
+                    group.barriers = std::move(barriers);
+                }
+            }
+
+            for (std::size_t i = 0; i < m_images.size(); ++i) {
+                const auto& image = m_images[i];
+                auto& state = images[i];
+                if (!image.import || image.first_group > image.last_group) {
+                    continue;
+                }
+                if (image.import->final_layout == VK_IMAGE_LAYOUT_UNDEFINED || image.import->final_layout == state.layout) {
+                    continue;
+                }
+                if (record) {
+                    m_final_barriers.push_back({
+                        static_cast<uint32_t>(i), state.write_stages | state.read_stages, image.import->final_stages,
+                        state.write_access, image.import->final_access, state.layout, image.import->final_layout
+                    });
+                }
+            }
+        };
+
+        simulate(false);
+        simulate(true);
+    }
+}
@@ -0,0 +1,279 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#ifndef BAMBOOENGINE_RENDER_GRAPH_HPP
+#define BAMBOOENGINE_RENDER_GRAPH_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <functional>
+#include <limits>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+namespace bbge {
+
+    struct render_graph_context;
+
+    // What an attachment starts a pass with
+    enum class attachment_load : uint8_t {
+        clear, load, dont_care
+    };
+
+    // How a pass uses an image
+    enum class render_graph_access : uint8_t {
+        color_attachment,
+        depth_attachment,
+        depth_read,         // read-only depth attachment
+        resolve_attachment,
+        fragment_sampled,
+        compute_sampled,
+        storage_read,       // compute shader storage image
+        storage_write,
+        transfer_src,
+        transfer_dst
+    };
+
+    enum class render_graph_pass_type : uint8_t {
+        graphics, compute, transfer
+    };
+
+    /**
+     * @brief Synchronization requirements of an access.
+     */
+    struct render_graph_access_info {
+        VkPipelineStageFlags stages;
+        VkAccessFlags        access;
+        VkImageLayout        layout;
+        VkImageUsageFlags    usage;
+        bool                 write;
+        bool                 attachment;
+    };
+
+    [[nodiscard]] const render_graph_access_info& get_access_info(render_graph_access access) noexcept;
+    [[nodiscard]] std::string_view to_string(render_graph_access access);
+    [[nodiscard]] std::string_view to_string(render_graph_pass_type type);
+
+    struct render_graph_image_desc {
+        VkFormat              format  = VK_FORMAT_UNDEFINED;
+        VkExtent2D            extent  = { 0, 0 };   // zero to follow the graph's extent
+        float                 scale   = 1.0f;       // of the graph's extent if the extent is zero
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+        VkClearValue          clear   = { };        // used by attachment_load::clear
+    };
+
+    /**
+     * @brief State of an image owned outside of the graph, e.g. a swap chain image.
+     */
+    struct render_graph_import {
+        VkImageLayout        initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags initial_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;        // last access before the graph
+        VkAccessFlags        initial_access = 0;
+        VkImageLayout        final_layout   = VK_IMAGE_LAYOUT_UNDEFINED;                // undefined keeps the last layout
+        VkPipelineStageFlags final_stages   = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;     // first access after the graph
+        VkAccessFlags        final_access   = 0;
+    };
+
+    struct render_graph_barrier {
+        uint32_t             image;
+        VkPipelineStageFlags src_stages;
+        VkPipelineStageFlags dst_stages;
+        VkAccessFlags        src_access;
+        VkAccessFlags        dst_access;
+        VkImageLayout        old_layout;
+        VkImageLayout        new_layout;
+    };
+
+    struct render_graph_attachment {
+        uint32_t            image;
+        VkAttachmentLoadOp  load;
+        VkAttachmentStoreOp store;
+        VkImageLayout       layout;
+    };
+
+    /**
+     * @brief Passes that execute after one batch of barriers.
+     * Merged graphics passes are the subpasses of one render pass, compute and transfer passes are alone.
+     */
+    struct render_graph_group {
+        render_graph_pass_type               type;
+        std::vector<uint32_t>                passes;        // in subpass order
+        std::vector<render_graph_barrier>    barriers;      // recorded as one vkCmdPipelineBarrier before the group
+        std::vector<render_graph_attachment> attachments;   // of the render pass, empty unless graphics
+    };
+
+    /**
+     * @brief Frame graph of passes that declare how they access virtual images.
+     * compile() culls passes whose results are never used, merges consecutive graphics passes into the subpasses of one
+     * render pass, batches the barriers between groups of passes and assigns memory slots so that transient images whose
+     * lifetimes don't overlap share the same memory. Created images that are only attachments of one render pass are
+     * lazily allocated and never stored.
+     * The graph only describes the frame, vulkan_render_graph creates the Vulkan objects and records it.
+     */
+    class render_graph {
+    public:
+
+        using resource = uint32_t;
+        using pass = uint32_t;
+        using record_function = std::function<void(const render_graph_context&)>;
+
+        static constexpr uint32_t no_alias_slot = std::numeric_limits<uint32_t>::max();
+
+        struct image_resource {
+            std::string                        name;
+            render_graph_image_desc            desc;
+            std::optional<render_graph_import> import;
+            VkImageUsageFlags                  usage      = 0;
+            uint32_t                           alias_slot = no_alias_slot;  // created images only
+            bool                               lazy       = false;          // never leaves its render pass
+            bool                               persistent = false;          // read before written, keeps its contents
+            uint32_t                           first_group = std::numeric_limits<uint32_t>::max();
+            uint32_t                           last_group  = 0;
+        };
+
+        struct pass_access {
+            resource            image;
+            render_graph_access access;
+            attachment_load     load;
+            resource            resolve_source; // color attachment a resolve attachment resolves
+        };
+
+        struct pass_info {
+            std::string              name;
+            render_graph_pass_type   type;
+            std::vector<pass_access> accesses;
+            record_function          record;
+            bool                     secondary_command_buffers = false;
+            bool                     side_effects              = false;
+            bool                     culled                    = false;
+            uint32_t                 group                     = 0;
+            uint32_t                 subpass                   = 0;
+        };
+
+        /**
+         * @brief Declares the accesses of a pass.
+         */
+        class pass_builder {
+        public:
+
+            pass_builder& color(resource image, attachment_load load = attachment_load::clear);
+
+            /**
+             * @brief Resolve a multisampled color attachment of this pass at the end of the subpass.
+             * @param source Color attachment declared before
+             * @param target Single sampled image
+             */
+            pass_builder& resolve(resource source, resource target);
+            pass_builder& depth(resource image, attachment_load load = attachment_load::clear);
+            pass_builder& depth_read(resource image);
+            pass_builder& sample(resource image);
+            pass_builder& storage_read(resource image);
+            pass_builder& storage_write(resource image);
+            pass_builder& transfer_src(resource image);
+            pass_builder& transfer_dst(resource image);
+
+            /**
+             * @brief The pass records its render pass contents into secondary command buffers.
+             * It isn't merged into a previous render pass since those record subpass 0 only.
+             */
+            pass_builder& secondary_command_buffers();
+
+            /**
+             * @brief Never cull the pass, even if the graph doesn't use its results.
+             */
+            pass_builder& side_effects();
+            pass_builder& record(record_function function);
+
+            [[nodiscard]] pass get() const noexcept;
+
+        private:
+
+            friend class render_graph;
+
+            render_graph& m_graph;
+            pass m_pass;
+
+            pass_builder(render_graph& graph, pass p) noexcept;
+            pass_builder& add(resource image, render_graph_access access, attachment_load load, resource resolve_source = 0);
+        };
+
+        render_graph() = default;
+
+        /**
+         * @brief Declare an image the graph owns.
+         * @param name Debug name
+         * @param desc Description
+         * @return Handle
+         */
+        resource create_image(std::string name, const render_graph_image_desc& desc);
+
+        /**
+         * @brief Declare an image owned outside of the graph. Imported images are never aliased or culled.
+         * @param name Debug name
+         * @param desc Description, the clear value and format are used for attachments
+         * @param import State before and after the graph
+         * @return Handle
+         */
+        resource import_image(std::string name, const render_graph_image_desc& desc, const render_graph_import& import);
+
+        /**
+         * @brief Add a pass. Passes execute in the order they are added.
+         * @param name Debug name
+         * @param type Queue capability the pass needs
+         * @return Builder to declare the accesses
+         */
+        pass_builder add_pass(std::string name, render_graph_pass_type type = render_graph_pass_type::graphics);
+
+        /**
+         * @brief Compile the graph. Throws std::invalid_argument if the graph is inconsistent.
+         */
+        void compile();
+
+        [[nodiscard]] bool is_compiled() const noexcept;
+        [[nodiscard]] const std::vector<image_resource>& get_images() const noexcept;
+        [[nodiscard]] const std::vector<pass_info>& get_passes() const noexcept;
+        [[nodiscard]] const std::vector<render_graph_group>& get_groups() const noexcept;
+
+        /**
+         * @brief Get the barriers that transition imported images to their final layout after the last group.
+         * @return Barriers
+         */
+        [[nodiscard]] const std::vector<render_graph_barrier>& get_final_barriers() const noexcept;
+        [[nodiscard]] uint32_t get_alias_slot_count() const noexcept;
+
+    private:
+
+        std::vector<image_resource> m_images;
+        std::vector<pass_info> m_passes;
+        std::vector<render_graph_group> m_groups;
+        std::vector<render_graph_barrier> m_final_barriers;
+        uint32_t m_alias_slots = 0;
+        bool m_compiled = false;
+
+        void validate() const;
+        void cull();
+        void merge();
+        void find_lifetimes();
+        void assign_alias_slots();
+        void create_attachments();
+        void create_barriers();
+        [[nodiscard]] bool can_merge(const render_graph_group& group, const pass_info& p) const;
+    };
+}
+
+#endif //BAMBOOENGINE_RENDER_GRAPH_HPP
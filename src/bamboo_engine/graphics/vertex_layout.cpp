@@ -0,0 +1,71 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "vertex_layout.hpp"
+
+namespace bbge {
+
+    constexpr std::array<std::string_view, 2> vertex_input_rate_names {
+        "vertex", "instance"
+    };
+
+    std::string_view to_string(vertex_input_rate r) {
+        auto v = static_cast<uint8_t>(r);
+        return vertex_input_rate_names[v];
+    }
+
+    constexpr std::array<VkVertexInputRate, 2> vertex_input_rate_vk_conversion {
+        VK_VERTEX_INPUT_RATE_VERTEX,
+        VK_VERTEX_INPUT_RATE_INSTANCE
+    };
+
+    VkVertexInputRate to_vulkan(vertex_input_rate r) {
+        auto v = static_cast<uint8_t>(r);
+        return vertex_input_rate_vk_conversion[v];
+    }
+
+    constexpr std::array<std::string_view, 2> index_type_names {
+        "uint16", "uint32"
+    };
+
+    std::string_view to_string(index_type t) {
+        auto v = static_cast<uint8_t>(t);
+        return index_type_names[v];
+    }
+
+    constexpr std::array<VkIndexType, 2> index_type_vk_conversion {
+        VK_INDEX_TYPE_UINT16,
+        VK_INDEX_TYPE_UINT32
+    };
+
+    VkIndexType to_vulkan(index_type t) {
+        auto v = static_cast<uint8_t>(t);
+        return index_type_vk_conversion[v];
+    }
+
+    const std::vector<VkVertexInputBindingDescription>& vertex_layout::get_bindings() const noexcept {
+        return m_bindings;
+    }
+
+    const std::vector<VkVertexInputAttributeDescription>& vertex_layout::get_attributes() const noexcept {
+        return m_attributes;
+    }
+
+    bool vertex_layout::empty() const noexcept {
+        return m_bindings.empty();
+    }
+}
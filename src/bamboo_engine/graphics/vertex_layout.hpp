@@ -0,0 +1,186 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VERTEX_LAYOUT_HPP
+#define BAMBOOENGINE_VERTEX_LAYOUT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+namespace bbge {
+
+    /**
+     * @brief Maps a C++ type to the format of a vertex attribute. Specialize it for custom attribute types.
+     */
+    template <typename T>
+    struct vertex_format_of;
+
+    template <> struct vertex_format_of<float>      { static constexpr const VkFormat value = VK_FORMAT_R32_SFLOAT; };
+    template <> struct vertex_format_of<glm::vec2>  { static constexpr const VkFormat value = VK_FORMAT_R32G32_SFLOAT; };
+    template <> struct vertex_format_of<glm::vec3>  { static constexpr const VkFormat value = VK_FORMAT_R32G32B32_SFLOAT; };
+    template <> struct vertex_format_of<glm::vec4>  { static constexpr const VkFormat value = VK_FORMAT_R32G32B32A32_SFLOAT; };
+    template <> struct vertex_format_of<int32_t>    { static constexpr const VkFormat value = VK_FORMAT_R32_SINT; };
+    template <> struct vertex_format_of<glm::ivec2> { static constexpr const VkFormat value = VK_FORMAT_R32G32_SINT; };
+    template <> struct vertex_format_of<glm::ivec3> { static constexpr const VkFormat value = VK_FORMAT_R32G32B32_SINT; };
+    template <> struct vertex_format_of<glm::ivec4> { static constexpr const VkFormat value = VK_FORMAT_R32G32B32A32_SINT; };
+    template <> struct vertex_format_of<uint32_t>   { static constexpr const VkFormat value = VK_FORMAT_R32_UINT; };
+    template <> struct vertex_format_of<glm::uvec2> { static constexpr const VkFormat value = VK_FORMAT_R32G32_UINT; };
+    template <> struct vertex_format_of<glm::uvec3> { static constexpr const VkFormat value = VK_FORMAT_R32G32B32_UINT; };
+    template <> struct vertex_format_of<glm::uvec4> { static constexpr const VkFormat value = VK_FORMAT_R32G32B32A32_UINT; };
+
+    template <typename T>
+    inline constexpr const VkFormat vertex_format_v = vertex_format_of<T>::value;
+
+    template <typename T, typename = void>
+    struct has_vertex_format : std::false_type { };
+
+    template <typename T>
+    struct has_vertex_format<T, std::void_t<decltype(vertex_format_of<T>::value)>> : std::true_type { };
+
+    /**
+     * @brief One attribute of a vertex struct. Every attribute uses one shader location.
+     */
+    struct vertex_member {
+        VkFormat format;
+        uint32_t offset;
+    };
+
+    /**
+     * @brief Describe a member of a vertex struct, e.g. BBGE_VERTEX_MEMBER(mesh_vertex, position).
+     */
+#define BBGE_VERTEX_MEMBER(vertex, member) \
+    ::bbge::vertex_member { ::bbge::vertex_format_v<decltype(vertex::member)>, static_cast<uint32_t>(offsetof(vertex, member)) }
+
+    /**
+     * @brief Attributes of a vertex type, in shader location order.
+     * By default a vertex struct lists them in a static constexpr function:
+     * @code
+     *   struct mesh_vertex {
+     *       glm::vec3 position;
+     *       glm::vec2 uv;
+     *       static constexpr std::array<bbge::vertex_member, 2> vertex_members() {
+     *           return { BBGE_VERTEX_MEMBER(mesh_vertex, position), BBGE_VERTEX_MEMBER(mesh_vertex, uv) };
+     *       }
+     *   };
+     * @endcode
+     * Types with a vertex_format_of specialization are a single attribute, which is how deinterleaved streams are described.
+     */
+    template <typename Vertex, typename = void>
+    struct vertex_traits {
+        static constexpr auto members() noexcept { return Vertex::vertex_members(); }
+    };
+
+    template <typename Vertex>
+    struct vertex_traits<Vertex, std::enable_if_t<has_vertex_format<Vertex>::value>> {
+        static constexpr std::array<vertex_member, 1> members() noexcept { return { vertex_member { vertex_format_v<Vertex>, 0 } }; }
+    };
+
+    /**
+     * @brief Generate the attribute descriptions of a vertex type at compile time.
+     * @tparam Vertex Vertex type
+     * @param binding Binding the vertices are read from
+     * @param first_location Shader location of the first attribute, the others follow consecutively
+     * @return One description per attribute
+     */
+    template <typename Vertex>
+    constexpr auto make_vertex_attributes(uint32_t binding, uint32_t first_location) noexcept {
+        constexpr auto members = vertex_traits<Vertex>::members();
+        std::array<VkVertexInputAttributeDescription, members.size()> attributes { };
+        for (std::size_t i = 0; i < members.size(); ++i) {
+            attributes[i].location = first_location + static_cast<uint32_t>(i);
+            attributes[i].binding  = binding;
+            attributes[i].format   = members[i].format;
+            attributes[i].offset   = members[i].offset;
+        }
+        return attributes;
+    }
+
+    enum class vertex_input_rate : uint8_t {
+        vertex, instance
+    };
+
+    enum class index_type : uint8_t {
+        uint16, uint32
+    };
+
+    template <typename T>
+    struct index_type_of;
+
+    template <> struct index_type_of<uint16_t> { static constexpr const index_type value = index_type::uint16; };
+    template <> struct index_type_of<uint32_t> { static constexpr const index_type value = index_type::uint32; };
+
+    template <typename T>
+    inline constexpr const index_type index_type_v = index_type_of<T>::value;
+
+    // vulkan conversions
+    VkVertexInputRate to_vulkan(vertex_input_rate r);
+    VkIndexType       to_vulkan(index_type t);
+
+    // string conversions
+    std::string_view to_string(vertex_input_rate r);
+    std::string_view to_string(index_type t);
+
+    /**
+     * @brief Vertex input of a pipeline: which buffers are bound and which attributes are read from them.
+     * Bindings are numbered in the order they are added and attribute locations are assigned consecutively.
+     * An empty layout means the vertex shader generates its vertices.
+     */
+    class vertex_layout {
+    public:
+
+        /**
+         * @brief Add a binding that reads tightly packed elements of a vertex type.
+         * Interleaved vertices use one binding per struct, deinterleaved ones one binding per attribute.
+         * @tparam Vertex Vertex struct or single attribute type
+         * @param rate Advance per vertex or per instance
+         * @return This layout
+         */
+        template <typename Vertex>
+        vertex_layout& add_binding(vertex_input_rate rate = vertex_input_rate::vertex);
+
+        [[nodiscard]] const std::vector<VkVertexInputBindingDescription>& get_bindings() const noexcept;
+        [[nodiscard]] const std::vector<VkVertexInputAttributeDescription>& get_attributes() const noexcept;
+        [[nodiscard]] bool empty() const noexcept;
+
+    private:
+
+        std::vector<VkVertexInputBindingDescription> m_bindings;
+        std::vector<VkVertexInputAttributeDescription> m_attributes;
+        uint32_t m_next_location = 0;
+    };
+
+    template <typename Vertex>
+    vertex_layout& vertex_layout::add_binding(vertex_input_rate rate) {
+
+        auto binding = static_cast<uint32_t>(m_bindings.size());
+        m_bindings.push_back({ binding, static_cast<uint32_t>(sizeof(Vertex)), to_vulkan(rate) });
+
+        auto attributes = make_vertex_attributes<Vertex>(binding, m_next_location);
+        m_attributes.insert(m_attributes.end(), attributes.begin(), attributes.end());
+        m_next_location += static_cast<uint32_t>(attributes.size());
+
+        return *this;
+    }
+}
+
+#endif //BAMBOOENGINE_VERTEX_LAYOUT_HPP
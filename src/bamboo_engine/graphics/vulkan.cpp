@@ -17,15 +17,21 @@
 // Created by Leon Suchy on 04.08.20.
 //
 
+#include <algorithm>
+#include <array>
+#include <exception>
 #include "vulkan.hpp"
 #include <SDL2/SDL_vulkan.h>
 #include "../util/logging.hpp"
 #include "vulkan_utils.hpp"
+#include "vulkan_capability_cache.hpp"
+#include "vulkan_pipeline_cache.hpp"
+#include "vulkan_allocator.hpp"
 #include "../client/glfw.hpp"
 
 namespace bbge {
 
-    vulkan_instance::vulkan_instance(const std::string& app_name, version app_version)
+    vulkan_instance::vulkan_instance(const std::string& app_name, version app_version, bool headless)
         : m_application_info(), m_instance() {
 
         // app info
@@ -41,12 +47,15 @@ namespace bbge {
         m_application_info.pApplicationName = app_name.c_str();
         m_application_info.applicationVersion = vulkan_utils::convert_version(app_version);
 
-        // extensions
-        print_available_extensions();
-        std::vector<const char*> extensions = get_required_extensions();
+        // extensions, enumerated once for all checks
+        auto available_extensions = vulkan_utils::query_available_instance_extensions().or_throw();
+        #ifndef NDEBUG
+            print_available_extensions(available_extensions);
+        #endif
+        std::vector<const char*> extensions = get_required_extensions(available_extensions, headless);
         {
             // join with optional extensions
-            std::vector<const char*> optional = get_optional_extensions();
+            std::vector<const char*> optional = get_optional_extensions(available_extensions);
             extensions.reserve(extensions.size() + optional.size());
             extensions.insert(extensions.end(), optional.begin(), optional.end());
         }
@@ -59,10 +68,10 @@ namespace bbge {
             }
         }
 
-        // layers
-        print_available_layers();
+        // layers, only enumerated for validation
         std::vector<const char*> layers;
         #ifndef NDEBUG
+            print_available_layers();
             SPDLOG_DEBUG("Vulkan validations layers are enabled.");
             layers = vulkan_utils::get_validation_layers();
         #endif
@@ -100,29 +109,24 @@ namespace bbge {
     }
 
     vulkan_instance::~vulkan_instance() {
+        // physical device handles die with the instance
+        vulkan_capability_cache::clear();
         vkDestroyInstance(m_instance, nullptr);
 
         SPDLOG_TRACE("Destroyed Vulkan instance.");
     }
 
-    void vulkan_instance::print_available_extensions() {
+    void vulkan_instance::print_available_extensions(const std::vector<VkExtensionProperties>& available) {
 
-        auto exts_res = vulkan_utils::query_available_instance_extensions();
-        exts_res.log_err();
-        if (exts_res.is_err()) return;
         SPDLOG_TRACE("Available Vulkan instance extensions: ");
-        for (const auto& prop : *exts_res.ok()) {
+        for (const auto& prop : available) {
             SPDLOG_TRACE("+ {} at version {}.", prop.extensionName, prop.specVersion);
         }
     }
 
-    std::vector<const char*> vulkan_instance::get_optional_extensions() {
+    std::vector<const char*> vulkan_instance::get_optional_extensions(const std::vector<VkExtensionProperties>& available) {
 
         std::vector<const char*> result;
-        auto available_res = vulkan_utils::query_available_instance_extensions();
-        available_res.log_err();
-        if (available_res.is_err()) return { };
-        auto& available = *available_res.ok();
 
         for (const char* requested : optional_extensions) {
             auto it = std::find_if(available.begin(), available.end(),
@@ -135,7 +139,13 @@ namespace bbge {
         return result;
     }
 
-    std::vector<const char*> vulkan_instance::get_required_extensions() {
+    std::vector<const char*> vulkan_instance::get_required_extensions(const std::vector<VkExtensionProperties>& available,
+                                                                      bool headless) {
+
+        // nothing is presented without a window
+        if (headless) {
+            return { };
+        }
 
         // GLFW
         uint32_t num_exts = 0;
@@ -144,8 +154,6 @@ namespace bbge {
         std::copy(exts, exts + num_exts, result.begin());
 
         // Check if they are available and throw if not
-        auto available = std::move(vulkan_utils::query_available_instance_extensions().or_throw());
-
         for (const char* ext : result) {
             auto it = std::find_if(available.begin(), available.end(),
                                    [ext](const VkExtensionProperties& props) { return std::strcmp(props.extensionName, ext) == 0; });
@@ -206,9 +214,21 @@ namespace bbge {
 
     }
 
+    std::string vulkan_result_code::what() const {
+        return fmt::format("[vulkan] {} (err={}).", context, vulkan_utils::to_string(code));
+    }
+
+    void vulkan_result_code::raise() const {
+        throw vulkan_error(context, code);
+    }
+
     vulkan_function_loader::vulkan_function_loader(VkInstance instance) : m_instance(instance) {
         m_vkCreateDebugUtilsMessengerEXT = (PFN_vkCreateDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
         m_vkDestroyDebugUtilsMessengerEXT = (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
+        m_vkCmdBeginDebugUtilsLabelEXT = (PFN_vkCmdBeginDebugUtilsLabelEXT) vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT");
+        m_vkCmdEndDebugUtilsLabelEXT = (PFN_vkCmdEndDebugUtilsLabelEXT) vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT");
+        m_vkCmdInsertDebugUtilsLabelEXT = (PFN_vkCmdInsertDebugUtilsLabelEXT) vkGetInstanceProcAddr(instance, "vkCmdInsertDebugUtilsLabelEXT");
+        m_vkSetDebugUtilsObjectNameEXT = (PFN_vkSetDebugUtilsObjectNameEXT) vkGetInstanceProcAddr(instance, "vkSetDebugUtilsObjectNameEXT");
     }
 
     VkResult vulkan_function_loader::vkCreateDebugUtilsMessengerEXT(
@@ -229,6 +249,27 @@ namespace bbge {
         return VK_SUCCESS;
     }
 
+    void vulkan_function_loader::vkCmdBeginDebugUtilsLabelEXT(VkCommandBuffer commandBuffer, const VkDebugUtilsLabelEXT* pLabelInfo) {
+        if (m_vkCmdBeginDebugUtilsLabelEXT) m_vkCmdBeginDebugUtilsLabelEXT(commandBuffer, pLabelInfo);
+    }
+
+    void vulkan_function_loader::vkCmdEndDebugUtilsLabelEXT(VkCommandBuffer commandBuffer) {
+        if (m_vkCmdEndDebugUtilsLabelEXT) m_vkCmdEndDebugUtilsLabelEXT(commandBuffer);
+    }
+
+    void vulkan_function_loader::vkCmdInsertDebugUtilsLabelEXT(VkCommandBuffer commandBuffer, const VkDebugUtilsLabelEXT* pLabelInfo) {
+        if (m_vkCmdInsertDebugUtilsLabelEXT) m_vkCmdInsertDebugUtilsLabelEXT(commandBuffer, pLabelInfo);
+    }
+
+    VkResult vulkan_function_loader::vkSetDebugUtilsObjectNameEXT(VkDevice device, const VkDebugUtilsObjectNameInfoEXT* pNameInfo) {
+        if (!m_vkSetDebugUtilsObjectNameEXT) return VkResult::VK_ERROR_EXTENSION_NOT_PRESENT;
+        return m_vkSetDebugUtilsObjectNameEXT(device, pNameInfo);
+    }
+
+    bool vulkan_function_loader::has_debug_utils() const noexcept {
+        return m_vkCmdBeginDebugUtilsLabelEXT && m_vkCmdEndDebugUtilsLabelEXT;
+    }
+
     vulkan_debug_messenger::~vulkan_debug_messenger() {
         auto vkDestroyDebugUtilsMessengerEXT =
             (PFN_vkDestroyDebugUtilsMessengerEXT)
@@ -262,22 +303,41 @@ namespace bbge {
     }
 
     vulkan_device::~vulkan_device() {
+        m_pipeline_cache.reset(); // written back while the device is still alive
+        m_allocator.reset();
         if (m_device) {
             vkDestroyDevice(m_device, nullptr);
             SPDLOG_TRACE("Destroyed Vulkan device.");
         }
     }
 
-    vulkan_device::vulkan_device(VkInstance inst, VkSurfaceKHR surface, const selection_strategy& strat)
+    vulkan_device::vulkan_device(VkInstance inst, VkSurfaceKHR surface, const selection_strategy& strat,
+                                 pipeline_cache_blob cache_blob, const std::filesystem::path& cache_path)
       : m_instance(inst), m_surface(surface),
-        m_physical_device(strat.select(inst, surface).or_throw()), m_device(),
+        m_physical_device(strat.select(inst, surface).or_throw()), m_present_wait(false), m_descriptor_indexing(false),
+        m_descriptor_indexing_properties(),
+        m_get_memory_properties2(nullptr), m_device(),
         m_queue_handles() {
 
-        log_available_physical_devices();
+        // the selection enumerated the devices already, listing them again is only worth it while debugging
+        #ifndef NDEBUG
+            log_available_physical_devices();
+        #endif
+        m_extensions = get_extensions();
+        m_features = get_features();
+        m_present_wait = query_present_wait_support();
+        m_descriptor_indexing = query_descriptor_indexing_support();
+        if (m_descriptor_indexing) {
+            m_descriptor_indexing_properties = query_descriptor_indexing_properties();
+        }
+        m_get_memory_properties2 = query_memory_budget_support();
         auto [device, q_fam_indices] = create_device();
         m_device = device;
         m_queue_family_indices = q_fam_indices;
         m_queue_handles = get_queue_handles(q_fam_indices);
+        create_queue_mutexes();
+        create_pipeline_cache(std::move(cache_blob), cache_path);
+        create_allocator();
     }
 
     result<VkPhysicalDevice, std::runtime_error>
@@ -285,7 +345,7 @@ namespace bbge {
 
         // query devices
         auto devices_res = vulkan_utils::query_physical_devices(instance);
-        if (devices_res.is_err()) return *devices_res.err();
+        if (devices_res.is_err()) return std::runtime_error(devices_res.err()->what());
         auto& devices = *devices_res.ok();
         if (devices.empty()) {
             return { std::runtime_error("No devices connected.") };
@@ -317,6 +377,10 @@ namespace bbge {
     bool vulkan_device::default_selection_strategy::is_device_suitable(VkSurfaceKHR surface, VkPhysicalDevice dev) {
 
         if (!check_graphics_support(dev)) return false;
+
+        // headless devices only render offscreen
+        if (!surface) return true;
+
         if (!check_presentation_support(dev, surface)) return false;
         if (!check_required_extensions(dev)) return false;
         if (!check_swap_chain_support(surface, dev)) return false;
@@ -326,8 +390,7 @@ namespace bbge {
 
     int vulkan_device::default_selection_strategy::score_device(VkPhysicalDevice dev) {
 
-        VkPhysicalDeviceProperties properties;
-        vkGetPhysicalDeviceProperties(dev, &properties);
+        const auto& properties = vulkan_capability_cache::get(dev).properties;
 
         int score = 0;
 
@@ -344,40 +407,27 @@ namespace bbge {
     bool vulkan_device::default_selection_strategy::check_swap_chain_support(
         VkSurfaceKHR surface, VkPhysicalDevice dev) {
 
-        auto formats_res = vulkan_utils::query_surface_formats(dev, surface);
-        if (formats_res.or_else({ }).empty()) return false;
-        auto present_modes_res = vulkan_utils::query_present_modes(dev, surface);
-        if (present_modes_res.or_else({ }).empty()) return false;
+        auto support = vulkan_capability_cache::get_surface_support(dev, surface);
+        if (support.is_err()) return false;
+        const auto& s = **support.ok();
 
-        return true;
+        return !s.formats.empty() && !s.present_modes.empty();
     }
 
     bool vulkan_device::default_selection_strategy::check_required_extensions(VkPhysicalDevice dev) {
 
-        auto extensions_res = vulkan_utils::query_available_device_extensions(dev);
-        auto& extensions = extensions_res.or_throw();
-        for (const char* required : required_extensions) {
-            auto it = std::find_if(extensions.begin(), extensions.end(),
-                                   [required](const VkExtensionProperties& props) { return std::strcmp(required, props.extensionName) == 0; });
-            if (it == extensions.end()) {
-                return false;
-            }
-        }
-
-        return true;
+        const auto& capabilities = vulkan_capability_cache::get(dev);
+        return std::all_of(std::begin(required_extensions), std::end(required_extensions),
+                           [&capabilities](const char* required) { return capabilities.has_extension(required); });
     }
 
     bool vulkan_device::default_selection_strategy::check_presentation_support(VkPhysicalDevice dev, VkSurfaceKHR surface) {
 
-        auto queue_families = vulkan_utils::query_queue_families(dev);
+        auto support = vulkan_capability_cache::get_surface_support(dev, surface);
+        if (support.is_err()) return false;
+        const auto& presentation = (*support.ok())->presentation;
 
-        for (auto it = queue_families.begin(); it != queue_families.end(); ++it) {
-            VkBool32 supported = VK_FALSE;
-            vkGetPhysicalDeviceSurfaceSupportKHR(dev, std::distance(queue_families.begin(), it), surface, &supported);
-            if (supported) return true;
-        }
-
-        return false;
+        return std::any_of(presentation.begin(), presentation.end(), [](VkBool32 supported) { return supported == VK_TRUE; });
     }
 
     bool vulkan_device::default_selection_strategy::check_graphics_support(VkPhysicalDevice dev) {
@@ -387,19 +437,33 @@ namespace bbge {
         };
 
         // Check if all required queue families are supported
-        auto queue_families = vulkan_utils::query_queue_families(dev);
+        const auto& queue_families = vulkan_capability_cache::get(dev).queue_families;
         return std::any_of(queue_families.begin(), queue_families.end(), has_graphics_queue_family);
     }
 
     const vulkan_device::default_selection_strategy vulkan_device::selection_default { };
 
-    vulkan_device::vulkan_device(VkInstance inst, VkSurfaceKHR surface, VkPhysicalDevice dev)
-      : m_instance(inst), m_surface(surface), m_physical_device(dev), m_device(), m_queue_handles() {
-
+    vulkan_device::vulkan_device(VkInstance inst, VkSurfaceKHR surface, VkPhysicalDevice dev, pipeline_cache_blob cache_blob,
+                                 const std::filesystem::path& cache_path)
+      : m_instance(inst), m_surface(surface), m_physical_device(dev), m_present_wait(false), m_descriptor_indexing(false),
+        m_descriptor_indexing_properties(),
+        m_get_memory_properties2(nullptr), m_device(), m_queue_handles() {
+
+        m_extensions = get_extensions();
+        m_features = get_features();
+        m_present_wait = query_present_wait_support();
+        m_descriptor_indexing = query_descriptor_indexing_support();
+        if (m_descriptor_indexing) {
+            m_descriptor_indexing_properties = query_descriptor_indexing_properties();
+        }
+        m_get_memory_properties2 = query_memory_budget_support();
         const auto [device, q_fam_indices] = create_device();
         m_device = device;
         m_queue_family_indices = q_fam_indices;
         m_queue_handles = get_queue_handles(q_fam_indices);
+        create_queue_mutexes();
+        create_pipeline_cache(std::move(cache_blob), cache_path);
+        create_allocator();
     }
 
     std::pair<VkDevice, vulkan_queue_family_indices> vulkan_device::create_device() const {
@@ -409,8 +473,14 @@ namespace bbge {
         vulkan_queue_family_indices q_fam_indices = get_required_queue_family_indices();
         std::set<uint32_t> queue_family_index_set {
             q_fam_indices.graphics,
-            q_fam_indices.presentation
+            q_fam_indices.transfer
         };
+        if (q_fam_indices.presentation != std::numeric_limits<uint32_t>::max()) {
+            queue_family_index_set.insert(q_fam_indices.presentation);
+        }
+        if (q_fam_indices.compute != std::numeric_limits<uint32_t>::max()) {
+            queue_family_index_set.insert(q_fam_indices.compute);
+        }
         std::vector<VkDeviceQueueCreateInfo> q_create_infos;
         q_create_infos.reserve(queue_family_index_set.size());
 
@@ -431,10 +501,7 @@ namespace bbge {
         layers = vulkan_utils::get_validation_layers();
         #endif
 
-        auto extensions = get_extensions();
-        log_device_extensions(extensions);
-
-        VkPhysicalDeviceFeatures features { };
+        log_device_extensions(m_extensions);
 
         VkDeviceCreateInfo create_info { };
         create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -442,9 +509,38 @@ namespace bbge {
         create_info.pQueueCreateInfos = q_create_infos.data();
         create_info.enabledLayerCount = layers.size();
         create_info.ppEnabledLayerNames = layers.data();
-        create_info.enabledExtensionCount = extensions.size();
-        create_info.ppEnabledExtensionNames = extensions.data();
-        create_info.pEnabledFeatures = &features;
+        create_info.enabledExtensionCount = m_extensions.size();
+        create_info.ppEnabledExtensionNames = m_extensions.data();
+        create_info.pEnabledFeatures = &m_features;
+
+        // only the features bindless descriptor sets need
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing { };
+        descriptor_indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        descriptor_indexing.pNext = const_cast<void*>(create_info.pNext);
+        descriptor_indexing.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        descriptor_indexing.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+        descriptor_indexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        descriptor_indexing.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        descriptor_indexing.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        descriptor_indexing.descriptorBindingPartiallyBound = VK_TRUE;
+        descriptor_indexing.runtimeDescriptorArray = VK_TRUE;
+        if (m_descriptor_indexing) {
+            create_info.pNext = &descriptor_indexing;
+        }
+
+        #ifdef VK_KHR_present_wait
+        VkPhysicalDevicePresentIdFeaturesKHR present_id { };
+        present_id.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        present_id.presentId = VK_TRUE;
+        VkPhysicalDevicePresentWaitFeaturesKHR present_wait { };
+        present_wait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        present_id.pNext = const_cast<void*>(create_info.pNext);
+        present_wait.pNext = &present_id;
+        present_wait.presentWait = VK_TRUE;
+        if (m_present_wait) {
+            create_info.pNext = &present_wait;
+        }
+        #endif
 
         VkDevice dev;
         auto res = vkCreateDevice(m_physical_device, &create_info, nullptr, &dev);
@@ -464,46 +560,203 @@ namespace bbge {
         };
 
         vulkan_queue_family_indices family_indices { };
-        auto queue_families = vulkan_utils::query_queue_families(m_physical_device);
+        const auto& queue_families = vulkan_capability_cache::get(m_physical_device).queue_families;
 
         // graphics family
         auto graphics_it = std::find_if(queue_families.begin(), queue_families.end(), has_graphics_queue_family);
         if (graphics_it == queue_families.end()) throw std::logic_error("The device selection strategy selected an unsuitable device.");
         family_indices.graphics = std::distance(queue_families.begin(), graphics_it);
 
-        // presentation family
-        for (auto it = queue_families.begin(); it != queue_families.end(); ++it) {
-            VkBool32 supported = VK_FALSE;
-            auto idx = std::distance(queue_families.begin(), it);
-            vkGetPhysicalDeviceSurfaceSupportKHR(m_physical_device, idx, m_surface, &supported);
-            if (supported) {
-                family_indices.presentation = idx;
-                break;
+        // presentation family, headless devices have none
+        if (m_surface) {
+            const auto& presentation = vulkan_capability_cache::get_surface_support(m_physical_device, m_surface).or_throw()->presentation;
+            auto presentation_it = std::find(presentation.begin(), presentation.end(), VK_TRUE);
+            if (presentation_it != presentation.end()) {
+                family_indices.presentation = std::distance(presentation.begin(), presentation_it);
             }
         }
 
+        // transfer family, prefer one that does nothing but transfers since it maps to the DMA engines
+        const auto find_transfer_family = [&queue_families](VkQueueFlags excluded) {
+            return std::find_if(queue_families.begin(), queue_families.end(), [excluded](const VkQueueFamilyProperties& qf) {
+                return qf.queueCount > 0 && (qf.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(qf.queueFlags & excluded);
+            });
+        };
+        auto transfer_it = find_transfer_family(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+        if (transfer_it == queue_families.end()) {
+            transfer_it = find_transfer_family(VK_QUEUE_GRAPHICS_BIT);
+        }
+        family_indices.transfer = transfer_it != queue_families.end()
+            ? std::distance(queue_families.begin(), transfer_it)
+            : family_indices.graphics;
+
+        // compute family, a family without graphics runs concurrently with the graphics queue
+        const auto find_compute_family = [&queue_families](VkQueueFlags excluded) {
+            return std::find_if(queue_families.begin(), queue_families.end(), [excluded](const VkQueueFamilyProperties& qf) {
+                return qf.queueCount > 0 && (qf.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(qf.queueFlags & excluded);
+            });
+        };
+        auto compute_it = find_compute_family(VK_QUEUE_GRAPHICS_BIT);
+        if (compute_it == queue_families.end() && (graphics_it->queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+            compute_it = graphics_it;
+        }
+        if (compute_it == queue_families.end()) {
+            compute_it = find_compute_family(0);
+        }
+        if (compute_it != queue_families.end()) {
+            family_indices.compute = std::distance(queue_families.begin(), compute_it);
+        }
+
+        SPDLOG_DEBUG("Using queue families graphics={}, presentation={}, transfer={}, compute={}.",
+                     family_indices.graphics, family_indices.presentation, family_indices.transfer,
+                     family_indices.compute);
+
         return family_indices;
     }
 
     std::vector<const char*> vulkan_device::get_extensions() const {
 
+        const auto& capabilities = vulkan_capability_cache::get(m_physical_device);
+        const auto is_available = [&capabilities](const char* name) { return capabilities.has_extension(name); };
+
         // in debug mode we double check the selection strategy's selection
         #ifndef NDEBUG
-            auto extensions = vulkan_utils::query_available_device_extensions(m_physical_device).or_throw();
             for (const char* required : required_extensions) {
-                auto it = std::find_if(extensions.begin(), extensions.end(),
-                                       [required](const VkExtensionProperties& props) { return std::strcmp(required, props.extensionName) == 0; });
-                if (it == extensions.end()) {
+                if (m_surface && !is_available(required)) {
                     throw std::logic_error("The device selection strategy selected an unsuitable device. Not all required extensions are supported.");
                 }
             }
         #endif
 
-        std::vector<const char*> exts(std::size(required_extensions));
-        std::copy(required_extensions, required_extensions + std::size(required_extensions), exts.begin());
+        std::vector<const char*> exts;
+        if (m_surface) {
+            exts.assign(std::begin(required_extensions), std::end(required_extensions));
+        }
+
+        // present ids and waits extend the swap chain, which headless devices don't have
+        const auto needs_swap_chain = [](const char* name) {
+            #ifdef VK_KHR_present_wait
+            return std::strcmp(name, VK_KHR_PRESENT_ID_EXTENSION_NAME) == 0 || std::strcmp(name, VK_KHR_PRESENT_WAIT_EXTENSION_NAME) == 0;
+            #else
+            static_cast<void>(name);
+            return false;
+            #endif
+        };
+
+        // optional extensions are only enabled if the device supports them
+        for (const char* optional : optional_extensions) {
+            if (is_available(optional) && (m_surface || !needs_swap_chain(optional))) {
+                exts.push_back(optional);
+            }
+        }
+
         return exts;
     }
 
+    VkPhysicalDeviceFeatures vulkan_device::get_features() const {
+
+        const auto& supported = vulkan_capability_cache::get(m_physical_device).features;
+
+        // optional features, code using them checks get_enabled_features and falls back otherwise
+        VkPhysicalDeviceFeatures features { };
+        features.multiDrawIndirect = supported.multiDrawIndirect;
+        features.drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
+        features.pipelineStatisticsQuery = supported.pipelineStatisticsQuery;
+        features.sampleRateShading = supported.sampleRateShading;
+
+        return features;
+    }
+
+    bool vulkan_device::query_present_wait_support() const {
+
+        #ifdef VK_KHR_present_wait
+            if (!is_extension_enabled(VK_KHR_PRESENT_ID_EXTENSION_NAME) || !is_extension_enabled(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+                return false;
+            }
+
+            // only available if the instance enabled VK_KHR_get_physical_device_properties2
+            auto get_features2 = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceFeatures2KHR");
+            if (!get_features2) return false;
+
+            VkPhysicalDevicePresentIdFeaturesKHR present_id { };
+            present_id.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+            VkPhysicalDevicePresentWaitFeaturesKHR present_wait { };
+            present_wait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+            present_wait.pNext = &present_id;
+            VkPhysicalDeviceFeatures2KHR features { };
+            features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+            features.pNext = &present_wait;
+            get_features2(m_physical_device, &features);
+
+            return present_id.presentId == VK_TRUE && present_wait.presentWait == VK_TRUE;
+        #else
+            return false;
+        #endif
+    }
+
+    bool vulkan_device::query_descriptor_indexing_support() const {
+
+        if (!is_extension_enabled(VK_KHR_MAINTENANCE3_EXTENSION_NAME) || !is_extension_enabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+            return false;
+        }
+
+        auto get_features2 = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceFeatures2KHR");
+        if (!get_features2) return false;
+
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing { };
+        descriptor_indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2KHR features { };
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features.pNext = &descriptor_indexing;
+        get_features2(m_physical_device, &features);
+
+        return descriptor_indexing.shaderSampledImageArrayNonUniformIndexing == VK_TRUE
+            && descriptor_indexing.shaderStorageBufferArrayNonUniformIndexing == VK_TRUE
+            && descriptor_indexing.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE
+            && descriptor_indexing.descriptorBindingStorageBufferUpdateAfterBind == VK_TRUE
+            && descriptor_indexing.descriptorBindingUpdateUnusedWhilePending == VK_TRUE
+            && descriptor_indexing.descriptorBindingPartiallyBound == VK_TRUE
+            && descriptor_indexing.runtimeDescriptorArray == VK_TRUE;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT vulkan_device::query_descriptor_indexing_properties() const {
+
+        // descriptor indexing support implies the instance enabled VK_KHR_get_physical_device_properties2
+        auto get_properties2 = (PFN_vkGetPhysicalDeviceProperties2KHR) vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceProperties2KHR");
+        if (!get_properties2) return { };
+
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT descriptor_indexing { };
+        descriptor_indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2KHR properties { };
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+        properties.pNext = &descriptor_indexing;
+        get_properties2(m_physical_device, &properties);
+        descriptor_indexing.pNext = nullptr;
+        return descriptor_indexing;
+    }
+
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR vulkan_device::query_memory_budget_support() const {
+
+        if (!is_extension_enabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+            return nullptr;
+        }
+
+        // only available if the instance enabled VK_KHR_get_physical_device_properties2
+        return (PFN_vkGetPhysicalDeviceMemoryProperties2KHR) vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+    }
+
+    void vulkan_device::create_pipeline_cache(pipeline_cache_blob cache_blob, const std::filesystem::path& cache_path) {
+        m_pipeline_cache = std::make_unique<vulkan_pipeline_cache>(
+            m_physical_device, m_device, cache_path,
+            is_extension_enabled(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME),
+            cache_blob.valid() ? cache_blob.get() : vulkan_pipeline_cache::load_blob(cache_path)
+        );
+    }
+
+    void vulkan_device::create_allocator() {
+        m_allocator = std::make_unique<vulkan_allocator>(m_physical_device, m_device);
+    }
+
     void vulkan_device::log_available_physical_devices() const {
 
         auto devices = vulkan_utils::query_physical_devices(m_instance);
@@ -542,11 +795,36 @@ namespace bbge {
         return m_queue_handles;
     }
 
+    std::mutex& vulkan_device::get_queue_mutex(VkQueue queue) const {
+        auto it = std::find_if(m_queue_mutexes.begin(), m_queue_mutexes.end(),
+                               [queue] (const auto& entry) { return entry.first == queue; });
+        if (!queue || it == m_queue_mutexes.end()) {
+            throw std::invalid_argument("Queue doesn't belong to this device.");
+        }
+        return *it->second;
+    }
+
+    void vulkan_device::create_queue_mutexes() {
+        for (auto queue : { m_queue_handles.graphics, m_queue_handles.presentation, m_queue_handles.transfer, m_queue_handles.compute }) {
+            bool known = std::any_of(m_queue_mutexes.begin(), m_queue_mutexes.end(),
+                                     [queue] (const auto& entry) { return entry.first == queue; });
+            if (queue && !known) {
+                m_queue_mutexes.emplace_back(queue, std::make_unique<std::mutex>());
+            }
+        }
+    }
+
     vulkan_device::queue_handles
     vulkan_device::get_queue_handles(const vulkan_queue_family_indices& indices) const {
         queue_handles handles { };
         vkGetDeviceQueue(m_device, indices.graphics, 0, &handles.graphics);
-        vkGetDeviceQueue(m_device, indices.presentation, 0, &handles.presentation);
+        if (indices.presentation != std::numeric_limits<uint32_t>::max()) {
+            vkGetDeviceQueue(m_device, indices.presentation, 0, &handles.presentation);
+        }
+        vkGetDeviceQueue(m_device, indices.transfer, 0, &handles.transfer);
+        if (indices.compute != std::numeric_limits<uint32_t>::max()) {
+            vkGetDeviceQueue(m_device, indices.compute, 0, &handles.compute);
+        }
         return handles;
     }
 
@@ -567,8 +845,72 @@ namespace bbge {
         return m_queue_family_indices;
     }
 
+    bool vulkan_device::has_async_compute() const noexcept {
+        return m_queue_family_indices.compute != std::numeric_limits<uint32_t>::max()
+            && m_queue_family_indices.compute != m_queue_family_indices.graphics;
+    }
+
+    bool vulkan_device::is_headless() const noexcept {
+        return m_surface == VK_NULL_HANDLE;
+    }
+
+    vulkan_pipeline_cache& vulkan_device::get_pipeline_cache() const noexcept {
+        return *m_pipeline_cache;
+    }
+
+    vulkan_allocator& vulkan_device::get_allocator() const noexcept {
+        return *m_allocator;
+    }
+
+    bool vulkan_device::is_extension_enabled(std::string_view name) const noexcept {
+        return std::any_of(m_extensions.begin(), m_extensions.end(),
+                           [name](const char* ext) { return name == ext; });
+    }
+
+    const VkPhysicalDeviceFeatures& vulkan_device::get_enabled_features() const noexcept {
+        return m_features;
+    }
+
+    bool vulkan_device::has_present_wait() const noexcept {
+        return m_present_wait;
+    }
+
+    bool vulkan_device::has_descriptor_indexing() const noexcept {
+        return m_descriptor_indexing;
+    }
+
+    const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& vulkan_device::get_descriptor_indexing_properties() const noexcept {
+        return m_descriptor_indexing_properties;
+    }
+
+    std::vector<vulkan_device::heap_budget> vulkan_device::get_memory_budget() const {
+
+        if (m_get_memory_properties2) {
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT budget { };
+            budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+            VkPhysicalDeviceMemoryProperties2KHR properties { };
+            properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+            properties.pNext = &budget;
+            m_get_memory_properties2(m_physical_device, &properties);
+
+            std::vector<heap_budget> budgets(properties.memoryProperties.memoryHeapCount);
+            for (uint32_t heap = 0; heap < budgets.size(); ++heap) {
+                budgets[heap] = { budget.heapBudget[heap], budget.heapUsage[heap] };
+            }
+            return budgets;
+        }
+
+        auto stats = m_allocator->get_statistics();
+        std::vector<heap_budget> budgets(stats.size());
+        for (std::size_t heap = 0; heap < stats.size(); ++heap) {
+            budgets[heap] = { stats[heap].heap_size / 100 * fallback_budget_percent, stats[heap].reserved };
+        }
+        return budgets;
+    }
+
     vulkan_surface::~vulkan_surface() {
         if (m_surface) {
+            vulkan_capability_cache::invalidate_surface(m_surface);
             vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
             SPDLOG_TRACE("Destroyed Vulkan surface.");
         }
@@ -587,62 +929,137 @@ namespace bbge {
         return m_surface;
     }
 
+    constexpr std::array<std::string_view, 4> present_policy_names {
+        "immediate", "mailbox", "fifo", "fifo relaxed"
+    };
+
+    std::string_view to_string(present_policy p) noexcept {
+        auto v = static_cast<uint8_t>(p);
+        return present_policy_names[v];
+    }
+
     vulkan_swap_chain::vulkan_swap_chain(
         VkPhysicalDevice physical_device, VkDevice device,
         VkSurfaceKHR surface, const glfw_window& window,
-        const vulkan_queue_family_indices& q_fam_indices)
-      : m_device(device), m_handle(VK_NULL_HANDLE), m_image_views() {
+        const vulkan_queue_family_indices& q_fam_indices,
+        const swap_chain_settings& settings)
+      : m_physical_device(physical_device), m_device(device), m_surface(surface), m_window(window),
+        m_queue_settings(pick_queue_settings(q_fam_indices)), m_format(), m_present_mode(),
+        m_image_count(settings.image_count), m_extent(), m_handle(VK_NULL_HANDLE), m_image_views() {
+
+        // format and present mode don't change with the window size, so they're only picked once
+        m_format = pick_surface_format(physical_device, surface);
+        m_present_mode = pick_present_mode(physical_device, surface, settings.policy);
 
         auto capabilities = vulkan_utils::query_surface_capabilities(physical_device, surface).or_throw();
+        create_swap_chain(capabilities, pick_swap_extent(capabilities, window.get_handle()), VK_NULL_HANDLE);
+
+        SPDLOG_TRACE("Created Vulkan swap chain.");
+    }
+
+    void vulkan_swap_chain::create_swap_chain(
+        const VkSurfaceCapabilitiesKHR& capabilities, VkExtent2D extent, VkSwapchainKHR old_swap_chain) {
 
         VkSwapchainCreateInfoKHR create_info { };
         create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
         create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
         create_info.imageArrayLayers = 1;
-        create_info.surface = surface;
+        create_info.surface = m_surface;
         create_info.preTransform = capabilities.currentTransform;
         create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR; // disable window transparency
         create_info.clipped = VK_TRUE;
-        create_info.oldSwapchain = VK_NULL_HANDLE;
+        create_info.oldSwapchain = old_swap_chain; // lets the driver reuse resources of the old swap chain
 
-        // image count
-        auto image_count = std::min(capabilities.minImageCount + 1, capabilities.maxImageCount);
+        // image count, a max of 0 means there is no limit
+        auto image_count = m_image_count > 0 ? std::max(m_image_count, capabilities.minImageCount) : capabilities.minImageCount + 1;
+        if (capabilities.maxImageCount > 0) {
+            image_count = std::min(image_count, capabilities.maxImageCount);
+        }
+        if (m_image_count > 0 && image_count != m_image_count) {
+            SPDLOG_WARN("Requested {} swap chain images, but the surface only supports {} to {}. Using {}.",
+                        m_image_count, capabilities.minImageCount, capabilities.maxImageCount, image_count);
+        }
         create_info.minImageCount = image_count;
 
-        // present mode
-        auto present_mode = pick_present_mode(physical_device, surface);
-        create_info.presentMode = present_mode;
-
-        // surface format
-        m_format = pick_surface_format(physical_device, surface);
+        // cached settings
+        create_info.presentMode = m_present_mode;
         create_info.imageFormat = m_format.format;
         create_info.imageColorSpace = m_format.colorSpace;
-
-        // extent (surface size)
-        m_extent = pick_swap_extent(physical_device, surface, window.get_handle());
-        create_info.imageExtent = m_extent;
+        create_info.imageExtent = extent;
 
         // queue settings
-        auto q_settings = pick_queue_settings(q_fam_indices);
-        create_info.imageSharingMode        = q_settings.image_sharing_mode;
-        create_info.queueFamilyIndexCount   = q_settings.queue_family_indices.size();
-        create_info.pQueueFamilyIndices     = q_settings.queue_family_indices.empty() ? nullptr : q_settings.queue_family_indices.data();
+        create_info.imageSharingMode        = m_queue_settings.image_sharing_mode;
+        create_info.queueFamilyIndexCount   = m_queue_settings.queue_family_indices.size();
+        create_info.pQueueFamilyIndices     = m_queue_settings.queue_family_indices.empty() ? nullptr : m_queue_settings.queue_family_indices.data();
 
         // create the swap chain
-        auto res = vkCreateSwapchainKHR(device, &create_info, nullptr, &m_handle);
+        VkSwapchainKHR handle = VK_NULL_HANDLE;
+        auto res = vkCreateSwapchainKHR(m_device, &create_info, nullptr, &handle);
         if (res != VkResult::VK_SUCCESS) {
             throw vulkan_error("Failed to create swap chain", res);
         }
 
-        SPDLOG_TRACE("Created Vulkan swap chain.");
+        // the members only change once everything exists
+        try {
+            auto images = vulkan_utils::query_swapchain_images(m_device, handle).or_throw();
+            auto views = create_image_views(images);
+            m_handle = handle;
+            m_images = std::move(images);
+            m_image_views = std::move(views);
+            m_extent = extent;
+        }
+        catch (...) {
+            vkDestroySwapchainKHR(m_device, handle, nullptr);
+            throw;
+        }
+    }
+
+    bool vulkan_swap_chain::recreate(uint32_t retire_after_frames) {
+
+        auto capabilities = vulkan_utils::query_surface_capabilities(m_physical_device, m_surface).or_throw();
+        auto extent = pick_swap_extent(capabilities, m_window.get_handle());
+        if (extent.width == 0 || extent.height == 0) {
+            return false; // minimized, try again later
+        }
+
+        // the old swap chain is retired even if creating the new one fails, so it can't be presented to anymore.
+        // Its resources might still be used by frames in flight.
+        retired_resources retired {
+            m_handle,
+            std::move(m_image_views)
+        };
+        m_handle = VK_NULL_HANDLE;
+        m_images.clear();
+        m_image_views.clear();
+
+        std::exception_ptr error;
+        try {
+            create_swap_chain(capabilities, extent, retired.handle);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+
+        if (retire_after_frames == 0) {
+            destroy(retired.handle, retired.image_views);
+        }
+        else {
+            m_retired.push(std::move(retired), retire_after_frames);
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
 
-        m_images = std::move(vulkan_utils::query_swapchain_images(m_device, m_handle).or_throw());
+        SPDLOG_DEBUG("Recreated Vulkan swap chain with extent {}x{}.", m_extent.width, m_extent.height);
+        return true;
+    }
 
+    void vulkan_swap_chain::release_retired(uint64_t frame_number) noexcept {
+        m_retired.release(frame_number, [this] (retired_resources& r) { destroy(r.handle, r.image_views); });
     }
 
     VkSurfaceFormatKHR vulkan_swap_chain::pick_surface_format(VkPhysicalDevice device, VkSurfaceKHR surface) {
-        auto surface_formats = vulkan_utils::query_surface_formats(device, surface);
-        auto& formats = surface_formats.or_throw();
+        const auto& formats = vulkan_capability_cache::get_surface_support(device, surface).or_throw()->formats;
         if (formats.empty()) {
             throw std::logic_error("The device selection strategy selected an unsuitable device. No surface formats are supported.");
         }
@@ -656,24 +1073,42 @@ namespace bbge {
         return formats.front();
     }
 
-    VkPresentModeKHR vulkan_swap_chain::pick_present_mode(VkPhysicalDevice device, VkSurfaceKHR surface) {
-        auto present_modes = vulkan_utils::query_present_modes(device, surface);
-        auto& modes = present_modes.or_throw();
+    VkPresentModeKHR vulkan_swap_chain::pick_present_mode(VkPhysicalDevice device, VkSurfaceKHR surface, present_policy policy) {
+        const auto& modes = vulkan_capability_cache::get_surface_support(device, surface).or_throw()->present_modes;
         if (modes.empty()) {
             throw std::logic_error("No present modes even though VK_PRESENT_MODE_FIFO_KHR should be guaranteed.");
         }
 
-        // prefer triple buffered
-        auto it = std::find(modes.begin(), modes.end(), VK_PRESENT_MODE_MAILBOX_KHR);
-        if (it != modes.end()) return VK_PRESENT_MODE_MAILBOX_KHR;
+        // unsupported modes fall back to the next one with less tearing, immediate keeps its latency with mailbox
+        VkPresentModeKHR preferred = VK_PRESENT_MODE_FIFO_KHR;
+        VkPresentModeKHR fallback = VK_PRESENT_MODE_FIFO_KHR;
+        switch (policy) {
+            case present_policy::immediate:
+                preferred = VK_PRESENT_MODE_IMMEDIATE_KHR;
+                fallback = VK_PRESENT_MODE_MAILBOX_KHR;
+                break;
+            case present_policy::mailbox:
+                preferred = VK_PRESENT_MODE_MAILBOX_KHR;
+                break;
+            case present_policy::fifo_relaxed:
+                preferred = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+                break;
+            default:
+                break;
+        }
 
-        // vsync
-        return VK_PRESENT_MODE_FIFO_KHR; // always available
-    }
+        const auto is_supported = [&modes](VkPresentModeKHR mode) {
+            return std::find(modes.begin(), modes.end(), mode) != modes.end();
+        };
+        if (is_supported(preferred)) return preferred;
 
-    VkExtent2D vulkan_swap_chain::pick_swap_extent(VkPhysicalDevice device, VkSurfaceKHR surface, GLFWwindow* win) {
+        auto mode = is_supported(fallback) ? fallback : VK_PRESENT_MODE_FIFO_KHR; // FIFO is always available
+        SPDLOG_WARN("The {} present policy is not supported by the surface, falling back to {}.",
+                    to_string(policy), mode == VK_PRESENT_MODE_MAILBOX_KHR ? "mailbox" : "fifo");
+        return mode;
+    }
 
-        auto capabilities = vulkan_utils::query_surface_capabilities(device, surface).or_throw();
+    VkExtent2D vulkan_swap_chain::pick_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities, GLFWwindow* win) {
 
         // use automatic resolution pick
         if (capabilities.currentExtent.width != std::numeric_limits<decltype(capabilities.currentExtent.width)>::max()) {
@@ -695,13 +1130,21 @@ namespace bbge {
     }
 
     vulkan_swap_chain::~vulkan_swap_chain() {
-        if (m_handle) {
-            vkDestroySwapchainKHR(m_device, m_handle, nullptr);
-            SPDLOG_TRACE("Destroyed Vulkan swap chain.");
-        }
-        for (auto view : m_image_views) {
+        m_retired.release_all([this] (retired_resources& r) { destroy(r.handle, r.image_views); });
+        destroy(m_handle, m_image_views);
+        SPDLOG_TRACE("Destroyed Vulkan swap chain.");
+    }
+
+    void vulkan_swap_chain::destroy(VkSwapchainKHR handle, std::vector<VkImageView>& views) const noexcept {
+
+        // views reference the swap chain images, so they go first
+        for (auto view : views) {
             vkDestroyImageView(m_device, view, nullptr);
         }
+        views.clear();
+        if (handle) {
+            vkDestroySwapchainKHR(m_device, handle, nullptr);
+        }
     }
 
     vulkan_swap_chain::queue_settings
@@ -731,12 +1174,12 @@ namespace bbge {
         return m_images;
     }
 
-    std::vector<VkImageView> vulkan_swap_chain::create_image_views() const {
+    std::vector<VkImageView> vulkan_swap_chain::create_image_views(const std::vector<VkImage>& images) const {
 
         std::vector<VkImageView> views;
-        views.reserve(m_images.size());
+        views.reserve(images.size());
 
-        for (auto img : m_images) {
+        for (auto img : images) {
 
             VkImageViewCreateInfo create_info { };
             create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -755,6 +1198,7 @@ namespace bbge {
             VkImageView view;
             auto res = vkCreateImageView(m_device, &create_info, nullptr, &view);
             if (res != VkResult::VK_SUCCESS) {
+                for (auto v : views) vkDestroyImageView(m_device, v, nullptr);
                 throw vulkan_error("Failed to create image view", res);
             }
             views.push_back(view);
@@ -767,7 +1211,15 @@ namespace bbge {
         return m_format.format;
     }
 
+    VkPresentModeKHR vulkan_swap_chain::get_present_mode() const noexcept {
+        return m_present_mode;
+    }
+
     const VkExtent2D& vulkan_swap_chain::get_extent() const {
         return m_extent;
     }
+
+    const std::vector<VkImageView>& vulkan_swap_chain::get_image_views() const noexcept {
+        return m_image_views;
+    }
 }
\ No newline at end of file
@@ -20,7 +20,13 @@
 #ifndef BAMBOOENGINE_VULKAN_HPP
 #define BAMBOOENGINE_VULKAN_HPP
 
+#include <cstddef>
+#include <filesystem>
+#include <future>
 #include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 #include <set>
@@ -31,13 +37,37 @@
 #include "../client/window.hpp"
 #include "../util/macros.hpp"
 #include "../util/result.hpp"
+#include "../util/retire_queue.hpp"
 
 namespace bbge {
 
+    class vulkan_pipeline_cache;
+    class vulkan_allocator;
+
     struct vulkan_error : public std::runtime_error {
         vulkan_error(const std::string& msg, VkResult res);
     };
 
+    /**
+     * @brief Cheap error of a failed Vulkan call for callers that usually fall back instead of reporting it.
+     * Holds the result code and a static description, the message is only formatted by what() or raise().
+     */
+    struct vulkan_result_code {
+        VkResult    code;
+        const char* context; // string literal describing the failed operation
+
+        /**
+         * @brief Format the message like a vulkan_error.
+         * @return Message
+         */
+        [[nodiscard]] std::string what() const;
+
+        /**
+         * @brief Throw the error as a vulkan_error, used by result::or_throw().
+         */
+        [[noreturn]] void raise() const;
+    };
+
     /**
      * @brief Loads vulkan extension functions at runtime.
      * The member functions have the same name as their Vulkan counterparts.
@@ -62,6 +92,17 @@ namespace bbge {
             VkDebugUtilsMessengerEXT messenger,
             const VkAllocationCallbacks* pAllocator);
 
+        // debug labels and names are silently skipped if the extension isn't available
+        void vkCmdBeginDebugUtilsLabelEXT(VkCommandBuffer commandBuffer, const VkDebugUtilsLabelEXT* pLabelInfo);
+        void vkCmdEndDebugUtilsLabelEXT(VkCommandBuffer commandBuffer);
+        void vkCmdInsertDebugUtilsLabelEXT(VkCommandBuffer commandBuffer, const VkDebugUtilsLabelEXT* pLabelInfo);
+        VkResult vkSetDebugUtilsObjectNameEXT(VkDevice device, const VkDebugUtilsObjectNameInfoEXT* pNameInfo);
+
+        /**
+         * @brief Check if the debug utils functions were found.
+         * @return True if VK_EXT_debug_utils is enabled
+         */
+        [[nodiscard]] bool has_debug_utils() const noexcept;
 
     private:
 
@@ -69,12 +110,22 @@ namespace bbge {
 
         PFN_vkCreateDebugUtilsMessengerEXT m_vkCreateDebugUtilsMessengerEXT;
         PFN_vkDestroyDebugUtilsMessengerEXT m_vkDestroyDebugUtilsMessengerEXT;
+        PFN_vkCmdBeginDebugUtilsLabelEXT m_vkCmdBeginDebugUtilsLabelEXT;
+        PFN_vkCmdEndDebugUtilsLabelEXT m_vkCmdEndDebugUtilsLabelEXT;
+        PFN_vkCmdInsertDebugUtilsLabelEXT m_vkCmdInsertDebugUtilsLabelEXT;
+        PFN_vkSetDebugUtilsObjectNameEXT m_vkSetDebugUtilsObjectNameEXT;
     };
 
     class vulkan_instance {
     public:
 
-        vulkan_instance(const std::string& app_name, version app_version);
+        /**
+         * @brief Create an instance.
+         * @param app_name Application name
+         * @param app_version Application version
+         * @param headless True to skip the window system extensions, for devices without a surface
+         */
+        vulkan_instance(const std::string& app_name, version app_version, bool headless = false);
         ~vulkan_instance();
 
         BBGE_NO_COPIES(vulkan_instance);
@@ -104,16 +155,18 @@ namespace bbge {
 
         static constexpr const version engine_version { BAMBOOENGINE_VERSION_MAJOR, BAMBOOENGINE_VERSION_MINOR };
         static constexpr const char* optional_extensions[] = {
-            VK_EXT_DEBUG_UTILS_EXTENSION_NAME
+            VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+            VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME // queries extension features on Vulkan 1.0
         };
 
         VkApplicationInfo m_application_info;
         VkInstance m_instance;
 
         // extensions
-        static void print_available_extensions();
-        [[nodiscard]] static std::vector<const char*> get_required_extensions();
-        [[nodiscard]] static std::vector<const char*> get_optional_extensions();
+        static void print_available_extensions(const std::vector<VkExtensionProperties>& available);
+        [[nodiscard]] static std::vector<const char*> get_required_extensions(
+            const std::vector<VkExtensionProperties>& available, bool headless);
+        [[nodiscard]] static std::vector<const char*> get_optional_extensions(const std::vector<VkExtensionProperties>& available);
 
         // layers
         static void print_available_layers();
@@ -140,6 +193,8 @@ namespace bbge {
     struct vulkan_queue_family_indices {
         uint32_t graphics = std::numeric_limits<uint32_t>::max(); // the high value makes API calls fail if not assigned
         uint32_t presentation = std::numeric_limits<uint32_t>::max();
+        uint32_t transfer = std::numeric_limits<uint32_t>::max(); // transfer-only family if available, graphics otherwise
+        uint32_t compute = std::numeric_limits<uint32_t>::max();  // async compute family if available, otherwise any compute family
     };
 
     class vulkan_device {
@@ -173,21 +228,43 @@ namespace bbge {
 
         struct queue_handles {
             VkQueue graphics;
-            VkQueue presentation;
+            VkQueue presentation; // VK_NULL_HANDLE on headless devices
+            VkQueue transfer;
+            VkQueue compute; // VK_NULL_HANDLE if the device has no compute queue
         };
 
+        /**
+         * @brief Memory the process may use from a heap, see VK_EXT_memory_budget.
+         */
+        struct heap_budget {
+            VkDeviceSize budget;    // before allocations may fail or degrade performance
+            VkDeviceSize usage;     // by this process
+        };
+
+        // pipeline cache contents read ahead of device creation, see vulkan_pipeline_cache::load_blob
+        using pipeline_cache_blob = std::future<result<std::vector<std::byte>, std::runtime_error>>;
+
         /**
          * @brief Create a vulkan device. Let the implementation pick a device.
          * @param inst Valid instance
+         * @param surface Surface to present to or VK_NULL_HANDLE for a headless device without presentation
+         * @param strategy Picks the physical device
+         * @param cache_blob Preloaded pipeline cache, read from cache_path if not valid
+         * @param cache_path Location the pipeline cache is read from and written back to
          */
-        explicit vulkan_device(VkInstance inst, VkSurfaceKHR surface, const selection_strategy& strategy = selection_default);
+        explicit vulkan_device(VkInstance inst, VkSurfaceKHR surface, const selection_strategy& strategy = selection_default,
+                               pipeline_cache_blob cache_blob = { }, const std::filesystem::path& cache_path = pipeline_cache_path);
 
         /**
          * @brief Create a vulkan device. Use the provided device.
          * @param inst Valid instance
+         * @param surface Surface to present to or VK_NULL_HANDLE for a headless device without presentation
          * @param dev Device to use
+         * @param cache_blob Preloaded pipeline cache, read from cache_path if not valid
+         * @param cache_path Location the pipeline cache is read from and written back to
          */
-        vulkan_device(VkInstance inst, VkSurfaceKHR surface, VkPhysicalDevice dev);
+        vulkan_device(VkInstance inst, VkSurfaceKHR surface, VkPhysicalDevice dev, pipeline_cache_blob cache_blob = { },
+                      const std::filesystem::path& cache_path = pipeline_cache_path);
 
         ~vulkan_device();
 
@@ -205,6 +282,15 @@ namespace bbge {
          */
         [[nodiscard]] const queue_handles& get_queues() const noexcept;
 
+        /**
+         * @brief Get the lock every submission, present and wait on a queue has to hold.
+         * Queue families share one VkQueue between roles, e.g. transfer and compute on the graphics queue,
+         * and Vulkan requires access to a queue to be externally synchronized, so there is one lock per VkQueue.
+         * @param queue One of the handles returned by get_queues()
+         * @return Lock shared by all roles using that queue
+         */
+        [[nodiscard]] std::mutex& get_queue_mutex(VkQueue queue) const;
+
         /**
          * Get the physical device behind this device.
          * @return Physical device handle
@@ -217,6 +303,73 @@ namespace bbge {
          */
         [[nodiscard]] const vulkan_queue_family_indices& get_queue_family_indices() const noexcept;
 
+        /**
+         * Check if the device was created without a surface. Headless devices have no presentation queue
+         * and no swap chain support, they render to offscreen images only.
+         * @return True if headless
+         */
+        [[nodiscard]] bool is_headless() const noexcept;
+
+        /**
+         * Check if compute work can be submitted to a queue family other than the graphics family.
+         * @return True if the compute queue can overlap graphics work
+         */
+        [[nodiscard]] bool has_async_compute() const noexcept;
+
+        /**
+         * Get the pipeline cache shared by all pipelines created on this device.
+         * @return Pipeline cache
+         */
+        [[nodiscard]] vulkan_pipeline_cache& get_pipeline_cache() const noexcept;
+
+        /**
+         * Get the allocator for buffer and image memory of this device.
+         * @return Device memory allocator
+         */
+        [[nodiscard]] vulkan_allocator& get_allocator() const noexcept;
+
+        /**
+         * Check if an optional device extension was enabled.
+         * @param name Extension name
+         * @return True if the extension is enabled
+         */
+        [[nodiscard]] bool is_extension_enabled(std::string_view name) const noexcept;
+
+        /**
+         * Get the device features that were enabled. Optional features are enabled if the device supports them.
+         * @return Enabled features
+         */
+        [[nodiscard]] const VkPhysicalDeviceFeatures& get_enabled_features() const noexcept;
+
+        /**
+         * Check if presents can be identified and waited for with VK_KHR_present_id and VK_KHR_present_wait.
+         * @return True if both extensions and their features are enabled
+         */
+        [[nodiscard]] bool has_present_wait() const noexcept;
+
+        /**
+         * Check if VK_EXT_descriptor_indexing is enabled with everything bindless descriptor sets need:
+         * partially bound, update after bind and non uniformly indexed runtime arrays of sampled images and storage buffers.
+         * @return True if the features are enabled
+         */
+        [[nodiscard]] bool has_descriptor_indexing() const noexcept;
+
+        /**
+         * Get the descriptor limits of update after bind sets, e.g. how large bindless arrays may be.
+         * @return Descriptor indexing properties, all zero without descriptor indexing
+         */
+        [[nodiscard]] const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& get_descriptor_indexing_properties() const noexcept;
+
+        /**
+         * Get the budget and usage of every memory heap. Without VK_EXT_memory_budget the budget is estimated
+         * as a share of the heap size and the usage is what this device's allocator reserved.
+         * @return Budgets indexed by heap
+         */
+        [[nodiscard]] std::vector<heap_budget> get_memory_budget() const;
+
+        // default location of the pipeline cache blob, relative to the working directory
+        static constexpr const char* pipeline_cache_path = "cache/pipelines.bin";
+
     private:
 
         static constexpr const char* validation_layers[] = {
@@ -227,24 +380,55 @@ namespace bbge {
             "VK_LAYER_LUNARG_object_tracker"
         };
 
+        // only required to present, headless devices don't need them
         static constexpr const char* required_extensions[] = {
             VK_KHR_SWAPCHAIN_EXTENSION_NAME
         };
 
+        static constexpr const char* optional_extensions[] = {
+            VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME,
+            VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+            VK_KHR_MAINTENANCE3_EXTENSION_NAME, // required by descriptor indexing on Vulkan 1.0
+            VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+            VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+        #ifdef VK_KHR_present_wait
+            VK_KHR_PRESENT_ID_EXTENSION_NAME,
+            VK_KHR_PRESENT_WAIT_EXTENSION_NAME
+        #endif
+        };
+
         static const default_selection_strategy selection_default;
         static constexpr const float default_queue_priority = 1.0f;
+        static constexpr const VkDeviceSize fallback_budget_percent = 80;
 
         VkInstance m_instance;
         VkSurfaceKHR m_surface;
         VkPhysicalDevice m_physical_device;
         vulkan_queue_family_indices m_queue_family_indices;
+        std::vector<const char*> m_extensions;
+        VkPhysicalDeviceFeatures m_features;
+        bool m_present_wait;
+        bool m_descriptor_indexing;
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT m_descriptor_indexing_properties;
+        PFN_vkGetPhysicalDeviceMemoryProperties2KHR m_get_memory_properties2; // nullptr without VK_EXT_memory_budget
         VkDevice m_device;
         queue_handles m_queue_handles;
+        std::vector<std::pair<VkQueue, std::unique_ptr<std::mutex>>> m_queue_mutexes; // one per distinct queue
+        std::unique_ptr<vulkan_pipeline_cache> m_pipeline_cache;
+        std::unique_ptr<vulkan_allocator> m_allocator;
 
         [[nodiscard]] std::pair<VkDevice, vulkan_queue_family_indices> create_device() const;
         [[nodiscard]] vulkan_queue_family_indices get_required_queue_family_indices() const;
         [[nodiscard]] std::vector<const char*> get_extensions() const;
+        [[nodiscard]] VkPhysicalDeviceFeatures get_features() const;
+        [[nodiscard]] bool query_present_wait_support() const;
+        [[nodiscard]] bool query_descriptor_indexing_support() const;
+        [[nodiscard]] VkPhysicalDeviceDescriptorIndexingPropertiesEXT query_descriptor_indexing_properties() const;
+        [[nodiscard]] PFN_vkGetPhysicalDeviceMemoryProperties2KHR query_memory_budget_support() const;
+        void create_pipeline_cache(pipeline_cache_blob cache_blob, const std::filesystem::path& cache_path);
+        void create_allocator();
         [[nodiscard]] queue_handles get_queue_handles(const vulkan_queue_family_indices& indices) const;
+        void create_queue_mutexes();
 
         // logging
         void log_available_physical_devices() const;
@@ -278,6 +462,23 @@ namespace bbge {
         VkSurfaceKHR m_surface;
     };
 
+    /**
+     * @brief How presented images are queued. Modes the surface doesn't support fall back towards FIFO.
+     */
+    enum class present_policy : uint8_t {
+        immediate,      // no vsync, may tear, lowest latency
+        mailbox,        // vsync, a new image replaces the queued one instead of waiting
+        fifo,           // vsync, always supported
+        fifo_relaxed    // vsync, but late images are presented immediately and may tear
+    };
+
+    [[nodiscard]] std::string_view to_string(present_policy p) noexcept;
+
+    struct swap_chain_settings {
+        present_policy  policy      = present_policy::mailbox;
+        uint32_t        image_count = 0; // clamped to the surface's limits, 0 picks the minimum plus one
+    };
+
     class vulkan_swap_chain {
     public:
 
@@ -286,7 +487,8 @@ namespace bbge {
         vulkan_swap_chain(
             VkPhysicalDevice physical_device, VkDevice device,
             VkSurfaceKHR surface, const glfw_window& window,
-            const vulkan_queue_family_indices& q_fam_indices);
+            const vulkan_queue_family_indices& q_fam_indices,
+            const swap_chain_settings& settings = { });
 
         ~vulkan_swap_chain();
 
@@ -308,31 +510,75 @@ namespace bbge {
          */
         [[nodiscard]] VkFormat get_format() const noexcept;
 
+        /**
+         * Get the present mode picked for the policy on construction.
+         * @return Present mode
+         */
+        [[nodiscard]] VkPresentModeKHR get_present_mode() const noexcept;
+
         /**
          * Get the current extent of this swap chain.
          * @return Extent. Should match the window size.
          */
         [[nodiscard]] const VkExtent2D& get_extent() const;
 
+        /**
+         * Get the image views, one for each swap chain image.
+         * @return Image views in the same order as the images
+         */
+        [[nodiscard]] const std::vector<VkImageView>& get_image_views() const noexcept;
+
+        /**
+         * Recreate the swap chain in place, e.g. after the window was resized.
+         * The surface format and present mode picked on construction are reused.
+         * The old swap chain is handed to the driver as oldSwapchain and kept alive together with
+         * its views until release_retired() was called for retire_after_frames more frames.
+         * @param retire_after_frames Number of frames until the old resources are guaranteed to be unused
+         * @return False if the surface has a zero extent (minimized window) and no swap chain was created
+         */
+        bool recreate(uint32_t retire_after_frames);
+
+        /**
+         * Count down the retired resources of previous recreations and destroy those that are no longer in use.
+         * Call after waiting for the frame's fence. Calls for a frame number that was counted already do nothing,
+         * so a frame that is begun again after a failed acquire doesn't count twice.
+         * @param frame_number Number of the frame that is about to be recorded
+         */
+        void release_retired(uint64_t frame_number) noexcept;
+
     private:
 
+        struct queue_settings {
+            VkSharingMode image_sharing_mode;
+            std::vector<uint32_t> queue_family_indices;
+        };
+
+        struct retired_resources {
+            VkSwapchainKHR handle;
+            std::vector<VkImageView> image_views;
+        };
+
+        VkPhysicalDevice m_physical_device;
         VkDevice m_device;
+        VkSurfaceKHR m_surface;
+        const glfw_window& m_window;
+        queue_settings m_queue_settings;
         VkSurfaceFormatKHR m_format;
+        VkPresentModeKHR m_present_mode;
+        uint32_t m_image_count; // requested, 0 picks the minimum plus one
         VkExtent2D m_extent;
         VkSwapchainKHR m_handle;
         std::vector<VkImage> m_images;
         std::vector<VkImageView> m_image_views;
-
-        struct queue_settings {
-            VkSharingMode image_sharing_mode;
-            std::vector<uint32_t> queue_family_indices;
-        };
+        retire_queue<retired_resources> m_retired;
 
         [[nodiscard]] static VkSurfaceFormatKHR pick_surface_format(VkPhysicalDevice dev, VkSurfaceKHR surface);
-        [[nodiscard]] static VkPresentModeKHR pick_present_mode(VkPhysicalDevice device, VkSurfaceKHR surface);
-        [[nodiscard]] static VkExtent2D pick_swap_extent(VkPhysicalDevice device, VkSurfaceKHR surface, GLFWwindow* win);
+        [[nodiscard]] static VkPresentModeKHR pick_present_mode(VkPhysicalDevice device, VkSurfaceKHR surface, present_policy policy);
+        [[nodiscard]] static VkExtent2D pick_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities, GLFWwindow* win);
         [[nodiscard]] static queue_settings pick_queue_settings(const vulkan_queue_family_indices& q_fam_indices);
-        [[nodiscard]] std::vector<VkImageView> create_image_views() const;
+        void create_swap_chain(const VkSurfaceCapabilitiesKHR& capabilities, VkExtent2D extent, VkSwapchainKHR old_swap_chain);
+        [[nodiscard]] std::vector<VkImageView> create_image_views(const std::vector<VkImage>& images) const;
+        void destroy(VkSwapchainKHR handle, std::vector<VkImageView>& views) const noexcept;
     };
 }
 
@@ -0,0 +1,616 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <bitset>
+#include <utility>
+#include "vulkan_allocator.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        constexpr const uint32_t resource_kind_count = 2;
+
+        VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) noexcept {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        double to_mib(VkDeviceSize bytes) noexcept {
+            return static_cast<double>(bytes) / (1024.0 * 1024.0);
+        }
+
+        struct memory_flags {
+            VkMemoryPropertyFlags required;
+            VkMemoryPropertyFlags preferred;
+            VkMemoryPropertyFlags avoided;
+        };
+
+        memory_flags get_memory_flags(memory_usage usage) noexcept {
+            switch (usage) {
+                case memory_usage::gpu_only:
+                    return { 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT };
+                case memory_usage::cpu_to_gpu:
+                    // keep small host visible device local heaps free for resources that need them
+                    return {
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                    };
+                case memory_usage::gpu_to_cpu:
+                    return {
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 0
+                    };
+                case memory_usage::gpu_lazily_allocated:
+                    return {
+                        0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                    };
+            }
+            return { 0, 0, 0 };
+        }
+    }
+
+    vulkan_buffer::vulkan_buffer(vulkan_allocator& allocator, VkBuffer handle, const vulkan_allocation& allocation,
+                                 VkDeviceSize size) noexcept
+      : m_allocator(&allocator), m_handle(handle), m_allocation(allocation), m_size(size) {
+
+    }
+
+    vulkan_buffer::vulkan_buffer(vulkan_buffer&& other) noexcept
+      : m_allocator(std::exchange(other.m_allocator, nullptr)),
+        m_handle(std::exchange(other.m_handle, VK_NULL_HANDLE)),
+        m_allocation(std::exchange(other.m_allocation, { })), m_size(std::exchange(other.m_size, 0)) {
+
+    }
+
+    vulkan_buffer& vulkan_buffer::operator=(vulkan_buffer&& other) noexcept {
+        if (this != &other) {
+            destroy();
+            m_allocator = std::exchange(other.m_allocator, nullptr);
+            m_handle = std::exchange(other.m_handle, VK_NULL_HANDLE);
+            m_allocation = std::exchange(other.m_allocation, { });
+            m_size = std::exchange(other.m_size, 0);
+        }
+        return *this;
+    }
+
+    vulkan_buffer::~vulkan_buffer() {
+        destroy();
+    }
+
+    VkBuffer vulkan_buffer::get_handle() const noexcept {
+        return m_handle;
+    }
+
+    VkDeviceSize vulkan_buffer::get_size() const noexcept {
+        return m_size;
+    }
+
+    const vulkan_allocation& vulkan_buffer::get_allocation() const noexcept {
+        return m_allocation;
+    }
+
+    std::byte* vulkan_buffer::get_mapped() const noexcept {
+        return m_allocation.mapped;
+    }
+
+    void vulkan_buffer::destroy() noexcept {
+        if (!m_allocator) return;
+        if (m_handle) vkDestroyBuffer(m_allocator->get_device(), m_handle, nullptr);
+        m_allocator->free(m_allocation);
+        m_allocator = nullptr;
+        m_handle = VK_NULL_HANDLE;
+    }
+
+    vulkan_image::vulkan_image(vulkan_allocator& allocator, VkImage handle, const vulkan_allocation& allocation,
+                               const VkImageCreateInfo& info) noexcept
+      : m_allocator(&allocator), m_handle(handle), m_allocation(allocation),
+        m_format(info.format), m_extent(info.extent), m_mip_levels(info.mipLevels) {
+
+    }
+
+    vulkan_image::vulkan_image(vulkan_image&& other) noexcept
+      : m_allocator(std::exchange(other.m_allocator, nullptr)),
+        m_handle(std::exchange(other.m_handle, VK_NULL_HANDLE)),
+        m_allocation(std::exchange(other.m_allocation, { })),
+        m_format(other.m_format), m_extent(other.m_extent), m_mip_levels(other.m_mip_levels) {
+
+    }
+
+    vulkan_image& vulkan_image::operator=(vulkan_image&& other) noexcept {
+        if (this != &other) {
+            destroy();
+            m_allocator = std::exchange(other.m_allocator, nullptr);
+            m_handle = std::exchange(other.m_handle, VK_NULL_HANDLE);
+            m_allocation = std::exchange(other.m_allocation, { });
+            m_format = other.m_format;
+            m_extent = other.m_extent;
+            m_mip_levels = other.m_mip_levels;
+        }
+        return *this;
+    }
+
+    vulkan_image::~vulkan_image() {
+        destroy();
+    }
+
+    VkImage vulkan_image::get_handle() const noexcept {
+        return m_handle;
+    }
+
+    VkFormat vulkan_image::get_format() const noexcept {
+        return m_format;
+    }
+
+    VkExtent3D vulkan_image::get_extent() const noexcept {
+        return m_extent;
+    }
+
+    uint32_t vulkan_image::get_mip_levels() const noexcept {
+        return m_mip_levels;
+    }
+
+    const vulkan_allocation& vulkan_image::get_allocation() const noexcept {
+        return m_allocation;
+    }
+
+    void vulkan_image::destroy() noexcept {
+        if (!m_allocator) return;
+        if (m_handle) vkDestroyImage(m_allocator->get_device(), m_handle, nullptr);
+        m_allocator->free(m_allocation);
+        m_allocator = nullptr;
+        m_handle = VK_NULL_HANDLE;
+    }
+
+    vulkan_allocator::vulkan_allocator(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize block_size)
+      : m_device(device), m_memory_properties(), m_buffer_image_granularity(1), m_max_allocation_count(0),
+        m_block_size(block_size), m_separate_kinds(true), m_dedicated(), m_device_allocation_count(0) {
+
+        vkGetPhysicalDeviceMemoryProperties(physical_device, &m_memory_properties);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device, &properties);
+        m_buffer_image_granularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+        m_max_allocation_count = properties.limits.maxMemoryAllocationCount;
+        m_separate_kinds = m_buffer_image_granularity > 1;
+
+        m_pools.resize(m_memory_properties.memoryTypeCount * resource_kind_count);
+        for (uint32_t type = 0; type < m_memory_properties.memoryTypeCount; ++type) {
+
+            // a single block should not take up a large part of a small heap
+            auto heap_size = m_memory_properties.memoryHeaps[m_memory_properties.memoryTypes[type].heapIndex].size;
+            auto pool_block_size = std::min(m_block_size, std::max<VkDeviceSize>(heap_size / 8, 1 << 20));
+
+            for (uint32_t kind = 0; kind < resource_kind_count; ++kind) {
+                auto& pool = m_pools[type * resource_kind_count + kind];
+                pool.memory_type = type;
+                pool.block_size = pool_block_size;
+            }
+        }
+
+        SPDLOG_TRACE("Created Vulkan allocator (block size={} MiB, buffer image granularity={}).",
+                     to_mib(m_block_size), m_buffer_image_granularity);
+    }
+
+    vulkan_allocator::~vulkan_allocator() {
+
+        log_statistics();
+
+        for (auto& pool : m_pools) {
+            for (auto& block : pool.blocks) {
+                if (!block) continue;
+                if (!block->allocator.is_empty()) {
+                    SPDLOG_WARN("Freeing device memory block with {} live allocations.", block->allocator.get_allocation_count());
+                }
+                free_device_memory(block->memory);
+            }
+        }
+
+        for (uint32_t type = 0; type < m_memory_properties.memoryTypeCount; ++type) {
+            if (m_dedicated[type].count > 0) {
+                SPDLOG_WARN("{} dedicated allocations of memory type {} were leaked.", m_dedicated[type].count, type);
+            }
+        }
+
+        SPDLOG_TRACE("Destroyed Vulkan allocator.");
+    }
+
+    result<vulkan_allocation, vulkan_error> vulkan_allocator::allocate(
+        const VkMemoryRequirements& requirements, memory_usage usage, resource_kind kind) {
+
+        auto memory_type = find_memory_type(requirements.memoryTypeBits, usage);
+        if (!memory_type) {
+            return vulkan_error("No compatible memory type", VkResult::VK_ERROR_FEATURE_NOT_PRESENT);
+        }
+
+        std::lock_guard lock(m_mutex);
+
+        auto pool_index = get_pool_index(*memory_type, kind);
+        auto& pool = m_pools[pool_index];
+
+        // large resources would waste most of a block
+        if (requirements.size > pool.block_size / 2) {
+            return allocate_dedicated(requirements.size, *memory_type);
+        }
+
+        return allocate_from_pool(pool, pool_index, requirements);
+    }
+
+    void vulkan_allocator::free(vulkan_allocation& allocation) noexcept {
+
+        std::lock_guard lock(m_mutex);
+
+        switch (allocation.source) {
+            case vulkan_allocation::source_type::pool: {
+                auto& pool = m_pools[allocation.pool];
+                auto& block = pool.blocks[allocation.block];
+                block->allocator.free(allocation.handle);
+
+                // keep one block alive per pool, so alternating allocations do not thrash vkAllocateMemory
+                if (block->allocator.is_empty()) {
+                    auto live_blocks = std::count_if(pool.blocks.begin(), pool.blocks.end(),
+                                                     [](const auto& b) { return b.has_value(); });
+                    if (live_blocks > 1) {
+                        free_device_memory(block->memory);
+                        block.reset();
+                    }
+                }
+                break;
+            }
+            case vulkan_allocation::source_type::dedicated:
+                free_device_memory(allocation.memory);
+                m_dedicated[allocation.memory_type].bytes -= allocation.size;
+                --m_dedicated[allocation.memory_type].count;
+                break;
+            case vulkan_allocation::source_type::arena:
+            case vulkan_allocation::source_type::none:
+                break;
+        }
+
+        allocation = { };
+    }
+
+    vulkan_buffer vulkan_allocator::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, memory_usage memory,
+                                                  gsl::span<const uint32_t> queue_families) {
+
+        VkBufferCreateInfo create_info { };
+        create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        create_info.size = size;
+        create_info.usage = usage;
+        create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (queue_families.size() > 1) {
+            create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            create_info.queueFamilyIndexCount = static_cast<uint32_t>(queue_families.size());
+            create_info.pQueueFamilyIndices = queue_families.data();
+        }
+
+        VkBuffer buffer;
+        auto res = vkCreateBuffer(m_device, &create_info, nullptr, &buffer);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to create buffer", res);
+        }
+
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(m_device, buffer, &requirements);
+
+        auto allocation = allocate(requirements, memory, resource_kind::linear);
+        if (allocation.is_err()) {
+            vkDestroyBuffer(m_device, buffer, nullptr);
+            throw *allocation.err();
+        }
+
+        res = vkBindBufferMemory(m_device, buffer, allocation.ok()->memory, allocation.ok()->offset);
+        if (res != VkResult::VK_SUCCESS) {
+            vkDestroyBuffer(m_device, buffer, nullptr);
+            free(*allocation.ok());
+            throw vulkan_error("Failed to bind buffer memory", res);
+        }
+
+        return vulkan_buffer(*this, buffer, *allocation.ok(), size);
+    }
+
+    vulkan_image vulkan_allocator::create_image(const VkImageCreateInfo& info, memory_usage memory) {
+
+        VkImage image;
+        auto res = vkCreateImage(m_device, &info, nullptr, &image);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to create image", res);
+        }
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(m_device, image, &requirements);
+
+        auto kind = info.tiling == VK_IMAGE_TILING_LINEAR ? resource_kind::linear : resource_kind::optimal;
+        auto allocation = allocate(requirements, memory, kind);
+        if (allocation.is_err()) {
+            vkDestroyImage(m_device, image, nullptr);
+            throw *allocation.err();
+        }
+
+        res = vkBindImageMemory(m_device, image, allocation.ok()->memory, allocation.ok()->offset);
+        if (res != VkResult::VK_SUCCESS) {
+            vkDestroyImage(m_device, image, nullptr);
+            free(*allocation.ok());
+            throw vulkan_error("Failed to bind image memory", res);
+        }
+
+        return vulkan_image(*this, image, *allocation.ok(), info);
+    }
+
+    std::optional<uint32_t> vulkan_allocator::find_memory_type(uint32_t type_bits, memory_usage usage) const noexcept {
+
+        auto flags = get_memory_flags(usage);
+
+        std::optional<uint32_t> best;
+        int best_score = std::numeric_limits<int>::min();
+
+        for (uint32_t type = 0; type < m_memory_properties.memoryTypeCount; ++type) {
+
+            if ((type_bits & (1u << type)) == 0) continue;
+
+            auto properties = m_memory_properties.memoryTypes[type].propertyFlags;
+            if ((properties & flags.required) != flags.required) continue;
+
+            // lower indices win ties, drivers order the types by preference
+            int score = 2 * static_cast<int>(std::bitset<32>(properties & flags.preferred).count())
+                          - static_cast<int>(std::bitset<32>(properties & flags.avoided).count());
+            if (score > best_score) {
+                best = type;
+                best_score = score;
+            }
+        }
+
+        return best;
+    }
+
+    std::vector<vulkan_allocator::heap_statistics> vulkan_allocator::get_statistics() const {
+
+        std::vector<heap_statistics> stats(m_memory_properties.memoryHeapCount);
+        for (uint32_t heap = 0; heap < m_memory_properties.memoryHeapCount; ++heap) {
+            stats[heap].heap_size = m_memory_properties.memoryHeaps[heap].size;
+            stats[heap].device_local =
+                (m_memory_properties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        }
+
+        std::lock_guard lock(m_mutex);
+
+        for (const auto& pool : m_pools) {
+            auto& s = stats[m_memory_properties.memoryTypes[pool.memory_type].heapIndex];
+            for (const auto& block : pool.blocks) {
+                if (!block) continue;
+                s.reserved += block->allocator.get_size();
+                s.used += block->allocator.get_used();
+                s.allocation_count += block->allocator.get_allocation_count();
+                ++s.block_count;
+            }
+        }
+
+        for (uint32_t type = 0; type < m_memory_properties.memoryTypeCount; ++type) {
+            auto& s = stats[m_memory_properties.memoryTypes[type].heapIndex];
+            s.reserved += m_dedicated[type].bytes;
+            s.used += m_dedicated[type].bytes;
+            s.dedicated_count += m_dedicated[type].count;
+            s.allocation_count += m_dedicated[type].count;
+        }
+
+        return stats;
+    }
+
+    void vulkan_allocator::log_statistics() const {
+
+        auto stats = get_statistics();
+        for (std::size_t heap = 0; heap < stats.size(); ++heap) {
+            const auto& s = stats[heap];
+            SPDLOG_DEBUG(
+                "Memory heap {}{}: {:.1f} of {:.1f} MiB reserved ({:.1f} MiB used) in {} blocks and {} dedicated allocations, {} allocations.",
+                heap, s.device_local ? " (device local)" : "", to_mib(s.reserved), to_mib(s.heap_size), to_mib(s.used),
+                s.block_count, s.dedicated_count, s.allocation_count
+            );
+        }
+    }
+
+    VkDevice vulkan_allocator::get_device() const noexcept {
+        return m_device;
+    }
+
+    VkDeviceSize vulkan_allocator::get_buffer_image_granularity() const noexcept {
+        return m_buffer_image_granularity;
+    }
+
+    const VkPhysicalDeviceMemoryProperties& vulkan_allocator::get_memory_properties() const noexcept {
+        return m_memory_properties;
+    }
+
+    uint32_t vulkan_allocator::get_pool_index(uint32_t memory_type, resource_kind kind) const noexcept {
+        auto kind_index = m_separate_kinds ? static_cast<uint32_t>(kind) : 0;
+        return memory_type * resource_kind_count + kind_index;
+    }
+
+    result<vulkan_allocation, vulkan_error> vulkan_allocator::allocate_from_pool(
+        memory_pool& pool, uint32_t pool_index, const VkMemoryRequirements& requirements) {
+
+        auto make_allocation = [&](uint32_t block_index, const tlsf_allocator::allocation& a) {
+            const auto& block = *pool.blocks[block_index];
+            vulkan_allocation allocation;
+            allocation.memory = block.memory;
+            allocation.offset = a.offset;
+            allocation.size = a.size;
+            allocation.mapped = block.mapped ? block.mapped + a.offset : nullptr;
+            allocation.memory_type = pool.memory_type;
+            allocation.source = vulkan_allocation::source_type::pool;
+            allocation.pool = pool_index;
+            allocation.block = block_index;
+            allocation.handle = a.block;
+            return allocation;
+        };
+
+        auto alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+
+        std::optional<uint32_t> empty_slot;
+        for (uint32_t i = 0; i < pool.blocks.size(); ++i) {
+            auto& block = pool.blocks[i];
+            if (!block) {
+                if (!empty_slot) empty_slot = i;
+                continue;
+            }
+
+            auto a = block->allocator.allocate(requirements.size, alignment);
+            if (a) return make_allocation(i, *a);
+        }
+
+        // every block is full, reserve a new one
+        auto memory = allocate_device_memory(pool.block_size, pool.memory_type);
+        if (memory.is_err()) {
+            return *memory.err();
+        }
+
+        auto block_index = empty_slot ? *empty_slot : static_cast<uint32_t>(pool.blocks.size());
+        if (!empty_slot) pool.blocks.emplace_back();
+        pool.blocks[block_index].emplace(memory_block { memory.ok()->first, memory.ok()->second, tlsf_allocator(pool.block_size) });
+
+        SPDLOG_DEBUG("Reserved {:.1f} MiB device memory block (memory type={}, pool={}, blocks={}).",
+                     to_mib(pool.block_size), pool.memory_type, pool_index, pool.blocks.size());
+
+        auto a = pool.blocks[block_index]->allocator.allocate(requirements.size, alignment);
+        if (!a) {
+            return vulkan_error("Allocation does not fit into an empty memory block", VkResult::VK_ERROR_OUT_OF_DEVICE_MEMORY);
+        }
+        return make_allocation(block_index, *a);
+    }
+
+    result<vulkan_allocation, vulkan_error> vulkan_allocator::allocate_dedicated(VkDeviceSize size, uint32_t memory_type) {
+
+        auto memory = allocate_device_memory(size, memory_type);
+        if (memory.is_err()) {
+            return *memory.err();
+        }
+
+        m_dedicated[memory_type].bytes += size;
+        ++m_dedicated[memory_type].count;
+
+        vulkan_allocation allocation;
+        allocation.memory = memory.ok()->first;
+        allocation.offset = 0;
+        allocation.size = size;
+        allocation.mapped = memory.ok()->second;
+        allocation.memory_type = memory_type;
+        allocation.source = vulkan_allocation::source_type::dedicated;
+        return allocation;
+    }
+
+    result<std::pair<VkDeviceMemory, std::byte*>, vulkan_error> vulkan_allocator::allocate_device_memory(
+        VkDeviceSize size, uint32_t memory_type) {
+
+        if (m_device_allocation_count >= m_max_allocation_count) {
+            return vulkan_error("Reached maxMemoryAllocationCount", VkResult::VK_ERROR_TOO_MANY_OBJECTS);
+        }
+
+        VkMemoryAllocateInfo alloc_info { };
+        alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc_info.allocationSize = size;
+        alloc_info.memoryTypeIndex = memory_type;
+
+        VkDeviceMemory memory;
+        auto res = vkAllocateMemory(m_device, &alloc_info, nullptr, &memory);
+        if (res != VkResult::VK_SUCCESS) {
+            return vulkan_error("Failed to allocate device memory", res);
+        }
+
+        // host visible memory stays mapped for its whole lifetime
+        std::byte* mapped = nullptr;
+        if (m_memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            void* ptr;
+            res = vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &ptr);
+            if (res != VkResult::VK_SUCCESS) {
+                vkFreeMemory(m_device, memory, nullptr);
+                return vulkan_error("Failed to map device memory", res);
+            }
+            mapped = static_cast<std::byte*>(ptr);
+        }
+
+        ++m_device_allocation_count;
+        return std::make_pair(memory, mapped);
+    }
+
+    void vulkan_allocator::free_device_memory(VkDeviceMemory memory) noexcept {
+        vkFreeMemory(m_device, memory, nullptr); // implicitly unmaps
+        --m_device_allocation_count;
+    }
+
+    vulkan_linear_arena::vulkan_linear_arena(
+        vulkan_allocator& allocator, VkDeviceSize size, memory_usage usage, uint32_t type_bits)
+      : m_allocator(allocator), m_offset(0) {
+
+        auto memory_type = allocator.find_memory_type(type_bits, usage);
+        if (!memory_type) {
+            throw vulkan_error("No compatible memory type for linear arena", VkResult::VK_ERROR_FEATURE_NOT_PRESENT);
+        }
+
+        // The arena mixes linear and optimal resources, so it cannot share a block with other allocations.
+        std::lock_guard lock(allocator.m_mutex);
+        m_block = allocator.allocate_dedicated(size, *memory_type).or_throw();
+
+        SPDLOG_TRACE("Created linear arena ({:.1f} MiB, memory type={}).", to_mib(size), *memory_type);
+    }
+
+    vulkan_linear_arena::~vulkan_linear_arena() {
+        m_allocator.free(m_block);
+    }
+
+    result<vulkan_allocation, std::runtime_error> vulkan_linear_arena::allocate(
+        const VkMemoryRequirements& requirements, resource_kind kind) {
+
+        if ((requirements.memoryTypeBits & (1u << m_block.memory_type)) == 0) {
+            return std::runtime_error("Resource does not support the memory type of the linear arena.");
+        }
+
+        auto offset = align_up(m_offset, std::max<VkDeviceSize>(requirements.alignment, 1));
+        if (m_last_kind && *m_last_kind != kind) {
+            offset = align_up(offset, m_allocator.get_buffer_image_granularity());
+        }
+
+        if (offset + requirements.size > m_block.size) {
+            return std::runtime_error("Linear arena is exhausted.");
+        }
+
+        vulkan_allocation allocation;
+        allocation.memory = m_block.memory;
+        allocation.offset = m_block.offset + offset;
+        allocation.size = requirements.size;
+        allocation.mapped = m_block.mapped ? m_block.mapped + offset : nullptr;
+        allocation.memory_type = m_block.memory_type;
+        allocation.source = vulkan_allocation::source_type::arena;
+
+        m_offset = offset + requirements.size;
+        m_last_kind = kind;
+        return allocation;
+    }
+
+    void vulkan_linear_arena::reset() noexcept {
+        m_offset = 0;
+        m_last_kind.reset();
+    }
+
+    VkDeviceSize vulkan_linear_arena::get_size() const noexcept {
+        return m_block.size;
+    }
+
+    VkDeviceSize vulkan_linear_arena::get_used() const noexcept {
+        return m_offset;
+    }
+}
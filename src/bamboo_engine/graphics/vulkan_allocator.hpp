@@ -0,0 +1,344 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_ALLOCATOR_HPP
+#define BAMBOOENGINE_VULKAN_ALLOCATOR_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include <gsl/gsl-lite.hpp>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "../util/macros.hpp"
+#include "../util/result.hpp"
+#include "../util/tlsf_allocator.hpp"
+
+namespace bbge {
+
+    class vulkan_allocator;
+
+    /**
+     * @brief Intended access pattern of a resource. Picks the memory type.
+     */
+    enum class memory_usage : uint8_t {
+        gpu_only,               // device local, never mapped
+        cpu_to_gpu,             // host visible and coherent, persistently mapped, e.g. staging or per frame data
+        gpu_to_cpu,             // host visible and coherent, preferably cached, for read backs
+        gpu_lazily_allocated    // transient attachments, falls back to device local memory
+    };
+
+    /**
+     * @brief Linear and optimal resources have to be bufferImageGranularity apart if they share memory.
+     * The allocator keeps them in separate blocks instead of padding every allocation.
+     */
+    enum class resource_kind : uint8_t {
+        linear,     // buffers and linearly tiled images
+        optimal     // optimally tiled images
+    };
+
+    /**
+     * @brief A range of device memory. Resources are bound at memory + offset.
+     */
+    struct vulkan_allocation {
+
+        enum class source_type : uint8_t {
+            none,
+            pool,       // sub-allocated from a shared block
+            dedicated,  // own VkDeviceMemory
+            arena       // owned by a vulkan_linear_arena, freed by resetting it
+        };
+
+        VkDeviceMemory memory       = VK_NULL_HANDLE;
+        VkDeviceSize   offset       = 0;
+        VkDeviceSize   size         = 0;
+        std::byte*     mapped       = nullptr; // host pointer to offset if the memory is host visible
+        uint32_t       memory_type  = std::numeric_limits<uint32_t>::max();
+
+        // bookkeeping of the allocator
+        source_type            source = source_type::none;
+        uint32_t               pool   = std::numeric_limits<uint32_t>::max();
+        uint32_t               block  = std::numeric_limits<uint32_t>::max();
+        tlsf_allocator::handle handle = tlsf_allocator::invalid_handle;
+
+        [[nodiscard]] explicit operator bool() const noexcept {
+            return memory != VK_NULL_HANDLE;
+        }
+    };
+
+    /**
+     * @brief Buffer bound to memory from a vulkan_allocator. Destroys the buffer and frees the memory.
+     */
+    class vulkan_buffer {
+    public:
+
+        BBGE_NO_COPIES(vulkan_buffer);
+
+        vulkan_buffer() noexcept = default;
+        vulkan_buffer(vulkan_allocator& allocator, VkBuffer handle, const vulkan_allocation& allocation, VkDeviceSize size) noexcept;
+        vulkan_buffer(vulkan_buffer&& other) noexcept;
+        vulkan_buffer& operator=(vulkan_buffer&& other) noexcept;
+        ~vulkan_buffer();
+
+        [[nodiscard]] VkBuffer get_handle() const noexcept;
+        [[nodiscard]] VkDeviceSize get_size() const noexcept;
+        [[nodiscard]] const vulkan_allocation& get_allocation() const noexcept;
+
+        /**
+         * @brief Get the persistently mapped contents.
+         * @return Host pointer or nullptr if the memory is not host visible
+         */
+        [[nodiscard]] std::byte* get_mapped() const noexcept;
+
+    private:
+
+        vulkan_allocator* m_allocator = nullptr;
+        VkBuffer m_handle = VK_NULL_HANDLE;
+        vulkan_allocation m_allocation;
+        VkDeviceSize m_size = 0; // may be smaller than the allocation
+
+        void destroy() noexcept;
+    };
+
+    /**
+     * @brief Image bound to memory from a vulkan_allocator. Destroys the image and frees the memory.
+     */
+    class vulkan_image {
+    public:
+
+        BBGE_NO_COPIES(vulkan_image);
+
+        vulkan_image() noexcept = default;
+        vulkan_image(vulkan_allocator& allocator, VkImage handle, const vulkan_allocation& allocation,
+                     const VkImageCreateInfo& info) noexcept;
+        vulkan_image(vulkan_image&& other) noexcept;
+        vulkan_image& operator=(vulkan_image&& other) noexcept;
+        ~vulkan_image();
+
+        [[nodiscard]] VkImage get_handle() const noexcept;
+        [[nodiscard]] VkFormat get_format() const noexcept;
+        [[nodiscard]] VkExtent3D get_extent() const noexcept;
+        [[nodiscard]] uint32_t get_mip_levels() const noexcept;
+        [[nodiscard]] const vulkan_allocation& get_allocation() const noexcept;
+
+    private:
+
+        vulkan_allocator* m_allocator = nullptr;
+        VkImage m_handle = VK_NULL_HANDLE;
+        vulkan_allocation m_allocation;
+        VkFormat m_format = VK_FORMAT_UNDEFINED;
+        VkExtent3D m_extent { };
+        uint32_t m_mip_levels = 0;
+
+        void destroy() noexcept;
+    };
+
+    /**
+     * @brief Device memory allocator.
+     * Long-lived resources are sub-allocated from large per memory type blocks with a TLSF allocator.
+     * Resources larger than half a block get a dedicated allocation.
+     * Transient per frame data should use a vulkan_linear_arena instead.
+     * All functions are thread safe.
+     */
+    class vulkan_allocator {
+    public:
+
+        static constexpr const VkDeviceSize default_block_size = VkDeviceSize(64) << 20;
+
+        /**
+         * @brief Memory usage of a single heap.
+         */
+        struct heap_statistics {
+            VkDeviceSize heap_size;         // as reported by the driver
+            VkDeviceSize reserved;          // allocated from the driver
+            VkDeviceSize used;              // handed out to resources
+            uint32_t     block_count;       // pool blocks
+            uint32_t     dedicated_count;   // dedicated allocations
+            uint32_t     allocation_count;  // live sub-allocations and dedicated allocations
+            bool         device_local;
+        };
+
+        BBGE_NO_COPIES(vulkan_allocator);
+        BBGE_NO_MOVES(vulkan_allocator);
+
+        /**
+         * @brief Create an allocator. No memory is reserved until the first allocation.
+         * @param physical_device Physical device to query the memory properties of
+         * @param device Device to allocate from
+         * @param block_size Preferred size of a pool block, smaller heaps use smaller blocks
+         */
+        vulkan_allocator(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize block_size = default_block_size);
+
+        /**
+         * @brief Frees all blocks. Warns about allocations that are still alive.
+         */
+        ~vulkan_allocator();
+
+        /**
+         * @brief Allocate memory for a resource.
+         * @param requirements Memory requirements of the resource
+         * @param usage Access pattern
+         * @param kind Linear or optimal resource
+         * @return Allocation or error if no memory type fits or the heap is exhausted
+         */
+        [[nodiscard]] result<vulkan_allocation, vulkan_error> allocate(
+            const VkMemoryRequirements& requirements, memory_usage usage, resource_kind kind);
+
+        /**
+         * @brief Free an allocation and reset it. Ignores empty and arena allocations.
+         * @param allocation Allocation returned by allocate()
+         */
+        void free(vulkan_allocation& allocation) noexcept;
+
+        /**
+         * @brief Create a buffer and bind memory to it.
+         * @param size Size in bytes
+         * @param usage Buffer usage
+         * @param memory Memory access pattern
+         * @param queue_families Families that use the buffer concurrently, empty or one family for exclusive use
+         * @return The buffer
+         */
+        [[nodiscard]] vulkan_buffer create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, memory_usage memory,
+                                                  gsl::span<const uint32_t> queue_families = { });
+
+        /**
+         * @brief Create an image and bind memory to it.
+         * @param info Image create info
+         * @param memory Memory access pattern
+         * @return The image
+         */
+        [[nodiscard]] vulkan_image create_image(const VkImageCreateInfo& info, memory_usage memory);
+
+        /**
+         * @brief Pick a memory type for a resource.
+         * @param type_bits Allowed memory types, see VkMemoryRequirements::memoryTypeBits
+         * @param usage Access pattern
+         * @return Memory type index or nothing if no type is compatible
+         */
+        [[nodiscard]] std::optional<uint32_t> find_memory_type(uint32_t type_bits, memory_usage usage) const noexcept;
+
+        /**
+         * @brief Get the usage of every memory heap.
+         * @return Statistics indexed by heap
+         */
+        [[nodiscard]] std::vector<heap_statistics> get_statistics() const;
+
+        /**
+         * @brief Log the usage of every memory heap.
+         */
+        void log_statistics() const;
+
+        [[nodiscard]] VkDevice get_device() const noexcept;
+        [[nodiscard]] VkDeviceSize get_buffer_image_granularity() const noexcept;
+        [[nodiscard]] const VkPhysicalDeviceMemoryProperties& get_memory_properties() const noexcept;
+
+    private:
+
+        friend class vulkan_linear_arena;
+
+        struct memory_block {
+            VkDeviceMemory memory;
+            std::byte* mapped;
+            tlsf_allocator allocator;
+        };
+
+        struct memory_pool {
+            uint32_t memory_type;
+            VkDeviceSize block_size;
+            std::vector<std::optional<memory_block>> blocks; // empty slots are reused
+        };
+
+        struct dedicated_statistics {
+            VkDeviceSize bytes = 0;
+            uint32_t count = 0;
+        };
+
+        VkDevice m_device;
+        VkPhysicalDeviceMemoryProperties m_memory_properties;
+        VkDeviceSize m_buffer_image_granularity;
+        uint32_t m_max_allocation_count;
+        VkDeviceSize m_block_size;
+        bool m_separate_kinds; // false if the granularity does not require linear and optimal resources to be apart
+
+        mutable std::mutex m_mutex;
+        std::vector<memory_pool> m_pools; // indexed by memory type and resource kind
+        std::array<dedicated_statistics, VK_MAX_MEMORY_TYPES> m_dedicated;
+        uint32_t m_device_allocation_count; // number of live vkAllocateMemory calls
+
+        [[nodiscard]] uint32_t get_pool_index(uint32_t memory_type, resource_kind kind) const noexcept;
+        [[nodiscard]] result<vulkan_allocation, vulkan_error> allocate_from_pool(
+            memory_pool& pool, uint32_t pool_index, const VkMemoryRequirements& requirements);
+        [[nodiscard]] result<vulkan_allocation, vulkan_error> allocate_dedicated(VkDeviceSize size, uint32_t memory_type);
+        [[nodiscard]] result<std::pair<VkDeviceMemory, std::byte*>, vulkan_error> allocate_device_memory(
+            VkDeviceSize size, uint32_t memory_type);
+        void free_device_memory(VkDeviceMemory memory) noexcept;
+    };
+
+    /**
+     * @brief Bump allocator over a single dedicated block for transient data, e.g. per frame uniforms.
+     * Allocations are never freed individually, reset() releases all of them at once.
+     * Linear and optimal resources may be mixed, the arena pads to bufferImageGranularity when the kind changes.
+     */
+    class vulkan_linear_arena {
+    public:
+
+        BBGE_NO_COPIES(vulkan_linear_arena);
+        BBGE_NO_MOVES(vulkan_linear_arena);
+
+        /**
+         * @brief Reserve the arena's memory.
+         * @param allocator Allocator to reserve from
+         * @param size Size of the arena
+         * @param usage Access pattern, picks the memory type
+         * @param type_bits Memory types the resources allocated from this arena support
+         */
+        vulkan_linear_arena(vulkan_allocator& allocator, VkDeviceSize size, memory_usage usage,
+                            uint32_t type_bits = std::numeric_limits<uint32_t>::max());
+
+        ~vulkan_linear_arena();
+
+        /**
+         * @brief Allocate memory for a resource.
+         * @param requirements Memory requirements of the resource
+         * @param kind Linear or optimal resource
+         * @return Allocation or error if the arena is full or its memory type is incompatible
+         */
+        [[nodiscard]] result<vulkan_allocation, std::runtime_error> allocate(
+            const VkMemoryRequirements& requirements, resource_kind kind);
+
+        /**
+         * @brief Release all allocations. The caller has to ensure the GPU no longer uses them.
+         */
+        void reset() noexcept;
+
+        [[nodiscard]] VkDeviceSize get_size() const noexcept;
+        [[nodiscard]] VkDeviceSize get_used() const noexcept;
+
+    private:
+
+        vulkan_allocator& m_allocator;
+        vulkan_allocation m_block;
+        VkDeviceSize m_offset;
+        std::optional<resource_kind> m_last_kind;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_ALLOCATOR_HPP
@@ -0,0 +1,245 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <fmt/format.h>
+#include "vulkan_bindless_set.hpp"
+
+namespace bbge {
+
+    vulkan_bindless_set::vulkan_bindless_set(const vulkan_device& device, uint32_t frames_in_flight,
+                                             uint32_t max_textures, uint32_t max_buffers)
+      : m_device(device.get_handle()), m_frames_in_flight(frames_in_flight), m_set_layout(VK_NULL_HANDLE),
+        m_pool(VK_NULL_HANDLE), m_set(VK_NULL_HANDLE), m_frame_number(UINT64_MAX) {
+
+        if (!device.has_descriptor_indexing()) {
+            throw std::runtime_error("Bindless descriptor sets require VK_EXT_descriptor_indexing.");
+        }
+
+        // the arrays have to fit into the update after bind limits of a set and of every stage using it
+        const auto& limits = device.get_descriptor_indexing_properties();
+        auto texture_limit = std::min({
+            limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers
+        });
+        auto buffer_limit = std::min(limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                                     limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+        if (max_textures > texture_limit) {
+            SPDLOG_WARN("Bindless texture array clamped from {} to {} textures, the device limit.", max_textures, texture_limit);
+            max_textures = texture_limit;
+        }
+        if (max_buffers > buffer_limit) {
+            SPDLOG_WARN("Bindless buffer array clamped from {} to {} buffers, the device limit.", max_buffers, buffer_limit);
+            max_buffers = buffer_limit;
+        }
+
+        m_textures.capacity = max_textures;
+        m_buffers.capacity = max_buffers;
+
+        try {
+            constexpr VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+            std::array<VkDescriptorSetLayoutBinding, 2> bindings { };
+            bindings[0].binding = texture_binding;
+            bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            bindings[0].descriptorCount = max_textures;
+            bindings[0].stageFlags = stages;
+            bindings[1].binding = buffer_binding;
+            bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[1].descriptorCount = max_buffers;
+            bindings[1].stageFlags = stages;
+
+            // unused elements may be invalid, and elements may change while frames using others are in flight
+            constexpr VkDescriptorBindingFlagsEXT binding_flag = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT
+                | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+            std::array<VkDescriptorBindingFlagsEXT, 2> binding_flags { binding_flag, binding_flag };
+
+            VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_info { };
+            flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+            flags_info.bindingCount = static_cast<uint32_t>(binding_flags.size());
+            flags_info.pBindingFlags = binding_flags.data();
+
+            VkDescriptorSetLayoutCreateInfo layout_info { };
+            layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layout_info.pNext = &flags_info;
+            layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+            layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+            layout_info.pBindings = bindings.data();
+            auto res = vkCreateDescriptorSetLayout(m_device, &layout_info, nullptr, &m_set_layout);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to create bindless descriptor set layout", res);
+            }
+
+            std::array<VkDescriptorPoolSize, 2> pool_sizes {{
+                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, max_textures },
+                { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, max_buffers }
+            }};
+            VkDescriptorPoolCreateInfo pool_info { };
+            pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+            pool_info.maxSets = 1;
+            pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+            pool_info.pPoolSizes = pool_sizes.data();
+            res = vkCreateDescriptorPool(m_device, &pool_info, nullptr, &m_pool);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to create bindless descriptor pool", res);
+            }
+
+            VkDescriptorSetAllocateInfo alloc_info { };
+            alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            alloc_info.descriptorPool = m_pool;
+            alloc_info.descriptorSetCount = 1;
+            alloc_info.pSetLayouts = &m_set_layout;
+            res = vkAllocateDescriptorSets(m_device, &alloc_info, &m_set);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to allocate bindless descriptor set", res);
+            }
+        }
+        catch (...) {
+            destroy();
+            throw;
+        }
+
+        SPDLOG_TRACE("Created bindless descriptor set with {} textures and {} buffers.", max_textures, max_buffers);
+    }
+
+    vulkan_bindless_set::~vulkan_bindless_set() {
+        destroy();
+        SPDLOG_TRACE("Destroyed bindless descriptor set.");
+    }
+
+    void vulkan_bindless_set::begin_frame(const vulkan_frame_scheduler::frame& f) noexcept {
+        if (f.number == m_frame_number) return;
+        m_frame_number = f.number;
+        m_textures.tick();
+        m_buffers.tick();
+    }
+
+    result<uint32_t, std::runtime_error> vulkan_bindless_set::add_texture(VkImageView view, VkSampler sampler, VkImageLayout layout) {
+
+        auto index = m_textures.allocate();
+        if (!index) {
+            return std::runtime_error(fmt::format("All {} bindless textures are in use.", m_textures.capacity));
+        }
+
+        VkDescriptorImageInfo image_info { sampler, view, layout };
+
+        VkWriteDescriptorSet write { };
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = m_set;
+        write.dstBinding = texture_binding;
+        write.dstArrayElement = *index;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &image_info;
+        vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+
+        return *index;
+    }
+
+    result<uint32_t, std::runtime_error> vulkan_bindless_set::add_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+
+        auto index = m_buffers.allocate();
+        if (!index) {
+            return std::runtime_error(fmt::format("All {} bindless buffers are in use.", m_buffers.capacity));
+        }
+
+        VkDescriptorBufferInfo buffer_info { buffer, offset, range };
+
+        VkWriteDescriptorSet write { };
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = m_set;
+        write.dstBinding = buffer_binding;
+        write.dstArrayElement = *index;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &buffer_info;
+        vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+
+        return *index;
+    }
+
+    void vulkan_bindless_set::remove_texture(uint32_t index) {
+        assert(index < m_textures.next);
+        m_textures.retire(index, m_frames_in_flight);
+    }
+
+    void vulkan_bindless_set::remove_buffer(uint32_t index) {
+        assert(index < m_buffers.next);
+        m_buffers.retire(index, m_frames_in_flight);
+    }
+
+    void vulkan_bindless_set::bind(VkCommandBuffer cmd, VkPipelineBindPoint bind_point, VkPipelineLayout layout, uint32_t set) const noexcept {
+        vkCmdBindDescriptorSets(cmd, bind_point, layout, set, 1, &m_set, 0, nullptr);
+    }
+
+    VkDescriptorSetLayout vulkan_bindless_set::get_set_layout() const noexcept {
+        return m_set_layout;
+    }
+
+    uint32_t vulkan_bindless_set::get_max_textures() const noexcept {
+        return m_textures.capacity;
+    }
+
+    uint32_t vulkan_bindless_set::get_max_buffers() const noexcept {
+        return m_buffers.capacity;
+    }
+
+    std::optional<uint32_t> vulkan_bindless_set::id_allocator::allocate() noexcept {
+        if (!free.empty()) {
+            auto index = free.back();
+            free.pop_back();
+            return index;
+        }
+        if (next < capacity) {
+            return next++;
+        }
+        return { };
+    }
+
+    void vulkan_bindless_set::id_allocator::retire(uint32_t index, uint32_t frames) noexcept {
+        if (frames == 0) {
+            free.push_back(index);
+            return;
+        }
+        retired.push_back({ index, frames });
+    }
+
+    void vulkan_bindless_set::id_allocator::tick() noexcept {
+        for (auto& r : retired) {
+            if (--r.frames_left == 0) {
+                free.push_back(r.index);
+            }
+        }
+        retired.erase(std::remove_if(retired.begin(), retired.end(),
+            [] (const retired_id& r) { return r.frames_left == 0; }), retired.end());
+    }
+
+    void vulkan_bindless_set::destroy() noexcept {
+        // the set is freed with its pool
+        if (m_pool) {
+            vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+            m_pool = VK_NULL_HANDLE;
+        }
+        if (m_set_layout) {
+            vkDestroyDescriptorSetLayout(m_device, m_set_layout, nullptr);
+            m_set_layout = VK_NULL_HANDLE;
+        }
+    }
+}
@@ -0,0 +1,146 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_BINDLESS_SET_HPP
+#define BAMBOOENGINE_VULKAN_BINDLESS_SET_HPP
+
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "vulkan_frame_scheduler.hpp"
+#include "../util/macros.hpp"
+#include "../util/result.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief One descriptor set holding every texture and storage buffer, shaders index it with ids from push constants.
+     * It is bound once per command buffer instead of per draw, and updated after bind,
+     * so resources can be added while frames using the set are in flight.
+     * Binding 0 is an array of combined image samplers, binding 1 an array of storage buffers.
+     * Requires vulkan_device::has_descriptor_indexing(). Not thread safe.
+     */
+    class vulkan_bindless_set {
+    public:
+
+        static constexpr const uint32_t texture_binding = 0;
+        static constexpr const uint32_t buffer_binding = 1;
+
+        static constexpr const uint32_t default_max_textures = 4096;
+        static constexpr const uint32_t default_max_buffers = 1024;
+
+        BBGE_NO_COPIES(vulkan_bindless_set);
+        BBGE_NO_MOVES(vulkan_bindless_set);
+
+        /**
+         * @brief Create the set. Throws a std::runtime_error if the device doesn't support descriptor indexing.
+         * @param device Device
+         * @param frames_in_flight Frames in flight of the frame scheduler, removed ids are reused after as many frames
+         * @param max_textures Size of the texture array, clamped to the device's update after bind limits
+         * @param max_buffers Size of the storage buffer array, clamped to the device's update after bind limits
+         */
+        vulkan_bindless_set(const vulkan_device& device, uint32_t frames_in_flight,
+                            uint32_t max_textures = default_max_textures, uint32_t max_buffers = default_max_buffers);
+
+        ~vulkan_bindless_set();
+
+        /**
+         * @brief Count down removed ids. Call once per frame after the frame scheduler waited for the frame's slot.
+         * @param f Current frame
+         */
+        void begin_frame(const vulkan_frame_scheduler::frame& f) noexcept;
+
+        /**
+         * @brief Write a texture into a free element of the texture array.
+         * @param view Image view, has to stay alive until the texture was removed and its id retired
+         * @param sampler Sampler, has to stay alive as long as the view
+         * @param layout Layout the image is in when shaders sample it
+         * @return Index into the texture array or an error if the array is full
+         */
+        [[nodiscard]] result<uint32_t, std::runtime_error> add_texture(
+            VkImageView view, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        /**
+         * @brief Write a storage buffer range into a free element of the buffer array.
+         * @param buffer Buffer created with VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+         * @param offset Offset of the range, a multiple of minStorageBufferOffsetAlignment
+         * @param range Size of the range
+         * @return Index into the buffer array or an error if the array is full
+         */
+        [[nodiscard]] result<uint32_t, std::runtime_error> add_buffer(
+            VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+        /**
+         * @brief Free a texture id. Frames in flight may still use it, so it's reused frames_in_flight frames later.
+         * @param index Id returned by add_texture()
+         */
+        void remove_texture(uint32_t index);
+
+        /**
+         * @brief Free a buffer id. Frames in flight may still use it, so it's reused frames_in_flight frames later.
+         * @param index Id returned by add_buffer()
+         */
+        void remove_buffer(uint32_t index);
+
+        /**
+         * @brief Bind the set. Binding it once per command buffer is enough for every pipeline with a compatible layout.
+         * @param cmd Command buffer
+         * @param bind_point Graphics or compute
+         * @param layout Pipeline layout with get_set_layout() at the set index
+         * @param set Set index
+         */
+        void bind(VkCommandBuffer cmd, VkPipelineBindPoint bind_point, VkPipelineLayout layout, uint32_t set = 0) const noexcept;
+
+        [[nodiscard]] VkDescriptorSetLayout get_set_layout() const noexcept;
+        [[nodiscard]] uint32_t get_max_textures() const noexcept;
+        [[nodiscard]] uint32_t get_max_buffers() const noexcept;
+
+    private:
+
+        struct id_allocator {
+            struct retired_id {
+                uint32_t index;
+                uint32_t frames_left;
+            };
+
+            uint32_t capacity = 0;
+            uint32_t next = 0;              // ids at and above were never handed out
+            std::vector<uint32_t> free;
+            std::vector<retired_id> retired;
+
+            [[nodiscard]] std::optional<uint32_t> allocate() noexcept;
+            void retire(uint32_t index, uint32_t frames) noexcept;
+            void tick() noexcept;
+        };
+
+        VkDevice m_device;
+        uint32_t m_frames_in_flight;
+        VkDescriptorSetLayout m_set_layout;
+        VkDescriptorPool m_pool;
+        VkDescriptorSet m_set;
+        id_allocator m_textures;
+        id_allocator m_buffers;
+        uint64_t m_frame_number; // frame the retired ids were last counted down in
+
+        void destroy() noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_BINDLESS_SET_HPP
@@ -0,0 +1,156 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "vulkan_capability_cache.hpp"
+
+namespace bbge {
+
+    std::mutex vulkan_capability_cache::s_mutex;
+    tsl::robin_map<VkPhysicalDevice, std::unique_ptr<vulkan_capability_cache::entry>> vulkan_capability_cache::s_entries;
+
+    namespace {
+
+        bool extension_name_less(const VkExtensionProperties& a, const VkExtensionProperties& b) noexcept {
+            return std::strcmp(a.extensionName, b.extensionName) < 0;
+        }
+    }
+
+    bool vulkan_capability_cache::device_capabilities::has_extension(std::string_view name) const noexcept {
+        auto it = std::lower_bound(extensions.begin(), extensions.end(), name,
+            [](const VkExtensionProperties& props, std::string_view n) { return std::string_view(props.extensionName) < n; });
+        return it != extensions.end() && std::string_view(it->extensionName) == name;
+    }
+
+    const vulkan_capability_cache::device_capabilities& vulkan_capability_cache::get(VkPhysicalDevice dev) {
+        std::lock_guard lock(s_mutex);
+        return get_entry(dev).capabilities;
+    }
+
+    result<const vulkan_capability_cache::surface_support*, vulkan_result_code>
+    vulkan_capability_cache::get_surface_support(VkPhysicalDevice dev, VkSurfaceKHR surface) {
+
+        assert(surface);
+
+        std::lock_guard lock(s_mutex);
+        auto& e = get_entry(dev);
+        auto it = e.surfaces.find(surface);
+        if (it != e.surfaces.end()) {
+            return it->second.get();
+        }
+
+        auto support = query_surface(dev, surface, e.capabilities.queue_families);
+        if (support.is_err()) {
+            return *support.err();
+        }
+        const auto* ptr = support.ok()->get();
+        e.surfaces.emplace(surface, std::move(*support.ok()));
+        return ptr;
+    }
+
+    void vulkan_capability_cache::invalidate_surface(VkSurfaceKHR surface) {
+        std::lock_guard lock(s_mutex);
+        for (auto it = s_entries.begin(); it != s_entries.end(); ++it) {
+            it.value()->surfaces.erase(surface);
+        }
+    }
+
+    void vulkan_capability_cache::clear() {
+        std::lock_guard lock(s_mutex);
+        s_entries.clear();
+    }
+
+    vulkan_capability_cache::entry& vulkan_capability_cache::get_entry(VkPhysicalDevice dev) {
+
+        assert(dev);
+
+        auto it = s_entries.find(dev);
+        if (it == s_entries.end()) {
+            it = s_entries.emplace(dev, query_device(dev)).first;
+        }
+        return *it->second;
+    }
+
+    std::unique_ptr<vulkan_capability_cache::entry> vulkan_capability_cache::query_device(VkPhysicalDevice dev) {
+
+        auto e = std::make_unique<entry>();
+        auto& caps = e->capabilities;
+
+        vkGetPhysicalDeviceProperties(dev, &caps.properties);
+        vkGetPhysicalDeviceFeatures(dev, &caps.features);
+
+        uint32_t count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(dev, &count, nullptr);
+        caps.queue_families.resize(count);
+        vkGetPhysicalDeviceQueueFamilyProperties(dev, &count, caps.queue_families.data());
+
+        auto res = vkEnumerateDeviceExtensionProperties(dev, nullptr, &count, nullptr);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to query supported device extensions", res);
+        }
+        caps.extensions.resize(count);
+        res = vkEnumerateDeviceExtensionProperties(dev, nullptr, &count, caps.extensions.data());
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to query supported device extensions", res);
+        }
+        std::sort(caps.extensions.begin(), caps.extensions.end(), extension_name_less);
+
+        SPDLOG_TRACE("Cached capabilities of '{}' ({} queue families, {} extensions).",
+                     caps.properties.deviceName, caps.queue_families.size(), caps.extensions.size());
+
+        return e;
+    }
+
+    result<std::unique_ptr<vulkan_capability_cache::surface_support>, vulkan_result_code>
+    vulkan_capability_cache::query_surface(VkPhysicalDevice dev, VkSurfaceKHR surface, const queue_family_list& queue_families) {
+
+        auto support = std::make_unique<surface_support>();
+
+        uint32_t count = 0;
+        auto res = vkGetPhysicalDeviceSurfaceFormatsKHR(dev, surface, &count, nullptr);
+        if (res != VkResult::VK_SUCCESS) {
+            return vulkan_result_code { res, "Failed to query surface formats" };
+        }
+        support->formats.resize(count);
+        res = vkGetPhysicalDeviceSurfaceFormatsKHR(dev, surface, &count, support->formats.data());
+        if (res != VkResult::VK_SUCCESS) {
+            return vulkan_result_code { res, "Failed to query surface formats" };
+        }
+
+        res = vkGetPhysicalDeviceSurfacePresentModesKHR(dev, surface, &count, nullptr);
+        if (res != VkResult::VK_SUCCESS) {
+            return vulkan_result_code { res, "Failed to query present modes" };
+        }
+        support->present_modes.resize(count);
+        res = vkGetPhysicalDeviceSurfacePresentModesKHR(dev, surface, &count, support->present_modes.data());
+        if (res != VkResult::VK_SUCCESS) {
+            return vulkan_result_code { res, "Failed to query present modes" };
+        }
+
+        support->presentation.resize(queue_families.size(), VK_FALSE);
+        for (uint32_t i = 0; i < queue_families.size(); ++i) {
+            res = vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, surface, &support->presentation[i]);
+            if (res != VkResult::VK_SUCCESS) {
+                return vulkan_result_code { res, "Failed to query presentation support" };
+            }
+        }
+
+        return support;
+    }
+}
@@ -0,0 +1,109 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_CAPABILITY_CACHE_HPP
+#define BAMBOOENGINE_VULKAN_CAPABILITY_CACHE_HPP
+
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include <boost/container/small_vector.hpp>
+#include <tsl/robin_map.h>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "../util/result.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Caches what physical devices support, so device selection and swap chain setup query the driver once.
+     * Entries live until clear(), surface dependent entries until invalidate_surface().
+     * Returned references stay valid until then. Thread safe.
+     */
+    struct vulkan_capability_cache {
+    public:
+
+        using queue_family_list = boost::container::small_vector<VkQueueFamilyProperties, 8>;
+        using surface_format_list = boost::container::small_vector<VkSurfaceFormatKHR, 16>;
+        using present_mode_list = boost::container::small_vector<VkPresentModeKHR, 8>;
+
+        struct device_capabilities {
+            VkPhysicalDeviceProperties          properties;
+            VkPhysicalDeviceFeatures            features;
+            queue_family_list                   queue_families;
+            std::vector<VkExtensionProperties>  extensions;     // sorted by name
+
+            /**
+             * @brief Check if the device supports an extension.
+             * @param name Extension name
+             * @return True if supported
+             */
+            [[nodiscard]] bool has_extension(std::string_view name) const noexcept;
+        };
+
+        struct surface_support {
+            surface_format_list                             formats;
+            present_mode_list                               present_modes;
+            boost::container::small_vector<VkBool32, 8>     presentation;   // per queue family
+        };
+
+        /**
+         * @brief Get the capabilities of a device, queried on first use.
+         * Throws a vulkan_error if the extensions can't be queried.
+         * @param dev Physical device
+         * @return Capabilities
+         */
+        [[nodiscard]] static const device_capabilities& get(VkPhysicalDevice dev);
+
+        /**
+         * @brief Get what a device supports on a surface, queried on first use. Failed queries aren't cached.
+         * @param dev Physical device
+         * @param surface Surface
+         * @return Support or the error of the failed query
+         */
+        [[nodiscard]] static result<const surface_support*, vulkan_result_code> get_surface_support(VkPhysicalDevice dev, VkSurfaceKHR surface);
+
+        /**
+         * @brief Forget everything about a surface, e.g. before it's destroyed.
+         * @param surface Surface
+         */
+        static void invalidate_surface(VkSurfaceKHR surface);
+
+        /**
+         * @brief Forget everything, e.g. before the instance owning the physical devices is destroyed.
+         */
+        static void clear();
+
+    private:
+
+        struct entry {
+            device_capabilities capabilities;
+            tsl::robin_map<VkSurfaceKHR, std::unique_ptr<surface_support>> surfaces;
+        };
+
+        static std::mutex s_mutex;
+        static tsl::robin_map<VkPhysicalDevice, std::unique_ptr<entry>> s_entries;
+
+        [[nodiscard]] static entry& get_entry(VkPhysicalDevice dev);
+        [[nodiscard]] static std::unique_ptr<entry> query_device(VkPhysicalDevice dev);
+        [[nodiscard]] static result<std::unique_ptr<surface_support>, vulkan_result_code> query_surface(
+            VkPhysicalDevice dev, VkSurfaceKHR surface, const queue_family_list& queue_families);
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_CAPABILITY_CACHE_HPP
@@ -0,0 +1,114 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "vulkan_command_buffer.hpp"
+
+namespace bbge {
+
+    vulkan_command_buffer::vulkan_command_buffer(VkCommandBuffer handle) noexcept : m_handle(handle) {
+        assert(handle);
+    }
+
+    VkCommandBuffer vulkan_command_buffer::get_handle() const noexcept {
+        return m_handle;
+    }
+
+    void vulkan_command_buffer::bind_pipeline(const vulkan_pipeline& pipeline) const noexcept {
+        vkCmdBindPipeline(m_handle, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.get_handle());
+    }
+
+    void vulkan_command_buffer::bind_pipeline(const vulkan_compute_pipeline& pipeline) const noexcept {
+        vkCmdBindPipeline(m_handle, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.get_handle());
+    }
+
+    void vulkan_command_buffer::set_viewport(const drect& viewport, float min_depth, float max_depth) const noexcept {
+        auto vk_viewport = to_vulkan_viewport(viewport);
+        vk_viewport.minDepth = min_depth;
+        vk_viewport.maxDepth = max_depth;
+        vkCmdSetViewport(m_handle, 0, 1, &vk_viewport);
+    }
+
+    void vulkan_command_buffer::set_scissor(const irect& scissor) const noexcept {
+        auto vk_scissor = to_vulkan_rect(scissor);
+        vkCmdSetScissor(m_handle, 0, 1, &vk_scissor);
+    }
+
+    void vulkan_command_buffer::set_viewport_and_scissor(VkExtent2D extent) const noexcept {
+        set_viewport({ 0, 0, static_cast<double>(extent.width), static_cast<double>(extent.height) });
+        set_scissor({ 0, 0, static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height) });
+    }
+
+    void vulkan_command_buffer::set_line_width(float width) const noexcept {
+        vkCmdSetLineWidth(m_handle, width);
+    }
+
+    void vulkan_command_buffer::set_depth_bias(const rasterizer_depth_bias& bias) const noexcept {
+        vkCmdSetDepthBias(m_handle, bias.const_factor, bias.clamp, bias.slope_factor);
+    }
+
+    void vulkan_command_buffer::bind_vertex_buffer(uint32_t binding, const vulkan_buffer& buffer, VkDeviceSize offset) const noexcept {
+        VkBuffer handle = buffer.get_handle();
+        vkCmdBindVertexBuffers(m_handle, binding, 1, &handle, &offset);
+    }
+
+    void vulkan_command_buffer::bind_vertex_buffers(
+        uint32_t first_binding, gsl::span<const VkBuffer> buffers, gsl::span<const VkDeviceSize> offsets) const noexcept {
+        assert(buffers.size() == offsets.size());
+        vkCmdBindVertexBuffers(m_handle, first_binding, static_cast<uint32_t>(buffers.size()), buffers.data(), offsets.data());
+    }
+
+    void vulkan_command_buffer::bind_index_buffer(const vulkan_buffer& buffer, index_type type, VkDeviceSize offset) const noexcept {
+        vkCmdBindIndexBuffer(m_handle, buffer.get_handle(), offset, to_vulkan(type));
+    }
+
+    void vulkan_command_buffer::bind_mesh(const vulkan_mesh& mesh) const noexcept {
+        bind_vertex_buffer(0, mesh.get_vertex_buffer());
+        if (mesh.is_indexed()) {
+            bind_index_buffer(mesh.get_index_buffer(), mesh.get_index_type());
+        }
+    }
+
+    void vulkan_command_buffer::draw(
+        uint32_t vertex_count, uint32_t instance_count,
+        uint32_t first_vertex, uint32_t first_instance) const noexcept {
+        vkCmdDraw(m_handle, vertex_count, instance_count, first_vertex, first_instance);
+    }
+
+    void vulkan_command_buffer::draw_indexed(
+        uint32_t index_count, uint32_t instance_count, uint32_t first_index,
+        int32_t vertex_offset, uint32_t first_instance) const noexcept {
+        vkCmdDrawIndexed(m_handle, index_count, instance_count, first_index, vertex_offset, first_instance);
+    }
+
+    void vulkan_command_buffer::draw(const vulkan_mesh& mesh, uint32_t instance_count, uint32_t first_instance) const noexcept {
+        if (mesh.is_indexed()) {
+            draw_indexed(mesh.get_index_count(), instance_count, 0, 0, first_instance);
+        }
+        else {
+            draw(mesh.get_vertex_count(), instance_count, 0, first_instance);
+        }
+    }
+
+    void vulkan_command_buffer::draw_indexed_indirect(
+        const vulkan_buffer& buffer, VkDeviceSize offset, uint32_t draw_count, uint32_t stride) const noexcept {
+        vkCmdDrawIndexedIndirect(m_handle, buffer.get_handle(), offset, draw_count, stride);
+    }
+
+    void vulkan_command_buffer::dispatch(uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z) const noexcept {
+        vkCmdDispatch(m_handle, group_count_x, group_count_y, group_count_z);
+    }
+}
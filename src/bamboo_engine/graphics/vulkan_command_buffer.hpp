@@ -0,0 +1,110 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_COMMAND_BUFFER_HPP
+#define BAMBOOENGINE_VULKAN_COMMAND_BUFFER_HPP
+
+#include <vulkan/vulkan.h>
+#include <gsl/gsl-lite.hpp>
+#include "vulkan_pipeline.hpp"
+#include "vulkan_compute_pipeline.hpp"
+#include "vulkan_mesh.hpp"
+#include "../util/rectangle.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Thin, non-owning recording interface on top of a VkCommandBuffer.
+     * The command buffer has to be in the recording state.
+     */
+    class vulkan_command_buffer {
+    public:
+
+        explicit vulkan_command_buffer(VkCommandBuffer handle) noexcept;
+
+        /**
+         * @brief Get the wrapped command buffer
+         * @return Command buffer handle
+         */
+        [[nodiscard]] VkCommandBuffer get_handle() const noexcept;
+
+        /**
+         * @brief Bind a graphics pipeline. Dynamic state has to be set afterwards.
+         * @param pipeline Pipeline
+         */
+        void bind_pipeline(const vulkan_pipeline& pipeline) const noexcept;
+
+        /**
+         * @brief Bind a compute pipeline.
+         * @param pipeline Pipeline
+         */
+        void bind_pipeline(const vulkan_compute_pipeline& pipeline) const noexcept;
+
+        // dynamic state setters, only valid for pipelines that declared the state dynamic
+        void set_viewport(const drect& viewport, float min_depth = 0.0f, float max_depth = 1.0f) const noexcept;
+        void set_scissor(const irect& scissor) const noexcept;
+        void set_viewport_and_scissor(VkExtent2D extent) const noexcept;
+        void set_line_width(float width) const noexcept;
+        void set_depth_bias(const rasterizer_depth_bias& bias) const noexcept;
+
+        // vertex input, bindings as numbered by the pipeline's vertex_layout
+        void bind_vertex_buffer(uint32_t binding, const vulkan_buffer& buffer, VkDeviceSize offset = 0) const noexcept;
+        void bind_vertex_buffers(uint32_t first_binding, gsl::span<const VkBuffer> buffers,
+                                 gsl::span<const VkDeviceSize> offsets) const noexcept;
+        void bind_index_buffer(const vulkan_buffer& buffer, index_type type, VkDeviceSize offset = 0) const noexcept;
+
+        /**
+         * @brief Bind a mesh's vertices to binding 0 and its indices if it has any.
+         * @param mesh Mesh
+         */
+        void bind_mesh(const vulkan_mesh& mesh) const noexcept;
+
+        // draw calls
+        void draw(uint32_t vertex_count, uint32_t instance_count = 1,
+                  uint32_t first_vertex = 0, uint32_t first_instance = 0) const noexcept;
+        void draw_indexed(uint32_t index_count, uint32_t instance_count = 1, uint32_t first_index = 0,
+                          int32_t vertex_offset = 0, uint32_t first_instance = 0) const noexcept;
+
+        /**
+         * @brief Draw a bound mesh, indexed if it has indices.
+         * @param mesh Mesh, bound with bind_mesh
+         * @param instance_count Number of instances, per-instance attributes have to be bound to other bindings
+         * @param first_instance First instance
+         */
+        void draw(const vulkan_mesh& mesh, uint32_t instance_count = 1, uint32_t first_instance = 0) const noexcept;
+
+        /**
+         * @brief Draw with parameters read from a buffer of VkDrawIndexedIndirectCommand.
+         * More than one draw needs the multiDrawIndirect feature.
+         * @param buffer Buffer created with VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+         * @param offset Offset of the first command
+         * @param draw_count Number of commands
+         * @param stride Distance between commands
+         */
+        void draw_indexed_indirect(const vulkan_buffer& buffer, VkDeviceSize offset, uint32_t draw_count,
+                                   uint32_t stride = sizeof(VkDrawIndexedIndirectCommand)) const noexcept;
+
+        // compute
+        void dispatch(uint32_t group_count_x, uint32_t group_count_y = 1, uint32_t group_count_z = 1) const noexcept;
+
+    private:
+
+        VkCommandBuffer m_handle;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_COMMAND_BUFFER_HPP
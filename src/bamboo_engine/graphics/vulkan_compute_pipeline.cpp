@@ -0,0 +1,107 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cassert>
+#include "vulkan_compute_pipeline.hpp"
+
+namespace bbge {
+
+    vulkan_compute_pipeline::vulkan_compute_pipeline(
+        std::string&& name, const std::filesystem::path& shader_path,
+        const compute_pipeline_settings& settings, const vulkan_device& dev)
+      : m_name(std::move(name)), m_device(dev.get_handle()), m_cache(dev.get_pipeline_cache()),
+        m_layout(VK_NULL_HANDLE), m_pipeline(VK_NULL_HANDLE) {
+
+        m_layout = create_pipeline_layout(settings).or_throw();
+
+        try {
+            m_pipeline = create_pipeline(shader_path).or_throw();
+        }
+        catch (...) {
+            vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+            throw;
+        }
+
+        SPDLOG_TRACE("Created vulkan compute pipeline '{}'.", m_name);
+    }
+
+    vulkan_compute_pipeline::~vulkan_compute_pipeline() {
+        if (m_pipeline) {
+            vkDestroyPipeline(m_device, m_pipeline, nullptr);
+        }
+        if (m_layout) {
+            vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+        }
+        SPDLOG_TRACE("Destroyed vulkan compute pipeline '{}'.", m_name);
+    }
+
+    VkPipeline vulkan_compute_pipeline::get_handle() const noexcept {
+        return m_pipeline;
+    }
+
+    VkPipelineLayout vulkan_compute_pipeline::get_layout() const noexcept {
+        return m_layout;
+    }
+
+    result<VkPipelineLayout, vulkan_error>
+    vulkan_compute_pipeline::create_pipeline_layout(const compute_pipeline_settings& settings) const {
+
+        assert(m_device);
+
+        VkPipelineLayoutCreateInfo create_info { };
+        create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        create_info.setLayoutCount = settings.descriptor_set_layouts.size();
+        create_info.pSetLayouts = settings.descriptor_set_layouts.data();
+        create_info.pushConstantRangeCount = settings.push_constant_ranges.size();
+        create_info.pPushConstantRanges = settings.push_constant_ranges.data();
+
+        VkPipelineLayout layout;
+        auto res = vkCreatePipelineLayout(m_device, &create_info, nullptr, &layout);
+        if (res != VkResult::VK_SUCCESS) {
+            return vulkan_error("Failed to create Vulkan compute pipeline layout", res);
+        }
+
+        return layout;
+    }
+
+    result<VkPipeline, vulkan_error> vulkan_compute_pipeline::create_pipeline(const std::filesystem::path& shader_path) const {
+
+        assert(m_device);
+        assert(m_layout);
+
+        vulkan_shader_module module(m_device, shader_path, shader_type::compute, m_name);
+
+        VkComputePipelineCreateInfo create_info { };
+        create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        create_info.stage = module.get_stage_create_info();
+        create_info.layout = m_layout;
+        create_info.basePipelineHandle = VK_NULL_HANDLE;
+        create_info.basePipelineIndex = -1;
+
+        vulkan_pipeline_cache::creation_tracker tracker(m_cache, 1);
+        create_info.pNext = tracker.get_next();
+
+        VkPipeline pipeline;
+        auto res = vkCreateComputePipelines(m_device, m_cache.get_handle(), 1, &create_info, nullptr, &pipeline);
+        if (res != VkResult::VK_SUCCESS) {
+            return vulkan_error("Failed to create compute pipeline", res);
+        }
+        tracker.finish();
+
+        return pipeline;
+    }
+}
@@ -0,0 +1,89 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_COMPUTE_PIPELINE_HPP
+#define BAMBOOENGINE_VULKAN_COMPUTE_PIPELINE_HPP
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "vulkan_pipeline_cache.hpp"
+#include "vulkan_shader.hpp"
+#include "../util/macros.hpp"
+#include "../util/result.hpp"
+
+namespace bbge {
+
+    struct compute_pipeline_settings {
+        std::vector<VkDescriptorSetLayout> descriptor_set_layouts; // not owned, only have to outlive the constructor
+        std::vector<VkPushConstantRange>   push_constant_ranges;
+    };
+
+    /**
+     * @brief Pipeline with a single compute shader.
+     * Can be dispatched on the graphics queue or on the device's compute queue.
+     */
+    class vulkan_compute_pipeline {
+    public:
+
+        BBGE_NO_COPIES(vulkan_compute_pipeline);
+        BBGE_NO_MOVES(vulkan_compute_pipeline);
+
+        /**
+         * @brief Create the pipeline through the device's pipeline cache.
+         * @param name Name for logs and errors
+         * @param shader_path Path to the SPIR-V compute shader
+         * @param settings Pipeline layout
+         * @param dev Device
+         */
+        vulkan_compute_pipeline(
+            std::string&& name,
+            const std::filesystem::path& shader_path,
+            const compute_pipeline_settings& settings,
+            const vulkan_device& dev
+        );
+
+        ~vulkan_compute_pipeline();
+
+        /**
+         * @brief Get the pipeline handle
+         * @return Pipeline handle
+         */
+        [[nodiscard]] VkPipeline get_handle() const noexcept;
+
+        /**
+         * @brief Get the layout to bind descriptor sets and push constants with.
+         * @return Pipeline layout handle
+         */
+        [[nodiscard]] VkPipelineLayout get_layout() const noexcept;
+
+    private:
+
+        std::string m_name;
+        VkDevice m_device;
+        vulkan_pipeline_cache& m_cache;
+        VkPipelineLayout m_layout;
+        VkPipeline m_pipeline;
+
+        [[nodiscard]] result<VkPipelineLayout, vulkan_error> create_pipeline_layout(const compute_pipeline_settings& settings) const;
+        [[nodiscard]] result<VkPipeline, vulkan_error> create_pipeline(const std::filesystem::path& shader_path) const;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_COMPUTE_PIPELINE_HPP
@@ -0,0 +1,98 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <array>
+#include "vulkan_format.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        // core formats are numbered in this order, so one range covers every numeric variant of a layout
+        struct format_range {
+            VkFormat first;
+            VkFormat last;
+            vulkan_format_block block;
+        };
+
+        constexpr const std::array<format_range, 44> format_ranges {{
+            { VK_FORMAT_R4G4_UNORM_PACK8,           VK_FORMAT_R4G4_UNORM_PACK8,             { 1 } },
+            { VK_FORMAT_R4G4B4A4_UNORM_PACK16,      VK_FORMAT_A1R5G5B5_UNORM_PACK16,        { 2 } },
+            { VK_FORMAT_R8_UNORM,                   VK_FORMAT_R8_SRGB,                      { 1 } },
+            { VK_FORMAT_R8G8_UNORM,                 VK_FORMAT_R8G8_SRGB,                    { 2 } },
+            { VK_FORMAT_R8G8B8_UNORM,               VK_FORMAT_B8G8R8_SRGB,                  { 3 } },
+            { VK_FORMAT_R8G8B8A8_UNORM,             VK_FORMAT_A2B10G10R10_SINT_PACK32,      { 4 } },
+            { VK_FORMAT_R16_UNORM,                  VK_FORMAT_R16_SFLOAT,                   { 2 } },
+            { VK_FORMAT_R16G16_UNORM,               VK_FORMAT_R16G16_SFLOAT,                { 4 } },
+            { VK_FORMAT_R16G16B16_UNORM,            VK_FORMAT_R16G16B16_SFLOAT,             { 6 } },
+            { VK_FORMAT_R16G16B16A16_UNORM,         VK_FORMAT_R16G16B16A16_SFLOAT,          { 8 } },
+            { VK_FORMAT_R32_UINT,                   VK_FORMAT_R32_SFLOAT,                   { 4 } },
+            { VK_FORMAT_R32G32_UINT,                VK_FORMAT_R32G32_SFLOAT,                { 8 } },
+            { VK_FORMAT_R32G32B32_UINT,             VK_FORMAT_R32G32B32_SFLOAT,             { 12 } },
+            { VK_FORMAT_R32G32B32A32_UINT,          VK_FORMAT_R32G32B32A32_SFLOAT,          { 16 } },
+            { VK_FORMAT_R64_UINT,                   VK_FORMAT_R64_SFLOAT,                   { 8 } },
+            { VK_FORMAT_R64G64_UINT,                VK_FORMAT_R64G64_SFLOAT,                { 16 } },
+            { VK_FORMAT_R64G64B64_UINT,             VK_FORMAT_R64G64B64_SFLOAT,             { 24 } },
+            { VK_FORMAT_R64G64B64A64_UINT,          VK_FORMAT_R64G64B64A64_SFLOAT,          { 32 } },
+            { VK_FORMAT_B10G11R11_UFLOAT_PACK32,    VK_FORMAT_E5B9G9R9_UFLOAT_PACK32,       { 4 } },
+            { VK_FORMAT_D16_UNORM,                  VK_FORMAT_D16_UNORM,                    { 2 } },
+            { VK_FORMAT_X8_D24_UNORM_PACK32,        VK_FORMAT_D32_SFLOAT,                   { 4 } },
+            { VK_FORMAT_S8_UINT,                    VK_FORMAT_S8_UINT,                      { 1 } },
+            { VK_FORMAT_BC1_RGB_UNORM_BLOCK,        VK_FORMAT_BC1_RGBA_SRGB_BLOCK,          { 8, 4, 4 } },
+            { VK_FORMAT_BC2_UNORM_BLOCK,            VK_FORMAT_BC3_SRGB_BLOCK,               { 16, 4, 4 } },
+            { VK_FORMAT_BC4_UNORM_BLOCK,            VK_FORMAT_BC4_SNORM_BLOCK,              { 8, 4, 4 } },
+            { VK_FORMAT_BC5_UNORM_BLOCK,            VK_FORMAT_BC7_SRGB_BLOCK,               { 16, 4, 4 } },
+            { VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK,    VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK,     { 8, 4, 4 } },
+            { VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK,  VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK,     { 16, 4, 4 } },
+            { VK_FORMAT_EAC_R11_UNORM_BLOCK,        VK_FORMAT_EAC_R11_SNORM_BLOCK,          { 8, 4, 4 } },
+            { VK_FORMAT_EAC_R11G11_UNORM_BLOCK,     VK_FORMAT_EAC_R11G11_SNORM_BLOCK,       { 16, 4, 4 } },
+            { VK_FORMAT_ASTC_4x4_UNORM_BLOCK,       VK_FORMAT_ASTC_4x4_SRGB_BLOCK,          { 16, 4, 4 } },
+            { VK_FORMAT_ASTC_5x4_UNORM_BLOCK,       VK_FORMAT_ASTC_5x4_SRGB_BLOCK,          { 16, 5, 4 } },
+            { VK_FORMAT_ASTC_5x5_UNORM_BLOCK,       VK_FORMAT_ASTC_5x5_SRGB_BLOCK,          { 16, 5, 5 } },
+            { VK_FORMAT_ASTC_6x5_UNORM_BLOCK,       VK_FORMAT_ASTC_6x5_SRGB_BLOCK,          { 16, 6, 5 } },
+            { VK_FORMAT_ASTC_6x6_UNORM_BLOCK,       VK_FORMAT_ASTC_6x6_SRGB_BLOCK,          { 16, 6, 6 } },
+            { VK_FORMAT_ASTC_8x5_UNORM_BLOCK,       VK_FORMAT_ASTC_8x5_SRGB_BLOCK,          { 16, 8, 5 } },
+            { VK_FORMAT_ASTC_8x6_UNORM_BLOCK,       VK_FORMAT_ASTC_8x6_SRGB_BLOCK,          { 16, 8, 6 } },
+            { VK_FORMAT_ASTC_8x8_UNORM_BLOCK,       VK_FORMAT_ASTC_8x8_SRGB_BLOCK,          { 16, 8, 8 } },
+            { VK_FORMAT_ASTC_10x5_UNORM_BLOCK,      VK_FORMAT_ASTC_10x5_SRGB_BLOCK,         { 16, 10, 5 } },
+            { VK_FORMAT_ASTC_10x6_UNORM_BLOCK,      VK_FORMAT_ASTC_10x6_SRGB_BLOCK,         { 16, 10, 6 } },
+            { VK_FORMAT_ASTC_10x8_UNORM_BLOCK,      VK_FORMAT_ASTC_10x8_SRGB_BLOCK,         { 16, 10, 8 } },
+            { VK_FORMAT_ASTC_10x10_UNORM_BLOCK,     VK_FORMAT_ASTC_10x10_SRGB_BLOCK,        { 16, 10, 10 } },
+            { VK_FORMAT_ASTC_12x10_UNORM_BLOCK,     VK_FORMAT_ASTC_12x10_SRGB_BLOCK,        { 16, 12, 10 } },
+            { VK_FORMAT_ASTC_12x12_UNORM_BLOCK,     VK_FORMAT_ASTC_12x12_SRGB_BLOCK,        { 16, 12, 12 } },
+        }};
+    }
+
+    std::optional<vulkan_format_block> get_format_block(VkFormat format) noexcept {
+        for (const auto& range : format_ranges) {
+            if (format >= range.first && format <= range.last) {
+                return range.block;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::optional<uint64_t> get_image_size(VkFormat format, uint32_t width, uint32_t height) noexcept {
+        auto block = get_format_block(format);
+        if (!block) return std::nullopt;
+
+        // partial blocks at the edges are stored whole
+        uint64_t blocks_x = (uint64_t(width) + block->width - 1) / block->width;
+        uint64_t blocks_y = (uint64_t(height) + block->height - 1) / block->height;
+        return blocks_x * blocks_y * block->size;
+    }
+}
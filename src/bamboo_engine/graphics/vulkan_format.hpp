@@ -0,0 +1,53 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_FORMAT_HPP
+#define BAMBOOENGINE_VULKAN_FORMAT_HPP
+
+#include <cstdint>
+#include <optional>
+#include <vulkan/vulkan.h>
+
+namespace bbge {
+
+    /**
+     * @brief Size of the smallest addressable unit of a format, a texel or a compressed block.
+     */
+    struct vulkan_format_block {
+        uint32_t size;          // bytes
+        uint32_t width  = 1;    // texels
+        uint32_t height = 1;    // texels
+    };
+
+    /**
+     * @brief Get the texel or block size of a format that can be copied to a whole image.
+     * @param format Format
+     * @return The block or nothing for combined depth stencil, multi-planar and unknown formats
+     */
+    [[nodiscard]] std::optional<vulkan_format_block> get_format_block(VkFormat format) noexcept;
+
+    /**
+     * @brief Get the size of tightly packed texels of an image level.
+     * @param format Format
+     * @param width Width of the level in texels
+     * @param height Height of the level in texels
+     * @return Size in bytes or nothing if get_format_block doesn't know the format
+     */
+    [[nodiscard]] std::optional<uint64_t> get_image_size(VkFormat format, uint32_t width, uint32_t height) noexcept;
+}
+
+#endif //BAMBOOENGINE_VULKAN_FORMAT_HPP
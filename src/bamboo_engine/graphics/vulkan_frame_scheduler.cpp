@@ -0,0 +1,368 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include "vulkan_frame_scheduler.hpp"
+#include "vulkan_utils.hpp"
+
+namespace bbge {
+
+    constexpr std::array<std::string_view, 3> frame_pacing_names {
+        "none", "fence", "present wait"
+    };
+
+    std::string_view to_string(frame_pacing p) noexcept {
+        auto v = static_cast<uint8_t>(p);
+        return frame_pacing_names[v];
+    }
+
+    vulkan_frame_scheduler::vulkan_frame_scheduler(
+        const vulkan_device& device, vulkan_swap_chain& swap_chain, uint32_t frames_in_flight,
+        const frame_pacing_settings& pacing)
+      : m_device(device.get_handle()), m_queue_family_indices(device.get_queue_family_indices()),
+        m_queues(device.get_queues()), m_graphics_queue_mutex(device.get_queue_mutex(m_queues.graphics)),
+        m_presentation_queue_mutex(device.get_queue_mutex(m_queues.presentation)), m_swap_chain(swap_chain),
+        m_images_in_flight(swap_chain.get_images().size(), VK_NULL_HANDLE),
+        m_current_slot(0), m_frame_number(0), m_swap_chain_outdated(false), m_pacing(pacing.mode),
+        m_max_queued_presents(std::max<uint32_t>(pacing.max_queued_presents, 1)), m_last_present_id(0),
+        m_first_present_id(0) {
+
+        if (frames_in_flight == 0) {
+            throw std::invalid_argument("At least one frame has to be in flight.");
+        }
+
+        #ifdef VK_KHR_present_wait
+        m_wait_for_present = nullptr;
+        if (device.has_present_wait()) {
+            m_wait_for_present = (PFN_vkWaitForPresentKHR) vkGetDeviceProcAddr(m_device, "vkWaitForPresentKHR");
+        }
+        if (m_pacing == frame_pacing::present_wait && !m_wait_for_present) {
+            m_pacing = frame_pacing::fence;
+        }
+        #else
+        if (m_pacing == frame_pacing::present_wait) {
+            m_pacing = frame_pacing::fence;
+        }
+        #endif
+        if (m_pacing != pacing.mode) {
+            SPDLOG_WARN("VK_KHR_present_wait is not supported, frames are paced with fences instead.");
+        }
+
+        m_slots.reserve(frames_in_flight);
+        try {
+            for (uint32_t i = 0; i < frames_in_flight; ++i) {
+                m_slots.push_back(create_slot());
+            }
+        }
+        catch (...) {
+            for (auto& slot : m_slots) destroy_slot(slot);
+            throw;
+        }
+
+        SPDLOG_TRACE("Created Vulkan frame scheduler with {} frames in flight and {} pacing.", frames_in_flight, to_string(m_pacing));
+    }
+
+    vulkan_frame_scheduler::~vulkan_frame_scheduler() {
+        wait_idle();
+        for (auto& slot : m_slots) {
+            destroy_slot(slot);
+        }
+        SPDLOG_TRACE("Destroyed Vulkan frame scheduler.");
+    }
+
+    void vulkan_frame_scheduler::pace() {
+
+        if (m_pacing == frame_pacing::none) return;
+
+        #ifdef VK_KHR_present_wait
+        if (m_pacing == frame_pacing::present_wait) {
+            // present ids are consecutive frame numbers, so this allows max_queued_presents pending presents
+            if (m_last_present_id == 0 || m_last_present_id < m_first_present_id + m_max_queued_presents - 1) return;
+            auto target = m_last_present_id - (m_max_queued_presents - 1);
+            auto res = m_wait_for_present(m_device, m_swap_chain.get_handle(), target, present_wait_timeout);
+            if (res == VkResult::VK_ERROR_OUT_OF_DATE_KHR || res == VkResult::VK_SUBOPTIMAL_KHR) {
+                m_swap_chain_outdated = true;
+            }
+            else if (res != VkResult::VK_SUCCESS && res != VkResult::VK_TIMEOUT) {
+                throw vulkan_error("Failed to wait for present", res);
+            }
+            return;
+        }
+        #endif
+
+        // the slot of the next frame is the oldest one in flight, begin_frame() won't block on it anymore
+        auto& slot = m_slots[m_current_slot];
+        auto res = vkWaitForFences(m_device, 1, &slot.in_flight, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to wait for frame fence", res);
+        }
+    }
+
+    std::optional<vulkan_frame_scheduler::frame> vulkan_frame_scheduler::begin_frame() {
+
+        auto& slot = m_slots[m_current_slot];
+
+        // wait until the GPU is done with the last submission of this slot
+        auto res = vkWaitForFences(m_device, 1, &slot.in_flight, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to wait for frame fence", res);
+        }
+
+        // one more slot is known to be finished, unless this frame was begun before and its acquire failed
+        m_swap_chain.release_retired(m_frame_number);
+
+        if (m_swap_chain_outdated && !recreate_swap_chain()) {
+            return { };
+        }
+
+        uint32_t image_index = 0;
+        res = vkAcquireNextImageKHR(
+            m_device, m_swap_chain.get_handle(), std::numeric_limits<uint64_t>::max(),
+            slot.image_available, VK_NULL_HANDLE, &image_index
+        );
+        if (res == VkResult::VK_ERROR_OUT_OF_DATE_KHR) {
+            // nothing was signaled, so the slot can be reused as is
+            m_swap_chain_outdated = true;
+            return { };
+        }
+        if (res == VkResult::VK_SUBOPTIMAL_KHR) {
+            // the image is still presentable, recreate after this frame
+            m_swap_chain_outdated = true;
+        }
+        else if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to acquire swap chain image", res);
+        }
+
+        // the image may still be in use by a frame from another slot if images are acquired out of order
+        auto& image_fence = m_images_in_flight[image_index];
+        if (image_fence != VK_NULL_HANDLE && image_fence != slot.in_flight) {
+            res = vkWaitForFences(m_device, 1, &image_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to wait for swap chain image fence", res);
+            }
+        }
+        image_fence = slot.in_flight;
+
+        // only reset once we know we are going to submit, otherwise the next wait would dead lock
+        res = vkResetFences(m_device, 1, &slot.in_flight);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to reset frame fence", res);
+        }
+
+        res = vkResetCommandPool(m_device, slot.command_pool, 0);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to reset frame command pool", res);
+        }
+
+        VkCommandBufferBeginInfo begin_info { };
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        res = vkBeginCommandBuffer(slot.command_buffer, &begin_info);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to begin frame command buffer", res);
+        }
+
+        return frame {
+            m_current_slot,
+            image_index,
+            m_frame_number,
+            slot.command_buffer,
+            VK_NULL_HANDLE
+        };
+    }
+
+    void vulkan_frame_scheduler::end_frame(const frame& f, const std::vector<wait_semaphore>& waits) {
+
+        assert(f.slot == m_current_slot);
+        auto& slot = m_slots[f.slot];
+
+        auto res = vkEndCommandBuffer(slot.command_buffer);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to end frame command buffer", res);
+        }
+
+        // rendering may not write to the image before the presentation engine released it
+        std::vector<VkSemaphore> wait_semaphores { slot.image_available };
+        std::vector<VkPipelineStageFlags> wait_stages { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+        for (const auto& wait : waits) {
+            wait_semaphores.push_back(wait.semaphore);
+            wait_stages.push_back(wait.stages);
+        }
+
+        VkSubmitInfo submit_info { };
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.waitSemaphoreCount = wait_semaphores.size();
+        submit_info.pWaitSemaphores = wait_semaphores.data();
+        submit_info.pWaitDstStageMask = wait_stages.data();
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &slot.command_buffer;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &slot.render_finished;
+
+        {
+            std::lock_guard lock(m_graphics_queue_mutex);
+            res = vkQueueSubmit(m_queues.graphics, 1, &submit_info, slot.in_flight);
+        }
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to submit frame", res);
+        }
+
+        VkSwapchainKHR swap_chain = m_swap_chain.get_handle();
+
+        VkPresentInfoKHR present_info { };
+        present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        present_info.waitSemaphoreCount = 1;
+        present_info.pWaitSemaphores = &slot.render_finished;
+        present_info.swapchainCount = 1;
+        present_info.pSwapchains = &swap_chain;
+        present_info.pImageIndices = &f.image_index;
+
+        // ids have to increase per swap chain, frame numbers do
+        auto present_id_value = f.number + 1;
+        #ifdef VK_KHR_present_wait
+        VkPresentIdKHR present_id { };
+        present_id.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        present_id.swapchainCount = 1;
+        present_id.pPresentIds = &present_id_value;
+        if (m_wait_for_present) {
+            present_info.pNext = &present_id;
+        }
+        #endif
+
+        {
+            std::lock_guard lock(m_presentation_queue_mutex);
+            res = vkQueuePresentKHR(m_queues.presentation, &present_info);
+        }
+        if (res == VkResult::VK_SUBOPTIMAL_KHR || res == VkResult::VK_ERROR_OUT_OF_DATE_KHR) {
+            m_swap_chain_outdated = true;
+        }
+        else if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to present frame", res);
+        }
+        if (m_last_present_id == 0) {
+            m_first_present_id = present_id_value;
+        }
+        m_last_present_id = present_id_value;
+
+        m_current_slot = (m_current_slot + 1) % m_slots.size();
+        ++m_frame_number;
+    }
+
+    void vulkan_frame_scheduler::request_swap_chain_recreation() noexcept {
+        m_swap_chain_outdated = true;
+    }
+
+    bool vulkan_frame_scheduler::recreate_swap_chain() {
+
+        // Frames still in flight keep using the old images, so instead of waiting for the device
+        // the old swap chain is retired until every slot has waited for its fence once.
+        if (!m_swap_chain.recreate(m_slots.size())) {
+            return false;
+        }
+
+        m_images_in_flight.assign(m_swap_chain.get_images().size(), VK_NULL_HANDLE);
+        m_swap_chain_outdated = false;
+        m_last_present_id = 0; // ids of the old swap chain can't be waited for on the new one
+        return true;
+    }
+
+    void vulkan_frame_scheduler::wait_idle() const {
+
+        std::vector<VkFence> fences;
+        fences.reserve(m_slots.size());
+        for (const auto& slot : m_slots) {
+            fences.push_back(slot.in_flight);
+        }
+        if (fences.empty()) return;
+
+        auto res = vkWaitForFences(m_device, fences.size(), fences.data(), VK_TRUE, std::numeric_limits<uint64_t>::max());
+        if (res != VkResult::VK_SUCCESS) {
+            SPDLOG_ERROR("Failed to wait for frames in flight (err={}).", vulkan_utils::to_string(res));
+        }
+    }
+
+    uint32_t vulkan_frame_scheduler::get_frames_in_flight() const noexcept {
+        return m_slots.size();
+    }
+
+    frame_pacing vulkan_frame_scheduler::get_pacing() const noexcept {
+        return m_pacing;
+    }
+
+    vulkan_frame_scheduler::frame_slot vulkan_frame_scheduler::create_slot() const {
+
+        frame_slot slot { };
+
+        try {
+            // the pool is reset as a whole every frame, individual buffers are never reset
+            VkCommandPoolCreateInfo pool_info { };
+            pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            pool_info.queueFamilyIndex = m_queue_family_indices.graphics;
+            auto res = vkCreateCommandPool(m_device, &pool_info, nullptr, &slot.command_pool);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to create frame command pool", res);
+            }
+
+            VkCommandBufferAllocateInfo alloc_info { };
+            alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            alloc_info.commandPool = slot.command_pool;
+            alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            alloc_info.commandBufferCount = 1;
+            res = vkAllocateCommandBuffers(m_device, &alloc_info, &slot.command_buffer);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to allocate frame command buffer", res);
+            }
+
+            // signaled, so the first wait on the slot returns immediately
+            VkFenceCreateInfo fence_info { };
+            fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+            res = vkCreateFence(m_device, &fence_info, nullptr, &slot.in_flight);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to create frame fence", res);
+            }
+
+            VkSemaphoreCreateInfo semaphore_info { };
+            semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            res = vkCreateSemaphore(m_device, &semaphore_info, nullptr, &slot.image_available);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to create image available semaphore", res);
+            }
+            res = vkCreateSemaphore(m_device, &semaphore_info, nullptr, &slot.render_finished);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to create render finished semaphore", res);
+            }
+        }
+        catch (...) {
+            destroy_slot(slot);
+            throw;
+        }
+
+        return slot;
+    }
+
+    void vulkan_frame_scheduler::destroy_slot(frame_slot& slot) const noexcept {
+        if (slot.render_finished) vkDestroySemaphore(m_device, slot.render_finished, nullptr);
+        if (slot.image_available) vkDestroySemaphore(m_device, slot.image_available, nullptr);
+        if (slot.in_flight) vkDestroyFence(m_device, slot.in_flight, nullptr);
+        if (slot.command_pool) vkDestroyCommandPool(m_device, slot.command_pool, nullptr); // frees the command buffer
+        slot = frame_slot { };
+    }
+}
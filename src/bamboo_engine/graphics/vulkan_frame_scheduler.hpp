@@ -0,0 +1,177 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_FRAME_SCHEDULER_HPP
+#define BAMBOOENGINE_VULKAN_FRAME_SCHEDULER_HPP
+
+#include <mutex>
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include <string_view>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "../util/macros.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Where the CPU waits for the GPU, see vulkan_frame_scheduler::pace().
+     */
+    enum class frame_pacing : uint8_t {
+        none,           // begin_frame() waits for the slot, after input was sampled
+        fence,          // pace() waits for the oldest frame in flight before input is sampled
+        present_wait    // pace() waits until at most max_queued_presents presents are pending, falls back to fence
+    };
+
+    [[nodiscard]] std::string_view to_string(frame_pacing p) noexcept;
+
+    struct frame_pacing_settings {
+        frame_pacing    mode                = frame_pacing::none;
+        uint32_t        max_queued_presents = 1;    // lower is less latency, higher is more throughput
+    };
+
+    /**
+     * @brief Drives the acquire/submit/present loop with multiple frames in flight.
+     * Every frame slot owns its command pool, fence and semaphores, so the CPU records
+     * the next frame while the GPU still works on the previous ones.
+     */
+    class vulkan_frame_scheduler {
+    public:
+
+        static constexpr const uint32_t default_frames_in_flight = 2;
+
+        /**
+         * @brief Everything needed to record a single frame.
+         */
+        struct frame {
+            uint32_t        slot;           // frame in flight index, [0, frames in flight)
+            uint32_t        image_index;    // acquired swap chain image
+            uint64_t        number;         // monotonically increasing frame counter
+            VkCommandBuffer command_buffer; // primary command buffer, already in the recording state
+            VkFramebuffer   framebuffer;    // of the render pass being recorded, set by the render graph
+        };
+
+        /**
+         * @brief Additional semaphore a frame submission waits on, e.g. for uploads on another queue.
+         */
+        struct wait_semaphore {
+            VkSemaphore          semaphore;
+            VkPipelineStageFlags stages;    // stages that have to wait
+        };
+
+        BBGE_NO_COPIES(vulkan_frame_scheduler);
+        BBGE_NO_MOVES(vulkan_frame_scheduler);
+
+        /**
+         * @brief Create the per frame resources.
+         * @param device Device to submit to, uses its graphics and presentation queues
+         * @param swap_chain Swap chain to present to
+         * @param frames_in_flight Number of frames the CPU may run ahead of the GPU
+         * @param pacing Frame pacing policy
+         */
+        vulkan_frame_scheduler(const vulkan_device& device, vulkan_swap_chain& swap_chain,
+                               uint32_t frames_in_flight = default_frames_in_flight,
+                               const frame_pacing_settings& pacing = { });
+
+        /**
+         * @brief Waits for all frames in flight and destroys the per frame resources.
+         */
+        ~vulkan_frame_scheduler();
+
+        /**
+         * @brief Block according to the pacing policy. Call right before sampling input for the next frame,
+         * so the frame starts with the freshest input instead of waiting for the GPU after it was sampled.
+         */
+        void pace();
+
+        /**
+         * @brief Wait for the next frame slot to become available and acquire a swap chain image.
+         * Recreates the swap chain if it became out of date or suboptimal.
+         * @return The frame to record or nothing if no image could be acquired, e.g. because the window is minimized
+         */
+        [[nodiscard]] std::optional<frame> begin_frame();
+
+        /**
+         * @brief Finish recording, submit the frame and present it.
+         * @param f Frame returned by begin_frame()
+         * @param waits Additional semaphores the submission waits on
+         */
+        void end_frame(const frame& f, const std::vector<wait_semaphore>& waits = { });
+
+        /**
+         * @brief Recreate the swap chain before the next frame, e.g. because the window was resized.
+         */
+        void request_swap_chain_recreation() noexcept;
+
+        /**
+         * @brief Block until the GPU has finished all submitted frames.
+         */
+        void wait_idle() const;
+
+        /**
+         * @brief Get the number of frames in flight.
+         * @return Frames in flight
+         */
+        [[nodiscard]] uint32_t get_frames_in_flight() const noexcept;
+
+        /**
+         * @brief Get the pacing mode in use, present_wait falls back to fence if the device doesn't support it.
+         * @return Frame pacing mode
+         */
+        [[nodiscard]] frame_pacing get_pacing() const noexcept;
+
+    private:
+
+        // pace() gives up waiting for a present after this, e.g. if the window is hidden and nothing is displayed
+        static constexpr const uint64_t present_wait_timeout = 100'000'000;
+
+        struct frame_slot {
+            VkCommandPool   command_pool    = VK_NULL_HANDLE;
+            VkCommandBuffer command_buffer  = VK_NULL_HANDLE;
+            VkFence         in_flight       = VK_NULL_HANDLE; // signaled when the GPU finished the slot's last submission
+            VkSemaphore     image_available = VK_NULL_HANDLE;
+            VkSemaphore     render_finished = VK_NULL_HANDLE;
+        };
+
+        VkDevice m_device;
+        const vulkan_queue_family_indices& m_queue_family_indices;
+        const vulkan_device::queue_handles& m_queues;
+        std::mutex& m_graphics_queue_mutex;
+        std::mutex& m_presentation_queue_mutex;
+        vulkan_swap_chain& m_swap_chain;
+        std::vector<frame_slot> m_slots;
+        std::vector<VkFence> m_images_in_flight; // fence of the slot currently rendering to a swap chain image
+        uint32_t m_current_slot;
+        uint64_t m_frame_number;
+        bool m_swap_chain_outdated;
+
+        frame_pacing m_pacing;
+        uint32_t m_max_queued_presents;
+        uint64_t m_last_present_id;     // 0 if nothing was presented to the current swap chain yet
+        uint64_t m_first_present_id;    // first id presented to the current swap chain
+        #ifdef VK_KHR_present_wait
+        PFN_vkWaitForPresentKHR m_wait_for_present;
+        #endif
+
+        [[nodiscard]] frame_slot create_slot() const;
+        [[nodiscard]] bool recreate_swap_chain();
+        void destroy_slot(frame_slot& slot) const noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_FRAME_SCHEDULER_HPP
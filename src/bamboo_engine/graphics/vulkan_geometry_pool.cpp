@@ -0,0 +1,115 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cassert>
+#include <fmt/format.h>
+#include "vulkan_geometry_pool.hpp"
+
+namespace bbge {
+
+    vulkan_geometry_pool::vulkan_geometry_pool(vulkan_allocator& allocator, vulkan_upload_service& uploads,
+                                               uint32_t vertex_stride, uint32_t vertex_capacity, uint32_t index_capacity)
+      : m_uploads(uploads), m_vertex_stride(vertex_stride),
+        m_vertices(allocator.create_buffer(
+            VkDeviceSize(vertex_stride) * vertex_capacity,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory_usage::gpu_only
+        )),
+        m_indices(allocator.create_buffer(
+            VkDeviceSize(sizeof(uint32_t)) * index_capacity,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory_usage::gpu_only
+        )),
+        m_vertex_ranges(vertex_capacity), m_index_ranges(index_capacity), m_mesh_count(0) {
+
+        SPDLOG_TRACE("Created geometry pool for {} vertices of {} bytes and {} indices.", vertex_capacity, vertex_stride, index_capacity);
+    }
+
+    result<vulkan_geometry_pool::mesh_id, std::runtime_error> vulkan_geometry_pool::add_mesh(
+        const void* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count) {
+
+        assert(vertex_count > 0 && index_count > 0);
+
+        auto vertex_range = m_vertex_ranges.allocate(vertex_count);
+        if (!vertex_range) {
+            return std::runtime_error(fmt::format(
+                "The geometry pool has no room for {} more vertices ({} of {} used).",
+                vertex_count, m_vertex_ranges.get_used(), m_vertex_ranges.get_size()
+            ));
+        }
+        auto index_range = m_index_ranges.allocate(index_count);
+        if (!index_range) {
+            m_vertex_ranges.free(vertex_range->block);
+            return std::runtime_error(fmt::format(
+                "The geometry pool has no room for {} more indices ({} of {} used).",
+                index_count, m_index_ranges.get_used(), m_index_ranges.get_size()
+            ));
+        }
+
+        m_uploads.upload_buffer(m_vertices, vertex_range->offset * m_vertex_stride, vertices,
+                                VkDeviceSize(vertex_count) * m_vertex_stride,
+                                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+        m_uploads.upload_buffer(m_indices, index_range->offset * sizeof(uint32_t), indices,
+                                VkDeviceSize(index_count) * sizeof(uint32_t),
+                                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+
+        slot s { };
+        s.range = { static_cast<int32_t>(vertex_range->offset), static_cast<uint32_t>(index_range->offset), index_count };
+        s.vertex_block = vertex_range->block;
+        s.index_block = index_range->block;
+
+        mesh_id id;
+        if (!m_free_ids.empty()) {
+            id = m_free_ids.back();
+            m_free_ids.pop_back();
+            m_slots[id] = s;
+        }
+        else {
+            id = static_cast<mesh_id>(m_slots.size());
+            m_slots.push_back(s);
+        }
+        ++m_mesh_count;
+
+        return id;
+    }
+
+    void vulkan_geometry_pool::remove_mesh(mesh_id id) {
+        assert(id < m_slots.size() && m_slots[id].vertex_block != tlsf_allocator::invalid_handle);
+        auto& s = m_slots[id];
+        m_vertex_ranges.free(s.vertex_block);
+        m_index_ranges.free(s.index_block);
+        s = slot { };
+        m_free_ids.push_back(id);
+        --m_mesh_count;
+    }
+
+    const vulkan_geometry_pool::mesh_range& vulkan_geometry_pool::get_mesh(mesh_id id) const noexcept {
+        assert(id < m_slots.size());
+        return m_slots[id].range;
+    }
+
+    void vulkan_geometry_pool::bind(const vulkan_command_buffer& cmd) const noexcept {
+        cmd.bind_vertex_buffer(0, m_vertices);
+        cmd.bind_index_buffer(m_indices, index_type::uint32);
+    }
+
+    uint32_t vulkan_geometry_pool::get_vertex_stride() const noexcept {
+        return m_vertex_stride;
+    }
+
+    std::size_t vulkan_geometry_pool::get_mesh_count() const noexcept {
+        return m_mesh_count;
+    }
+}
@@ -0,0 +1,135 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_GEOMETRY_POOL_HPP
+#define BAMBOOENGINE_VULKAN_GEOMETRY_POOL_HPP
+
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include <gsl/gsl-lite.hpp>
+#include <vulkan/vulkan.h>
+#include "vulkan_allocator.hpp"
+#include "vulkan_command_buffer.hpp"
+#include "vulkan_upload_service.hpp"
+#include "../util/macros.hpp"
+#include "../util/result.hpp"
+#include "../util/tlsf_allocator.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Shared vertex and index buffers that hold many meshes of one vertex type.
+     * All meshes are drawn with the same bindings, so draws only differ in their offsets and can be issued indirectly.
+     * Ranges of both buffers are handed out by a tlsf_allocator, counted in vertices and indices.
+     */
+    class vulkan_geometry_pool {
+    public:
+
+        using mesh_id = uint32_t;
+
+        /**
+         * @brief Where a mesh lives in the shared buffers, in the units of VkDrawIndexedIndirectCommand.
+         */
+        struct mesh_range {
+            int32_t  vertex_offset;
+            uint32_t first_index;
+            uint32_t index_count;
+        };
+
+        BBGE_NO_COPIES(vulkan_geometry_pool);
+        BBGE_NO_MOVES(vulkan_geometry_pool);
+
+        /**
+         * @brief Create the shared buffers.
+         * @param allocator Allocator of the buffers
+         * @param uploads Upload service that fills them
+         * @param vertex_stride Size of one vertex
+         * @param vertex_capacity Number of vertices the pool can hold
+         * @param index_capacity Number of 32 bit indices the pool can hold
+         */
+        vulkan_geometry_pool(vulkan_allocator& allocator, vulkan_upload_service& uploads,
+                             uint32_t vertex_stride, uint32_t vertex_capacity, uint32_t index_capacity);
+
+        /**
+         * @brief Add a mesh and queue its upload. It may be drawn once the uploads were flushed.
+         * @tparam Vertex Vertex type, its size has to be the pool's stride
+         * @param vertices Vertex data
+         * @param indices Indices relative to the mesh's first vertex
+         * @return Id of the mesh or an error if the pool is full
+         */
+        template <typename Vertex>
+        [[nodiscard]] result<mesh_id, std::runtime_error> add_mesh(gsl::span<const Vertex> vertices, gsl::span<const uint32_t> indices);
+
+        /**
+         * @brief Remove a mesh. The caller has to make sure the GPU doesn't draw it anymore.
+         * @param id Mesh id
+         */
+        void remove_mesh(mesh_id id);
+
+        /**
+         * @brief Get the location of a mesh.
+         * @param id Id of a mesh in this pool
+         * @return Location of the mesh
+         */
+        [[nodiscard]] const mesh_range& get_mesh(mesh_id id) const noexcept;
+
+        /**
+         * @brief Bind the vertex buffer to binding 0 and the index buffer.
+         * @param cmd Command buffer
+         */
+        void bind(const vulkan_command_buffer& cmd) const noexcept;
+
+        [[nodiscard]] uint32_t get_vertex_stride() const noexcept;
+        [[nodiscard]] std::size_t get_mesh_count() const noexcept;
+
+    private:
+
+        struct slot {
+            mesh_range range;
+            tlsf_allocator::handle vertex_block = tlsf_allocator::invalid_handle;
+            tlsf_allocator::handle index_block = tlsf_allocator::invalid_handle;
+        };
+
+        vulkan_upload_service& m_uploads;
+        uint32_t m_vertex_stride;
+        vulkan_buffer m_vertices;
+        vulkan_buffer m_indices;
+        tlsf_allocator m_vertex_ranges;
+        tlsf_allocator m_index_ranges;
+        std::vector<slot> m_slots;
+        std::vector<mesh_id> m_free_ids;
+        std::size_t m_mesh_count;
+
+        [[nodiscard]] result<mesh_id, std::runtime_error> add_mesh(const void* vertices, uint32_t vertex_count,
+                                                                   const uint32_t* indices, uint32_t index_count);
+    };
+
+    template <typename Vertex>
+    result<vulkan_geometry_pool::mesh_id, std::runtime_error> vulkan_geometry_pool::add_mesh(
+        gsl::span<const Vertex> vertices, gsl::span<const uint32_t> indices) {
+        static_assert(std::is_trivially_copyable_v<Vertex>, "Vertices are copied to the GPU byte by byte");
+        if (sizeof(Vertex) != m_vertex_stride) {
+            throw std::invalid_argument("The vertex type doesn't match the geometry pool's stride.");
+        }
+        return add_mesh(vertices.data(), static_cast<uint32_t>(vertices.size()),
+                        indices.data(), static_cast<uint32_t>(indices.size()));
+    }
+}
+
+#endif //BAMBOOENGINE_VULKAN_GEOMETRY_POOL_HPP
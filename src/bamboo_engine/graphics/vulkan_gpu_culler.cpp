@@ -0,0 +1,284 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include "vulkan_gpu_culler.hpp"
+
+namespace bbge {
+
+    vulkan_gpu_culler::vulkan_gpu_culler(const vulkan_device& device, const std::filesystem::path& shader_path,
+                                         uint32_t frames_in_flight, uint32_t max_objects)
+      : m_device(device.get_handle()), m_compute_queue(device.get_queues().compute), m_compute_queue_mutex(nullptr),
+        m_compute_family(device.get_queue_family_indices().compute), m_max_objects(max_objects),
+        m_multi_draw_indirect(device.get_enabled_features().multiDrawIndirect == VK_TRUE), m_max_draw_indirect_count(1),
+        m_set_layout(VK_NULL_HANDLE), m_descriptor_pool(VK_NULL_HANDLE) {
+
+        if (!m_compute_queue) {
+            throw vulkan_error("GPU culling needs a compute queue", VK_ERROR_FEATURE_NOT_PRESENT);
+        }
+        m_compute_queue_mutex = &device.get_queue_mutex(m_compute_queue);
+
+        // without multi draw indirect every command is drawn on its own
+        if (m_multi_draw_indirect) {
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(device.get_physical_device(), &properties);
+            m_max_draw_indirect_count = std::max<uint32_t>(properties.limits.maxDrawIndirectCount, 1);
+        }
+
+        try {
+            create_descriptors(frames_in_flight);
+
+            compute_pipeline_settings settings { };
+            settings.descriptor_set_layouts = { m_set_layout };
+            settings.push_constant_ranges = { { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants) } };
+            m_pipeline = std::make_unique<vulkan_compute_pipeline>(std::string("Frustum culling"), shader_path, settings, device);
+
+            m_slots.reserve(frames_in_flight);
+            for (uint32_t i = 0; i < frames_in_flight; ++i) {
+                m_slots.push_back(create_slot(device.get_allocator(), device.get_queue_family_indices().graphics));
+            }
+
+            std::vector<VkDescriptorSetLayout> layouts(frames_in_flight, m_set_layout);
+            std::vector<VkDescriptorSet> sets(frames_in_flight);
+            VkDescriptorSetAllocateInfo alloc_info { };
+            alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            alloc_info.descriptorPool = m_descriptor_pool;
+            alloc_info.descriptorSetCount = frames_in_flight;
+            alloc_info.pSetLayouts = layouts.data();
+            auto res = vkAllocateDescriptorSets(m_device, &alloc_info, sets.data());
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to allocate culling descriptor sets", res);
+            }
+            for (uint32_t i = 0; i < frames_in_flight; ++i) {
+                m_slots[i].descriptor_set = sets[i];
+                write_descriptor_set(m_slots[i]);
+            }
+        }
+        catch (...) {
+            destroy();
+            throw;
+        }
+
+        SPDLOG_TRACE("Created GPU culler for up to {} objects.", max_objects);
+    }
+
+    vulkan_gpu_culler::~vulkan_gpu_culler() {
+        destroy();
+        SPDLOG_TRACE("Destroyed GPU culler.");
+    }
+
+    vulkan_frame_scheduler::wait_semaphore vulkan_gpu_culler::cull(
+        const vulkan_frame_scheduler::frame& f, const frustum& view, gsl::span<const gpu_cull_object> objects) {
+
+        assert(f.slot < m_slots.size());
+        assert(objects.size() <= m_max_objects);
+        auto& slot = m_slots[f.slot];
+
+        // the frame scheduler waited for the slot, so the GPU is done with its buffers and command buffer
+        slot.object_count = static_cast<uint32_t>(std::min<std::size_t>(objects.size(), m_max_objects));
+        if (slot.object_count > 0) {
+            std::memcpy(slot.objects.get_mapped(), objects.data(), slot.object_count * sizeof(gpu_cull_object));
+        }
+
+        auto res = vkResetCommandPool(m_device, slot.command_pool, 0);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to reset culling command pool", res);
+        }
+
+        VkCommandBufferBeginInfo begin_info { };
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        res = vkBeginCommandBuffer(slot.command_buffer, &begin_info);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to begin culling command buffer", res);
+        }
+
+        if (slot.object_count > 0) {
+            push_constants constants { };
+            std::copy(view.planes.begin(), view.planes.end(), constants.planes);
+            constants.object_count = slot.object_count;
+
+            vulkan_command_buffer cmd(slot.command_buffer);
+            cmd.bind_pipeline(*m_pipeline);
+            vkCmdBindDescriptorSets(slot.command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->get_layout(),
+                                    0, 1, &slot.descriptor_set, 0, nullptr);
+            vkCmdPushConstants(slot.command_buffer, m_pipeline->get_layout(), VK_SHADER_STAGE_COMPUTE_BIT,
+                               0, sizeof(constants), &constants);
+            cmd.dispatch((slot.object_count + workgroup_size - 1) / workgroup_size);
+        }
+
+        res = vkEndCommandBuffer(slot.command_buffer);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to end culling command buffer", res);
+        }
+
+        // also submitted without objects, the frame waits on the semaphore either way
+        VkSubmitInfo submit_info { };
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &slot.command_buffer;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &slot.finished;
+        {
+            std::lock_guard lock(*m_compute_queue_mutex);
+            res = vkQueueSubmit(m_compute_queue, 1, &submit_info, VK_NULL_HANDLE);
+        }
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to submit culling", res);
+        }
+
+        return { slot.finished, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT };
+    }
+
+    void vulkan_gpu_culler::draw(const vulkan_command_buffer& cmd, const vulkan_frame_scheduler::frame& f) const noexcept {
+
+        assert(f.slot < m_slots.size());
+        const auto& slot = m_slots[f.slot];
+
+        constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        for (uint32_t first = 0; first < slot.object_count; first += m_max_draw_indirect_count) {
+            auto count = std::min(m_max_draw_indirect_count, slot.object_count - first);
+            cmd.draw_indexed_indirect(slot.commands, VkDeviceSize(first) * stride, count, stride);
+        }
+    }
+
+    const vulkan_buffer& vulkan_gpu_culler::get_draw_commands(uint32_t slot) const noexcept {
+        assert(slot < m_slots.size());
+        return m_slots[slot].commands;
+    }
+
+    uint32_t vulkan_gpu_culler::get_max_objects() const noexcept {
+        return m_max_objects;
+    }
+
+    void vulkan_gpu_culler::create_descriptors(uint32_t frames_in_flight) {
+
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings { };
+        for (uint32_t i = 0; i < bindings.size(); ++i) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layout_info { };
+        layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+        layout_info.pBindings = bindings.data();
+        auto res = vkCreateDescriptorSetLayout(m_device, &layout_info, nullptr, &m_set_layout);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to create culling descriptor set layout", res);
+        }
+
+        VkDescriptorPoolSize pool_size { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(bindings.size()) * frames_in_flight };
+        VkDescriptorPoolCreateInfo pool_info { };
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.maxSets = frames_in_flight;
+        pool_info.poolSizeCount = 1;
+        pool_info.pPoolSizes = &pool_size;
+        res = vkCreateDescriptorPool(m_device, &pool_info, nullptr, &m_descriptor_pool);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to create culling descriptor pool", res);
+        }
+    }
+
+    vulkan_gpu_culler::frame_slot vulkan_gpu_culler::create_slot(vulkan_allocator& allocator, uint32_t graphics_family) const {
+
+        frame_slot slot { };
+
+        slot.objects = allocator.create_buffer(
+            VkDeviceSize(m_max_objects) * sizeof(gpu_cull_object), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, memory_usage::cpu_to_gpu
+        );
+
+        // written on the compute queue, read on the graphics queue
+        std::array<uint32_t, 2> families { m_compute_family, graphics_family };
+        gsl::span<const uint32_t> sharing(families.data(), m_compute_family == graphics_family ? 1 : 2);
+        slot.commands = allocator.create_buffer(
+            VkDeviceSize(m_max_objects) * sizeof(VkDrawIndexedIndirectCommand),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, memory_usage::gpu_only, sharing
+        );
+
+        try {
+            VkCommandPoolCreateInfo pool_info { };
+            pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            pool_info.queueFamilyIndex = m_compute_family;
+            auto res = vkCreateCommandPool(m_device, &pool_info, nullptr, &slot.command_pool);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to create culling command pool", res);
+            }
+
+            VkCommandBufferAllocateInfo alloc_info { };
+            alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            alloc_info.commandPool = slot.command_pool;
+            alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            alloc_info.commandBufferCount = 1;
+            res = vkAllocateCommandBuffers(m_device, &alloc_info, &slot.command_buffer);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to allocate culling command buffer", res);
+            }
+
+            VkSemaphoreCreateInfo semaphore_info { };
+            semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            res = vkCreateSemaphore(m_device, &semaphore_info, nullptr, &slot.finished);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to create culling semaphore", res);
+            }
+        }
+        catch (...) {
+            if (slot.command_pool) vkDestroyCommandPool(m_device, slot.command_pool, nullptr);
+            throw;
+        }
+
+        return slot;
+    }
+
+    void vulkan_gpu_culler::write_descriptor_set(const frame_slot& slot) const noexcept {
+
+        std::array<VkDescriptorBufferInfo, 2> buffer_infos {
+            VkDescriptorBufferInfo { slot.objects.get_handle(), 0, VK_WHOLE_SIZE },
+            VkDescriptorBufferInfo { slot.commands.get_handle(), 0, VK_WHOLE_SIZE }
+        };
+
+        std::array<VkWriteDescriptorSet, 2> writes { };
+        for (uint32_t i = 0; i < writes.size(); ++i) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = slot.descriptor_set;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo = &buffer_infos[i];
+        }
+        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    void vulkan_gpu_culler::destroy() noexcept {
+        for (auto& slot : m_slots) {
+            if (slot.finished) vkDestroySemaphore(m_device, slot.finished, nullptr);
+            if (slot.command_pool) vkDestroyCommandPool(m_device, slot.command_pool, nullptr); // frees the command buffer
+        }
+        m_slots.clear(); // frees the buffers
+        m_pipeline.reset();
+        if (m_descriptor_pool) vkDestroyDescriptorPool(m_device, m_descriptor_pool, nullptr); // frees the sets
+        if (m_set_layout) vkDestroyDescriptorSetLayout(m_device, m_set_layout, nullptr);
+        m_descriptor_pool = VK_NULL_HANDLE;
+        m_set_layout = VK_NULL_HANDLE;
+    }
+}
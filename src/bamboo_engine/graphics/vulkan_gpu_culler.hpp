@@ -0,0 +1,139 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_GPU_CULLER_HPP
+#define BAMBOOENGINE_VULKAN_GPU_CULLER_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <glm/glm.hpp>
+#include <gsl/gsl-lite.hpp>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "vulkan_allocator.hpp"
+#include "vulkan_command_buffer.hpp"
+#include "vulkan_compute_pipeline.hpp"
+#include "vulkan_frame_scheduler.hpp"
+#include "../scene/frustum_culling.hpp"
+#include "../util/macros.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Object culled on the GPU, laid out like the std430 struct in cull.comp.
+     */
+    struct gpu_cull_object {
+        glm::vec4 sphere;           // xyz center, w radius, world space
+        uint32_t  index_count;
+        uint32_t  first_index;
+        int32_t   vertex_offset;
+        uint32_t  first_instance;   // has to be 0 unless drawIndirectFirstInstance is enabled
+    };
+    static_assert(sizeof(gpu_cull_object) == 32);
+
+    /**
+     * @brief Frustum culling in a compute shader on the device's compute queue.
+     * Writes one VkDrawIndexedIndirectCommand per object, invisible objects get an instance count of 0,
+     * so the graphics queue draws everything with a single indirect draw and the CPU never touches the results.
+     * Command buffers are shared between the compute and graphics families, so no ownership transfer is needed.
+     */
+    class vulkan_gpu_culler {
+    public:
+
+        static constexpr const uint32_t workgroup_size = 64; // local_size_x of cull.comp
+
+        BBGE_NO_COPIES(vulkan_gpu_culler);
+        BBGE_NO_MOVES(vulkan_gpu_culler);
+
+        /**
+         * @brief Create the pipeline and per frame buffers. Throws a vulkan_error if the device has no compute queue.
+         * @param device Device
+         * @param shader_path Path to the compiled cull.comp
+         * @param frames_in_flight Frames in flight of the frame scheduler
+         * @param max_objects Maximum number of objects per frame
+         */
+        vulkan_gpu_culler(const vulkan_device& device, const std::filesystem::path& shader_path,
+                          uint32_t frames_in_flight, uint32_t max_objects);
+
+        ~vulkan_gpu_culler();
+
+        /**
+         * @brief Cull objects for a frame. Submits to the compute queue right away.
+         * @param f Frame that draws the objects
+         * @param view Frustum to cull against
+         * @param objects Objects, at most max_objects
+         * @return Semaphore the frame submission has to wait on before drawing
+         */
+        [[nodiscard]] vulkan_frame_scheduler::wait_semaphore cull(const vulkan_frame_scheduler::frame& f, const frustum& view,
+                                                                  gsl::span<const gpu_cull_object> objects);
+
+        /**
+         * @brief Draw the objects culled for a frame with indirect draws. Vertex and index buffers have to be bound.
+         * @param cmd Command buffer of the frame, inside a render pass
+         * @param f Frame that was culled
+         */
+        void draw(const vulkan_command_buffer& cmd, const vulkan_frame_scheduler::frame& f) const noexcept;
+
+        /**
+         * @brief Get the indirect commands of a frame slot, e.g. to draw them differently.
+         * @param slot Frame in flight index
+         * @return Buffer of VkDrawIndexedIndirectCommand, one per culled object
+         */
+        [[nodiscard]] const vulkan_buffer& get_draw_commands(uint32_t slot) const noexcept;
+
+        [[nodiscard]] uint32_t get_max_objects() const noexcept;
+
+    private:
+
+        struct push_constants {
+            glm::vec4 planes[6];
+            uint32_t  object_count;
+        };
+
+        struct frame_slot {
+            vulkan_buffer   objects;                            // host visible, written every frame
+            vulkan_buffer   commands;                           // device local indirect commands
+            VkDescriptorSet descriptor_set  = VK_NULL_HANDLE;
+            VkCommandPool   command_pool    = VK_NULL_HANDLE;
+            VkCommandBuffer command_buffer  = VK_NULL_HANDLE;
+            VkSemaphore     finished        = VK_NULL_HANDLE;
+            uint32_t        object_count    = 0;
+        };
+
+        VkDevice m_device;
+        VkQueue m_compute_queue;
+        std::mutex* m_compute_queue_mutex; // shared with the other roles of the queue, e.g. graphics
+        uint32_t m_compute_family;
+        uint32_t m_max_objects;
+        bool m_multi_draw_indirect;
+        uint32_t m_max_draw_indirect_count;
+        VkDescriptorSetLayout m_set_layout;
+        VkDescriptorPool m_descriptor_pool;
+        std::unique_ptr<vulkan_compute_pipeline> m_pipeline;
+        std::vector<frame_slot> m_slots;
+
+        void create_descriptors(uint32_t frames_in_flight);
+        [[nodiscard]] frame_slot create_slot(vulkan_allocator& allocator, uint32_t graphics_family) const;
+        void write_descriptor_set(const frame_slot& slot) const noexcept;
+        void destroy() noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_GPU_CULLER_HPP
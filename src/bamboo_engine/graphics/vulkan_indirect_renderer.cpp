@@ -0,0 +1,275 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cassert>
+#include "vulkan_indirect_renderer.hpp"
+
+namespace bbge {
+
+    vulkan_indirect_renderer::vulkan_indirect_renderer(const vulkan_device& device, uint32_t frames_in_flight, uint32_t max_draws,
+                                                       vulkan_bindless_set* bindless)
+      : m_device(device.get_handle()), m_max_draws(max_draws),
+        m_first_instance(device.get_enabled_features().drawIndirectFirstInstance == VK_TRUE),
+        m_multi_draw_indirect(device.get_enabled_features().multiDrawIndirect == VK_TRUE), m_max_draw_indirect_count(1),
+        m_draw_indirect_count(nullptr), m_bindless(bindless), m_set_layout(VK_NULL_HANDLE), m_descriptor_pool(VK_NULL_HANDLE) {
+
+        if (m_multi_draw_indirect) {
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(device.get_physical_device(), &properties);
+            m_max_draw_indirect_count = std::max<uint32_t>(properties.limits.maxDrawIndirectCount, 1);
+
+            if (device.is_extension_enabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+                m_draw_indirect_count = (PFN_vkCmdDrawIndexedIndirectCountKHR) vkGetDeviceProcAddr(m_device, "vkCmdDrawIndexedIndirectCountKHR");
+            }
+        }
+        if (!m_first_instance) {
+            SPDLOG_WARN("drawIndirectFirstInstance is not supported, indirect rendering falls back to direct draws.");
+        }
+
+        try {
+            m_slots.reserve(frames_in_flight);
+            for (uint32_t i = 0; i < frames_in_flight; ++i) {
+                m_slots.push_back(create_slot(device.get_allocator()));
+            }
+
+            if (m_bindless) {
+                for (auto& slot : m_slots) {
+                    slot.draw_data_index = m_bindless->add_buffer(slot.draw_data.get_handle()).or_throw();
+                }
+            }
+            else {
+                create_descriptors(frames_in_flight);
+            }
+        }
+        catch (...) {
+            destroy();
+            throw;
+        }
+
+        SPDLOG_TRACE("Created indirect renderer for up to {} draws, count buffer {}.",
+                     max_draws, m_draw_indirect_count ? "enabled" : "disabled");
+    }
+
+    vulkan_indirect_renderer::~vulkan_indirect_renderer() {
+        destroy();
+        SPDLOG_TRACE("Destroyed indirect renderer.");
+    }
+
+    void vulkan_indirect_renderer::prepare(const vulkan_frame_scheduler::frame& f, const render_list& list,
+                                           gsl::span<const uint32_t> visible, const vulkan_geometry_pool& geometry) {
+
+        assert(f.slot < m_slots.size());
+        assert(visible.size() <= m_max_draws);
+        auto& slot = m_slots[f.slot];
+        visible = visible.subspan(0, std::min<std::size_t>(visible.size(), m_max_draws));
+
+        // the frame scheduler waited for the slot, so the GPU is done with its buffers
+        auto* draw_data = reinterpret_cast<indirect_draw_data*>(slot.draw_data.get_mapped());
+        for (std::size_t i = 0; i < visible.size(); ++i) {
+            auto draw = visible[i];
+            draw_data[i] = { list.model_matrices[draw], list.material_ids[draw], { } };
+        }
+
+        // a batch shares pipeline, material and mesh, so it is one command with an instance per draw
+        build_draw_batches(list, visible, m_batches);
+
+        auto* commands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(slot.commands.get_mapped());
+        auto* counts = reinterpret_cast<uint32_t*>(slot.counts.get_mapped());
+        slot.buckets.clear();
+        slot.direct_commands.clear();
+
+        for (uint32_t i = 0; i < m_batches.size(); ++i) {
+            const auto& batch = m_batches[i];
+            const auto& mesh = geometry.get_mesh(batch.mesh_id);
+
+            VkDrawIndexedIndirectCommand command { };
+            command.indexCount = mesh.index_count;
+            command.instanceCount = batch.count;
+            command.firstIndex = mesh.first_index;
+            command.vertexOffset = mesh.vertex_offset;
+            command.firstInstance = batch.first;
+            commands[i] = command;
+            if (!m_first_instance) {
+                slot.direct_commands.push_back(command);
+            }
+
+            // batches are sorted by pipeline first
+            if (slot.buckets.empty() || slot.buckets.back().pipeline_id != batch.pipeline_id) {
+                slot.buckets.push_back({ batch.pipeline_id, i, 0 });
+            }
+            ++slot.buckets.back().command_count;
+        }
+
+        for (std::size_t i = 0; i < slot.buckets.size(); ++i) {
+            counts[i] = slot.buckets[i].command_count;
+        }
+    }
+
+    gsl::span<const vulkan_indirect_renderer::bucket> vulkan_indirect_renderer::get_buckets(
+        const vulkan_frame_scheduler::frame& f) const noexcept {
+        assert(f.slot < m_slots.size());
+        return m_slots[f.slot].buckets;
+    }
+
+    void vulkan_indirect_renderer::draw(const vulkan_command_buffer& cmd, const vulkan_frame_scheduler::frame& f,
+                                        uint32_t bucket_index, VkPipelineLayout layout) const noexcept {
+
+        assert(f.slot < m_slots.size());
+        const auto& slot = m_slots[f.slot];
+        assert(bucket_index < slot.buckets.size());
+        const auto& b = slot.buckets[bucket_index];
+
+        if (m_bindless) {
+            indirect_push_constants constants { slot.draw_data_index };
+            vkCmdPushConstants(cmd.get_handle(), layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                               0, sizeof(constants), &constants);
+        }
+        else {
+            vkCmdBindDescriptorSets(cmd.get_handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, layout,
+                                    0, 1, &slot.descriptor_set, 0, nullptr);
+        }
+
+        // direct draws may use any first instance
+        if (!m_first_instance) {
+            for (uint32_t i = b.first_command; i < b.first_command + b.command_count; ++i) {
+                const auto& c = slot.direct_commands[i];
+                cmd.draw_indexed(c.indexCount, c.instanceCount, c.firstIndex, c.vertexOffset, c.firstInstance);
+            }
+            return;
+        }
+
+        constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        if (m_draw_indirect_count && b.command_count <= m_max_draw_indirect_count) {
+            m_draw_indirect_count(cmd.get_handle(), slot.commands.get_handle(), VkDeviceSize(b.first_command) * stride,
+                                  slot.counts.get_handle(), VkDeviceSize(bucket_index) * sizeof(uint32_t),
+                                  b.command_count, stride);
+            return;
+        }
+
+        // without multi draw indirect the maximum is 1
+        for (uint32_t first = 0; first < b.command_count; first += m_max_draw_indirect_count) {
+            auto count = std::min(m_max_draw_indirect_count, b.command_count - first);
+            cmd.draw_indexed_indirect(slot.commands, VkDeviceSize(b.first_command + first) * stride, count, stride);
+        }
+    }
+
+    VkDescriptorSetLayout vulkan_indirect_renderer::get_set_layout() const noexcept {
+        return m_bindless ? m_bindless->get_set_layout() : m_set_layout;
+    }
+
+    VkPushConstantRange vulkan_indirect_renderer::get_push_constant_range() noexcept {
+        return { VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(indirect_push_constants) };
+    }
+
+    uint32_t vulkan_indirect_renderer::get_max_draws() const noexcept {
+        return m_max_draws;
+    }
+
+    void vulkan_indirect_renderer::create_descriptors(uint32_t frames_in_flight) {
+
+        VkDescriptorSetLayoutBinding binding { };
+        binding.binding = 0;
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        VkDescriptorSetLayoutCreateInfo layout_info { };
+        layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_info.bindingCount = 1;
+        layout_info.pBindings = &binding;
+        auto res = vkCreateDescriptorSetLayout(m_device, &layout_info, nullptr, &m_set_layout);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to create draw data descriptor set layout", res);
+        }
+
+        VkDescriptorPoolSize pool_size { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frames_in_flight };
+        VkDescriptorPoolCreateInfo pool_info { };
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.maxSets = frames_in_flight;
+        pool_info.poolSizeCount = 1;
+        pool_info.pPoolSizes = &pool_size;
+        res = vkCreateDescriptorPool(m_device, &pool_info, nullptr, &m_descriptor_pool);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to create draw data descriptor pool", res);
+        }
+
+        std::vector<VkDescriptorSetLayout> layouts(frames_in_flight, m_set_layout);
+        std::vector<VkDescriptorSet> sets(frames_in_flight);
+        VkDescriptorSetAllocateInfo alloc_info { };
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = m_descriptor_pool;
+        alloc_info.descriptorSetCount = frames_in_flight;
+        alloc_info.pSetLayouts = layouts.data();
+        res = vkAllocateDescriptorSets(m_device, &alloc_info, sets.data());
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to allocate draw data descriptor sets", res);
+        }
+        for (uint32_t i = 0; i < frames_in_flight; ++i) {
+            m_slots[i].descriptor_set = sets[i];
+            write_descriptor_set(m_slots[i]);
+        }
+    }
+
+    vulkan_indirect_renderer::frame_slot vulkan_indirect_renderer::create_slot(vulkan_allocator& allocator) const {
+
+        frame_slot slot { };
+
+        slot.draw_data = allocator.create_buffer(
+            VkDeviceSize(m_max_draws) * sizeof(indirect_draw_data), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, memory_usage::cpu_to_gpu
+        );
+        slot.commands = allocator.create_buffer(
+            VkDeviceSize(m_max_draws) * sizeof(VkDrawIndexedIndirectCommand),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, memory_usage::cpu_to_gpu
+        );
+        // every draw may use its own pipeline, so there are at most as many buckets as draws
+        slot.counts = allocator.create_buffer(
+            VkDeviceSize(m_max_draws) * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, memory_usage::cpu_to_gpu
+        );
+        slot.buckets.reserve(m_max_draws);
+
+        return slot;
+    }
+
+    void vulkan_indirect_renderer::write_descriptor_set(const frame_slot& slot) const noexcept {
+
+        VkDescriptorBufferInfo buffer_info { slot.draw_data.get_handle(), 0, VK_WHOLE_SIZE };
+
+        VkWriteDescriptorSet write { };
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = slot.descriptor_set;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &buffer_info;
+        vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+    }
+
+    void vulkan_indirect_renderer::destroy() noexcept {
+        if (m_bindless) {
+            for (const auto& slot : m_slots) {
+                if (slot.draw_data_index != no_index) m_bindless->remove_buffer(slot.draw_data_index);
+            }
+        }
+        m_slots.clear(); // frees the buffers
+        if (m_descriptor_pool) vkDestroyDescriptorPool(m_device, m_descriptor_pool, nullptr); // frees the sets
+        if (m_set_layout) vkDestroyDescriptorSetLayout(m_device, m_set_layout, nullptr);
+        m_descriptor_pool = VK_NULL_HANDLE;
+        m_set_layout = VK_NULL_HANDLE;
+    }
+}
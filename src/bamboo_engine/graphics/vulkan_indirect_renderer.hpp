@@ -0,0 +1,167 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_INDIRECT_RENDERER_HPP
+#define BAMBOOENGINE_VULKAN_INDIRECT_RENDERER_HPP
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <gsl/gsl-lite.hpp>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "vulkan_allocator.hpp"
+#include "vulkan_bindless_set.hpp"
+#include "vulkan_command_buffer.hpp"
+#include "vulkan_frame_scheduler.hpp"
+#include "vulkan_geometry_pool.hpp"
+#include "../scene/render_extraction.hpp"
+#include "../util/macros.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Per draw data, laid out like the std430 struct the vertex shader reads at gl_InstanceIndex.
+     */
+    struct indirect_draw_data {
+        glm::mat4 model;
+        uint32_t  material_id;
+        uint32_t  padding[3];
+    };
+    static_assert(sizeof(indirect_draw_data) == 80);
+
+    /**
+     * @brief Push constants of pipelines drawing through a bindless indirect renderer.
+     */
+    struct indirect_push_constants {
+        uint32_t draw_data_buffer; // index of the frame's draw data in the bindless buffer array
+    };
+
+    /**
+     * @brief Draws a render list whose meshes live in a geometry pool with one indirect draw per pipeline.
+     * Every batch becomes one VkDrawIndexedIndirectCommand whose instances are its draws,
+     * the first instance points at the batch's draw data, so shaders index the storage buffer with gl_InstanceIndex.
+     * Uses vkCmdDrawIndexedIndirectCountKHR if available, reading each bucket's draw count from a buffer
+     * a GPU pass may overwrite. Falls back to one indirect draw per command without multiDrawIndirect
+     * and to direct draws without drawIndirectFirstInstance.
+     * With a bindless set the draw data buffers are elements of its buffer array and found through push constants,
+     * so nothing is bound per draw.
+     */
+    class vulkan_indirect_renderer {
+    public:
+
+        /**
+         * @brief Commands of a render list that share a pipeline.
+         */
+        struct bucket {
+            uint32_t pipeline_id;
+            uint32_t first_command;
+            uint32_t command_count;
+        };
+
+        BBGE_NO_COPIES(vulkan_indirect_renderer);
+        BBGE_NO_MOVES(vulkan_indirect_renderer);
+
+        /**
+         * @brief Create the descriptor set layout and per frame buffers.
+         * @param device Device
+         * @param frames_in_flight Frames in flight of the frame scheduler
+         * @param max_draws Maximum number of draws per frame
+         * @param bindless Optional bindless set to register the draw data with instead of an own descriptor set, has to outlive the renderer
+         */
+        vulkan_indirect_renderer(const vulkan_device& device, uint32_t frames_in_flight, uint32_t max_draws,
+                                 vulkan_bindless_set* bindless = nullptr);
+
+        ~vulkan_indirect_renderer();
+
+        /**
+         * @brief Write the draw data and indirect commands of a frame.
+         * @param f Frame that draws the list
+         * @param list Render list, mesh ids refer to the geometry pool
+         * @param visible Indices of the list's draws to render in ascending order, at most max_draws
+         * @param geometry Pool holding the meshes
+         */
+        void prepare(const vulkan_frame_scheduler::frame& f, const render_list& list,
+                     gsl::span<const uint32_t> visible, const vulkan_geometry_pool& geometry);
+
+        /**
+         * @brief Get the buckets prepared for a frame in pipeline order.
+         * @param f Prepared frame
+         * @return Buckets
+         */
+        [[nodiscard]] gsl::span<const bucket> get_buckets(const vulkan_frame_scheduler::frame& f) const noexcept;
+
+        /**
+         * @brief Draw one bucket. The bucket's pipeline and the geometry pool have to be bound.
+         * @param cmd Command buffer inside a render pass
+         * @param f Prepared frame
+         * @param bucket_index Index into get_buckets()
+         * @param layout Layout of the bucket's pipeline, its set 0 has to be get_set_layout().
+         * With a bindless set it has to be bound already and the layout needs get_push_constant_range().
+         */
+        void draw(const vulkan_command_buffer& cmd, const vulkan_frame_scheduler::frame& f,
+                  uint32_t bucket_index, VkPipelineLayout layout) const noexcept;
+
+        /**
+         * @brief Get the descriptor set layout of the draw data, a storage buffer at binding 0 read by the vertex shader.
+         * With a bindless set it's the bindless set's layout. Pipelines drawing through this renderer use it as set 0.
+         * @return Descriptor set layout
+         */
+        [[nodiscard]] VkDescriptorSetLayout get_set_layout() const noexcept;
+
+        /**
+         * @brief Get the push constant range of indirect_push_constants that pipelines need with a bindless set.
+         * @return Push constant range
+         */
+        [[nodiscard]] static VkPushConstantRange get_push_constant_range() noexcept;
+
+        [[nodiscard]] uint32_t get_max_draws() const noexcept;
+
+    private:
+
+        static constexpr const uint32_t no_index = UINT32_MAX;
+
+        struct frame_slot {
+            vulkan_buffer   draw_data;                          // host visible indirect_draw_data array
+            vulkan_buffer   commands;                           // host visible VkDrawIndexedIndirectCommand array
+            vulkan_buffer   counts;                             // host visible command count per bucket
+            VkDescriptorSet descriptor_set  = VK_NULL_HANDLE;
+            uint32_t        draw_data_index = no_index;         // bindless buffer index of the draw data
+            std::vector<bucket> buckets;
+            std::vector<VkDrawIndexedIndirectCommand> direct_commands; // only used without drawIndirectFirstInstance
+        };
+
+        VkDevice m_device;
+        uint32_t m_max_draws;
+        bool m_first_instance;
+        bool m_multi_draw_indirect;
+        uint32_t m_max_draw_indirect_count;
+        PFN_vkCmdDrawIndexedIndirectCountKHR m_draw_indirect_count;
+        vulkan_bindless_set* m_bindless;
+        VkDescriptorSetLayout m_set_layout;
+        VkDescriptorPool m_descriptor_pool;
+        std::vector<frame_slot> m_slots;
+        std::vector<draw_batch> m_batches;
+
+        void create_descriptors(uint32_t frames_in_flight); // after the slots were created
+        [[nodiscard]] frame_slot create_slot(vulkan_allocator& allocator) const;
+        void write_descriptor_set(const frame_slot& slot) const noexcept;
+        void destroy() noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_INDIRECT_RENDERER_HPP
@@ -0,0 +1,77 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cassert>
+#include "vulkan_mesh.hpp"
+
+namespace bbge {
+
+    vulkan_mesh vulkan_mesh::create(vulkan_allocator& allocator, vulkan_upload_service& uploads,
+                                    const void* vertices, VkDeviceSize vertex_size, uint32_t vertex_count,
+                                    const void* indices, uint32_t index_count, index_type type) {
+
+        assert(vertex_count > 0);
+
+        vulkan_mesh mesh;
+        mesh.m_vertex_count = vertex_count;
+        mesh.m_index_count = index_count;
+        mesh.m_index_type = type;
+
+        VkDeviceSize vertex_bytes = vertex_size * vertex_count;
+        mesh.m_vertices = allocator.create_buffer(
+            vertex_bytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory_usage::gpu_only
+        );
+        uploads.upload_buffer(mesh.m_vertices, 0, vertices, vertex_bytes,
+                              VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+
+        if (index_count > 0) {
+            VkDeviceSize index_bytes = VkDeviceSize(index_count) * (type == index_type::uint16 ? 2 : 4);
+            mesh.m_indices = allocator.create_buffer(
+                index_bytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory_usage::gpu_only
+            );
+            uploads.upload_buffer(mesh.m_indices, 0, indices, index_bytes,
+                                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+        }
+
+        SPDLOG_TRACE("Created mesh with {} vertices and {} {} indices.", vertex_count, index_count, to_string(type));
+        return mesh;
+    }
+
+    const vulkan_buffer& vulkan_mesh::get_vertex_buffer() const noexcept {
+        return m_vertices;
+    }
+
+    const vulkan_buffer& vulkan_mesh::get_index_buffer() const noexcept {
+        return m_indices;
+    }
+
+    uint32_t vulkan_mesh::get_vertex_count() const noexcept {
+        return m_vertex_count;
+    }
+
+    uint32_t vulkan_mesh::get_index_count() const noexcept {
+        return m_index_count;
+    }
+
+    index_type vulkan_mesh::get_index_type() const noexcept {
+        return m_index_type;
+    }
+
+    bool vulkan_mesh::is_indexed() const noexcept {
+        return m_index_count > 0;
+    }
+}
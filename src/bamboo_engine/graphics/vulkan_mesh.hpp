@@ -0,0 +1,90 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_MESH_HPP
+#define BAMBOOENGINE_VULKAN_MESH_HPP
+
+#include <cstdint>
+#include <type_traits>
+#include <gsl/gsl-lite.hpp>
+#include <vulkan/vulkan.h>
+#include "vertex_layout.hpp"
+#include "vulkan_allocator.hpp"
+#include "vulkan_upload_service.hpp"
+#include "../util/macros.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Vertices and optional indices in device local buffers.
+     * The vertex buffer holds one binding, per-instance data is bound separately.
+     */
+    class vulkan_mesh {
+    public:
+
+        BBGE_NO_COPIES(vulkan_mesh);
+
+        vulkan_mesh() noexcept = default;
+        vulkan_mesh(vulkan_mesh&& other) noexcept = default;
+        vulkan_mesh& operator=(vulkan_mesh&& other) noexcept = default;
+        ~vulkan_mesh() = default;
+
+        /**
+         * @brief Create the buffers and queue the uploads. The mesh may be drawn once the uploads were flushed.
+         * @tparam Vertex Vertex type, as described to the pipeline's vertex_layout
+         * @tparam Index uint16_t or uint32_t
+         * @param allocator Allocator of the buffers
+         * @param uploads Upload service that copies the data
+         * @param vertices Vertex data
+         * @param indices Index data, empty for non-indexed meshes
+         * @return The mesh
+         */
+        template <typename Vertex, typename Index = uint32_t>
+        [[nodiscard]] static vulkan_mesh create(vulkan_allocator& allocator, vulkan_upload_service& uploads,
+                                                gsl::span<const Vertex> vertices, gsl::span<const Index> indices = { });
+
+        [[nodiscard]] const vulkan_buffer& get_vertex_buffer() const noexcept;
+        [[nodiscard]] const vulkan_buffer& get_index_buffer() const noexcept;
+        [[nodiscard]] uint32_t get_vertex_count() const noexcept;
+        [[nodiscard]] uint32_t get_index_count() const noexcept;
+        [[nodiscard]] index_type get_index_type() const noexcept;
+        [[nodiscard]] bool is_indexed() const noexcept;
+
+    private:
+
+        vulkan_buffer m_vertices;
+        vulkan_buffer m_indices;
+        uint32_t m_vertex_count = 0;
+        uint32_t m_index_count = 0;
+        index_type m_index_type = index_type::uint32;
+
+        [[nodiscard]] static vulkan_mesh create(vulkan_allocator& allocator, vulkan_upload_service& uploads,
+                                                const void* vertices, VkDeviceSize vertex_size, uint32_t vertex_count,
+                                                const void* indices, uint32_t index_count, index_type type);
+    };
+
+    template <typename Vertex, typename Index>
+    vulkan_mesh vulkan_mesh::create(vulkan_allocator& allocator, vulkan_upload_service& uploads,
+                                    gsl::span<const Vertex> vertices, gsl::span<const Index> indices) {
+        static_assert(std::is_trivially_copyable_v<Vertex>, "Vertices are copied to the GPU byte by byte");
+        return create(allocator, uploads,
+                      vertices.data(), sizeof(Vertex), static_cast<uint32_t>(vertices.size()),
+                      indices.data(), static_cast<uint32_t>(indices.size()), index_type_v<Index>);
+    }
+}
+
+#endif //BAMBOOENGINE_VULKAN_MESH_HPP
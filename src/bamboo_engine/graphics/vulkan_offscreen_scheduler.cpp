@@ -0,0 +1,255 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+#include "vulkan_offscreen_scheduler.hpp"
+#include "vulkan_utils.hpp"
+#include "../util/logging.hpp"
+
+namespace bbge {
+
+    vulkan_offscreen_scheduler::vulkan_offscreen_scheduler(const vulkan_device& device, VkExtent2D extent,
+                                                           VkFormat format, uint32_t frames_in_flight)
+      : m_device(device.get_handle()), m_allocator(device.get_allocator()),
+        m_graphics_family(device.get_queue_family_indices().graphics), m_graphics_queue(device.get_queues().graphics),
+        m_graphics_queue_mutex(device.get_queue_mutex(m_graphics_queue)),
+        m_extent(extent), m_format(format), m_current_slot(0), m_frame_number(0) {
+
+        if (frames_in_flight == 0) {
+            throw std::invalid_argument("At least one frame has to be in flight.");
+        }
+
+        m_slots.reserve(frames_in_flight);
+        try {
+            for (uint32_t i = 0; i < frames_in_flight; ++i) {
+                m_slots.push_back(create_slot());
+                m_images.push_back(m_slots.back().image.get_handle());
+
+                VkImageViewCreateInfo view_info { };
+                view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                view_info.image = m_images.back();
+                view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                view_info.format = m_format;
+                view_info.components = vulkan_utils::make_identity_component_mapping();
+                view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+                VkImageView view;
+                auto res = vkCreateImageView(m_device, &view_info, nullptr, &view);
+                if (res != VkResult::VK_SUCCESS) {
+                    throw vulkan_error("Failed to create offscreen image view", res);
+                }
+                m_image_views.push_back(view);
+            }
+        }
+        catch (...) {
+            destroy();
+            throw;
+        }
+
+        SPDLOG_TRACE("Created Vulkan offscreen scheduler with {} frames in flight at {}x{}.",
+                     frames_in_flight, extent.width, extent.height);
+    }
+
+    vulkan_offscreen_scheduler::~vulkan_offscreen_scheduler() {
+        wait_idle();
+        destroy();
+        SPDLOG_TRACE("Destroyed Vulkan offscreen scheduler.");
+    }
+
+    vulkan_offscreen_scheduler::frame vulkan_offscreen_scheduler::begin_frame() {
+
+        auto& slot = m_slots[m_current_slot];
+
+        // wait until the GPU is done with the last submission of this slot, nothing else uses its image
+        auto res = vkWaitForFences(m_device, 1, &slot.in_flight, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to wait for frame fence", res);
+        }
+        res = vkResetFences(m_device, 1, &slot.in_flight);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to reset frame fence", res);
+        }
+
+        res = vkResetCommandPool(m_device, slot.command_pool, 0);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to reset frame command pool", res);
+        }
+
+        VkCommandBufferBeginInfo begin_info { };
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        res = vkBeginCommandBuffer(slot.command_buffer, &begin_info);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to begin frame command buffer", res);
+        }
+
+        return frame {
+            m_current_slot,
+            m_current_slot,
+            m_frame_number,
+            slot.command_buffer,
+            VK_NULL_HANDLE
+        };
+    }
+
+    void vulkan_offscreen_scheduler::end_frame(const frame& f, const std::vector<wait_semaphore>& waits) {
+
+        assert(f.slot == m_current_slot);
+        auto& slot = m_slots[f.slot];
+
+        auto res = vkEndCommandBuffer(slot.command_buffer);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to end frame command buffer", res);
+        }
+
+        std::vector<VkSemaphore> wait_semaphores;
+        std::vector<VkPipelineStageFlags> wait_stages;
+        for (const auto& wait : waits) {
+            wait_semaphores.push_back(wait.semaphore);
+            wait_stages.push_back(wait.stages);
+        }
+
+        VkSubmitInfo submit_info { };
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.waitSemaphoreCount = wait_semaphores.size();
+        submit_info.pWaitSemaphores = wait_semaphores.data();
+        submit_info.pWaitDstStageMask = wait_stages.data();
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &slot.command_buffer;
+
+        {
+            std::lock_guard lock(m_graphics_queue_mutex);
+            res = vkQueueSubmit(m_graphics_queue, 1, &submit_info, slot.in_flight);
+        }
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to submit frame", res);
+        }
+
+        m_current_slot = (m_current_slot + 1) % m_slots.size();
+        ++m_frame_number;
+    }
+
+    void vulkan_offscreen_scheduler::wait_idle() const {
+
+        std::vector<VkFence> fences;
+        fences.reserve(m_slots.size());
+        for (const auto& slot : m_slots) {
+            fences.push_back(slot.in_flight);
+        }
+        if (fences.empty()) return;
+
+        auto res = vkWaitForFences(m_device, fences.size(), fences.data(), VK_TRUE, std::numeric_limits<uint64_t>::max());
+        if (res != VkResult::VK_SUCCESS) {
+            SPDLOG_ERROR("Failed to wait for frames in flight (err={}).", vulkan_utils::to_string(res));
+        }
+    }
+
+    uint32_t vulkan_offscreen_scheduler::get_frames_in_flight() const noexcept {
+        return m_slots.size();
+    }
+
+    VkExtent2D vulkan_offscreen_scheduler::get_extent() const noexcept {
+        return m_extent;
+    }
+
+    VkFormat vulkan_offscreen_scheduler::get_format() const noexcept {
+        return m_format;
+    }
+
+    const std::vector<VkImage>& vulkan_offscreen_scheduler::get_images() const noexcept {
+        return m_images;
+    }
+
+    const std::vector<VkImageView>& vulkan_offscreen_scheduler::get_image_views() const noexcept {
+        return m_image_views;
+    }
+
+    vulkan_offscreen_scheduler::frame_slot vulkan_offscreen_scheduler::create_slot() const {
+
+        frame_slot slot { };
+
+        try {
+            // the pool is reset as a whole every frame, individual buffers are never reset
+            VkCommandPoolCreateInfo pool_info { };
+            pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            pool_info.queueFamilyIndex = m_graphics_family;
+            auto res = vkCreateCommandPool(m_device, &pool_info, nullptr, &slot.command_pool);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to create frame command pool", res);
+            }
+
+            VkCommandBufferAllocateInfo alloc_info { };
+            alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            alloc_info.commandPool = slot.command_pool;
+            alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            alloc_info.commandBufferCount = 1;
+            res = vkAllocateCommandBuffers(m_device, &alloc_info, &slot.command_buffer);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to allocate frame command buffer", res);
+            }
+
+            // signaled, so the first wait on the slot returns immediately
+            VkFenceCreateInfo fence_info { };
+            fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+            res = vkCreateFence(m_device, &fence_info, nullptr, &slot.in_flight);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to create frame fence", res);
+            }
+
+            // transfer source, so results can be read back or compared
+            VkImageCreateInfo image_info { };
+            image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            image_info.imageType = VK_IMAGE_TYPE_2D;
+            image_info.format = m_format;
+            image_info.extent = { m_extent.width, m_extent.height, 1 };
+            image_info.mipLevels = 1;
+            image_info.arrayLayers = 1;
+            image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+            image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            slot.image = m_allocator.create_image(image_info, memory_usage::gpu_only);
+        }
+        catch (...) {
+            destroy_slot(slot);
+            throw;
+        }
+
+        return slot;
+    }
+
+    void vulkan_offscreen_scheduler::destroy_slot(frame_slot& slot) const noexcept {
+        if (slot.in_flight) vkDestroyFence(m_device, slot.in_flight, nullptr);
+        if (slot.command_pool) vkDestroyCommandPool(m_device, slot.command_pool, nullptr); // frees the command buffer
+        slot = frame_slot { };
+    }
+
+    void vulkan_offscreen_scheduler::destroy() noexcept {
+        for (auto view : m_image_views) {
+            vkDestroyImageView(m_device, view, nullptr);
+        }
+        m_image_views.clear();
+        m_images.clear();
+        for (auto& slot : m_slots) {
+            destroy_slot(slot);
+        }
+        m_slots.clear();
+    }
+}
@@ -0,0 +1,119 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#ifndef BAMBOOENGINE_VULKAN_OFFSCREEN_SCHEDULER_HPP
+#define BAMBOOENGINE_VULKAN_OFFSCREEN_SCHEDULER_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "vulkan_allocator.hpp"
+#include "vulkan_frame_scheduler.hpp"
+#include "../util/macros.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Drives a frame loop without a window, e.g. on CI machines or for benchmarks.
+     * Every frame slot renders to its own color image instead of a swap chain image, so frames only wait for
+     * their slot's fence. Frames are the same as vulkan_frame_scheduler's, the image index is the slot.
+     */
+    class vulkan_offscreen_scheduler {
+    public:
+
+        using frame = vulkan_frame_scheduler::frame;
+        using wait_semaphore = vulkan_frame_scheduler::wait_semaphore;
+
+        static constexpr const VkFormat default_format = VK_FORMAT_R8G8B8A8_UNORM;
+
+        BBGE_NO_COPIES(vulkan_offscreen_scheduler);
+        BBGE_NO_MOVES(vulkan_offscreen_scheduler);
+
+        /**
+         * @brief Create the per frame resources and images.
+         * @param device Device to submit to, uses its graphics queue
+         * @param extent Size of the images
+         * @param format Format of the images, they can be color attachments and transfer sources
+         * @param frames_in_flight Number of frames the CPU may run ahead of the GPU
+         */
+        vulkan_offscreen_scheduler(const vulkan_device& device, VkExtent2D extent, VkFormat format = default_format,
+                                   uint32_t frames_in_flight = vulkan_frame_scheduler::default_frames_in_flight);
+
+        /**
+         * @brief Waits for all frames in flight and destroys the per frame resources.
+         */
+        ~vulkan_offscreen_scheduler();
+
+        /**
+         * @brief Wait for the next frame slot to become available.
+         * @return The frame to record
+         */
+        [[nodiscard]] frame begin_frame();
+
+        /**
+         * @brief Finish recording and submit the frame.
+         * @param f Frame returned by begin_frame()
+         * @param waits Additional semaphores the submission waits on
+         */
+        void end_frame(const frame& f, const std::vector<wait_semaphore>& waits = { });
+
+        /**
+         * @brief Block until the GPU has finished all submitted frames.
+         */
+        void wait_idle() const;
+
+        [[nodiscard]] uint32_t get_frames_in_flight() const noexcept;
+        [[nodiscard]] VkExtent2D get_extent() const noexcept;
+        [[nodiscard]] VkFormat get_format() const noexcept;
+
+        /**
+         * @brief Get the images frames render to, indexed by frame::image_index.
+         * @return Images
+         */
+        [[nodiscard]] const std::vector<VkImage>& get_images() const noexcept;
+        [[nodiscard]] const std::vector<VkImageView>& get_image_views() const noexcept;
+
+    private:
+
+        struct frame_slot {
+            VkCommandPool   command_pool    = VK_NULL_HANDLE;
+            VkCommandBuffer command_buffer  = VK_NULL_HANDLE;
+            VkFence         in_flight       = VK_NULL_HANDLE; // signaled when the GPU finished the slot's last submission
+            vulkan_image    image;
+        };
+
+        VkDevice m_device;
+        vulkan_allocator& m_allocator;
+        uint32_t m_graphics_family;
+        VkQueue m_graphics_queue;
+        std::mutex& m_graphics_queue_mutex;
+        VkExtent2D m_extent;
+        VkFormat m_format;
+        std::vector<frame_slot> m_slots;
+        std::vector<VkImage> m_images;
+        std::vector<VkImageView> m_image_views;
+        uint32_t m_current_slot;
+        uint64_t m_frame_number;
+
+        [[nodiscard]] frame_slot create_slot() const;
+        void destroy_slot(frame_slot& slot) const noexcept;
+        void destroy() noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_OFFSCREEN_SCHEDULER_HPP
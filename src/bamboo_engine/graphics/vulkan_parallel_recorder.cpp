@@ -0,0 +1,187 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cassert>
+#include <exception>
+#include "vulkan_parallel_recorder.hpp"
+
+namespace bbge {
+
+    vulkan_parallel_recorder::vulkan_parallel_recorder(const vulkan_device& device, job_system& jobs, uint32_t frames_in_flight)
+      : m_device(device.get_handle()), m_graphics_family(device.get_queue_family_indices().graphics), m_jobs(jobs) {
+
+        // one slice per worker plus one for the calling thread
+        auto slice_count = jobs.get_thread_count() + 1;
+
+        try {
+            m_slots.resize(frames_in_flight);
+            for (auto& slot : m_slots) {
+                slot.slices.reserve(slice_count);
+                for (std::size_t i = 0; i < slice_count; ++i) {
+                    slot.slices.push_back(create_slice());
+                }
+            }
+        }
+        catch (...) {
+            for (auto& slot : m_slots) {
+                for (auto& slice : slot.slices) destroy_slice(slice);
+            }
+            throw;
+        }
+
+        SPDLOG_TRACE("Created parallel recorder with {} slices per frame.", slice_count);
+    }
+
+    vulkan_parallel_recorder::~vulkan_parallel_recorder() {
+        for (auto& slot : m_slots) {
+            for (auto& slice : slot.slices) destroy_slice(slice);
+        }
+        SPDLOG_TRACE("Destroyed parallel recorder.");
+    }
+
+    void vulkan_parallel_recorder::record(const vulkan_frame_scheduler::frame& f, VkRenderPass render_pass,
+                                          std::size_t item_count, const slice_function& record, std::size_t min_slice_size) {
+
+        assert(f.slot < m_slots.size());
+        auto& slot = m_slots[f.slot];
+
+        // the frame scheduler waited for the slot's fence, so nothing recorded last time is still executing
+        if (slot.frame_number != f.number) {
+            for (auto& slice : slot.slices) {
+                auto res = vkResetCommandPool(m_device, slice.command_pool, 0);
+                if (res != VkResult::VK_SUCCESS) {
+                    throw vulkan_error("Failed to reset slice command pool", res);
+                }
+                slice.used = 0;
+            }
+            slot.frame_number = f.number;
+        }
+
+        if (item_count == 0) return;
+
+        min_slice_size = std::max<std::size_t>(min_slice_size, 1);
+        auto slice_count = std::min(slot.slices.size(), (item_count + min_slice_size - 1) / min_slice_size);
+        auto slice_size = (item_count + slice_count - 1) / slice_count;
+        slice_count = (item_count + slice_size - 1) / slice_size;
+
+        // allocated up front, pools must not be used from two threads at once
+        std::vector<VkCommandBuffer> command_buffers(slice_count);
+        for (std::size_t i = 0; i < slice_count; ++i) {
+            command_buffers[i] = acquire_command_buffer(slot.slices[i]);
+        }
+
+        VkCommandBufferInheritanceInfo inheritance { };
+        inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.renderPass = render_pass;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = f.framebuffer;
+
+        job_counter pending;
+        for (std::size_t i = 1; i < slice_count; ++i) {
+            auto first = i * slice_size;
+            auto last = std::min(first + slice_size, item_count);
+            m_jobs.run(pending, [this, cmd = command_buffers[i], &inheritance, first, last, &record]() {
+                record_slice(cmd, inheritance, first, last, record);
+            });
+        }
+
+        // the tasks reference locals, so every one of them has to finish before anything is rethrown
+        std::exception_ptr error;
+        try {
+            record_slice(command_buffers[0], inheritance, 0, std::min(slice_size, item_count), record);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        try {
+            m_jobs.wait(pending);
+        }
+        catch (...) {
+            if (!error) error = std::current_exception();
+        }
+        if (error) std::rethrow_exception(error);
+
+        vkCmdExecuteCommands(f.command_buffer, static_cast<uint32_t>(command_buffers.size()), command_buffers.data());
+    }
+
+    std::size_t vulkan_parallel_recorder::get_max_slices() const noexcept {
+        return m_slots.empty() ? 0 : m_slots.front().slices.size();
+    }
+
+    VkCommandBuffer vulkan_parallel_recorder::acquire_command_buffer(slice_context& slice) {
+
+        if (slice.used == slice.command_buffers.size()) {
+            VkCommandBufferAllocateInfo alloc_info { };
+            alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            alloc_info.commandPool = slice.command_pool;
+            alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            alloc_info.commandBufferCount = 1;
+
+            VkCommandBuffer cmd = VK_NULL_HANDLE;
+            auto res = vkAllocateCommandBuffers(m_device, &alloc_info, &cmd);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to allocate secondary command buffer", res);
+            }
+            slice.command_buffers.push_back(cmd);
+        }
+
+        return slice.command_buffers[slice.used++];
+    }
+
+    void vulkan_parallel_recorder::record_slice(VkCommandBuffer cmd, const VkCommandBufferInheritanceInfo& inheritance,
+                                                std::size_t first, std::size_t last, const slice_function& record) const {
+
+        VkCommandBufferBeginInfo begin_info { };
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        begin_info.pInheritanceInfo = &inheritance;
+        auto res = vkBeginCommandBuffer(cmd, &begin_info);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to begin secondary command buffer", res);
+        }
+
+        record(vulkan_command_buffer(cmd), first, last);
+
+        res = vkEndCommandBuffer(cmd);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to end secondary command buffer", res);
+        }
+    }
+
+    vulkan_parallel_recorder::slice_context vulkan_parallel_recorder::create_slice() const {
+
+        slice_context slice { };
+
+        // reset as a whole once per frame
+        VkCommandPoolCreateInfo pool_info { };
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex = m_graphics_family;
+        auto res = vkCreateCommandPool(m_device, &pool_info, nullptr, &slice.command_pool);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to create slice command pool", res);
+        }
+
+        return slice;
+    }
+
+    void vulkan_parallel_recorder::destroy_slice(slice_context& slice) const noexcept {
+        if (slice.command_pool) vkDestroyCommandPool(m_device, slice.command_pool, nullptr); // frees the command buffers
+        slice = slice_context { };
+    }
+}
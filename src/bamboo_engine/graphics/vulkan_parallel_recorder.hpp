@@ -0,0 +1,108 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_PARALLEL_RECORDER_HPP
+#define BAMBOOENGINE_VULKAN_PARALLEL_RECORDER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "vulkan_command_buffer.hpp"
+#include "vulkan_frame_scheduler.hpp"
+#include "../util/macros.hpp"
+#include "../util/job_system.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Records secondary command buffers for slices of a range of items on the job system.
+     * Every slice has its own command pool per frame in flight, so no two threads ever share a pool.
+     * The pools of a frame slot are reset the first time the slot records in a new frame.
+     */
+    class vulkan_parallel_recorder {
+    public:
+
+        /**
+         * @brief Records the items [first, last) into a secondary command buffer.
+         * Called concurrently for different slices. Dynamic state is not inherited and has to be set by every slice.
+         */
+        using slice_function = std::function<void(const vulkan_command_buffer& cmd, std::size_t first, std::size_t last)>;
+
+        static constexpr const std::size_t default_min_slice_size = 64;
+
+        BBGE_NO_COPIES(vulkan_parallel_recorder);
+        BBGE_NO_MOVES(vulkan_parallel_recorder);
+
+        /**
+         * @brief Create the command pools.
+         * @param device Device, the pools belong to its graphics queue family
+         * @param jobs Job system to record on, the calling thread records a slice as well
+         * @param frames_in_flight Frames in flight of the frame scheduler
+         */
+        vulkan_parallel_recorder(const vulkan_device& device, job_system& jobs, uint32_t frames_in_flight);
+
+        ~vulkan_parallel_recorder();
+
+        /**
+         * @brief Record items in parallel and execute them in the frame's primary command buffer.
+         * The primary command buffer has to be inside subpass 0 of the render pass,
+         * begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. Blocks until all slices are recorded.
+         * @param f Current frame
+         * @param render_pass Render pass the secondary command buffers continue
+         * @param item_count Number of items
+         * @param record Records a slice, exceptions are rethrown after all slices finished
+         * @param min_slice_size Minimum number of items per slice, so tiny slices don't cost more than they save
+         */
+        void record(const vulkan_frame_scheduler::frame& f, VkRenderPass render_pass, std::size_t item_count,
+                    const slice_function& record, std::size_t min_slice_size = default_min_slice_size);
+
+        /**
+         * @brief Get the maximum number of slices a range is split into.
+         * @return Number of slice command pools per frame in flight
+         */
+        [[nodiscard]] std::size_t get_max_slices() const noexcept;
+
+    private:
+
+        struct slice_context {
+            VkCommandPool command_pool = VK_NULL_HANDLE;
+            std::vector<VkCommandBuffer> command_buffers; // grows if a frame records more than once
+            std::size_t used = 0;
+        };
+
+        struct frame_slot {
+            std::vector<slice_context> slices;
+            uint64_t frame_number = UINT64_MAX; // frame the pools were last reset for
+        };
+
+        VkDevice m_device;
+        uint32_t m_graphics_family;
+        job_system& m_jobs;
+        std::vector<frame_slot> m_slots;
+
+        [[nodiscard]] VkCommandBuffer acquire_command_buffer(slice_context& slice);
+        void record_slice(VkCommandBuffer cmd, const VkCommandBufferInheritanceInfo& inheritance,
+                          std::size_t first, std::size_t last, const slice_function& record) const;
+        [[nodiscard]] slice_context create_slice() const;
+        void destroy_slice(slice_context& slice) const noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_PARALLEL_RECORDER_HPP
@@ -17,21 +17,12 @@
 // Created by Leon Suchy on 12.08.20.
 //
 
-#include <fstream>
 #include "vulkan_pipeline.hpp"
+#include "vulkan_render_targets.hpp"
 #include "../util/custom_formatters.hpp"
 
 namespace bbge {
 
-    constexpr std::array<std::string_view, 4> shader_type_names {
-        "fragment", "vertex", "geometry", "compute"
-    };
-
-    std::string_view to_string(shader_type t) {
-        auto v = static_cast<uint8_t>(t);
-        return shader_type_names[v];
-    }
-
     constexpr std::array<std::string_view, 3> rasterizer_mode_names {
         "fill", "line", "point"
     };
@@ -59,13 +50,72 @@ namespace bbge {
         return rasterizer_front_face_names[v];
     }
 
-    constexpr std::array<VkShaderStageFlagBits, 4> shader_type_vk_conversion {
-        VK_SHADER_STAGE_FRAGMENT_BIT, VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_GEOMETRY_BIT, VK_SHADER_STAGE_COMPUTE_BIT
+    constexpr std::array<std::string_view, 4> pipeline_dynamic_state_names {
+        "viewport", "scissor", "line width", "depth bias"
+    };
+
+    std::string_view to_string(pipeline_dynamic_state s) {
+        auto v = static_cast<uint8_t>(s);
+        return pipeline_dynamic_state_names[v];
+    }
+
+    constexpr std::array<std::string_view, 4> msaa_samples_names {
+        "1x", "2x", "4x", "8x"
+    };
+
+    std::string_view to_string(msaa_samples s) {
+        auto v = static_cast<uint8_t>(s);
+        return msaa_samples_names[v];
+    }
+
+    constexpr std::array<std::string_view, 8> depth_compare_names {
+        "never", "less", "equal", "less or equal", "greater", "not equal", "greater or equal", "always"
+    };
+
+    std::string_view to_string(depth_compare c) {
+        auto v = static_cast<uint8_t>(c);
+        return depth_compare_names[v];
+    }
+
+    constexpr std::array<VkSampleCountFlagBits, 4> sample_count_vk_conversion {
+        VK_SAMPLE_COUNT_1_BIT,
+        VK_SAMPLE_COUNT_2_BIT,
+        VK_SAMPLE_COUNT_4_BIT,
+        VK_SAMPLE_COUNT_8_BIT
+    };
+
+    VkSampleCountFlagBits to_vulkan(msaa_samples s) {
+        auto v = static_cast<uint8_t>(s);
+        return sample_count_vk_conversion[v];
+    }
+
+    // in the same order as VkCompareOp
+    constexpr std::array<VkCompareOp, 8> compare_op_vk_conversion {
+        VK_COMPARE_OP_NEVER,
+        VK_COMPARE_OP_LESS,
+        VK_COMPARE_OP_EQUAL,
+        VK_COMPARE_OP_LESS_OR_EQUAL,
+        VK_COMPARE_OP_GREATER,
+        VK_COMPARE_OP_NOT_EQUAL,
+        VK_COMPARE_OP_GREATER_OR_EQUAL,
+        VK_COMPARE_OP_ALWAYS
+    };
+
+    VkCompareOp to_vulkan(depth_compare c) {
+        auto v = static_cast<uint8_t>(c);
+        return compare_op_vk_conversion[v];
+    }
+
+    constexpr std::array<VkDynamicState, 4> dynamic_state_vk_conversion {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+        VK_DYNAMIC_STATE_LINE_WIDTH,
+        VK_DYNAMIC_STATE_DEPTH_BIAS
     };
 
-    VkShaderStageFlagBits to_vulkan(shader_type t) {
-        auto v = static_cast<uint8_t>(t);
-        return shader_type_vk_conversion[v];
+    VkDynamicState to_vulkan(pipeline_dynamic_state s) {
+        auto v = static_cast<uint8_t>(s);
+        return dynamic_state_vk_conversion[v];
     }
 
     constexpr std::array<VkPolygonMode, 3> polygon_mode_vk_conversion {
@@ -101,72 +151,41 @@ namespace bbge {
         return front_face_vk_conversion[v];
     }
 
-    result<std::vector<std::byte>, std::runtime_error> vulkan_pipeline::load_binary_file(const std::filesystem::path& p) {
-
-        if (!std::filesystem::exists(p)) {
-            return std::runtime_error(fmt::format("File '{}' doesn't exist.", p.string()));
-        }
-
-        std::fstream is(p, std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
-        if (!is) {
-            return std::runtime_error(fmt::format("Failed to read file '{}': {}.", p, std::strerror(errno)));
-        }
-        auto length = is.tellg();
-        is.seekg(std::ios_base::beg);
-        std::vector<std::byte> result(length);
-        is.read(reinterpret_cast<char*>(result.data()), length);
-        result.resize(is.gcount()); // if only part of the file was read we truncate the buffer
-        return result;
-    }
-
-    result<VkShaderModule, vulkan_error>
-    vulkan_pipeline::create_shader_module(VkDevice dev, const std::vector<std::byte>& spir_v_bytecode, shader_type type) const {
-
-        assert(dev);
-
-        VkShaderModuleCreateInfo create_info { };
-        create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        create_info.codeSize = spir_v_bytecode.size(); // in bytes
-        create_info.pCode = reinterpret_cast<const uint32_t*>(spir_v_bytecode.data());
-
-        VkShaderModule module = VK_NULL_HANDLE;
-        auto res = vkCreateShaderModule(dev, &create_info, nullptr, &module);
-        if (res != VkResult::VK_SUCCESS) {
-            return vulkan_error(fmt::format("Failed to create shader module of type '{}' for rendering pipeline '{}'", type, m_name), res);
-        }
-
-        return module;
-    }
-
     vulkan_pipeline::vulkan_pipeline(
         std::string&& name, const vulkan_pipeline::shader_module_paths& module_paths,
         const rendering_pipeline_settings& settings,
-        VkDevice dev, const vulkan_swap_chain& swap_chain)
-      : m_name(std::move(name)), m_device(dev), m_swap_chain(swap_chain),
-        m_layout(VK_NULL_HANDLE), m_render_pass(VK_NULL_HANDLE) {
+        const vulkan_device& dev, VkFormat color_format)
+      : vulkan_pipeline(std::move(name), load_shader_code_or_throw(module_paths), settings, dev, color_format) { }
+
+    vulkan_pipeline::vulkan_pipeline(
+        std::string&& name, const vulkan_pipeline::shader_code& code,
+        const rendering_pipeline_settings& settings,
+        const vulkan_device& dev, VkFormat color_format)
+      : m_name(std::move(name)), m_dynamic_states(settings.dynamic_states), m_device(dev.get_handle()), m_cache(dev.get_pipeline_cache()), m_color_format(color_format),
+        m_samples(vulkan_render_targets::pick_sample_count(dev.get_physical_device(), to_vulkan(settings.samples), settings.depth.has_value())),
+        m_depth_format(settings.depth ? vulkan_render_targets::pick_depth_format(dev.get_physical_device()) : VK_FORMAT_UNDEFINED),
+        m_sample_shading(settings.sample_shading && dev.get_enabled_features().sampleRateShading),
+        m_layout(VK_NULL_HANDLE), m_render_pass(settings.render_pass), m_owns_render_pass(!settings.render_pass),
+        m_subpass(settings.subpass) {
+
+        if (m_samples != to_vulkan(settings.samples)) {
+            SPDLOG_WARN("Pipeline {} requested {} MSAA, using {} samples.", m_name, to_string(settings.samples), static_cast<uint32_t>(m_samples));
+        }
 
         // pipeline layout, for uniform variables
-        m_layout = create_pipeline_layout().or_throw();
+        m_layout = create_pipeline_layout(settings).or_throw();
 
         // render passes
-        m_render_pass = create_simple_render_pass().or_throw();
+        if (m_owns_render_pass) {
+            m_render_pass = create_simple_render_pass().or_throw();
+        }
 
         // pipeline
-        m_pipeline = create_pipeline(module_paths, settings).or_throw();
+        m_pipeline = create_pipeline(code, settings).or_throw();
 
         SPDLOG_TRACE("Created vulkan pipeline.");
     }
 
-    VkPipelineShaderStageCreateInfo
-    vulkan_pipeline::make_shader_stage_create_info(VkShaderModule module, shader_type type) const {
-        VkPipelineShaderStageCreateInfo create_info { };
-        create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        create_info.stage = to_vulkan(type);
-        create_info.module = module;
-        create_info.pName = "main"; // entrypoint
-        return create_info;
-    }
-
     vulkan_pipeline::~vulkan_pipeline() {
         if (m_pipeline) {
             vkDestroyPipeline(m_device, m_pipeline, nullptr);
@@ -174,37 +193,159 @@ namespace bbge {
         if (m_layout) {
             vkDestroyPipelineLayout(m_device, m_layout, nullptr);
         }
-        if (m_render_pass) {
+        if (m_render_pass && m_owns_render_pass) {
             vkDestroyRenderPass(m_device, m_render_pass, nullptr);
         }
         SPDLOG_TRACE("Destroyed vulkan pipeline.");
     }
 
+    VkPipeline vulkan_pipeline::get_handle() const noexcept {
+        return m_pipeline;
+    }
+
+    VkRenderPass vulkan_pipeline::get_render_pass() const noexcept {
+        return m_render_pass;
+    }
+
+    VkPipelineLayout vulkan_pipeline::get_layout() const noexcept {
+        return m_layout;
+    }
+
+    bool vulkan_pipeline::is_dynamic(pipeline_dynamic_state s) const noexcept {
+        return m_dynamic_states.count(s) > 0;
+    }
+
+    VkSampleCountFlagBits vulkan_pipeline::get_samples() const noexcept {
+        return m_samples;
+    }
+
+    VkFormat vulkan_pipeline::get_depth_format() const noexcept {
+        return m_depth_format;
+    }
+
+    result<vulkan_pipeline::shader_code, std::runtime_error>
+    vulkan_pipeline::load_shader_code(const shader_module_paths& module_paths) {
+
+        auto vertex = mapped_file::open(module_paths.vertex_shader);
+        if (!vertex) return *vertex.err();
+        auto fragment = mapped_file::open(module_paths.fragment_shader);
+        if (!fragment) return *fragment.err();
+
+        shader_code code { vertex.ok()->get_contents(), fragment.ok()->get_contents(), { } };
+        code.files.push_back(std::move(*vertex.ok()));
+        code.files.push_back(std::move(*fragment.ok()));
+        return code;
+    }
+
+    result<vulkan_pipeline::shader_code, std::runtime_error>
+    vulkan_pipeline::load_shader_code(const asset_archive& archive, const shader_module_paths& module_names) {
+
+        auto vertex = archive.get_contents(module_names.vertex_shader.generic_string());
+        if (!vertex) return *vertex.err();
+        auto fragment = archive.get_contents(module_names.fragment_shader.generic_string());
+        if (!fragment) return *fragment.err();
+
+        return shader_code { *vertex.ok(), *fragment.ok(), { } };
+    }
+
+    vulkan_pipeline::shader_code vulkan_pipeline::load_shader_code_or_throw(const shader_module_paths& module_paths) {
+        auto code = load_shader_code(module_paths);
+        if (!code) {
+            throw vulkan_error(
+                fmt::format("Failed to load shader module code: {}", code.err()->what()),
+                VK_ERROR_UNKNOWN
+            );
+        }
+        return std::move(*code.ok());
+    }
+
     result<VkRenderPass, vulkan_error> vulkan_pipeline::create_simple_render_pass() const {
 
+        // multisampled color and depth are only needed within the pass, so they are never stored
+        bool multisampled = m_samples != VK_SAMPLE_COUNT_1_BIT;
+        bool depth = m_depth_format != VK_FORMAT_UNDEFINED;
+
+        // attachments in order: color, depth, resolve
+        std::vector<VkAttachmentDescription> attachments;
+
         VkAttachmentDescription color_attachment { };
-        color_attachment.format = m_swap_chain.get_format();
-        color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        color_attachment.format = m_color_format;
+        color_attachment.samples = m_samples;
         color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        color_attachment.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+        color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        color_attachment.finalLayout = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        attachments.push_back(color_attachment);
 
         VkAttachmentReference color_attachment_ref { };
         color_attachment_ref.attachment = 0;
         color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+        VkAttachmentReference depth_attachment_ref { };
+        if (depth) {
+            VkAttachmentDescription depth_attachment { };
+            depth_attachment.format = m_depth_format;
+            depth_attachment.samples = m_samples;
+            depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            depth_attachment_ref.attachment = static_cast<uint32_t>(attachments.size());
+            depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            attachments.push_back(depth_attachment);
+        }
+
+        VkAttachmentReference resolve_attachment_ref { };
+        if (multisampled) {
+            VkAttachmentDescription resolve_attachment { };
+            resolve_attachment.format = m_color_format;
+            resolve_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+            resolve_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; // fully overwritten by the resolve
+            resolve_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            resolve_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            resolve_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            resolve_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            resolve_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            resolve_attachment_ref.attachment = static_cast<uint32_t>(attachments.size());
+            resolve_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            attachments.push_back(resolve_attachment);
+        }
+
         VkSubpassDescription single_subpass { };
         single_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
         single_subpass.colorAttachmentCount = 1;
         single_subpass.pColorAttachments = &color_attachment_ref;
+        single_subpass.pDepthStencilAttachment = depth ? &depth_attachment_ref : nullptr;
+        single_subpass.pResolveAttachments = multisampled ? &resolve_attachment_ref : nullptr;
+
+        // the layout transition has to wait until the presentation engine released the image
+        // the multisampled and depth images are shared by all frames, so their writes also have to wait for the previous frame
+        VkSubpassDependency acquire_dependency { };
+        acquire_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        acquire_dependency.dstSubpass = 0;
+        acquire_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        acquire_dependency.srcAccessMask = multisampled ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0;
+        acquire_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        acquire_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        if (depth) {
+            acquire_dependency.srcStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            acquire_dependency.srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            acquire_dependency.dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            acquire_dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        }
 
         VkRenderPassCreateInfo render_pass_create_info { };
         render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        render_pass_create_info.attachmentCount = 1;
-        render_pass_create_info.pAttachments = &color_attachment;
+        render_pass_create_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+        render_pass_create_info.pAttachments = attachments.data();
         render_pass_create_info.subpassCount = 1;
         render_pass_create_info.pSubpasses = &single_subpass;
+        render_pass_create_info.dependencyCount = 1;
+        render_pass_create_info.pDependencies = &acquire_dependency;
 
         VkRenderPass pass;
         auto res = vkCreateRenderPass(m_device, &render_pass_create_info, nullptr, &pass);
@@ -215,12 +356,16 @@ namespace bbge {
         return pass;
     }
 
-    result<VkPipelineLayout, vulkan_error> vulkan_pipeline::create_pipeline_layout() const {
+    result<VkPipelineLayout, vulkan_error> vulkan_pipeline::create_pipeline_layout(const rendering_pipeline_settings& settings) const {
 
         assert(m_device);
 
         VkPipelineLayoutCreateInfo pipeline_layout_create_info { };
         pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipeline_layout_create_info.setLayoutCount = static_cast<uint32_t>(settings.descriptor_set_layouts.size());
+        pipeline_layout_create_info.pSetLayouts = settings.descriptor_set_layouts.data();
+        pipeline_layout_create_info.pushConstantRangeCount = static_cast<uint32_t>(settings.push_constant_ranges.size());
+        pipeline_layout_create_info.pPushConstantRanges = settings.push_constant_ranges.data();
 
         VkPipelineLayout layout;
         auto res = vkCreatePipelineLayout(m_device, &pipeline_layout_create_info, nullptr, &layout);
@@ -233,7 +378,7 @@ namespace bbge {
 
     result<VkPipeline, vulkan_error>
     vulkan_pipeline::create_pipeline(
-        const shader_module_paths& module_paths,
+        const shader_code& code,
         const rendering_pipeline_settings& settings
     ) const {
 
@@ -242,47 +387,22 @@ namespace bbge {
         assert(m_layout);
         assert(m_render_pass);
 
-        // shader modules
-        auto frag_code = load_binary_file(module_paths.fragment_shader);
-        auto vert_code = load_binary_file(module_paths.vertex_shader);
-
-        if (!frag_code) {
-            return vulkan_error(
-                fmt::format("Failed to load shader module code: {}", frag_code.err()->what()),
-                VK_ERROR_UNKNOWN
-            );
-        }
-        if (!vert_code) {
-            return vulkan_error(
-                fmt::format("Failed to load shader module code: {}", vert_code.err()->what()),
-                VK_ERROR_UNKNOWN
-            );
-        }
-
-        // RAII wrapper to ensure cleanup
-        struct module_wrapper {
-            VkDevice device;
-            VkShaderModule module;
-            ~module_wrapper() {
-                vkDestroyShaderModule(device, module, nullptr);
-            }
-        };
-
-        auto frag_module = module_wrapper { m_device, create_shader_module(m_device, *frag_code.ok(), shader_type::fragment).or_throw() };
-        auto vert_module = module_wrapper { m_device, create_shader_module(m_device, *vert_code.ok(), shader_type::vertex).or_throw() };
+        // shader modules, only needed until the pipeline exists
+        vulkan_shader_module vert_module(m_device, code.vertex_shader, shader_type::vertex, m_name);
+        vulkan_shader_module frag_module(m_device, code.fragment_shader, shader_type::fragment, m_name);
 
         std::array shader_stage_creation_infos = {
-            make_shader_stage_create_info(vert_module.module, shader_type::vertex),
-            make_shader_stage_create_info(frag_module.module, shader_type::fragment)
+            vert_module.get_stage_create_info(),
+            frag_module.get_stage_create_info()
         };
 
-        // Empty for now. Will have buffer layout descriptors
+        // Bindings and attributes of the input layout, none if the vertex shader generates its vertices
         VkPipelineVertexInputStateCreateInfo vertex_input_info { };
         vertex_input_info.sType                             = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertex_input_info.vertexBindingDescriptionCount     = 0;
-        vertex_input_info.pVertexBindingDescriptions        = nullptr; // Optional
-        vertex_input_info.vertexAttributeDescriptionCount   = 0;
-        vertex_input_info.pVertexAttributeDescriptions      = nullptr; // Optional
+        vertex_input_info.vertexBindingDescriptionCount     = static_cast<uint32_t>(settings.input_layout.get_bindings().size());
+        vertex_input_info.pVertexBindingDescriptions        = settings.input_layout.get_bindings().data();
+        vertex_input_info.vertexAttributeDescriptionCount   = static_cast<uint32_t>(settings.input_layout.get_attributes().size());
+        vertex_input_info.pVertexAttributeDescriptions      = settings.input_layout.get_attributes().data();
 
         // Triangle list
         VkPipelineInputAssemblyStateCreateInfo input_assembly { };
@@ -290,7 +410,7 @@ namespace bbge {
         input_assembly.topology                 = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         input_assembly.primitiveRestartEnable   = VK_FALSE;
 
-        // Viewport & scissor
+        // Viewport & scissor, only used if they're not dynamic
         VkViewport viewport = to_vulkan_viewport(settings.viewport);
         VkRect2D scissor = {
             { static_cast<int32_t>(viewport.x), static_cast<int32_t>(viewport.y) },
@@ -313,19 +433,19 @@ namespace bbge {
         rasterizer_create_info.lineWidth        = settings.render_width;
         rasterizer_create_info.cullMode         = to_vulkan(settings.cull_mode);
         rasterizer_create_info.frontFace        = to_vulkan(settings.front_face);
-        rasterizer_create_info.depthBiasEnable  = settings.depth_bias.has_value();
+        rasterizer_create_info.depthBiasEnable  = settings.depth_bias.has_value() || is_dynamic(pipeline_dynamic_state::depth_bias);
         if (settings.depth_bias) {
             rasterizer_create_info.depthBiasConstantFactor  = settings.depth_bias->const_factor;
             rasterizer_create_info.depthBiasClamp           = settings.depth_bias->clamp;
             rasterizer_create_info.depthBiasSlopeFactor     = settings.depth_bias->slope_factor;
         }
 
-        // multisampling, empty for now
+        // multisampling, has to match the render pass
         VkPipelineMultisampleStateCreateInfo multisampling { };
         multisampling.sType                 = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampling.sampleShadingEnable   = VK_FALSE;
-        multisampling.rasterizationSamples  = VK_SAMPLE_COUNT_1_BIT;
-        multisampling.minSampleShading      = 1.0f;
+        multisampling.sampleShadingEnable   = m_sample_shading;
+        multisampling.rasterizationSamples  = m_samples;
+        multisampling.minSampleShading      = settings.min_sample_shading;
         multisampling.pSampleMask           = nullptr;
         multisampling.alphaToCoverageEnable = VK_FALSE;
         multisampling.alphaToOneEnable      = VK_FALSE;
@@ -361,7 +481,30 @@ namespace bbge {
         color_blending.blendConstants[2] = 0.0f;
         color_blending.blendConstants[3] = 0.0f;
 
-        // < depth and stencil testing setup here
+        // depth testing, only if the render pass has a depth attachment
+        VkPipelineDepthStencilStateCreateInfo depth_stencil { };
+        depth_stencil.sType                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        if (settings.depth) {
+            depth_stencil.depthTestEnable   = VK_TRUE;
+            depth_stencil.depthWriteEnable  = settings.depth->write;
+            depth_stencil.depthCompareOp    = to_vulkan(settings.depth->compare);
+        }
+        depth_stencil.depthBoundsTestEnable = VK_FALSE;
+        depth_stencil.stencilTestEnable     = VK_FALSE;
+        depth_stencil.minDepthBounds        = 0.0f;
+        depth_stencil.maxDepthBounds        = 1.0f;
+
+        // dynamic state, has to be set when recording
+        std::vector<VkDynamicState> dynamic_states;
+        dynamic_states.reserve(m_dynamic_states.size());
+        for (auto state : m_dynamic_states) {
+            dynamic_states.push_back(to_vulkan(state));
+        }
+
+        VkPipelineDynamicStateCreateInfo dynamic_state { };
+        dynamic_state.sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic_state.dynamicStateCount = dynamic_states.size();
+        dynamic_state.pDynamicStates    = dynamic_states.empty() ? nullptr : dynamic_states.data();
 
         // put it all together
         VkGraphicsPipelineCreateInfo create_info { };
@@ -372,23 +515,27 @@ namespace bbge {
         create_info.pViewportState = &viewport_create_info;
         create_info.pRasterizationState = &rasterizer_create_info;
         create_info.pMultisampleState = &multisampling;
-        create_info.pDepthStencilState = nullptr;
+        create_info.pDepthStencilState = settings.depth ? &depth_stencil : nullptr;
         create_info.pColorBlendState = &color_blending;
-        create_info.pDynamicState = nullptr;
+        create_info.pDynamicState = dynamic_states.empty() ? nullptr : &dynamic_state;
         create_info.layout = m_layout;
         create_info.renderPass = m_render_pass;
-        create_info.subpass = 0;
+        create_info.subpass = m_subpass;
         create_info.pInputAssemblyState = &input_assembly;
 
         create_info.basePipelineHandle = VK_NULL_HANDLE;
         create_info.basePipelineIndex = -1;
 
-        // create
+        // create through the shared cache
+        vulkan_pipeline_cache::creation_tracker tracker(m_cache, create_info.stageCount);
+        create_info.pNext = tracker.get_next();
+
         VkPipeline pipeline;
-        auto res = vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline);
+        auto res = vkCreateGraphicsPipelines(m_device, m_cache.get_handle(), 1, &create_info, nullptr, &pipeline);
         if (res != VK_SUCCESS) {
             return vulkan_error("Failed to create graphics pipeline", res);
         }
+        tracker.finish();
 
         return pipeline;
     }
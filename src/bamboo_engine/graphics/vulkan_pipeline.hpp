@@ -22,9 +22,16 @@
 
 #include <filesystem>
 #include <vector>
+#include <set>
+#include <optional>
 #include <cstddef>
 #include <vulkan/vulkan.h>
 #include "vulkan.hpp"
+#include "vulkan_pipeline_cache.hpp"
+#include "vulkan_shader.hpp"
+#include "vertex_layout.hpp"
+#include "../util/asset_archive.hpp"
+#include "../util/mapped_file.hpp"
 #include "../util/result.hpp"
 #include "../util/rectangle.hpp"
 
@@ -49,16 +56,41 @@ namespace bbge {
         float slope_factor;
     };
 
-    enum class shader_type : uint8_t {
-        fragment, vertex, geometry, compute
+    // Samples per pixel, clamped to what the device supports for the render pass' attachments
+    enum class msaa_samples : uint8_t {
+        x1, x2, x4, x8
+    };
+
+    enum class depth_compare : uint8_t {
+        never, less, equal, less_or_equal, greater, not_equal, greater_or_equal, always
+    };
+
+    struct depth_test {
+        depth_compare compare = depth_compare::less;
+        bool          write   = true;   // if false the depth buffer is only tested against, e.g. for transparent objects
+    };
+
+    // Pipeline state that is set while recording instead of being baked into the pipeline
+    enum class pipeline_dynamic_state : uint8_t {
+        viewport, scissor, line_width, depth_bias
     };
 
     struct rendering_pipeline_settings {
 
-        // input layout description
+        // input layout description, empty if the vertex shader generates its vertices
+        vertex_layout                        input_layout;
+
+        // descriptor set layouts of the pipeline layout in set order, owned by the caller
+        std::vector<VkDescriptorSetLayout>   descriptor_set_layouts;
+
+        // push constant ranges of the pipeline layout
+        std::vector<VkPushConstantRange>     push_constant_ranges;
+
+        // dynamic state, by default a pipeline can be used with any viewport and resolution
+        std::set<pipeline_dynamic_state>     dynamic_states  = { pipeline_dynamic_state::viewport, pipeline_dynamic_state::scissor };
 
         // rasterizer
-        drect                                viewport;                                           // Viewport, should probably fit the window dimensions
+        drect                                viewport;                                           // Static viewport and scissor, ignored if they are dynamic
         rasterizer_mode                      rasterizer_mode = rasterizer_mode::fill;            // Rasterizer mode
         float                                render_width    = 1.0f;                             // Rasterizer point/line width
         rasterizer_cull_mode                 cull_mode       = rasterizer_cull_mode::back;       // Which side of a primitive should be culled
@@ -67,6 +99,17 @@ namespace bbge {
         std::optional<rasterizer_depth_bias> depth_bias      = { };                              // Allows to set the depth bias
 
         // multisampling
+        msaa_samples                         samples         = msaa_samples::x1;                 // Color and depth samples, resolved into the swap chain image
+        bool                                 sample_shading  = false;                            // Shade every sample instead of every pixel, if the device supports it
+        float                                min_sample_shading = 1.0f;                          // Fraction of samples to shade with sample shading
+
+        // depth testing, adds a depth attachment to the render pass
+        std::optional<depth_test>            depth           = { };
+
+        // render pass to render in, e.g. from a vulkan_render_graph, with attachments matching the samples and depth above
+        // without one the pipeline creates a single subpass render pass into the swap chain image
+        VkRenderPass                         render_pass     = VK_NULL_HANDLE;                   // Owned by the caller
+        uint32_t                             subpass         = 0;                                // Subpass of the render pass
 
         // color blending
     };
@@ -75,13 +118,17 @@ namespace bbge {
     VkPolygonMode           to_vulkan(rasterizer_mode m);
     VkCullModeFlags         to_vulkan(rasterizer_cull_mode m);
     VkFrontFace             to_vulkan(rasterizer_front_face f);
-    VkShaderStageFlagBits   to_vulkan(shader_type t);
+    VkDynamicState          to_vulkan(pipeline_dynamic_state s);
+    VkSampleCountFlagBits   to_vulkan(msaa_samples s);
+    VkCompareOp             to_vulkan(depth_compare c);
 
     // string conversions
-    std::string_view to_string(shader_type t);
     std::string_view to_string(rasterizer_mode m);
     std::string_view to_string(rasterizer_cull_mode m);
     std::string_view to_string(rasterizer_front_face m);
+    std::string_view to_string(pipeline_dynamic_state s);
+    std::string_view to_string(msaa_samples s);
+    std::string_view to_string(depth_compare c);
 
     class vulkan_pipeline {
     public:
@@ -93,30 +140,102 @@ namespace bbge {
             std::filesystem::path fragment_shader;
         };
 
+        // SPIR-V binaries, can be loaded before the device exists
+        struct shader_code {
+            gsl::span<const std::byte> vertex_shader;
+            gsl::span<const std::byte> fragment_shader;
+            std::vector<mapped_file>   files;   // owns the binaries loaded from files, mappings don't move with it
+        };
+
+        /**
+         * @brief Map the SPIR-V binaries of a pipeline. Doesn't need a device.
+         * @param module_paths Paths to the binaries
+         * @return The code or an error if a binary can't be opened
+         */
+        [[nodiscard]] static result<shader_code, std::runtime_error> load_shader_code(const shader_module_paths& module_paths);
+
+        /**
+         * @brief Get the SPIR-V binaries of a pipeline from an asset archive without copying them.
+         * The code references the archive, which has to outlive it.
+         * @param archive Archive with the compiled shaders
+         * @param module_names Names of the binaries in the archive
+         * @return The code or an error if a binary is missing or compressed
+         */
+        [[nodiscard]] static result<shader_code, std::runtime_error> load_shader_code(const asset_archive& archive, const shader_module_paths& module_names);
+
         vulkan_pipeline(
             std::string&& name,
             const shader_module_paths& module_paths,
             const rendering_pipeline_settings& settings,
-            VkDevice dev, const vulkan_swap_chain& swap_chain
+            const vulkan_device& dev, VkFormat color_format
+        );
+
+        vulkan_pipeline(
+            std::string&& name,
+            const shader_code& code,
+            const rendering_pipeline_settings& settings,
+            const vulkan_device& dev, VkFormat color_format
         );
 
         ~vulkan_pipeline();
 
+        /**
+         * @brief Get the pipeline handle
+         * @return Pipeline handle
+         */
+        [[nodiscard]] VkPipeline get_handle() const noexcept;
+
+        /**
+         * @brief Get the render pass this pipeline renders in.
+         * @return Render pass handle
+         */
+        [[nodiscard]] VkRenderPass get_render_pass() const noexcept;
+
+        /**
+         * @brief Get the pipeline layout to bind descriptor sets with.
+         * @return Pipeline layout handle
+         */
+        [[nodiscard]] VkPipelineLayout get_layout() const noexcept;
+
+        /**
+         * @brief Check if a state has to be set while recording.
+         * @param s State
+         * @return True if the state is dynamic
+         */
+        [[nodiscard]] bool is_dynamic(pipeline_dynamic_state s) const noexcept;
+
+        /**
+         * @brief Get the sample count of the render pass' color and depth attachments after clamping.
+         * @return Sample count, render targets have to match it
+         */
+        [[nodiscard]] VkSampleCountFlagBits get_samples() const noexcept;
+
+        /**
+         * @brief Get the format of the render pass' depth attachment.
+         * @return Depth format or VK_FORMAT_UNDEFINED if the pipeline doesn't test depth
+         */
+        [[nodiscard]] VkFormat get_depth_format() const noexcept;
+
     private:
 
         std::string m_name;
+        std::set<pipeline_dynamic_state> m_dynamic_states;
         VkDevice m_device;
-        const vulkan_swap_chain& m_swap_chain;
+        vulkan_pipeline_cache& m_cache;
+        VkFormat m_color_format;    // of the render pass the pipeline creates without one in its settings
+        VkSampleCountFlagBits m_samples;
+        VkFormat m_depth_format;
+        bool m_sample_shading;
         VkPipelineLayout m_layout;
         VkRenderPass m_render_pass;
+        bool m_owns_render_pass;
+        uint32_t m_subpass;
         VkPipeline m_pipeline;
 
-        [[nodiscard]] static result<std::vector<std::byte>, std::runtime_error> load_binary_file(const std::filesystem::path& p);
-        [[nodiscard]] result<VkShaderModule, vulkan_error> create_shader_module(VkDevice dev, const std::vector<std::byte>& spir_v_bytecode, shader_type type) const;
-        [[nodiscard]] VkPipelineShaderStageCreateInfo make_shader_stage_create_info(VkShaderModule module, shader_type type) const;
-        [[nodiscard]] result<VkPipelineLayout, vulkan_error> create_pipeline_layout() const;
+        [[nodiscard]] result<VkPipelineLayout, vulkan_error> create_pipeline_layout(const rendering_pipeline_settings& settings) const;
         [[nodiscard]] result<VkRenderPass, vulkan_error> create_simple_render_pass() const;
-        [[nodiscard]] result<VkPipeline, vulkan_error> create_pipeline(const shader_module_paths& module_paths, const rendering_pipeline_settings& settings) const;
+        [[nodiscard]] result<VkPipeline, vulkan_error> create_pipeline(const shader_code& code, const rendering_pipeline_settings& settings) const;
+        [[nodiscard]] static shader_code load_shader_code_or_throw(const shader_module_paths& module_paths);
     };
 }
 
@@ -0,0 +1,53 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "vulkan_pipeline_builder.hpp"
+
+namespace bbge {
+
+    vulkan_pipeline_builder::vulkan_pipeline_builder(
+        const vulkan_device& dev, VkFormat color_format, job_system& jobs) noexcept
+      : m_device(dev), m_color_format(color_format), m_jobs(jobs) {
+
+    }
+
+    vulkan_pipeline_builder::pipeline_future vulkan_pipeline_builder::build(description desc) const {
+        return m_jobs.submit([this, desc = std::move(desc)]() mutable {
+            if (desc.code) {
+                return std::make_unique<vulkan_pipeline>(
+                    std::move(desc.name), *desc.code, desc.settings, m_device, m_color_format
+                );
+            }
+            return std::make_unique<vulkan_pipeline>(
+                std::move(desc.name), desc.module_paths, desc.settings, m_device, m_color_format
+            );
+        });
+    }
+
+    std::vector<vulkan_pipeline_builder::pipeline_future>
+    vulkan_pipeline_builder::build_all(gsl::span<const description> descs) const {
+
+        std::vector<pipeline_future> futures;
+        futures.reserve(descs.size());
+        for (const auto& desc : descs) {
+            futures.push_back(build(desc));
+        }
+
+        SPDLOG_DEBUG("Compiling {} pipelines on {} threads.", descs.size(), m_jobs.get_thread_count());
+        return futures;
+    }
+}
@@ -0,0 +1,81 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_PIPELINE_BUILDER_HPP
+#define BAMBOOENGINE_VULKAN_PIPELINE_BUILDER_HPP
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include <gsl/gsl-lite.hpp>
+#include "vulkan.hpp"
+#include "vulkan_pipeline.hpp"
+#include "../util/job_system.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Compiles graphics pipelines on the job system.
+     * All pipelines go through the device's pipeline cache, which Vulkan synchronizes internally.
+     */
+    class vulkan_pipeline_builder {
+    public:
+
+        /**
+         * @brief Everything needed to construct a vulkan_pipeline.
+         */
+        struct description {
+            std::string                          name;
+            vulkan_pipeline::shader_module_paths module_paths;
+            std::shared_ptr<const vulkan_pipeline::shader_code> code; // preloaded SPIR-V, module_paths are loaded if null
+            rendering_pipeline_settings          settings;
+        };
+
+        using pipeline_future = std::future<std::unique_ptr<vulkan_pipeline>>;
+
+        /**
+         * @brief Create a builder. The device and pool have to outlive all pending builds.
+         * @param dev Device to create the pipelines on
+         * @param color_format Format pipelines without a render pass in their settings render to, e.g. the swap chain's
+         * @param jobs Job system to compile on
+         */
+        vulkan_pipeline_builder(const vulkan_device& dev, VkFormat color_format, job_system& jobs) noexcept;
+
+        /**
+         * @brief Compile a single pipeline in the background.
+         * @param desc Pipeline description
+         * @return Future of the pipeline, get() rethrows a vulkan_error if compilation failed
+         */
+        [[nodiscard]] pipeline_future build(description desc) const;
+
+        /**
+         * @brief Compile many pipelines in parallel.
+         * @param descs Pipeline descriptions
+         * @return One future per description, in the same order
+         */
+        [[nodiscard]] std::vector<pipeline_future> build_all(gsl::span<const description> descs) const;
+
+    private:
+
+        const vulkan_device& m_device;
+        VkFormat m_color_format;
+        job_system& m_jobs;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_PIPELINE_BUILDER_HPP
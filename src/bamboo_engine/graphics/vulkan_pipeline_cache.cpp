@@ -0,0 +1,236 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <fstream>
+#include <cstring>
+#include "vulkan_pipeline_cache.hpp"
+#include "vulkan_utils.hpp"
+#include "../util/custom_formatters.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        // Layout of VkPipelineCacheHeaderVersionOne, read byte-wise because the blob has no alignment guarantees
+        constexpr const std::size_t header_size_offset     = 0;
+        constexpr const std::size_t header_version_offset  = 4;
+        constexpr const std::size_t vendor_id_offset       = 8;
+        constexpr const std::size_t device_id_offset       = 12;
+        constexpr const std::size_t uuid_offset            = 16;
+        constexpr const std::size_t min_header_size        = uuid_offset + VK_UUID_SIZE;
+
+        uint32_t read_u32(const std::vector<std::byte>& blob, std::size_t offset) {
+            uint32_t v;
+            std::memcpy(&v, blob.data() + offset, sizeof(v));
+            return v;
+        }
+    }
+
+    vulkan_pipeline_cache::vulkan_pipeline_cache(
+        VkPhysicalDevice physical_device, VkDevice device,
+        std::filesystem::path path, bool creation_feedback)
+      : vulkan_pipeline_cache(physical_device, device, path, creation_feedback, load_blob(path)) { }
+
+    vulkan_pipeline_cache::vulkan_pipeline_cache(
+        VkPhysicalDevice physical_device, VkDevice device,
+        std::filesystem::path path, bool creation_feedback,
+        result<std::vector<std::byte>, std::runtime_error> blob_res)
+      : m_physical_device(physical_device), m_device(device), m_path(std::move(path)),
+        m_creation_feedback(creation_feedback), m_handle(VK_NULL_HANDLE),
+        m_cold_creations(0), m_warm_creations(0), m_unknown_creations(0) {
+
+        assert(physical_device);
+        assert(device);
+
+        // a missing or stale blob is no reason to fail, the cache just starts out empty
+        std::vector<std::byte> blob;
+        if (blob_res.is_ok()) {
+            if (is_blob_compatible(*blob_res.ok())) {
+                blob = std::move(*blob_res.ok());
+            }
+            else {
+                SPDLOG_DEBUG("Discarding pipeline cache '{}', it was created for a different device or driver.", m_path);
+            }
+        }
+        else {
+            blob_res.log_err(spdlog::level::debug);
+        }
+
+        VkPipelineCacheCreateInfo create_info { };
+        create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        create_info.initialDataSize = blob.size();
+        create_info.pInitialData = blob.empty() ? nullptr : blob.data();
+
+        auto res = vkCreatePipelineCache(m_device, &create_info, nullptr, &m_handle);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to create pipeline cache", res);
+        }
+
+        SPDLOG_TRACE("Created Vulkan pipeline cache with {} bytes of initial data.", blob.size());
+    }
+
+    vulkan_pipeline_cache::~vulkan_pipeline_cache() {
+        if (m_handle) {
+            log_statistics();
+            auto saved = save();
+            saved.log_err(spdlog::level::warn);
+            if (saved.is_ok()) {
+                SPDLOG_TRACE("Wrote {} bytes of pipeline cache to '{}'.", *saved.ok(), m_path);
+            }
+            vkDestroyPipelineCache(m_device, m_handle, nullptr);
+            SPDLOG_TRACE("Destroyed Vulkan pipeline cache.");
+        }
+    }
+
+    VkPipelineCache vulkan_pipeline_cache::get_handle() const noexcept {
+        return m_handle;
+    }
+
+    result<std::size_t, std::runtime_error> vulkan_pipeline_cache::save() const {
+
+        std::size_t size = 0;
+        auto res = vkGetPipelineCacheData(m_device, m_handle, &size, nullptr);
+        if (res != VkResult::VK_SUCCESS) {
+            return std::runtime_error(fmt::format("Failed to query pipeline cache size (err={}).", vulkan_utils::to_string(res)));
+        }
+        std::vector<std::byte> data(size);
+        res = vkGetPipelineCacheData(m_device, m_handle, &size, data.data());
+        if (res != VkResult::VK_SUCCESS && res != VkResult::VK_INCOMPLETE) {
+            return std::runtime_error(fmt::format("Failed to query pipeline cache data (err={}).", vulkan_utils::to_string(res)));
+        }
+        data.resize(size);
+
+        std::error_code ec;
+        if (m_path.has_parent_path()) {
+            std::filesystem::create_directories(m_path.parent_path(), ec);
+            if (ec) {
+                return std::runtime_error(fmt::format("Failed to create directory for pipeline cache '{}': {}.", m_path, ec.message()));
+            }
+        }
+
+        // write next to the target and swap it in afterwards
+        auto tmp_path = m_path;
+        tmp_path += ".tmp";
+        {
+            std::ofstream os(tmp_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+            if (!os) {
+                return std::runtime_error(fmt::format("Failed to open '{}' for writing: {}.", tmp_path, std::strerror(errno)));
+            }
+            os.write(reinterpret_cast<const char*>(data.data()), data.size());
+            os.flush();
+            if (!os) {
+                return std::runtime_error(fmt::format("Failed to write pipeline cache to '{}'.", tmp_path));
+            }
+        }
+
+        std::filesystem::rename(tmp_path, m_path, ec);
+        if (ec) {
+            // the rename error is the one worth reporting, a failed cleanup only leaves the temporary file behind
+            std::error_code remove_ec;
+            std::filesystem::remove(tmp_path, remove_ec);
+            return std::runtime_error(fmt::format("Failed to replace pipeline cache '{}': {}.", m_path, ec.message()));
+        }
+
+        return data.size();
+    }
+
+    void vulkan_pipeline_cache::log_statistics() const {
+        auto cold = m_cold_creations.load(std::memory_order_relaxed);
+        auto warm = m_warm_creations.load(std::memory_order_relaxed);
+        auto unknown = m_unknown_creations.load(std::memory_order_relaxed);
+        SPDLOG_DEBUG("Pipeline cache: {} pipeline creations, {} cold, {} warm, {} unknown.", cold + warm + unknown, cold, warm, unknown);
+    }
+
+    result<std::vector<std::byte>, std::runtime_error> vulkan_pipeline_cache::load_blob(const std::filesystem::path& p) {
+
+        if (!std::filesystem::exists(p)) {
+            return std::runtime_error(fmt::format("No pipeline cache at '{}', starting cold.", p));
+        }
+
+        std::ifstream is(p, std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
+        if (!is) {
+            return std::runtime_error(fmt::format("Failed to read pipeline cache '{}': {}.", p, std::strerror(errno)));
+        }
+        auto length = is.tellg();
+        is.seekg(0, std::ios_base::beg);
+        std::vector<std::byte> blob(length);
+        is.read(reinterpret_cast<char*>(blob.data()), length);
+        blob.resize(is.gcount());
+        return blob;
+    }
+
+    bool vulkan_pipeline_cache::is_blob_compatible(const std::vector<std::byte>& blob) const {
+
+        if (blob.size() < min_header_size) return false;
+
+        auto header_size = read_u32(blob, header_size_offset);
+        auto header_version = read_u32(blob, header_version_offset);
+        if (header_size < min_header_size || header_size > blob.size()) return false;
+        if (header_version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) return false;
+
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(m_physical_device, &props);
+
+        if (read_u32(blob, vendor_id_offset) != props.vendorID) return false;
+        if (read_u32(blob, device_id_offset) != props.deviceID) return false;
+        return std::memcmp(blob.data() + uuid_offset, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    void vulkan_pipeline_cache::record_creation(bool warm) const noexcept {
+        if (warm) m_warm_creations.fetch_add(1, std::memory_order_relaxed);
+        else m_cold_creations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void vulkan_pipeline_cache::record_unknown_creation() const noexcept {
+        m_unknown_creations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    vulkan_pipeline_cache::creation_tracker::creation_tracker(const vulkan_pipeline_cache& cache, uint32_t stage_count)
+      : m_cache(cache), m_pipeline_feedback(), m_stage_feedback(), m_feedback_info() {
+
+        assert(stage_count <= max_stages);
+
+        if (m_cache.m_creation_feedback) {
+            m_feedback_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+            m_feedback_info.pPipelineCreationFeedback = &m_pipeline_feedback;
+            m_feedback_info.pipelineStageCreationFeedbackCount = stage_count;
+            m_feedback_info.pPipelineStageCreationFeedbacks = m_stage_feedback.data();
+        }
+    }
+
+    const void* vulkan_pipeline_cache::creation_tracker::get_next() const noexcept {
+        return m_cache.m_creation_feedback ? &m_feedback_info : nullptr;
+    }
+
+    void vulkan_pipeline_cache::creation_tracker::finish() {
+
+        #pragma clang diagnostic push
+        #pragma ide diagnostic ignored "hicpp-signed-bitwise"
+        if (m_cache.m_creation_feedback) {
+            bool valid = m_pipeline_feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT;
+            bool hit = m_pipeline_feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT;
+            // without the valid bit the driver didn't say, don't count it as a miss either
+            if (valid) m_cache.record_creation(hit);
+            else m_cache.record_unknown_creation();
+            return;
+        }
+        #pragma clang diagnostic pop
+
+        // the cache is shared by parallel builds, so its size says nothing about this creation
+        m_cache.record_unknown_creation();
+    }
+}
@@ -0,0 +1,147 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_PIPELINE_CACHE_HPP
+#define BAMBOOENGINE_VULKAN_PIPELINE_CACHE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+#include <stdexcept>
+#include <vulkan/vulkan.h>
+#include "../util/macros.hpp"
+#include "../util/result.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief On-disk backed VkPipelineCache shared by all pipelines of a device.
+     * The blob is loaded on construction and written back on destruction.
+     * Blobs written by another driver or device are discarded.
+     */
+    class vulkan_pipeline_cache {
+    public:
+
+        /**
+         * @brief Classifies a single pipeline creation as cold or warm.
+         * Needs VK_EXT_pipeline_creation_feedback, without it creations are counted as unknown.
+         * Guessing from cache growth isn't an option, pipelines are built in parallel and share the cache.
+         */
+        class creation_tracker {
+        public:
+
+            BBGE_NO_COPIES(creation_tracker);
+            BBGE_NO_MOVES(creation_tracker);
+
+            creation_tracker(const vulkan_pipeline_cache& cache, uint32_t stage_count);
+
+            /**
+             * @brief Get the feedback struct to chain into the pipeline create info.
+             * @return Pointer for pNext or nullptr if feedback is not supported
+             */
+            [[nodiscard]] const void* get_next() const noexcept;
+
+            /**
+             * @brief Record the outcome. Call once after the pipeline was created successfully.
+             */
+            void finish();
+
+        private:
+
+            static constexpr const std::size_t max_stages = 5;
+
+            const vulkan_pipeline_cache& m_cache;
+            VkPipelineCreationFeedbackEXT m_pipeline_feedback;
+            std::array<VkPipelineCreationFeedbackEXT, max_stages> m_stage_feedback;
+            VkPipelineCreationFeedbackCreateInfoEXT m_feedback_info;
+        };
+
+        BBGE_NO_COPIES(vulkan_pipeline_cache);
+        BBGE_NO_MOVES(vulkan_pipeline_cache);
+
+        /**
+         * @brief Create the cache and fill it from disk if a compatible blob exists.
+         * @param physical_device Device the blob has to match
+         * @param device Logical device owning the cache
+         * @param path Location of the cache blob
+         * @param creation_feedback True if VK_EXT_pipeline_creation_feedback is enabled on the device
+         */
+        vulkan_pipeline_cache(VkPhysicalDevice physical_device, VkDevice device,
+                              std::filesystem::path path, bool creation_feedback);
+
+        /**
+         * @brief Create the cache from a blob that was read already, e.g. while the device was created.
+         * @param physical_device Device the blob has to match
+         * @param device Logical device owning the cache
+         * @param path Location the cache is written back to
+         * @param creation_feedback True if VK_EXT_pipeline_creation_feedback is enabled on the device
+         * @param blob_res Result of load_blob(), an error or incompatible blob starts the cache out empty
+         */
+        vulkan_pipeline_cache(VkPhysicalDevice physical_device, VkDevice device,
+                              std::filesystem::path path, bool creation_feedback,
+                              result<std::vector<std::byte>, std::runtime_error> blob_res);
+
+        ~vulkan_pipeline_cache();
+
+        /**
+         * @brief Get the cache handle
+         * @return Cache handle, pass it to vkCreate*Pipelines
+         */
+        [[nodiscard]] VkPipelineCache get_handle() const noexcept;
+
+        /**
+         * @brief Write the cache back to disk.
+         * The data goes to a temporary file first which then replaces the old blob,
+         * so a crash never leaves a truncated cache behind.
+         * @return Number of bytes written
+         */
+        [[nodiscard]] result<std::size_t, std::runtime_error> save() const;
+
+        /**
+         * @brief Log how many pipeline creations hit the cache.
+         */
+        void log_statistics() const;
+
+        /**
+         * @brief Read a cache blob. Doesn't need a device, so it can run in parallel to device creation.
+         * @param p Location of the cache blob
+         * @return The blob or an error if there is none
+         */
+        [[nodiscard]] static result<std::vector<std::byte>, std::runtime_error> load_blob(const std::filesystem::path& p);
+
+    private:
+
+        VkPhysicalDevice m_physical_device;
+        VkDevice m_device;
+        std::filesystem::path m_path;
+        bool m_creation_feedback;
+        VkPipelineCache m_handle;
+
+        // statistics, pipelines may be created from multiple threads
+        mutable std::atomic<uint32_t> m_cold_creations;
+        mutable std::atomic<uint32_t> m_warm_creations;
+        mutable std::atomic<uint32_t> m_unknown_creations;
+
+        [[nodiscard]] bool is_blob_compatible(const std::vector<std::byte>& blob) const;
+        void record_creation(bool warm) const noexcept;
+        void record_unknown_creation() const noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_PIPELINE_CACHE_HPP
@@ -0,0 +1,282 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <array>
+#include <cassert>
+#include "vulkan_profiler.hpp"
+#include "vulkan_capability_cache.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        constexpr VkQueryPipelineStatisticFlags pipeline_statistic_flags =
+            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+        // one value per statistic plus the availability
+        constexpr uint32_t pipeline_result_count = 6;
+        constexpr uint32_t timestamp_result_count = 2;
+    }
+
+    vulkan_profiler::scope::scope(vulkan_profiler& profiler, const vulkan_frame_scheduler::frame& f,
+                                  std::string_view name, bool pipeline_statistics)
+      : m_profiler(profiler), m_frame(f), m_id(profiler.begin_scope(f, name, pipeline_statistics)) {
+
+    }
+
+    vulkan_profiler::scope::~scope() {
+        m_profiler.end_scope(m_frame, m_id);
+    }
+
+    vulkan_profiler::vulkan_profiler(const vulkan_device& device, VkInstance instance, uint32_t frames_in_flight,
+                                     uint32_t max_scopes, std::size_t history)
+      : m_device(device.get_handle()), m_functions(instance), m_max_scopes(max_scopes), m_history(history),
+        m_timestamp_period(0.0), m_timestamp_mask(0),
+        m_pipeline_statistics(device.get_enabled_features().pipelineStatisticsQuery == VK_TRUE),
+        m_pipeline_scope_open(false) {
+
+        const auto& capabilities = vulkan_capability_cache::get(device.get_physical_device());
+        auto valid_bits = capabilities.queue_families[device.get_queue_family_indices().graphics].timestampValidBits;
+        if (valid_bits > 0) {
+            m_timestamp_mask = valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+            m_timestamp_period = capabilities.properties.limits.timestampPeriod;
+        }
+        else {
+            SPDLOG_WARN("The graphics queue doesn't support timestamps, GPU scopes are only labeled.");
+        }
+
+        try {
+            m_slots.resize(frames_in_flight);
+            for (auto& slot : m_slots) {
+                slot.scopes.reserve(max_scopes);
+
+                if (m_timestamp_mask != 0) {
+                    VkQueryPoolCreateInfo info { };
+                    info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                    info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+                    info.queryCount = max_scopes * 2;
+                    auto res = vkCreateQueryPool(m_device, &info, nullptr, &slot.timestamps);
+                    if (res != VkResult::VK_SUCCESS) {
+                        throw vulkan_error("Failed to create timestamp query pool", res);
+                    }
+                }
+
+                if (m_pipeline_statistics) {
+                    VkQueryPoolCreateInfo info { };
+                    info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                    info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+                    info.queryCount = max_scopes;
+                    info.pipelineStatistics = pipeline_statistic_flags;
+                    auto res = vkCreateQueryPool(m_device, &info, nullptr, &slot.pipeline_statistics);
+                    if (res != VkResult::VK_SUCCESS) {
+                        throw vulkan_error("Failed to create pipeline statistics query pool", res);
+                    }
+                }
+            }
+        }
+        catch (...) {
+            destroy();
+            throw;
+        }
+
+        m_results.resize(std::size_t(max_scopes) * 2 * timestamp_result_count);
+
+        SPDLOG_TRACE("Created GPU profiler for {} scopes per frame (timestamps={}, pipeline statistics={}, labels={}).",
+                     max_scopes, m_timestamp_mask != 0, m_pipeline_statistics, m_functions.has_debug_utils());
+    }
+
+    vulkan_profiler::~vulkan_profiler() {
+        destroy();
+        SPDLOG_TRACE("Destroyed GPU profiler.");
+    }
+
+    void vulkan_profiler::begin_frame(const vulkan_frame_scheduler::frame& f) {
+
+        assert(f.slot < m_slots.size());
+        auto& slot = m_slots[f.slot];
+
+        // the frame scheduler waited for the slot's fence, so the results are available
+        read_results(slot);
+
+        slot.scopes.clear();
+        slot.timestamp_count = 0;
+        slot.pipeline_count = 0;
+        slot.frame_number = f.number;
+        m_pipeline_scope_open = false;
+
+        if (slot.timestamps) {
+            vkCmdResetQueryPool(f.command_buffer, slot.timestamps, 0, m_max_scopes * 2);
+        }
+        if (slot.pipeline_statistics) {
+            vkCmdResetQueryPool(f.command_buffer, slot.pipeline_statistics, 0, m_max_scopes);
+        }
+    }
+
+    uint32_t vulkan_profiler::begin_scope(const vulkan_frame_scheduler::frame& f, std::string_view name, bool pipeline_statistics) {
+
+        assert(f.slot < m_slots.size());
+        auto& slot = m_slots[f.slot];
+
+        begin_label(f.command_buffer, name);
+
+        recorded_scope recorded { get_statistics_index(name) };
+        if (slot.scopes.size() < m_max_scopes) {
+            if (slot.timestamps) {
+                recorded.timestamp_query = slot.timestamp_count;
+                slot.timestamp_count += 2;
+                vkCmdWriteTimestamp(f.command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.timestamps, recorded.timestamp_query);
+            }
+            // only one pipeline statistics query can be active at a time
+            if (pipeline_statistics && slot.pipeline_statistics && !m_pipeline_scope_open) {
+                recorded.pipeline_query = slot.pipeline_count++;
+                vkCmdBeginQuery(f.command_buffer, slot.pipeline_statistics, recorded.pipeline_query, 0);
+                m_pipeline_scope_open = true;
+            }
+        }
+
+        slot.scopes.push_back(recorded);
+        return static_cast<uint32_t>(slot.scopes.size() - 1);
+    }
+
+    void vulkan_profiler::end_scope(const vulkan_frame_scheduler::frame& f, uint32_t id) {
+
+        assert(f.slot < m_slots.size());
+        auto& slot = m_slots[f.slot];
+        assert(id < slot.scopes.size());
+        const auto& recorded = slot.scopes[id];
+
+        if (recorded.pipeline_query != no_query) {
+            vkCmdEndQuery(f.command_buffer, slot.pipeline_statistics, recorded.pipeline_query);
+            m_pipeline_scope_open = false;
+        }
+        if (recorded.timestamp_query != no_query) {
+            vkCmdWriteTimestamp(f.command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.timestamps, recorded.timestamp_query + 1);
+        }
+
+        m_functions.vkCmdEndDebugUtilsLabelEXT(f.command_buffer);
+    }
+
+    void vulkan_profiler::insert_label(VkCommandBuffer cmd, std::string_view name) {
+
+        if (!m_functions.has_debug_utils()) return;
+
+        m_label.assign(name);
+        VkDebugUtilsLabelEXT label { };
+        label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+        label.pLabelName = m_label.c_str();
+        m_functions.vkCmdInsertDebugUtilsLabelEXT(cmd, &label);
+    }
+
+    const std::deque<gpu_scope_statistics>& vulkan_profiler::get_statistics() const noexcept {
+        return m_statistics;
+    }
+
+    void vulkan_profiler::log_statistics() const {
+        for (const auto& s : m_statistics) {
+            auto summary = s.milliseconds.get_summary();
+            SPDLOG_DEBUG("GPU scope '{}': min={:.3f}ms avg={:.3f}ms p99={:.3f}ms over {} frames.",
+                         s.name, summary.min, summary.avg, summary.p99, summary.samples);
+        }
+    }
+
+    bool vulkan_profiler::has_timestamps() const noexcept {
+        return m_timestamp_mask != 0;
+    }
+
+    bool vulkan_profiler::has_pipeline_statistics() const noexcept {
+        return m_pipeline_statistics;
+    }
+
+    uint32_t vulkan_profiler::get_statistics_index(std::string_view name) {
+
+        auto it = m_statistics_indices.find(name);
+        if (it != m_statistics_indices.end()) {
+            return it->second;
+        }
+
+        // deque elements don't move, so the key can view the stored name
+        auto index = static_cast<uint32_t>(m_statistics.size());
+        m_statistics.push_back({ std::string(name), rolling_statistics(m_history), { }, 0 });
+        m_statistics_indices.emplace(std::string_view(m_statistics.back().name), index);
+        return index;
+    }
+
+    void vulkan_profiler::begin_label(VkCommandBuffer cmd, std::string_view name) {
+
+        if (!m_functions.has_debug_utils()) return;
+
+        m_label.assign(name);
+        VkDebugUtilsLabelEXT label { };
+        label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+        label.pLabelName = m_label.c_str();
+        m_functions.vkCmdBeginDebugUtilsLabelEXT(cmd, &label);
+    }
+
+    void vulkan_profiler::read_results(frame_slot& slot) {
+
+        // no wait flag, anything not available wasn't executed and is skipped
+        constexpr VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+
+        if (slot.timestamp_count > 0) {
+            constexpr VkDeviceSize stride = timestamp_result_count * sizeof(uint64_t);
+            auto res = vkGetQueryPoolResults(m_device, slot.timestamps, 0, slot.timestamp_count,
+                                             slot.timestamp_count * stride, m_results.data(), stride, flags);
+            if (res != VkResult::VK_SUCCESS && res != VkResult::VK_NOT_READY) {
+                throw vulkan_error("Failed to read timestamp queries", res);
+            }
+
+            for (const auto& recorded : slot.scopes) {
+                if (recorded.timestamp_query == no_query) continue;
+                const auto* begin = &m_results[recorded.timestamp_query * timestamp_result_count];
+                const auto* end = begin + timestamp_result_count;
+                if (begin[1] == 0 || end[1] == 0) continue;
+
+                auto ticks = (end[0] - begin[0]) & m_timestamp_mask;
+                auto& statistics = m_statistics[recorded.statistics_index];
+                statistics.milliseconds.add(static_cast<double>(ticks) * m_timestamp_period / 1'000'000.0);
+                statistics.last_frame = slot.frame_number;
+            }
+        }
+
+        if (slot.pipeline_count > 0) {
+            constexpr VkDeviceSize stride = pipeline_result_count * sizeof(uint64_t);
+            std::array<uint64_t, pipeline_result_count> values { };
+            for (const auto& recorded : slot.scopes) {
+                if (recorded.pipeline_query == no_query) continue;
+                auto res = vkGetQueryPoolResults(m_device, slot.pipeline_statistics, recorded.pipeline_query, 1,
+                                                 stride, values.data(), stride, flags);
+                if (res != VkResult::VK_SUCCESS || values[pipeline_result_count - 1] == 0) continue;
+
+                m_statistics[recorded.statistics_index].last_pipeline_statistics = {
+                    values[0], values[1], values[2], values[3], values[4]
+                };
+            }
+        }
+    }
+
+    void vulkan_profiler::destroy() noexcept {
+        for (auto& slot : m_slots) {
+            if (slot.timestamps) vkDestroyQueryPool(m_device, slot.timestamps, nullptr);
+            if (slot.pipeline_statistics) vkDestroyQueryPool(m_device, slot.pipeline_statistics, nullptr);
+        }
+        m_slots.clear();
+    }
+}
@@ -0,0 +1,189 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_PROFILER_HPP
+#define BAMBOOENGINE_VULKAN_PROFILER_HPP
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <tsl/robin_map.h>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "vulkan_frame_scheduler.hpp"
+#include "../util/macros.hpp"
+#include "../util/rolling_statistics.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Pipeline statistics of one scope, in the bit order of the query's flags.
+     */
+    struct gpu_pipeline_statistics {
+        uint64_t input_assembly_primitives   = 0;
+        uint64_t vertex_shader_invocations   = 0;
+        uint64_t clipping_primitives         = 0;
+        uint64_t fragment_shader_invocations = 0;
+        uint64_t compute_shader_invocations  = 0;
+    };
+
+    /**
+     * @brief Measured GPU time of every scope with the same name.
+     */
+    struct gpu_scope_statistics {
+        std::string                 name;
+        rolling_statistics          milliseconds;
+        gpu_pipeline_statistics     last_pipeline_statistics;   // zero unless the scope queries them
+        uint64_t                    last_frame = 0;             // number of the frame the scope was last measured in
+    };
+
+    /**
+     * @brief Measures GPU time of named scopes in a frame's primary command buffer.
+     * Every frame in flight has its own query pools, they are read once the frame scheduler waited for the slot again,
+     * so reading never stalls. Scopes also become VK_EXT_debug_utils labels for frame captures.
+     * Scopes can nest, scopes with pipeline statistics can't. Both have to begin and end outside render passes
+     * that execute secondary command buffers.
+     */
+    class vulkan_profiler {
+    public:
+
+        static constexpr const uint32_t default_max_scopes = 64;
+        static constexpr const std::size_t default_history = 240;
+
+        /**
+         * @brief RAII scope, ends when it goes out of scope.
+         */
+        class scope {
+        public:
+
+            BBGE_NO_COPIES(scope);
+            BBGE_NO_MOVES(scope);
+
+            scope(vulkan_profiler& profiler, const vulkan_frame_scheduler::frame& f, std::string_view name,
+                  bool pipeline_statistics = false);
+            ~scope();
+
+        private:
+            vulkan_profiler& m_profiler;
+            const vulkan_frame_scheduler::frame& m_frame;
+            uint32_t m_id;
+        };
+
+        BBGE_NO_COPIES(vulkan_profiler);
+        BBGE_NO_MOVES(vulkan_profiler);
+
+        /**
+         * @brief Create the query pools.
+         * @param device Device, timestamps are measured on its graphics queue
+         * @param instance Instance to load the debug utils functions from
+         * @param frames_in_flight Frames in flight of the frame scheduler
+         * @param max_scopes Maximum number of scopes per frame
+         * @param history Number of frames the statistics summarize
+         */
+        vulkan_profiler(const vulkan_device& device, VkInstance instance, uint32_t frames_in_flight,
+                        uint32_t max_scopes = default_max_scopes, std::size_t history = default_history);
+
+        ~vulkan_profiler();
+
+        /**
+         * @brief Publish the results the slot measured last time and reset its queries.
+         * Call at the start of every frame, before any scope and outside a render pass.
+         * @param f Frame that just began
+         */
+        void begin_frame(const vulkan_frame_scheduler::frame& f);
+
+        /**
+         * @brief Begin a scope. Scopes beyond max_scopes are only labeled.
+         * @param f Current frame
+         * @param name Name, scopes with the same name share statistics
+         * @param pipeline_statistics Also count primitives and shader invocations
+         * @return Id to end the scope with
+         */
+        [[nodiscard]] uint32_t begin_scope(const vulkan_frame_scheduler::frame& f, std::string_view name,
+                                           bool pipeline_statistics = false);
+
+        /**
+         * @brief End a scope.
+         * @param f Current frame
+         * @param id Id returned by begin_scope
+         */
+        void end_scope(const vulkan_frame_scheduler::frame& f, uint32_t id);
+
+        /**
+         * @brief Insert a single debug label, e.g. to mark an event in a capture.
+         * @param cmd Command buffer
+         * @param name Label
+         */
+        void insert_label(VkCommandBuffer cmd, std::string_view name);
+
+        /**
+         * @brief Get the statistics of all scopes seen so far in order of appearance.
+         * @return Statistics
+         */
+        [[nodiscard]] const std::deque<gpu_scope_statistics>& get_statistics() const noexcept;
+
+        /**
+         * @brief Log the summaries of all scopes at debug level.
+         */
+        void log_statistics() const;
+
+        [[nodiscard]] bool has_timestamps() const noexcept;
+        [[nodiscard]] bool has_pipeline_statistics() const noexcept;
+
+    private:
+
+        static constexpr const uint32_t no_query = UINT32_MAX;
+
+        struct recorded_scope {
+            uint32_t statistics_index;             // into m_statistics
+            uint32_t timestamp_query = no_query;   // begin, end is the next query
+            uint32_t pipeline_query = no_query;
+        };
+
+        struct frame_slot {
+            VkQueryPool timestamps = VK_NULL_HANDLE;
+            VkQueryPool pipeline_statistics = VK_NULL_HANDLE;
+            std::vector<recorded_scope> scopes;
+            uint32_t timestamp_count = 0;
+            uint32_t pipeline_count = 0;
+            uint64_t frame_number = 0;
+        };
+
+        VkDevice m_device;
+        vulkan_function_loader m_functions;
+        uint32_t m_max_scopes;
+        std::size_t m_history;
+        double m_timestamp_period;      // nanoseconds per tick
+        uint64_t m_timestamp_mask;      // valid bits of the graphics queue's timestamps
+        bool m_pipeline_statistics;
+        std::vector<frame_slot> m_slots;
+        std::deque<gpu_scope_statistics> m_statistics;
+        tsl::robin_map<std::string_view, uint32_t> m_statistics_indices; // keys point to names in m_statistics
+        std::vector<uint64_t> m_results;
+        std::string m_label;            // null terminated copy of a label name
+        bool m_pipeline_scope_open;
+
+        [[nodiscard]] uint32_t get_statistics_index(std::string_view name);
+        void begin_label(VkCommandBuffer cmd, std::string_view name);
+        void read_results(frame_slot& slot);
+        void destroy() noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_PROFILER_HPP
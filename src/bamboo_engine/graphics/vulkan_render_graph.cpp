@@ -0,0 +1,590 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <fmt/format.h>
+#include "vulkan_render_graph.hpp"
+#include "../util/logging.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        VkImageAspectFlags get_aspect(VkFormat format) noexcept {
+            switch (format) {
+                case VK_FORMAT_D16_UNORM:
+                case VK_FORMAT_X8_D24_UNORM_PACK32:
+                case VK_FORMAT_D32_SFLOAT:
+                    return VK_IMAGE_ASPECT_DEPTH_BIT;
+                case VK_FORMAT_D16_UNORM_S8_UINT:
+                case VK_FORMAT_D24_UNORM_S8_UINT:
+                case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                    return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+                case VK_FORMAT_S8_UINT:
+                    return VK_IMAGE_ASPECT_STENCIL_BIT;
+                default:
+                    return VK_IMAGE_ASPECT_COLOR_BIT;
+            }
+        }
+
+        constexpr VkAccessFlags write_access_mask =
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    }
+
+    vulkan_render_graph::vulkan_render_graph(const vulkan_device& device, render_graph&& graph)
+      : m_device(device.get_handle()), m_allocator(device.get_allocator()), m_graph(std::move(graph)),
+        m_extent { 0, 0 }, m_memory_size(0), m_undefined_contents(true) {
+
+        m_graph.compile();
+        m_images.resize(m_graph.get_images().size());
+
+        try {
+            for (const auto& group : m_graph.get_groups()) {
+                m_render_passes.push_back(group.type == render_graph_pass_type::graphics
+                    ? create_render_pass(group).or_throw()
+                    : VK_NULL_HANDLE);
+            }
+        }
+        catch (...) {
+            for (auto pass : m_render_passes) {
+                if (pass) {
+                    vkDestroyRenderPass(m_device, pass, nullptr);
+                }
+            }
+            throw;
+        }
+
+        SPDLOG_TRACE("Created render graph ({} passes in {} groups, {} alias slots).",
+                     m_graph.get_passes().size(), m_graph.get_groups().size(), m_graph.get_alias_slot_count());
+    }
+
+    vulkan_render_graph::~vulkan_render_graph() {
+        for (auto& retired : m_retired) {
+            destroy(retired);
+        }
+        retire(0);
+        for (auto pass : m_render_passes) {
+            if (pass) {
+                vkDestroyRenderPass(m_device, pass, nullptr);
+            }
+        }
+        SPDLOG_TRACE("Destroyed render graph.");
+    }
+
+    vulkan_render_graph::subpass vulkan_render_graph::get_subpass(render_graph::pass p) const {
+        const auto& info = m_graph.get_passes().at(p);
+        if (info.type != render_graph_pass_type::graphics || info.culled) {
+            throw std::invalid_argument(fmt::format("Pass '{}' doesn't render in a render pass.", info.name));
+        }
+        return { m_render_passes[info.group], info.subpass };
+    }
+
+    void vulkan_render_graph::resize(VkExtent2D extent, uint32_t retire_after_frames) {
+
+        bool resized = extent.width != m_extent.width || extent.height != m_extent.height;
+        m_extent = extent;
+
+        // imported images may have been recreated, so the framebuffers always go
+        if (resized) {
+            retire(retire_after_frames);
+            create_images();
+            m_undefined_contents = true;
+        }
+        else {
+            retired_resources retired { { }, { }, { }, retire_after_frames };
+            for (const auto& [key, framebuffer] : m_framebuffers) {
+                retired.framebuffers.push_back(framebuffer);
+            }
+            m_framebuffers.clear();
+            if (retire_after_frames == 0) {
+                destroy(retired);
+            }
+            else {
+                m_retired.push_back(std::move(retired));
+            }
+        }
+
+        // imported images follow the graph's extent as well
+        const auto& images = m_graph.get_images();
+        for (std::size_t i = 0; i < images.size(); ++i) {
+            if (images[i].import) {
+                m_images[i].extent = get_scaled_extent(images[i].desc);
+            }
+        }
+
+        SPDLOG_DEBUG("Resized render graph to {}x{}, {} bytes of image memory.", extent.width, extent.height, m_memory_size);
+    }
+
+    void vulkan_render_graph::set_image(render_graph::resource r, VkImage image, VkImageView view) {
+        if (!m_graph.get_images().at(r).import) {
+            throw std::invalid_argument(fmt::format("Image '{}' isn't imported.", m_graph.get_images()[r].name));
+        }
+        m_images[r].image = image;
+        m_images[r].view = view;
+    }
+
+    void vulkan_render_graph::execute(const vulkan_frame_scheduler::frame& f) {
+
+        const auto& passes = m_graph.get_passes();
+        const auto& groups = m_graph.get_groups();
+        auto cmd = f.command_buffer;
+        std::vector<bool> seen(m_images.size(), false);
+
+        for (uint32_t g = 0; g < groups.size(); ++g) {
+
+            const auto& group = groups[g];
+            record_barriers(cmd, group.barriers, seen);
+
+            if (group.type != render_graph_pass_type::graphics) {
+                const auto& p = passes[group.passes.front()];
+                if (p.record) {
+                    p.record(render_graph_context { f, cmd, VK_NULL_HANDLE, 0, m_extent, *this });
+                }
+                continue;
+            }
+
+            auto extent = m_images[group.attachments.front().image].extent;
+            auto framebuffer = get_framebuffer(g);
+
+            std::vector<VkClearValue> clear_values;
+            clear_values.reserve(group.attachments.size());
+            for (const auto& attachment : group.attachments) {
+                clear_values.push_back(m_graph.get_images()[attachment.image].desc.clear);
+            }
+
+            VkRenderPassBeginInfo begin_info { };
+            begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            begin_info.renderPass = m_render_passes[g];
+            begin_info.framebuffer = framebuffer;
+            begin_info.renderArea = { { 0, 0 }, extent };
+            begin_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
+            begin_info.pClearValues = clear_values.data();
+
+            auto frame = f;
+            frame.framebuffer = framebuffer;
+
+            for (uint32_t s = 0; s < group.passes.size(); ++s) {
+                const auto& p = passes[group.passes[s]];
+                auto contents = p.secondary_command_buffers ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+                if (s == 0) {
+                    vkCmdBeginRenderPass(cmd, &begin_info, contents);
+                }
+                else {
+                    vkCmdNextSubpass(cmd, contents);
+                }
+                if (p.record) {
+                    p.record(render_graph_context { frame, cmd, m_render_passes[g], s, extent, *this });
+                }
+            }
+
+            vkCmdEndRenderPass(cmd);
+        }
+
+        record_barriers(cmd, m_graph.get_final_barriers(), seen);
+        m_undefined_contents = false;
+    }
+
+    void vulkan_render_graph::release_retired() noexcept {
+        for (auto& retired : m_retired) {
+            if (--retired.frames_left == 0) {
+                destroy(retired);
+            }
+        }
+        m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(),
+            [] (const retired_resources& r) { return r.frames_left == 0; }), m_retired.end());
+    }
+
+    VkImage vulkan_render_graph::get_image(render_graph::resource r) const {
+        return m_images.at(r).image;
+    }
+
+    VkImageView vulkan_render_graph::get_view(render_graph::resource r) const {
+        return m_images.at(r).view;
+    }
+
+    VkExtent2D vulkan_render_graph::get_extent(render_graph::resource r) const {
+        return m_images.at(r).extent;
+    }
+
+    VkDeviceSize vulkan_render_graph::get_memory_size() const noexcept {
+        return m_memory_size;
+    }
+
+    const render_graph& vulkan_render_graph::get_graph() const noexcept {
+        return m_graph;
+    }
+
+    result<VkRenderPass, vulkan_error> vulkan_render_graph::create_render_pass(const render_graph_group& group) const {
+
+        const auto& images = m_graph.get_images();
+        const auto& passes = m_graph.get_passes();
+
+        // the graph's barriers transition the layouts, so attachments keep theirs for the whole render pass
+        std::vector<VkAttachmentDescription> attachments;
+        for (const auto& a : group.attachments) {
+            const auto& desc = images[a.image].desc;
+            bool stencil = get_aspect(desc.format) & VK_IMAGE_ASPECT_STENCIL_BIT;
+            VkAttachmentDescription attachment { };
+            attachment.format = desc.format;
+            attachment.samples = desc.samples;
+            attachment.loadOp = a.load;
+            attachment.storeOp = a.store;
+            attachment.stencilLoadOp = stencil ? a.load : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachment.stencilStoreOp = stencil ? a.store : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachment.initialLayout = a.layout;
+            attachment.finalLayout = a.layout;
+            attachments.push_back(attachment);
+        }
+
+        auto attachment_index = [&] (render_graph::resource r) {
+            auto it = std::find_if(group.attachments.begin(), group.attachments.end(),
+                                   [&] (const render_graph_attachment& a) { return a.image == r; });
+            return static_cast<uint32_t>(it - group.attachments.begin());
+        };
+
+        // references have to outlive vkCreateRenderPass
+        std::vector<std::vector<VkAttachmentReference>> color_refs(group.passes.size());
+        std::vector<std::vector<VkAttachmentReference>> resolve_refs(group.passes.size());
+        std::vector<VkAttachmentReference> depth_refs(group.passes.size(), { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED });
+        std::vector<VkSubpassDescription> subpasses(group.passes.size());
+
+        for (std::size_t s = 0; s < group.passes.size(); ++s) {
+
+            const auto& p = passes[group.passes[s]];
+            for (const auto& a : p.accesses) {
+                const auto& info = get_access_info(a.access);
+                if (a.access == render_graph_access::color_attachment) {
+                    color_refs[s].push_back({ attachment_index(a.image), info.layout });
+                }
+                else if (a.access == render_graph_access::depth_attachment || a.access == render_graph_access::depth_read) {
+                    depth_refs[s] = { attachment_index(a.image), info.layout };
+                }
+            }
+
+            // resolve attachments pair up with the color attachments they resolve
+            bool resolves = false;
+            resolve_refs[s].resize(color_refs[s].size(), { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED });
+            for (const auto& a : p.accesses) {
+                if (a.access != render_graph_access::resolve_attachment) {
+                    continue;
+                }
+                auto source = attachment_index(a.resolve_source);
+                auto color = std::find_if(color_refs[s].begin(), color_refs[s].end(),
+                                          [&] (const VkAttachmentReference& r) { return r.attachment == source; });
+                resolve_refs[s][color - color_refs[s].begin()] = { attachment_index(a.image), get_access_info(a.access).layout };
+                resolves = true;
+            }
+
+            auto& subpass = subpasses[s];
+            subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+            subpass.colorAttachmentCount = static_cast<uint32_t>(color_refs[s].size());
+            subpass.pColorAttachments = color_refs[s].data();
+            subpass.pResolveAttachments = resolves ? resolve_refs[s].data() : nullptr;
+            subpass.pDepthStencilAttachment = depth_refs[s].attachment != VK_ATTACHMENT_UNUSED ? &depth_refs[s] : nullptr;
+        }
+
+        // order every subpass after the earlier ones that touch the same attachments
+        std::vector<VkSubpassDependency> dependencies;
+        for (uint32_t dst = 1; dst < group.passes.size(); ++dst) {
+            for (uint32_t src = 0; src < dst; ++src) {
+
+                VkSubpassDependency dependency { };
+                for (const auto& a : passes[group.passes[src]].accesses) {
+                    for (const auto& b : passes[group.passes[dst]].accesses) {
+                        if (a.image != b.image) {
+                            continue;
+                        }
+                        const auto& src_info = get_access_info(a.access);
+                        const auto& dst_info = get_access_info(b.access);
+                        dependency.srcStageMask |= src_info.stages;
+                        dependency.srcAccessMask |= src_info.access & write_access_mask;
+                        dependency.dstStageMask |= dst_info.stages;
+                        dependency.dstAccessMask |= dst_info.access;
+                    }
+                }
+
+                if (dependency.srcStageMask) {
+                    dependency.srcSubpass = src;
+                    dependency.dstSubpass = dst;
+                    dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+                    dependencies.push_back(dependency);
+                }
+            }
+        }
+
+        VkRenderPassCreateInfo create_info { };
+        create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        create_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+        create_info.pAttachments = attachments.data();
+        create_info.subpassCount = static_cast<uint32_t>(subpasses.size());
+        create_info.pSubpasses = subpasses.data();
+        create_info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        create_info.pDependencies = dependencies.data();
+
+        VkRenderPass pass;
+        auto res = vkCreateRenderPass(m_device, &create_info, nullptr, &pass);
+        if (res != VkResult::VK_SUCCESS) {
+            return vulkan_error("Failed to create render graph render pass", res);
+        }
+        return pass;
+    }
+
+    VkExtent2D vulkan_render_graph::get_scaled_extent(const render_graph_image_desc& desc) const noexcept {
+        if (desc.extent.width && desc.extent.height) {
+            return desc.extent;
+        }
+        return {
+            std::max(1u, static_cast<uint32_t>(std::lround(m_extent.width * desc.scale))),
+            std::max(1u, static_cast<uint32_t>(std::lround(m_extent.height * desc.scale)))
+        };
+    }
+
+    void vulkan_render_graph::create_images() {
+
+        const auto& images = m_graph.get_images();
+
+        struct slot {
+            VkMemoryRequirements  requirements { 0, 0, ~0u };
+            std::vector<uint32_t> images;
+            bool                  lazy = false;
+        };
+        std::vector<slot> slots(m_graph.get_alias_slot_count());
+
+        for (uint32_t i = 0; i < images.size(); ++i) {
+
+            const auto& image = images[i];
+            if (image.alias_slot == render_graph::no_alias_slot) {
+                continue;
+            }
+
+            auto& binding = m_images[i];
+            binding.extent = get_scaled_extent(image.desc);
+
+            VkImageCreateInfo image_info { };
+            image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            image_info.imageType = VK_IMAGE_TYPE_2D;
+            image_info.format = image.desc.format;
+            image_info.extent = { binding.extent.width, binding.extent.height, 1 };
+            image_info.mipLevels = 1;
+            image_info.arrayLayers = 1;
+            image_info.samples = image.desc.samples;
+            image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            image_info.usage = image.usage | (image.lazy ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+            image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            auto res = vkCreateImage(m_device, &image_info, nullptr, &binding.image);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error(fmt::format("Failed to create render graph image '{}'", image.name), res);
+            }
+
+            VkMemoryRequirements requirements;
+            vkGetImageMemoryRequirements(m_device, binding.image, &requirements);
+
+            auto& s = slots[image.alias_slot];
+            s.requirements.size = std::max(s.requirements.size, requirements.size);
+            s.requirements.alignment = std::max(s.requirements.alignment, requirements.alignment);
+            s.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+            s.images.push_back(i);
+            s.lazy = image.lazy;
+        }
+
+        auto bind = [&] (uint32_t i, const vulkan_allocation& allocation) {
+            auto res = vkBindImageMemory(m_device, m_images[i].image, allocation.memory, allocation.offset);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to bind render graph image memory", res);
+            }
+        };
+
+        m_memory_size = 0;
+        for (const auto& s : slots) {
+
+            auto usage = s.lazy ? memory_usage::gpu_lazily_allocated : memory_usage::gpu_only;
+
+            // images that can't share a memory type don't alias
+            if (!s.requirements.memoryTypeBits) {
+                SPDLOG_WARN("Render graph images of one alias slot have no memory type in common, allocating them separately.");
+                for (auto i : s.images) {
+                    VkMemoryRequirements requirements;
+                    vkGetImageMemoryRequirements(m_device, m_images[i].image, &requirements);
+                    m_allocations.push_back(m_allocator.allocate(requirements, usage, resource_kind::optimal).or_throw());
+                    m_memory_size += m_allocations.back().size;
+                    bind(i, m_allocations.back());
+                }
+                continue;
+            }
+
+            m_allocations.push_back(m_allocator.allocate(s.requirements, usage, resource_kind::optimal).or_throw());
+            m_memory_size += m_allocations.back().size;
+            for (auto i : s.images) {
+                bind(i, m_allocations.back());
+            }
+        }
+
+        for (uint32_t i = 0; i < images.size(); ++i) {
+
+            auto& binding = m_images[i];
+            if (images[i].import || !binding.image) {
+                continue;
+            }
+
+            VkImageViewCreateInfo view_info { };
+            view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            view_info.image = binding.image;
+            view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            view_info.format = images[i].desc.format;
+            view_info.subresourceRange = { get_aspect(images[i].desc.format), 0, 1, 0, 1 };
+            auto res = vkCreateImageView(m_device, &view_info, nullptr, &binding.view);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error(fmt::format("Failed to create render graph image view '{}'", images[i].name), res);
+            }
+        }
+    }
+
+    VkFramebuffer vulkan_render_graph::get_framebuffer(uint32_t group) {
+
+        const auto& attachments = m_graph.get_groups()[group].attachments;
+
+        framebuffer_key key { group, { } };
+        for (const auto& a : attachments) {
+            auto view = m_images[a.image].view;
+            if (!view) {
+                throw std::invalid_argument(fmt::format("Render graph image '{}' isn't bound.", m_graph.get_images()[a.image].name));
+            }
+            key.second.push_back(view);
+        }
+
+        auto it = m_framebuffers.find(key);
+        if (it != m_framebuffers.end()) {
+            return it->second;
+        }
+
+        auto extent = m_images[attachments.front().image].extent;
+
+        VkFramebufferCreateInfo create_info { };
+        create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        create_info.renderPass = m_render_passes[group];
+        create_info.attachmentCount = static_cast<uint32_t>(key.second.size());
+        create_info.pAttachments = key.second.data();
+        create_info.width = extent.width;
+        create_info.height = extent.height;
+        create_info.layers = 1;
+
+        VkFramebuffer framebuffer;
+        auto res = vkCreateFramebuffer(m_device, &create_info, nullptr, &framebuffer);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to create render graph framebuffer", res);
+        }
+
+        m_framebuffers.emplace(std::move(key), framebuffer);
+        return framebuffer;
+    }
+
+    void vulkan_render_graph::record_barriers(VkCommandBuffer cmd, const std::vector<render_graph_barrier>& barriers,
+                                              std::vector<bool>& seen) const {
+        if (barriers.empty()) {
+            return;
+        }
+
+        const auto& images = m_graph.get_images();
+        VkPipelineStageFlags src_stages = 0;
+        VkPipelineStageFlags dst_stages = 0;
+        std::vector<VkImageMemoryBarrier> image_barriers;
+        image_barriers.reserve(barriers.size());
+
+        for (const auto& b : barriers) {
+
+            const auto& image = images[b.image];
+            if (!m_images[b.image].image) {
+                throw std::invalid_argument(fmt::format("Render graph image '{}' isn't bound.", image.name));
+            }
+
+            // the steady state assumes last frame's layout, which freshly created images don't have yet
+            auto old_layout = b.old_layout;
+            if (m_undefined_contents && image.persistent && !seen[b.image]) {
+                old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            }
+            seen[b.image] = true;
+
+            VkImageMemoryBarrier barrier { };
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = b.src_access;
+            barrier.dstAccessMask = b.dst_access;
+            barrier.oldLayout = old_layout;
+            barrier.newLayout = b.new_layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = m_images[b.image].image;
+            barrier.subresourceRange = { get_aspect(image.desc.format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+            image_barriers.push_back(barrier);
+
+            src_stages |= b.src_stages;
+            dst_stages |= b.dst_stages;
+        }
+
+        // one call per batch
+        vkCmdPipelineBarrier(cmd,
+            src_stages ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            dst_stages ? dst_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, nullptr, 0, nullptr,
+            static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+    }
+
+    void vulkan_render_graph::retire(uint32_t frames) {
+
+        retired_resources retired { { }, std::move(m_allocations), { }, frames };
+        m_allocations.clear();
+        for (const auto& [key, framebuffer] : m_framebuffers) {
+            retired.framebuffers.push_back(framebuffer);
+        }
+        m_framebuffers.clear();
+
+        const auto& images = m_graph.get_images();
+        for (std::size_t i = 0; i < images.size(); ++i) {
+            if (!images[i].import) {
+                retired.images.push_back(m_images[i]);
+                m_images[i] = image_binding { };
+            }
+        }
+
+        if (frames == 0) {
+            destroy(retired);
+        }
+        else {
+            m_retired.push_back(std::move(retired));
+        }
+    }
+
+    void vulkan_render_graph::destroy(retired_resources& resources) noexcept {
+        for (auto framebuffer : resources.framebuffers) {
+            vkDestroyFramebuffer(m_device, framebuffer, nullptr);
+        }
+        for (const auto& image : resources.images) {
+            if (image.view) {
+                vkDestroyImageView(m_device, image.view, nullptr);
+            }
+            if (image.image) {
+                vkDestroyImage(m_device, image.image, nullptr);
+            }
+        }
+        for (auto& allocation : resources.allocations) {
+            m_allocator.free(allocation);
+        }
+        resources = retired_resources { { }, { }, { }, resources.frames_left };
+    }
+}
@@ -0,0 +1,157 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#ifndef BAMBOOENGINE_VULKAN_RENDER_GRAPH_HPP
+#define BAMBOOENGINE_VULKAN_RENDER_GRAPH_HPP
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "vulkan_allocator.hpp"
+#include "vulkan_frame_scheduler.hpp"
+#include "render_graph.hpp"
+#include "../util/macros.hpp"
+
+namespace bbge {
+
+    class vulkan_render_graph;
+
+    /**
+     * @brief What a pass records with.
+     */
+    struct render_graph_context {
+        vulkan_frame_scheduler::frame frame;            // the framebuffer is the one of the pass' render pass
+        VkCommandBuffer               command_buffer;
+        VkRenderPass                  render_pass;      // VK_NULL_HANDLE outside of render passes
+        uint32_t                      subpass;
+        VkExtent2D                    extent;           // of the render pass' framebuffer
+        const vulkan_render_graph&    graph;
+    };
+
+    /**
+     * @brief Vulkan objects of a compiled render_graph.
+     * Creates one render pass per merged group of graphics passes, the images the graph owns and their framebuffers.
+     * Images that share an alias slot are bound to the same memory. Imported images are bound every frame before execute().
+     */
+    class vulkan_render_graph {
+    public:
+
+        struct subpass {
+            VkRenderPass render_pass;
+            uint32_t     index;
+        };
+
+        BBGE_NO_COPIES(vulkan_render_graph);
+        BBGE_NO_MOVES(vulkan_render_graph);
+
+        /**
+         * @brief Compile the graph and create its render passes. The images are created by the first resize().
+         * @param device Device
+         * @param graph Frame graph
+         */
+        vulkan_render_graph(const vulkan_device& device, render_graph&& graph);
+
+        ~vulkan_render_graph();
+
+        /**
+         * @brief Get the render pass and subpass a graphics pass records in, to create pipelines for it.
+         * @param p Graphics pass
+         * @return Render pass and subpass index
+         */
+        [[nodiscard]] subpass get_subpass(render_graph::pass p) const;
+
+        /**
+         * @brief Recreate the images if the extent changed and drop all framebuffers.
+         * Call whenever an imported image is recreated, e.g. with the swap chain.
+         * @param extent Extent that images without an extent of their own scale
+         * @param retire_after_frames Number of frames until the old objects are guaranteed to be unused
+         */
+        void resize(VkExtent2D extent, uint32_t retire_after_frames);
+
+        /**
+         * @brief Bind an imported image for the following execute() calls.
+         * @param r Imported image
+         * @param image Image handle
+         * @param view View of the image, used for framebuffers
+         */
+        void set_image(render_graph::resource r, VkImage image, VkImageView view);
+
+        /**
+         * @brief Record all passes into a frame's command buffer.
+         * @param f Current frame
+         */
+        void execute(const vulkan_frame_scheduler::frame& f);
+
+        /**
+         * @brief Count down retired objects and destroy those that are no longer in use.
+         * Call once per frame after waiting for the frame's fence.
+         */
+        void release_retired() noexcept;
+
+        [[nodiscard]] VkImage get_image(render_graph::resource r) const;
+        [[nodiscard]] VkImageView get_view(render_graph::resource r) const;
+        [[nodiscard]] VkExtent2D get_extent(render_graph::resource r) const;
+
+        /**
+         * @brief Get the memory bound to the images the graph owns.
+         * @return Size in bytes, after aliasing
+         */
+        [[nodiscard]] VkDeviceSize get_memory_size() const noexcept;
+        [[nodiscard]] const render_graph& get_graph() const noexcept;
+
+    private:
+
+        struct image_binding {
+            VkImage     image  = VK_NULL_HANDLE;
+            VkImageView view   = VK_NULL_HANDLE;
+            VkExtent2D  extent = { 0, 0 };
+        };
+
+        using framebuffer_key = std::pair<uint32_t, std::vector<VkImageView>>;
+
+        struct retired_resources {
+            std::vector<image_binding>     images;         // owned images only
+            std::vector<vulkan_allocation> allocations;
+            std::vector<VkFramebuffer>     framebuffers;
+            uint32_t                       frames_left;
+        };
+
+        VkDevice m_device;
+        vulkan_allocator& m_allocator;
+        render_graph m_graph;
+        std::vector<VkRenderPass> m_render_passes;          // per group, VK_NULL_HANDLE unless graphics
+        std::vector<image_binding> m_images;                // per resource
+        std::vector<vulkan_allocation> m_allocations;
+        std::map<framebuffer_key, VkFramebuffer> m_framebuffers;
+        std::vector<retired_resources> m_retired;
+        VkExtent2D m_extent;
+        VkDeviceSize m_memory_size;
+        bool m_undefined_contents;                          // persistent images were just created
+
+        [[nodiscard]] result<VkRenderPass, vulkan_error> create_render_pass(const render_graph_group& group) const;
+        [[nodiscard]] VkExtent2D get_scaled_extent(const render_graph_image_desc& desc) const noexcept;
+        void create_images();
+        [[nodiscard]] VkFramebuffer get_framebuffer(uint32_t group);
+        void record_barriers(VkCommandBuffer cmd, const std::vector<render_graph_barrier>& barriers, std::vector<bool>& seen) const;
+        void retire(uint32_t frames);
+        void destroy(retired_resources& resources) noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_RENDER_GRAPH_HPP
@@ -0,0 +1,64 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <array>
+#include <stdexcept>
+#include "vulkan_capability_cache.hpp"
+#include "vulkan_render_targets.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        // most precise first, stencil is unused
+        constexpr std::array<VkFormat, 4> depth_format_candidates {
+            VK_FORMAT_D32_SFLOAT,
+            VK_FORMAT_D32_SFLOAT_S8_UINT,
+            VK_FORMAT_D24_UNORM_S8_UINT,
+            VK_FORMAT_D16_UNORM
+        };
+    }
+
+    VkSampleCountFlagBits vulkan_render_targets::pick_sample_count(VkPhysicalDevice physical_device,
+                                                                   VkSampleCountFlagBits requested, bool depth) {
+
+        const auto& limits = vulkan_capability_cache::get(physical_device).properties.limits;
+        auto supported = limits.framebufferColorSampleCounts;
+        if (depth) {
+            supported &= limits.framebufferDepthSampleCounts;
+        }
+
+        // sample counts are single bits, so walk down from the requested one
+        for (auto count = static_cast<uint32_t>(requested); count > 1; count >>= 1) {
+            if (supported & count) {
+                return static_cast<VkSampleCountFlagBits>(count);
+            }
+        }
+        return VK_SAMPLE_COUNT_1_BIT;
+    }
+
+    VkFormat vulkan_render_targets::pick_depth_format(VkPhysicalDevice physical_device) {
+        for (auto format : depth_format_candidates) {
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+            if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+                return format;
+            }
+        }
+        throw std::runtime_error("The device doesn't support any depth attachment format.");
+    }
+}
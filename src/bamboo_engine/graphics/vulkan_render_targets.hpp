@@ -0,0 +1,52 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_RENDER_TARGETS_HPP
+#define BAMBOOENGINE_VULKAN_RENDER_TARGETS_HPP
+
+#include <vulkan/vulkan.h>
+
+namespace bbge {
+
+    /**
+     * @brief Picks the sample count and depth format of render targets. The render graph creates the attachments.
+     */
+    class vulkan_render_targets {
+    public:
+
+        vulkan_render_targets() = delete;
+
+        /**
+         * @brief Pick the highest supported sample count up to a requested one.
+         * @param physical_device Device
+         * @param requested Requested sample count
+         * @param depth True if depth attachments have to support the sample count as well
+         * @return Sample count
+         */
+        [[nodiscard]] static VkSampleCountFlagBits pick_sample_count(VkPhysicalDevice physical_device,
+                                                                     VkSampleCountFlagBits requested, bool depth);
+
+        /**
+         * @brief Pick the most precise depth format that can be an optimally tiled attachment.
+         * @param physical_device Device
+         * @return Depth format
+         */
+        [[nodiscard]] static VkFormat pick_depth_format(VkPhysicalDevice physical_device);
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_RENDER_TARGETS_HPP
@@ -0,0 +1,115 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include "vulkan_shader.hpp"
+#include "../util/custom_formatters.hpp"
+#include "../util/mapped_file.hpp"
+
+namespace bbge {
+
+    constexpr std::array<std::string_view, 4> shader_type_names {
+        "fragment", "vertex", "geometry", "compute"
+    };
+
+    std::string_view to_string(shader_type t) {
+        auto v = static_cast<uint8_t>(t);
+        return shader_type_names[v];
+    }
+
+    constexpr std::array<VkShaderStageFlagBits, 4> shader_type_vk_conversion {
+        VK_SHADER_STAGE_FRAGMENT_BIT, VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_GEOMETRY_BIT, VK_SHADER_STAGE_COMPUTE_BIT
+    };
+
+    VkShaderStageFlagBits to_vulkan(shader_type t) {
+        auto v = static_cast<uint8_t>(t);
+        return shader_type_vk_conversion[v];
+    }
+
+    result<VkShaderModule, vulkan_error> create_shader_module(
+        VkDevice dev, gsl::span<const std::byte> spir_v_bytecode, shader_type type, std::string_view pipeline_name) {
+
+        assert(dev);
+        assert(reinterpret_cast<std::uintptr_t>(spir_v_bytecode.data()) % alignof(uint32_t) == 0);
+
+        if (spir_v_bytecode.size() == 0 || spir_v_bytecode.size() % sizeof(uint32_t) != 0) {
+            return vulkan_error(fmt::format("Invalid SPIR-V size for shader module of type '{}' for pipeline '{}'", to_string(type), pipeline_name),
+                                VK_ERROR_UNKNOWN);
+        }
+
+        VkShaderModuleCreateInfo create_info { };
+        create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        create_info.codeSize = spir_v_bytecode.size(); // in bytes
+        create_info.pCode = reinterpret_cast<const uint32_t*>(spir_v_bytecode.data());
+
+        VkShaderModule module = VK_NULL_HANDLE;
+        auto res = vkCreateShaderModule(dev, &create_info, nullptr, &module);
+        if (res != VkResult::VK_SUCCESS) {
+            return vulkan_error(fmt::format("Failed to create shader module of type '{}' for pipeline '{}'", to_string(type), pipeline_name), res);
+        }
+
+        return module;
+    }
+
+    vulkan_shader_module::vulkan_shader_module(
+        VkDevice dev, const std::filesystem::path& p, shader_type type, std::string_view pipeline_name)
+      : m_device(dev), m_type(type), m_module(VK_NULL_HANDLE) {
+
+        // the driver copies the code, so the mapping only has to live until the module exists
+        auto code = mapped_file::open(p);
+        if (!code) {
+            throw vulkan_error(
+                fmt::format("Failed to load shader module code: {}", code.err()->what()),
+                VK_ERROR_UNKNOWN
+            );
+        }
+
+        m_module = create_shader_module(dev, code.ok()->get_contents(), type, pipeline_name).or_throw();
+    }
+
+    vulkan_shader_module::vulkan_shader_module(
+        VkDevice dev, gsl::span<const std::byte> spir_v_bytecode, shader_type type, std::string_view pipeline_name)
+      : m_device(dev), m_type(type), m_module(VK_NULL_HANDLE) {
+
+        m_module = create_shader_module(dev, spir_v_bytecode, type, pipeline_name).or_throw();
+    }
+
+    vulkan_shader_module::~vulkan_shader_module() {
+        if (m_module) {
+            vkDestroyShaderModule(m_device, m_module, nullptr);
+        }
+    }
+
+    VkShaderModule vulkan_shader_module::get_handle() const noexcept {
+        return m_module;
+    }
+
+    shader_type vulkan_shader_module::get_type() const noexcept {
+        return m_type;
+    }
+
+    VkPipelineShaderStageCreateInfo vulkan_shader_module::get_stage_create_info() const noexcept {
+        VkPipelineShaderStageCreateInfo create_info { };
+        create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        create_info.stage = to_vulkan(m_type);
+        create_info.module = m_module;
+        create_info.pName = "main"; // entrypoint
+        return create_info;
+    }
+}
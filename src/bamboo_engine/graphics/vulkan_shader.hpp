@@ -0,0 +1,97 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_SHADER_HPP
+#define BAMBOOENGINE_VULKAN_SHADER_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <gsl/gsl-lite.hpp>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "../util/macros.hpp"
+#include "../util/result.hpp"
+
+namespace bbge {
+
+    enum class shader_type : uint8_t {
+        fragment, vertex, geometry, compute
+    };
+
+    VkShaderStageFlagBits to_vulkan(shader_type t);
+    std::string_view to_string(shader_type t);
+
+    /**
+     * @brief Create a shader module from SPIR-V byte code.
+     * @param dev Device
+     * @param spir_v_bytecode Byte code, 4 byte aligned, e.g. straight from a mapped_file
+     * @param type Stage the module is used for
+     * @param pipeline_name Name of the pipeline the module is created for, only used for error messages
+     * @return The shader module
+     */
+    [[nodiscard]] result<VkShaderModule, vulkan_error> create_shader_module(
+        VkDevice dev, gsl::span<const std::byte> spir_v_bytecode, shader_type type, std::string_view pipeline_name);
+
+    /**
+     * @brief Shader module that only lives until the pipelines using it were created.
+     */
+    class vulkan_shader_module {
+    public:
+
+        BBGE_NO_COPIES(vulkan_shader_module);
+        BBGE_NO_MOVES(vulkan_shader_module);
+
+        /**
+         * @brief Map a SPIR-V binary and create the module from it. Throws a vulkan_error on failure.
+         * @param dev Device
+         * @param p Path to the binary
+         * @param type Stage the module is used for
+         * @param pipeline_name Name of the pipeline the module is created for
+         */
+        vulkan_shader_module(VkDevice dev, const std::filesystem::path& p, shader_type type, std::string_view pipeline_name);
+
+        /**
+         * @brief Create the module from SPIR-V that was loaded already. Throws a vulkan_error on failure.
+         * @param dev Device
+         * @param spir_v_bytecode SPIR-V binary, aligned to 4 bytes
+         * @param type Stage the module is used for
+         * @param pipeline_name Name of the pipeline the module is created for
+         */
+        vulkan_shader_module(VkDevice dev, gsl::span<const std::byte> spir_v_bytecode, shader_type type, std::string_view pipeline_name);
+
+        ~vulkan_shader_module();
+
+        [[nodiscard]] VkShaderModule get_handle() const noexcept;
+        [[nodiscard]] shader_type get_type() const noexcept;
+
+        /**
+         * @brief Make the stage info to put into a pipeline create info.
+         * @return Stage info with entry point "main"
+         */
+        [[nodiscard]] VkPipelineShaderStageCreateInfo get_stage_create_info() const noexcept;
+
+    private:
+
+        VkDevice m_device;
+        shader_type m_type;
+        VkShaderModule m_module;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_SHADER_HPP
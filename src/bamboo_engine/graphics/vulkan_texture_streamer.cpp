@@ -0,0 +1,471 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <fmt/format.h>
+#include "vulkan_texture_streamer.hpp"
+#include "../util/logging.hpp"
+
+namespace bbge {
+
+    vulkan_texture_streamer::vulkan_texture_streamer(
+        const vulkan_device& device, vulkan_upload_service& uploads, vulkan_bindless_set& bindless,
+        const asset_archive& archive, uint32_t frames_in_flight, const texture_streamer_settings& settings)
+      : m_device(device), m_uploads(uploads), m_bindless(bindless), m_archive(archive),
+        m_frames_in_flight(frames_in_flight), m_settings(settings), m_sampler(VK_NULL_HANDLE),
+        m_resident_bytes(0), m_frame_number(0) {
+
+        VkSamplerCreateInfo sampler_info { };
+        sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        sampler_info.magFilter = VK_FILTER_LINEAR;
+        sampler_info.minFilter = VK_FILTER_LINEAR;
+        sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        sampler_info.minLod = 0.0f;
+        sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+        sampler_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        auto res = vkCreateSampler(m_device.get_handle(), &sampler_info, nullptr, &m_sampler);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to create texture streamer sampler", res);
+        }
+
+        SPDLOG_TRACE("Created texture streamer.");
+    }
+
+    vulkan_texture_streamer::~vulkan_texture_streamer() {
+        for (auto& p : m_pending) destroy(p.image);
+        for (auto& r : m_retired) destroy(r.image);
+        for (auto& tex : m_textures) {
+            if (!tex.loaded) continue;
+            if (tex.current.descriptor != invalid_descriptor) {
+                m_bindless.remove_texture(tex.current.descriptor);
+            }
+            destroy(tex.current);
+        }
+        vkDestroySampler(m_device.get_handle(), m_sampler, nullptr);
+        SPDLOG_TRACE("Destroyed texture streamer.");
+    }
+
+    result<vulkan_texture_streamer::texture_handle, std::runtime_error> vulkan_texture_streamer::load(std::string_view name) {
+
+        auto contents = m_archive.get_contents(name);
+        if (contents.is_err()) {
+            return *contents.err();
+        }
+        auto file = texture_file::parse(*contents.ok());
+        if (file.is_err()) {
+            return std::runtime_error(fmt::format("Failed to load texture '{}': {}", name, file.err()->what()));
+        }
+
+        texture tex;
+        tex.file = std::move(*file.ok());
+
+        auto stored = tex.file.get_mip_count();
+        tex.mip_count = can_generate_mips(static_cast<VkFormat>(tex.file.get_format()))
+            ? get_full_mip_count(tex.file.get_width(), tex.file.get_height())
+            : stored;
+
+        // every level is a single upload, leave room in the staging ring for the rest of the frame
+        auto max_level_size = m_uploads.get_staging_size() / 2;
+        while (tex.min_mip + 1 < stored && tex.file.get_mip(tex.min_mip).texels.size() > max_level_size) {
+            ++tex.min_mip;
+        }
+        tex.tail_mip = tex.min_mip;
+        while (tex.tail_mip + 1 < stored) {
+            auto mip = tex.file.get_mip(tex.tail_mip);
+            if (std::max(mip.width, mip.height) <= m_settings.initial_extent) break;
+            ++tex.tail_mip;
+        }
+
+        texture_handle handle;
+        if (!m_free.empty()) {
+            handle = m_free.back();
+            m_free.pop_back();
+            m_textures[handle] = std::move(tex);
+        }
+        else {
+            handle = static_cast<texture_handle>(m_textures.size());
+            m_textures.push_back(std::move(tex));
+        }
+
+        auto& t = m_textures[handle];
+        t.loaded = true;
+        t.last_used = m_frame_number;
+        m_lru.push_front(handle);
+        t.lru = m_lru.begin();
+
+        auto release_slot = [this, &t, handle] {
+            m_lru.erase(t.lru);
+            t = texture { };
+            m_free.push_back(handle);
+        };
+        try {
+            stream(handle, t.tail_mip);
+        }
+        catch (const vulkan_error& e) {
+            release_slot();
+            return std::runtime_error(fmt::format("Failed to create texture '{}': {}", name, e.what()));
+        }
+        catch (...) {
+            release_slot();
+            throw;
+        }
+
+        return handle;
+    }
+
+    void vulkan_texture_streamer::unload(texture_handle handle) {
+
+        assert(handle < m_textures.size() && m_textures[handle].loaded);
+        auto& tex = m_textures[handle];
+
+        for (auto& p : m_pending) {
+            if (p.handle == handle) retire(p.image);
+        }
+        m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(),
+            [handle] (const pending_image& p) { return p.handle == handle; }), m_pending.end());
+
+        retire(tex.current);
+        m_lru.erase(tex.lru);
+        tex = texture { };
+        m_free.push_back(handle);
+    }
+
+    void vulkan_texture_streamer::touch(texture_handle handle) noexcept {
+        assert(handle < m_textures.size() && m_textures[handle].loaded);
+        auto& tex = m_textures[handle];
+        tex.last_used = m_frame_number;
+        m_lru.splice(m_lru.begin(), m_lru, tex.lru);
+    }
+
+    uint32_t vulkan_texture_streamer::get_descriptor(texture_handle handle) const noexcept {
+        assert(handle < m_textures.size());
+        return m_textures[handle].current.descriptor;
+    }
+
+    uint32_t vulkan_texture_streamer::get_resident_mip(texture_handle handle) const noexcept {
+        assert(handle < m_textures.size());
+        return m_textures[handle].current.base_mip;
+    }
+
+    void vulkan_texture_streamer::update(const vulkan_frame_scheduler::frame& f) {
+
+        m_frame_number = f.number;
+
+        VkDeviceSize retiring = 0;
+        for (auto& r : m_retired) {
+            if (--r.frames_left == 0) {
+                destroy(r.image);
+            }
+            else {
+                retiring += r.image.image.get_allocation().size;
+            }
+        }
+        m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(),
+            [] (const retired_image& r) { return r.frames_left == 0; }), m_retired.end());
+
+        if (!m_heap) return;
+
+        auto budget = m_device.get_memory_budget()[*m_heap];
+        auto limit = budget.budget / 100 * m_settings.budget_percent;
+        if (budget.usage > limit) {
+            // memory of evicted images is still counted until frames in flight no longer use them
+            auto excess = budget.usage - limit;
+            if (excess > retiring) {
+                evict(excess - retiring);
+            }
+        }
+        else {
+            refine(limit - budget.usage);
+        }
+    }
+
+    void vulkan_texture_streamer::record(const vulkan_frame_scheduler::frame& f) {
+
+        for (auto& p : m_pending) {
+
+            auto& tex = m_textures[p.handle];
+            tex.pending = false;
+
+            if (tex.mip_count > tex.file.get_mip_count()) {
+                record_mip_generation(f.command_buffer, tex, p.image);
+            }
+
+            auto descriptor = m_bindless.add_texture(p.image.view, m_sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            if (descriptor.is_err()) {
+                SPDLOG_ERROR("Failed to publish streamed texture: {}", descriptor.err()->what());
+                retire(p.image);
+                continue;
+            }
+
+            p.image.descriptor = *descriptor.ok();
+            retire(tex.current);
+            tex.current = std::move(p.image);
+        }
+
+        m_pending.clear();
+    }
+
+    VkDeviceSize vulkan_texture_streamer::get_resident_bytes() const noexcept {
+        return m_resident_bytes;
+    }
+
+    bool vulkan_texture_streamer::can_generate_mips(VkFormat format) const noexcept {
+        constexpr VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT
+            | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(m_device.get_physical_device(), format, &properties);
+        return (properties.optimalTilingFeatures & required) == required;
+    }
+
+    VkDeviceSize vulkan_texture_streamer::estimate_size(const texture& tex, uint32_t base_mip) const noexcept {
+        auto size = get_upload_size(tex, base_mip);
+        // every generated level is a quarter of the one before, together a third of the last stored level
+        if (tex.mip_count > tex.file.get_mip_count()) {
+            size += tex.file.get_mip(tex.file.get_mip_count() - 1).texels.size() / 3;
+        }
+        return size;
+    }
+
+    VkDeviceSize vulkan_texture_streamer::get_upload_size(const texture& tex, uint32_t base_mip) const noexcept {
+        VkDeviceSize size = 0;
+        for (uint32_t level = base_mip; level < tex.file.get_mip_count(); ++level) {
+            size += tex.file.get_mip(level).texels.size();
+        }
+        return size;
+    }
+
+    void vulkan_texture_streamer::stream(texture_handle handle, uint32_t base_mip) {
+
+        auto& tex = m_textures[handle];
+        assert(!tex.pending && base_mip >= tex.min_mip && base_mip < tex.file.get_mip_count());
+
+        auto format = static_cast<VkFormat>(tex.file.get_format());
+        auto stored = tex.file.get_mip_count();
+        bool generate = tex.mip_count > stored;
+
+        VkImageCreateInfo image_info { };
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = format;
+        image_info.extent = { std::max(tex.file.get_width() >> base_mip, 1u), std::max(tex.file.get_height() >> base_mip, 1u), 1 };
+        image_info.mipLevels = tex.mip_count - base_mip;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
+            | (generate ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        residency r;
+        r.base_mip = base_mip;
+        r.image = m_device.get_allocator().create_image(image_info, memory_usage::gpu_only);
+        m_resident_bytes += r.image.get_allocation().size;
+        if (!m_heap) {
+            const auto& properties = m_device.get_allocator().get_memory_properties();
+            m_heap = properties.memoryTypes[r.image.get_allocation().memory_type].heapIndex;
+        }
+
+        VkImageViewCreateInfo view_info { };
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = r.image.get_handle();
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = format;
+        view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, image_info.mipLevels, 0, 1 };
+        auto res = vkCreateImageView(m_device.get_handle(), &view_info, nullptr, &r.view);
+        if (res != VkResult::VK_SUCCESS) {
+            destroy(r);
+            throw vulkan_error("Failed to create streamed texture view", res);
+        }
+
+        // the least detailed stored level is the source of the generated ones
+        uint32_t level = base_mip;
+        try {
+            for (; level < stored; ++level) {
+                auto mip = tex.file.get_mip(level);
+                if (generate && level + 1 == stored) {
+                    m_uploads.upload_image(r.image, mip.texels.data(), mip.texels.size(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                           level - base_mip, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+                }
+                else {
+                    m_uploads.upload_image(r.image, mip.texels.data(), mip.texels.size(),
+                                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, level - base_mip);
+                }
+            }
+        }
+        catch (...) {
+            // recorded copies still reference the image, so it has to outlive their submission
+            if (level == base_mip) {
+                destroy(r);
+            }
+            else {
+                retire(r);
+            }
+            throw;
+        }
+
+        tex.pending = true;
+        m_pending.push_back({ handle, std::move(r) });
+    }
+
+    void vulkan_texture_streamer::refine(VkDeviceSize headroom) {
+
+        VkDeviceSize uploaded = 0;
+        for (auto handle : m_lru) {
+
+            const auto& tex = m_textures[handle];
+            if (tex.last_used + m_settings.refine_frames < m_frame_number) break; // the rest was used even longer ago
+            if (tex.pending || tex.current.base_mip <= tex.min_mip) continue;
+
+            auto base_mip = tex.current.base_mip - 1;
+            auto size = estimate_size(tex, base_mip);
+            auto upload = get_upload_size(tex, base_mip);
+            if (size > headroom) continue;
+            if (uploaded > 0 && uploaded + upload > m_settings.max_upload_bytes) break;
+
+            try {
+                stream(handle, base_mip);
+            }
+            catch (const vulkan_error& e) {
+                SPDLOG_DEBUG("Stopped refining textures: {}", e.what());
+                break;
+            }
+
+            uploaded += upload;
+            headroom -= size;
+        }
+    }
+
+    void vulkan_texture_streamer::evict(VkDeviceSize excess) {
+
+        VkDeviceSize freed = 0;
+        uint32_t count = 0;
+        for (auto it = m_lru.rbegin(); it != m_lru.rend() && freed < excess; ++it) {
+
+            const auto& tex = m_textures[*it];
+            if (tex.last_used + 1 >= m_frame_number) break; // never evict what the previous frame used
+            if (tex.pending || tex.current.base_mip >= tex.tail_mip) continue;
+
+            auto size = tex.current.image.get_allocation().size;
+            auto tail_size = estimate_size(tex, tex.tail_mip);
+
+            try {
+                stream(*it, tex.tail_mip);
+            }
+            catch (const vulkan_error& e) {
+                SPDLOG_WARN("Failed to evict texture: {}", e.what());
+                break;
+            }
+
+            freed += size > tail_size ? size - tail_size : 0;
+            ++count;
+        }
+
+        if (count > 0) {
+            SPDLOG_DEBUG("Evicted {} textures to free {} of {} bytes over budget.", count, freed, excess);
+        }
+    }
+
+    void vulkan_texture_streamer::record_mip_generation(VkCommandBuffer cmd, const texture& tex, const residency& r) const noexcept {
+
+        auto stored_levels = tex.file.get_mip_count() - r.base_mip;
+        auto levels = tex.mip_count - r.base_mip;
+        auto extent = r.image.get_extent();
+
+        auto level_extent = [&extent] (uint32_t level) {
+            return VkOffset3D {
+                static_cast<int32_t>(std::max(extent.width >> level, 1u)),
+                static_cast<int32_t>(std::max(extent.height >> level, 1u)),
+                1
+            };
+        };
+
+        VkImageMemoryBarrier barrier { };
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = r.image.get_handle();
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, stored_levels, levels - stored_levels, 0, 1 };
+
+        // the generated levels have no contents yet
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        barrier.subresourceRange.levelCount = 1;
+        for (uint32_t level = stored_levels; level < levels; ++level) {
+
+            VkImageBlit blit { };
+            blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+            blit.srcOffsets[1] = level_extent(level - 1);
+            blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+            blit.dstOffsets[1] = level_extent(level);
+            vkCmdBlitImage(cmd, r.image.get_handle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           r.image.get_handle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+            // the source is done, the destination is the source of the next level
+            std::array<VkImageMemoryBarrier, 2> barriers { barrier, barrier };
+            barriers[0].subresourceRange.baseMipLevel = level - 1;
+            barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barriers[1].subresourceRange.baseMipLevel = level;
+            barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+        }
+
+        barrier.subresourceRange.baseMipLevel = levels - 1;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    void vulkan_texture_streamer::retire(residency& r) {
+        if (!r.image.get_handle()) return;
+        if (r.descriptor != invalid_descriptor) {
+            m_bindless.remove_texture(r.descriptor);
+            r.descriptor = invalid_descriptor;
+        }
+        m_retired.push_back({ std::move(r), m_frames_in_flight });
+        r = residency { };
+    }
+
+    void vulkan_texture_streamer::destroy(residency& r) noexcept {
+        if (r.view) {
+            vkDestroyImageView(m_device.get_handle(), r.view, nullptr);
+        }
+        m_resident_bytes -= r.image.get_allocation().size;
+        r = residency { };
+    }
+}
@@ -0,0 +1,200 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_TEXTURE_STREAMER_HPP
+#define BAMBOOENGINE_VULKAN_TEXTURE_STREAMER_HPP
+
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "vulkan_allocator.hpp"
+#include "vulkan_bindless_set.hpp"
+#include "vulkan_frame_scheduler.hpp"
+#include "vulkan_upload_service.hpp"
+#include "../util/asset_archive.hpp"
+#include "../util/macros.hpp"
+#include "../util/result.hpp"
+#include "../util/texture_file.hpp"
+
+namespace bbge {
+
+    struct texture_streamer_settings {
+        uint32_t     initial_extent     = 64;                   // textures load with their least detailed stored level up to this size
+        VkDeviceSize max_upload_bytes   = VkDeviceSize(8) << 20; // per frame, for refining textures
+        uint32_t     budget_percent     = 90;                   // of the device local heap's budget the device may use
+        uint64_t     refine_frames      = 60;                   // textures not touched within this many frames aren't refined
+    };
+
+    /**
+     * @brief Streams textures from an asset archive into bindless descriptors.
+     * A texture loads its least detailed stored mip levels right away and is refined one level per step while it is used
+     * and the device local heap has room under its VK_EXT_memory_budget budget. Levels the file doesn't store are generated
+     * with vkCmdBlitImage. Over budget, the least recently used textures drop back to their initial levels.
+     * Every change of residency creates a new image, so shaders always see a complete mip chain,
+     * and get_descriptor() may return a different index after every record().
+     * Not thread safe.
+     */
+    class vulkan_texture_streamer {
+    public:
+
+        using texture_handle = uint32_t;
+
+        static constexpr const uint32_t invalid_descriptor = std::numeric_limits<uint32_t>::max();
+
+        BBGE_NO_COPIES(vulkan_texture_streamer);
+        BBGE_NO_MOVES(vulkan_texture_streamer);
+
+        /**
+         * @brief Create the streamer and its sampler.
+         * @param device Device
+         * @param uploads Upload service the texels are copied with
+         * @param bindless Bindless set the textures are published in
+         * @param archive Archive the textures are read from, has to outlive the streamer
+         * @param frames_in_flight Frames in flight of the frame scheduler
+         * @param settings Streaming settings
+         */
+        vulkan_texture_streamer(const vulkan_device& device, vulkan_upload_service& uploads, vulkan_bindless_set& bindless,
+                                const asset_archive& archive, uint32_t frames_in_flight,
+                                const texture_streamer_settings& settings = { });
+
+        /**
+         * @brief Destroys all images. The caller has to ensure the GPU no longer uses them.
+         */
+        ~vulkan_texture_streamer();
+
+        /**
+         * @brief Load a texture at its initial resolution. Call before the upload service's flush.
+         * @param name Name of the texture file in the archive
+         * @return Handle or an error if the texture is missing, malformed or can't be created
+         */
+        [[nodiscard]] result<texture_handle, std::runtime_error> load(std::string_view name);
+
+        /**
+         * @brief Destroy a texture once frames in flight no longer use it.
+         * @param handle Texture
+         */
+        void unload(texture_handle handle);
+
+        /**
+         * @brief Mark a texture as used by the current frame. Keeps it from being evicted and lets it be refined.
+         * @param handle Texture
+         */
+        void touch(texture_handle handle) noexcept;
+
+        /**
+         * @brief Get the texture's index in the bindless set.
+         * @param handle Texture
+         * @return Index or invalid_descriptor before the texture was first published by record()
+         */
+        [[nodiscard]] uint32_t get_descriptor(texture_handle handle) const noexcept;
+
+        /**
+         * @brief Get the most detailed mip level that is resident.
+         * @param handle Texture
+         * @return Level of the texture, 0 if it is fully resident
+         */
+        [[nodiscard]] uint32_t get_resident_mip(texture_handle handle) const noexcept;
+
+        /**
+         * @brief Destroy retired images, then refine or evict textures under the memory budget.
+         * Call after the frame scheduler waited for the frame's slot and before the upload service's flush.
+         * @param f Current frame
+         */
+        void update(const vulkan_frame_scheduler::frame& f);
+
+        /**
+         * @brief Generate the mip levels of this frame's new images and publish them.
+         * Call after the upload service's flush, outside a render pass and before the frame reads the descriptors.
+         * @param f Current frame
+         */
+        void record(const vulkan_frame_scheduler::frame& f);
+
+        /**
+         * @brief Get the memory of all images, including ones that wait to be destroyed.
+         * @return Size in bytes
+         */
+        [[nodiscard]] VkDeviceSize get_resident_bytes() const noexcept;
+
+    private:
+
+        // one image of a texture, level 0 of the image is level base_mip of the texture
+        struct residency {
+            vulkan_image image;
+            VkImageView  view       = VK_NULL_HANDLE;
+            uint32_t     base_mip   = 0;
+            uint32_t     descriptor = invalid_descriptor;
+        };
+
+        struct texture {
+            texture_file file;
+            uint32_t     mip_count  = 0;     // full chain if the format can be blitted, otherwise the stored levels
+            uint32_t     min_mip    = 0;     // most detailed level that fits the staging ring
+            uint32_t     tail_mip   = 0;     // least detailed level that is streamed, the initial one
+            residency    current;
+            bool         pending    = false; // a new image is published by the next record()
+            bool         loaded     = false;
+            uint64_t     last_used  = 0;
+            std::list<texture_handle>::iterator lru;
+        };
+
+        struct pending_image {
+            texture_handle handle;
+            residency      image;
+        };
+
+        struct retired_image {
+            residency image;
+            uint32_t  frames_left;
+        };
+
+        const vulkan_device& m_device;
+        vulkan_upload_service& m_uploads;
+        vulkan_bindless_set& m_bindless;
+        const asset_archive& m_archive;
+        uint32_t m_frames_in_flight;
+        texture_streamer_settings m_settings;
+        VkSampler m_sampler;
+
+        std::vector<texture> m_textures;
+        std::vector<texture_handle> m_free;
+        std::list<texture_handle> m_lru;        // most recently used first
+        std::vector<pending_image> m_pending;
+        std::vector<retired_image> m_retired;
+        std::optional<uint32_t> m_heap;         // heap the images are allocated from, known after the first one
+        VkDeviceSize m_resident_bytes;
+        uint64_t m_frame_number;
+
+        [[nodiscard]] bool can_generate_mips(VkFormat format) const noexcept;
+        [[nodiscard]] VkDeviceSize estimate_size(const texture& tex, uint32_t base_mip) const noexcept;
+        [[nodiscard]] VkDeviceSize get_upload_size(const texture& tex, uint32_t base_mip) const noexcept;
+        void stream(texture_handle handle, uint32_t base_mip);
+        void refine(VkDeviceSize headroom);
+        void evict(VkDeviceSize excess);
+        void record_mip_generation(VkCommandBuffer cmd, const texture& tex, const residency& r) const noexcept;
+        void retire(residency& r);
+        void destroy(residency& r) noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_TEXTURE_STREAMER_HPP
@@ -0,0 +1,209 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <fmt/format.h>
+#include "vulkan_capability_cache.hpp"
+#include "vulkan_uniform_ring.hpp"
+#include "../util/logging.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) noexcept {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        VkDeviceSize get_offset_alignment(const VkPhysicalDeviceLimits& limits) noexcept {
+            return std::max({ VkDeviceSize(16), limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment });
+        }
+
+        VkDeviceSize get_buffer_size(VkDeviceSize frame_size, uint32_t frames_in_flight, VkDeviceSize max_range) noexcept {
+            // the descriptor ranges are fixed, pad the end so the last allocation's window stays inside the buffer
+            return frame_size * frames_in_flight + max_range;
+        }
+    }
+
+    vulkan_uniform_ring::vulkan_uniform_ring(const vulkan_device& device, uint32_t frames_in_flight, VkDeviceSize frame_size,
+                                             VkDeviceSize uniform_range, VkDeviceSize storage_range)
+      : m_device(device.get_handle()),
+        m_alignment(get_offset_alignment(vulkan_capability_cache::get(device.get_physical_device()).properties.limits)),
+        m_begin(0), m_head(0), m_set_layout(VK_NULL_HANDLE), m_pool(VK_NULL_HANDLE), m_set(VK_NULL_HANDLE) {
+
+        const auto& limits = vulkan_capability_cache::get(device.get_physical_device()).properties.limits;
+
+        m_frame_size = align_up(frame_size, m_alignment);
+        m_uniform_range = std::min<VkDeviceSize>(uniform_range, limits.maxUniformBufferRange);
+        m_storage_range = std::min<VkDeviceSize>(storage_range, limits.maxStorageBufferRange);
+        if (m_uniform_range < uniform_range) {
+            SPDLOG_WARN("Uniform ring range of {} bytes exceeds the device limit, using {} bytes.", uniform_range, m_uniform_range);
+        }
+        if (m_storage_range < storage_range) {
+            SPDLOG_WARN("Uniform ring storage range of {} bytes exceeds the device limit, using {} bytes.", storage_range, m_storage_range);
+        }
+
+        auto buffer_size = get_buffer_size(m_frame_size, frames_in_flight, std::max(m_uniform_range, m_storage_range));
+        if (buffer_size > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("Uniform ring is too large for 32 bit dynamic offsets.");
+        }
+
+        m_buffer = device.get_allocator().create_buffer(
+            buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, memory_usage::cpu_to_gpu
+        );
+        if (!m_buffer.get_mapped()) {
+            throw std::runtime_error("Uniform ring memory is not host visible.");
+        }
+        m_head = 0;
+        m_begin = 0;
+
+        try {
+            constexpr VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+            std::array<VkDescriptorSetLayoutBinding, 2> bindings { };
+            bindings[0].binding = uniform_binding;
+            bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            bindings[0].descriptorCount = 1;
+            bindings[0].stageFlags = stages;
+            bindings[1].binding = storage_binding;
+            bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            bindings[1].descriptorCount = 1;
+            bindings[1].stageFlags = stages;
+
+            VkDescriptorSetLayoutCreateInfo layout_info { };
+            layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+            layout_info.pBindings = bindings.data();
+            auto res = vkCreateDescriptorSetLayout(m_device, &layout_info, nullptr, &m_set_layout);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to create uniform ring descriptor set layout", res);
+            }
+
+            std::array<VkDescriptorPoolSize, 2> pool_sizes {{
+                { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+                { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 }
+            }};
+            VkDescriptorPoolCreateInfo pool_info { };
+            pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            pool_info.maxSets = 1;
+            pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+            pool_info.pPoolSizes = pool_sizes.data();
+            res = vkCreateDescriptorPool(m_device, &pool_info, nullptr, &m_pool);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to create uniform ring descriptor pool", res);
+            }
+
+            VkDescriptorSetAllocateInfo alloc_info { };
+            alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            alloc_info.descriptorPool = m_pool;
+            alloc_info.descriptorSetCount = 1;
+            alloc_info.pSetLayouts = &m_set_layout;
+            res = vkAllocateDescriptorSets(m_device, &alloc_info, &m_set);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to allocate uniform ring descriptor set", res);
+            }
+
+            // both bindings view the buffer from its start, the dynamic offsets select the allocation
+            std::array<VkDescriptorBufferInfo, 2> buffer_infos {{
+                { m_buffer.get_handle(), 0, m_uniform_range },
+                { m_buffer.get_handle(), 0, m_storage_range }
+            }};
+            std::array<VkWriteDescriptorSet, 2> writes { };
+            for (uint32_t i = 0; i < writes.size(); ++i) {
+                writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[i].dstSet = m_set;
+                writes[i].dstBinding = bindings[i].binding;
+                writes[i].descriptorCount = 1;
+                writes[i].descriptorType = bindings[i].descriptorType;
+                writes[i].pBufferInfo = &buffer_infos[i];
+            }
+            vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        }
+        catch (...) {
+            destroy();
+            throw;
+        }
+
+        SPDLOG_TRACE("Created uniform ring with {} frames of {} bytes (alignment={}).", frames_in_flight, m_frame_size, m_alignment);
+    }
+
+    vulkan_uniform_ring::~vulkan_uniform_ring() {
+        destroy();
+        SPDLOG_TRACE("Destroyed uniform ring.");
+    }
+
+    void vulkan_uniform_ring::begin_frame(const vulkan_frame_scheduler::frame& f) noexcept {
+        m_begin = f.slot * m_frame_size;
+        m_head = m_begin;
+    }
+
+    result<vulkan_uniform_ring::allocation, std::runtime_error> vulkan_uniform_ring::allocate_uniform(VkDeviceSize size) {
+        return allocate(size, m_uniform_range);
+    }
+
+    result<vulkan_uniform_ring::allocation, std::runtime_error> vulkan_uniform_ring::allocate_storage(VkDeviceSize size) {
+        return allocate(size, m_storage_range);
+    }
+
+    result<vulkan_uniform_ring::allocation, std::runtime_error> vulkan_uniform_ring::allocate(VkDeviceSize size, VkDeviceSize range) {
+
+        if (size > range) {
+            return std::runtime_error(fmt::format("Uniform ring allocation of {} bytes exceeds the descriptor range of {} bytes.", size, range));
+        }
+
+        auto offset = align_up(m_head, m_alignment);
+        if (offset + size > m_begin + m_frame_size) {
+            return std::runtime_error(fmt::format("Uniform ring frame of {} bytes is full.", m_frame_size));
+        }
+        m_head = offset + size;
+
+        return allocation { m_buffer.get_mapped() + offset, static_cast<uint32_t>(offset) };
+    }
+
+    void vulkan_uniform_ring::bind(VkCommandBuffer cmd, VkPipelineBindPoint bind_point, VkPipelineLayout layout, uint32_t set,
+                                   uint32_t uniform_offset, uint32_t storage_offset) const noexcept {
+        // dynamic offsets are ordered by binding number
+        std::array<uint32_t, 2> offsets { uniform_offset, storage_offset };
+        vkCmdBindDescriptorSets(cmd, bind_point, layout, set, 1, &m_set, static_cast<uint32_t>(offsets.size()), offsets.data());
+    }
+
+    VkDescriptorSetLayout vulkan_uniform_ring::get_set_layout() const noexcept {
+        return m_set_layout;
+    }
+
+    VkDeviceSize vulkan_uniform_ring::get_alignment() const noexcept {
+        return m_alignment;
+    }
+
+    VkDeviceSize vulkan_uniform_ring::get_used() const noexcept {
+        return m_head - m_begin;
+    }
+
+    void vulkan_uniform_ring::destroy() noexcept {
+        // the set is freed with its pool, the buffer by its destructor
+        if (m_pool) {
+            vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+            m_pool = VK_NULL_HANDLE;
+        }
+        if (m_set_layout) {
+            vkDestroyDescriptorSetLayout(m_device, m_set_layout, nullptr);
+            m_set_layout = VK_NULL_HANDLE;
+        }
+    }
+}
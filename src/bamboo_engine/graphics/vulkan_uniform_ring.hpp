@@ -0,0 +1,164 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_UNIFORM_RING_HPP
+#define BAMBOOENGINE_VULKAN_UNIFORM_RING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "vulkan_allocator.hpp"
+#include "vulkan_frame_scheduler.hpp"
+#include "../util/macros.hpp"
+#include "../util/result.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Linear allocator for per frame uniform and storage data in one persistently mapped buffer.
+     * Every frame in flight owns a region that is reset when the frame begins, so allocating is a pointer bump.
+     * Allocations are addressed with dynamic offsets into one descriptor set, so thousands of draws share
+     * a buffer and a set: binding 0 is a dynamic uniform buffer, binding 1 a dynamic storage buffer.
+     * Not thread safe.
+     */
+    class vulkan_uniform_ring {
+    public:
+
+        static constexpr const uint32_t uniform_binding = 0;
+        static constexpr const uint32_t storage_binding = 1;
+
+        static constexpr const VkDeviceSize default_frame_size = VkDeviceSize(4) << 20;
+        static constexpr const VkDeviceSize default_uniform_range = VkDeviceSize(64) << 10;
+        static constexpr const VkDeviceSize default_storage_range = VkDeviceSize(1) << 20;
+
+        /**
+         * @brief Memory for one allocation. Write it before the frame is submitted.
+         */
+        struct allocation {
+            std::byte*   data;   // mapped memory
+            uint32_t     offset; // dynamic offset to bind the set with
+        };
+
+        BBGE_NO_COPIES(vulkan_uniform_ring);
+        BBGE_NO_MOVES(vulkan_uniform_ring);
+
+        /**
+         * @brief Create the buffer and the descriptor set.
+         * @param device Device
+         * @param frames_in_flight Frames in flight of the frame scheduler
+         * @param frame_size Bytes available to every frame
+         * @param uniform_range Size of the uniform buffer descriptor, the maximum size of a uniform allocation.
+         * Clamped to maxUniformBufferRange.
+         * @param storage_range Size of the storage buffer descriptor, the maximum size of a storage allocation
+         */
+        vulkan_uniform_ring(const vulkan_device& device, uint32_t frames_in_flight,
+                            VkDeviceSize frame_size = default_frame_size,
+                            VkDeviceSize uniform_range = default_uniform_range,
+                            VkDeviceSize storage_range = default_storage_range);
+
+        ~vulkan_uniform_ring();
+
+        /**
+         * @brief Reset the frame's region. Call after the frame scheduler waited for the frame's slot.
+         * @param f Current frame
+         */
+        void begin_frame(const vulkan_frame_scheduler::frame& f) noexcept;
+
+        /**
+         * @brief Allocate data read through the uniform binding.
+         * @param size Size in bytes, at most the uniform range
+         * @return Allocation or an error if the frame's region is full
+         */
+        [[nodiscard]] result<allocation, std::runtime_error> allocate_uniform(VkDeviceSize size);
+
+        /**
+         * @brief Allocate data read through the storage binding.
+         * @param size Size in bytes, at most the storage range
+         * @return Allocation or an error if the frame's region is full
+         */
+        [[nodiscard]] result<allocation, std::runtime_error> allocate_storage(VkDeviceSize size);
+
+        /**
+         * @brief Copy a value into a uniform allocation.
+         * @tparam T Trivially copyable type laid out like the shader's uniform block
+         * @param value Value
+         * @return Dynamic offset of the uniform binding or an error if the frame's region is full
+         */
+        template <typename T>
+        [[nodiscard]] result<uint32_t, std::runtime_error> push_uniform(const T& value);
+
+        /**
+         * @brief Bind the set with the dynamic offsets of one uniform and one storage allocation.
+         * @param cmd Command buffer
+         * @param bind_point Graphics or compute
+         * @param layout Pipeline layout with get_set_layout() at the set index
+         * @param set Set index
+         * @param uniform_offset Dynamic offset of the uniform binding
+         * @param storage_offset Dynamic offset of the storage binding
+         */
+        void bind(VkCommandBuffer cmd, VkPipelineBindPoint bind_point, VkPipelineLayout layout, uint32_t set,
+                  uint32_t uniform_offset, uint32_t storage_offset = 0) const noexcept;
+
+        [[nodiscard]] VkDescriptorSetLayout get_set_layout() const noexcept;
+
+        /**
+         * @brief Get the alignment of all allocations.
+         * @return The larger of the uniform and storage buffer offset alignments
+         */
+        [[nodiscard]] VkDeviceSize get_alignment() const noexcept;
+
+        /**
+         * @brief Get the bytes allocated in the current frame, including padding.
+         * @return Used bytes of the current frame's region
+         */
+        [[nodiscard]] VkDeviceSize get_used() const noexcept;
+
+    private:
+
+        VkDevice m_device;
+        VkDeviceSize m_frame_size;
+        VkDeviceSize m_uniform_range;
+        VkDeviceSize m_storage_range;
+        VkDeviceSize m_alignment;
+        vulkan_buffer m_buffer;
+        VkDeviceSize m_begin;   // region of the current frame
+        VkDeviceSize m_head;
+        VkDescriptorSetLayout m_set_layout;
+        VkDescriptorPool m_pool;
+        VkDescriptorSet m_set;
+
+        [[nodiscard]] result<allocation, std::runtime_error> allocate(VkDeviceSize size, VkDeviceSize range);
+        void destroy() noexcept;
+    };
+
+    template <typename T>
+    result<uint32_t, std::runtime_error> vulkan_uniform_ring::push_uniform(const T& value) {
+
+        static_assert(std::is_trivially_copyable_v<T>, "Uniform data is copied bytewise.");
+
+        auto a = allocate_uniform(sizeof(T));
+        if (a.is_err()) return *a.err();
+        std::memcpy(a.ok()->data, &value, sizeof(T));
+        return a.ok()->offset;
+    }
+}
+
+#endif //BAMBOOENGINE_VULKAN_UNIFORM_RING_HPP
@@ -0,0 +1,489 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <fmt/format.h>
+#include "vulkan_upload_service.hpp"
+#include "vulkan_format.hpp"
+#include "vulkan_utils.hpp"
+#include "../util/hot_log.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        // image copies can need alignments that aren't powers of two, like 12 for 3 component floats
+        VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) noexcept {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        // buffer copies have no alignment requirement, 16 keeps the memcpy into the ring fast
+        constexpr const VkDeviceSize buffer_copy_alignment = 16;
+    }
+
+    vulkan_upload_service::vulkan_upload_service(
+        const vulkan_device& device, uint32_t frames_in_flight, VkDeviceSize staging_size)
+      : m_device(device.get_handle()), m_transfer_queue(device.get_queues().transfer),
+        m_transfer_queue_mutex(device.get_queue_mutex(m_transfer_queue)),
+        m_transfer_family(device.get_queue_family_indices().transfer),
+        m_graphics_family(device.get_queue_family_indices().graphics),
+        m_transfer_ownership(m_transfer_family != m_graphics_family), m_optimal_copy_alignment(1),
+        m_staging(device.get_allocator().create_buffer(staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, memory_usage::cpu_to_gpu)),
+        m_capacity(staging_size), m_head(0), m_tail(0), m_in_use(0), m_next_batch(0),
+        m_submitted_since_flush(false), m_acquire_stages(0) {
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device.get_physical_device(), &properties);
+        m_optimal_copy_alignment = std::max<VkDeviceSize>(properties.limits.optimalBufferCopyOffsetAlignment, 1);
+
+        try {
+            for (uint32_t i = 0; i < batch_count; ++i) {
+                m_batches.push_back(create_batch());
+            }
+
+            VkSemaphoreCreateInfo semaphore_info { };
+            semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            for (uint32_t i = 0; i < frames_in_flight; ++i) {
+                VkSemaphore semaphore;
+                auto res = vkCreateSemaphore(m_device, &semaphore_info, nullptr, &semaphore);
+                if (res != VkResult::VK_SUCCESS) {
+                    throw vulkan_error("Failed to create upload semaphore", res);
+                }
+                m_semaphores.push_back(semaphore);
+            }
+        }
+        catch (...) {
+            for (auto& b : m_batches) destroy_batch(b);
+            for (auto semaphore : m_semaphores) vkDestroySemaphore(m_device, semaphore, nullptr);
+            throw;
+        }
+
+        SPDLOG_TRACE("Created Vulkan upload service (staging={} bytes, ownership transfer={}).",
+                     m_capacity, m_transfer_ownership);
+    }
+
+    vulkan_upload_service::~vulkan_upload_service() {
+
+        if (has_pending()) {
+            SPDLOG_WARN("Destroying upload service with uploads that were never flushed.");
+        }
+
+        // flush submissions without a fence signal semaphores, so a fence wait is not enough
+        VkResult res;
+        {
+            std::lock_guard lock(m_transfer_queue_mutex);
+            res = vkQueueWaitIdle(m_transfer_queue);
+        }
+        if (res != VkResult::VK_SUCCESS) {
+            SPDLOG_ERROR("Failed to wait for pending uploads (err={}).", vulkan_utils::to_string(res));
+        }
+
+        for (auto& b : m_batches) destroy_batch(b);
+        for (auto semaphore : m_semaphores) vkDestroySemaphore(m_device, semaphore, nullptr);
+        SPDLOG_TRACE("Destroyed Vulkan upload service.");
+    }
+
+    void vulkan_upload_service::upload_buffer(
+        const vulkan_buffer& dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size,
+        VkPipelineStageFlags dst_stages, VkAccessFlags dst_access) {
+
+        assert(dst.get_handle());
+        assert(dst_offset + size <= dst.get_size());
+
+        // chunks of half the ring let the next chunk be written while the previous one is copied
+        const auto max_chunk = m_capacity / 2;
+        const auto* src = static_cast<const std::byte*>(data);
+
+        while (size > 0) {
+            auto chunk = std::min(size, max_chunk);
+            auto staging_offset = allocate_staging(chunk, buffer_copy_alignment);
+            std::memcpy(m_staging.get_mapped() + staging_offset, src, chunk);
+
+            auto cmd = get_recording_command_buffer();
+
+            VkBufferCopy region { };
+            region.srcOffset = staging_offset;
+            region.dstOffset = dst_offset;
+            region.size = chunk;
+            vkCmdCopyBuffer(cmd, m_staging.get_handle(), dst.get_handle(), 1, &region);
+
+            if (m_transfer_ownership) {
+                VkBufferMemoryBarrier barrier { };
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = 0;
+                barrier.srcQueueFamilyIndex = m_transfer_family;
+                barrier.dstQueueFamilyIndex = m_graphics_family;
+                barrier.buffer = dst.get_handle();
+                barrier.offset = dst_offset;
+                barrier.size = chunk;
+                vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                     0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+                // the acquire has to match the release
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = dst_access;
+                m_buffer_acquires.push_back(barrier);
+            }
+
+            m_acquire_stages |= dst_stages;
+            src += chunk;
+            dst_offset += chunk;
+            size -= chunk;
+        }
+    }
+
+    void vulkan_upload_service::upload_image(
+        const vulkan_image& dst, const void* data, VkDeviceSize size, VkImageLayout final_layout,
+        uint32_t mip_level, VkPipelineStageFlags dst_stages, VkAccessFlags dst_access) {
+
+        assert(dst.get_handle());
+        assert(mip_level < dst.get_mip_levels());
+
+        if (size > m_capacity) {
+            throw std::length_error("Image upload does not fit into the staging ring.");
+        }
+
+        // bufferOffset has to be a multiple of the texel or block size and of 4
+        auto block = get_format_block(dst.get_format());
+        if (!block) {
+            throw std::invalid_argument(fmt::format("Images of format {} can't be uploaded.", static_cast<uint32_t>(dst.get_format())));
+        }
+        auto alignment = std::lcm(std::lcm<VkDeviceSize>(block->size, 4), m_optimal_copy_alignment);
+
+        auto staging_offset = allocate_staging(size, alignment);
+        std::memcpy(m_staging.get_mapped() + staging_offset, data, size);
+
+        auto cmd = get_recording_command_buffer();
+
+        VkImageSubresourceRange range { };
+        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        range.baseMipLevel = mip_level;
+        range.levelCount = 1;
+        range.baseArrayLayer = 0;
+        range.layerCount = 1;
+
+        // the old contents are discarded
+        VkImageMemoryBarrier barrier { };
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = dst.get_handle();
+        barrier.subresourceRange = range;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        auto extent = dst.get_extent();
+        VkBufferImageCopy region { };
+        region.bufferOffset = staging_offset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = mip_level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = {
+            std::max(extent.width >> mip_level, 1u),
+            std::max(extent.height >> mip_level, 1u),
+            std::max(extent.depth >> mip_level, 1u)
+        };
+        vkCmdCopyBufferToImage(cmd, m_staging.get_handle(), dst.get_handle(),
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        // transition to the final layout, which doubles as the release if the families differ
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = final_layout;
+        if (m_transfer_ownership) {
+            barrier.srcQueueFamilyIndex = m_transfer_family;
+            barrier.dstQueueFamilyIndex = m_graphics_family;
+        }
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        if (m_transfer_ownership) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = dst_access;
+            m_image_acquires.push_back(barrier);
+        }
+
+        m_acquire_stages |= dst_stages;
+    }
+
+    std::optional<vulkan_frame_scheduler::wait_semaphore> vulkan_upload_service::flush(const vulkan_frame_scheduler::frame& f) {
+
+        if (!has_pending()) {
+            return { };
+        }
+
+        // The slot's previous frame has finished, so the semaphore's last wait has completed.
+        // The signal also covers batches that were submitted early, they ran before on the same queue.
+        assert(f.slot < m_semaphores.size());
+        auto semaphore = m_semaphores[f.slot];
+        submit(semaphore);
+
+        auto stages = m_acquire_stages;
+        if (!m_buffer_acquires.empty() || !m_image_acquires.empty()) {
+            vkCmdPipelineBarrier(
+                f.command_buffer, stages, stages, 0, 0, nullptr,
+                m_buffer_acquires.size(), m_buffer_acquires.data(),
+                m_image_acquires.size(), m_image_acquires.data()
+            );
+        }
+
+        m_buffer_acquires.clear();
+        m_image_acquires.clear();
+        m_acquire_stages = 0;
+        m_submitted_since_flush = false;
+
+        return vulkan_frame_scheduler::wait_semaphore { semaphore, stages };
+    }
+
+    bool vulkan_upload_service::has_pending() const noexcept {
+        return m_recording.has_value() || m_submitted_since_flush;
+    }
+
+    VkDeviceSize vulkan_upload_service::get_staging_size() const noexcept {
+        return m_capacity;
+    }
+
+    VkCommandBuffer vulkan_upload_service::get_recording_command_buffer() {
+
+        if (m_recording) {
+            return m_batches[*m_recording].command_buffer;
+        }
+
+        // batches are reused round robin, so the oldest submission is the one to wait for
+        auto index = m_next_batch;
+        while (std::find(m_in_flight.begin(), m_in_flight.end(), index) != m_in_flight.end()) {
+            retire_oldest();
+        }
+
+        auto& b = m_batches[index];
+        auto res = vkResetCommandPool(m_device, b.command_pool, 0);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to reset upload command pool", res);
+        }
+
+        VkCommandBufferBeginInfo begin_info { };
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        res = vkBeginCommandBuffer(b.command_buffer, &begin_info);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to begin upload command buffer", res);
+        }
+
+        b.staging_bytes = 0;
+        b.staging_end = m_head;
+        m_recording = index;
+        m_next_batch = (index + 1) % m_batches.size();
+        return b.command_buffer;
+    }
+
+    VkDeviceSize vulkan_upload_service::allocate_staging(VkDeviceSize size, VkDeviceSize alignment) {
+
+        assert(size > 0 && size <= m_capacity);
+
+        retire_completed();
+
+        while (true) {
+            auto in_use_before = m_in_use;
+            if (auto offset = try_allocate_staging(size, alignment)) {
+                // account the range to the batch that is going to copy from it
+                auto consumed = m_in_use - in_use_before;
+                (void) get_recording_command_buffer();
+                auto& b = m_batches[*m_recording];
+                b.staging_bytes += consumed;
+                b.staging_end = m_head;
+                return *offset;
+            }
+
+            if (!m_in_flight.empty()) {
+                retire_oldest();
+            }
+            else if (m_recording) {
+                // the ring is full of this batch's own copies
+                BBGE_HOT_DEBUG("Staging ring is full, submitting uploads early.");
+                submit(VK_NULL_HANDLE);
+            }
+            else {
+                throw std::logic_error("Staging ring is full without pending uploads.");
+            }
+        }
+    }
+
+    std::optional<VkDeviceSize> vulkan_upload_service::try_allocate_staging(VkDeviceSize size, VkDeviceSize alignment) noexcept {
+
+        if (m_in_use == 0) {
+            m_head = m_tail = 0;
+        }
+
+        auto offset = align_up(m_head, alignment);
+        VkDeviceSize end;
+
+        if (m_in_use == 0 || m_head > m_tail) {
+            // free space at the end and in front of the tail
+            if (offset + size <= m_capacity) {
+                end = offset + size;
+            }
+            else if (size <= m_tail) {
+                offset = 0;
+                end = size;
+                m_in_use += m_capacity - m_head; // the skipped end of the ring
+                m_head = 0;
+            }
+            else {
+                return { };
+            }
+        }
+        else if (m_head < m_tail && offset + size <= m_tail) {
+            end = offset + size;
+        }
+        else {
+            return { };
+        }
+
+        m_in_use += end - m_head;
+        m_head = end;
+        return offset;
+    }
+
+    void vulkan_upload_service::submit(VkSemaphore signal) {
+
+        VkSubmitInfo submit_info { };
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.signalSemaphoreCount = signal ? 1 : 0;
+        submit_info.pSignalSemaphores = signal ? &signal : nullptr;
+
+        VkFence fence = VK_NULL_HANDLE;
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+        if (m_recording) {
+            const auto& b = m_batches[*m_recording];
+            cmd = b.command_buffer;
+            fence = b.fence;
+
+            auto res = vkEndCommandBuffer(cmd);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to end upload command buffer", res);
+            }
+            submit_info.commandBufferCount = 1;
+            submit_info.pCommandBuffers = &cmd;
+        }
+
+        VkResult res;
+        {
+            std::lock_guard lock(m_transfer_queue_mutex);
+            res = vkQueueSubmit(m_transfer_queue, 1, &submit_info, fence);
+        }
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to submit uploads", res);
+        }
+
+        if (m_recording) {
+            m_in_flight.push_back(*m_recording);
+            m_recording.reset();
+        }
+        m_submitted_since_flush = true;
+    }
+
+    void vulkan_upload_service::retire_completed() {
+        while (!m_in_flight.empty()) {
+            auto res = vkGetFenceStatus(m_device, m_batches[m_in_flight.front()].fence);
+            if (res == VkResult::VK_NOT_READY) {
+                return;
+            }
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to query upload fence", res);
+            }
+            retire_oldest();
+        }
+    }
+
+    void vulkan_upload_service::retire_oldest() {
+
+        assert(!m_in_flight.empty());
+        auto& b = m_batches[m_in_flight.front()];
+
+        auto res = vkWaitForFences(m_device, 1, &b.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to wait for upload fence", res);
+        }
+        res = vkResetFences(m_device, 1, &b.fence);
+        if (res != VkResult::VK_SUCCESS) {
+            throw vulkan_error("Failed to reset upload fence", res);
+        }
+
+        // batches complete in submission order, so the ring is freed up to the batch's end
+        m_in_use -= b.staging_bytes;
+        m_tail = b.staging_end;
+        b.staging_bytes = 0;
+        m_in_flight.pop_front();
+    }
+
+    vulkan_upload_service::batch vulkan_upload_service::create_batch() const {
+
+        batch b { };
+
+        try {
+            VkCommandPoolCreateInfo pool_info { };
+            pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            pool_info.queueFamilyIndex = m_transfer_family;
+            auto res = vkCreateCommandPool(m_device, &pool_info, nullptr, &b.command_pool);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to create upload command pool", res);
+            }
+
+            VkCommandBufferAllocateInfo alloc_info { };
+            alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            alloc_info.commandPool = b.command_pool;
+            alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            alloc_info.commandBufferCount = 1;
+            res = vkAllocateCommandBuffers(m_device, &alloc_info, &b.command_buffer);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to allocate upload command buffer", res);
+            }
+
+            VkFenceCreateInfo fence_info { };
+            fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            res = vkCreateFence(m_device, &fence_info, nullptr, &b.fence);
+            if (res != VkResult::VK_SUCCESS) {
+                throw vulkan_error("Failed to create upload fence", res);
+            }
+        }
+        catch (...) {
+            destroy_batch(b);
+            throw;
+        }
+
+        return b;
+    }
+
+    void vulkan_upload_service::destroy_batch(batch& b) const noexcept {
+        if (b.fence) vkDestroyFence(m_device, b.fence, nullptr);
+        if (b.command_pool) vkDestroyCommandPool(m_device, b.command_pool, nullptr);
+        b = batch { };
+    }
+}
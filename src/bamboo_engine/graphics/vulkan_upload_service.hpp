@@ -0,0 +1,169 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_VULKAN_UPLOAD_SERVICE_HPP
+#define BAMBOOENGINE_VULKAN_UPLOAD_SERVICE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vulkan.hpp"
+#include "vulkan_allocator.hpp"
+#include "vulkan_frame_scheduler.hpp"
+#include "../util/macros.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Uploads buffer and image contents on the transfer queue without stalling the graphics queue.
+     * Data is copied into a persistently mapped staging ring and all copies of a frame are submitted as one batch.
+     * If the transfer queue belongs to another family, ownership is released on the transfer queue
+     * and acquired on the graphics queue in the frame's command buffer.
+     * Not thread safe, all calls have to come from the thread that records frames.
+     * The transfer queue may be the graphics queue, submissions hold the device's lock of that queue.
+     */
+    class vulkan_upload_service {
+    public:
+
+        static constexpr const VkDeviceSize default_staging_size = VkDeviceSize(32) << 20;
+
+        // by default uploads may be read by any graphics stage
+        static constexpr const VkPipelineStageFlags default_dst_stages =
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        static constexpr const VkAccessFlags default_dst_access = VK_ACCESS_MEMORY_READ_BIT;
+
+        BBGE_NO_COPIES(vulkan_upload_service);
+        BBGE_NO_MOVES(vulkan_upload_service);
+
+        /**
+         * @brief Create the staging ring and transfer command pools.
+         * @param device Device to upload to, uses its transfer and graphics queues
+         * @param frames_in_flight Frames in flight of the frame scheduler submitting the frames
+         * @param staging_size Size of the staging ring
+         */
+        vulkan_upload_service(const vulkan_device& device, uint32_t frames_in_flight,
+                              VkDeviceSize staging_size = default_staging_size);
+
+        /**
+         * @brief Waits for all pending uploads.
+         */
+        ~vulkan_upload_service();
+
+        /**
+         * @brief Copy data into a buffer. Large uploads are split into multiple copies.
+         * The buffer must not be in use by the GPU until the upload was flushed.
+         * @param dst Destination buffer, created with VK_BUFFER_USAGE_TRANSFER_DST_BIT
+         * @param dst_offset Offset into the destination buffer
+         * @param data Source data
+         * @param size Size of the data in bytes
+         * @param dst_stages Stages that read the buffer afterwards
+         * @param dst_access Accesses of those stages
+         */
+        void upload_buffer(const vulkan_buffer& dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size,
+                           VkPipelineStageFlags dst_stages = default_dst_stages,
+                           VkAccessFlags dst_access = default_dst_access);
+
+        /**
+         * @brief Replace the contents of one mip level of a color image's first layer. Its previous contents are discarded.
+         * @param dst Destination image, created with VK_IMAGE_USAGE_TRANSFER_DST_BIT
+         * @param data Tightly packed texels of the whole mip level
+         * @param size Size of the data in bytes, has to fit into the staging ring
+         * @param final_layout Layout of the mip level after the upload
+         * @param mip_level Mip level to upload
+         * @param dst_stages Stages that read the image afterwards
+         * @param dst_access Accesses of those stages
+         */
+        void upload_image(const vulkan_image& dst, const void* data, VkDeviceSize size,
+                          VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, uint32_t mip_level = 0,
+                          VkPipelineStageFlags dst_stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                          VkAccessFlags dst_access = VK_ACCESS_SHADER_READ_BIT);
+
+        /**
+         * @brief Submit all uploads since the last flush and make them visible to a frame.
+         * Records the ownership acquisition into the frame's command buffer, so call it before recording draws.
+         * @param f Frame that uses the uploads
+         * @return Semaphore the frame submission has to wait on or nothing if there were no uploads
+         */
+        [[nodiscard]] std::optional<vulkan_frame_scheduler::wait_semaphore> flush(const vulkan_frame_scheduler::frame& f);
+
+        /**
+         * @brief Check if uploads are waiting for the next flush.
+         * @return True if there are pending uploads
+         */
+        [[nodiscard]] bool has_pending() const noexcept;
+
+        /**
+         * @brief Get the size of the staging ring, the largest possible image upload.
+         * @return Staging ring size in bytes
+         */
+        [[nodiscard]] VkDeviceSize get_staging_size() const noexcept;
+
+    private:
+
+        struct batch {
+            VkCommandPool   command_pool    = VK_NULL_HANDLE;
+            VkCommandBuffer command_buffer  = VK_NULL_HANDLE;
+            VkFence         fence           = VK_NULL_HANDLE; // signaled once the batch finished on the transfer queue
+            VkDeviceSize    staging_end     = 0;              // ring head after the batch's last copy
+            VkDeviceSize    staging_bytes   = 0;              // ring bytes consumed, including padding
+        };
+
+        static constexpr const uint32_t batch_count = 4;
+
+        VkDevice m_device;
+        VkQueue m_transfer_queue;
+        std::mutex& m_transfer_queue_mutex; // shared with the other roles of the queue
+        uint32_t m_transfer_family;
+        uint32_t m_graphics_family;
+        bool m_transfer_ownership; // queue families differ, ownership has to be transferred
+        VkDeviceSize m_optimal_copy_alignment; // of image copies, a hint of the device
+
+        vulkan_buffer m_staging;
+        VkDeviceSize m_capacity;
+        VkDeviceSize m_head;
+        VkDeviceSize m_tail;
+        VkDeviceSize m_in_use;
+
+        std::vector<batch> m_batches;
+        std::optional<uint32_t> m_recording;   // batch that currently records copies
+        std::deque<uint32_t> m_in_flight;      // submitted batches in submission order
+        uint32_t m_next_batch;
+        bool m_submitted_since_flush;
+
+        std::vector<VkSemaphore> m_semaphores; // one per frame in flight, signaled by the flush submission
+
+        // recorded into the frame's command buffer on flush
+        std::vector<VkBufferMemoryBarrier> m_buffer_acquires;
+        std::vector<VkImageMemoryBarrier> m_image_acquires;
+        VkPipelineStageFlags m_acquire_stages;
+
+        [[nodiscard]] VkCommandBuffer get_recording_command_buffer();
+        [[nodiscard]] VkDeviceSize allocate_staging(VkDeviceSize size, VkDeviceSize alignment);
+        [[nodiscard]] std::optional<VkDeviceSize> try_allocate_staging(VkDeviceSize size, VkDeviceSize alignment) noexcept;
+        void submit(VkSemaphore signal);
+        void retire_completed();
+        void retire_oldest();
+        [[nodiscard]] batch create_batch() const;
+        void destroy_batch(batch& b) const noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_VULKAN_UPLOAD_SERVICE_HPP
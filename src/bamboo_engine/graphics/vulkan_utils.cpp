@@ -409,35 +409,35 @@ namespace bbge {
         return debug_create_info;
     }
 
-    result<std::vector<VkExtensionProperties>, vulkan_error>
+    result<std::vector<VkExtensionProperties>, vulkan_result_code>
     vulkan_utils::query_available_instance_extensions() {
 
         uint32_t num_avail = 0;
         auto res = vkEnumerateInstanceExtensionProperties(nullptr, &num_avail, nullptr);
         if (res != VkResult::VK_SUCCESS) {
-            return vulkan_error("Failed to query available instance extensions", res);
+            return vulkan_result_code { res, "Failed to query available instance extensions" };
         }
         std::vector<VkExtensionProperties> available(num_avail);
         res = vkEnumerateInstanceExtensionProperties(nullptr, &num_avail, available.data());
         if (res != VkResult::VK_SUCCESS) {
-            return vulkan_error("Failed to query available instance extensions", res);
+            return vulkan_result_code { res, "Failed to query available instance extensions" };
         }
 
         return available;
     }
 
-    result<std::vector<VkLayerProperties>, vulkan_error>
+    result<std::vector<VkLayerProperties>, vulkan_result_code>
     vulkan_utils::query_available_layers() {
 
         uint32_t count = 0;
         auto res = vkEnumerateInstanceLayerProperties(&count, nullptr);
         if (res != VkResult::VK_SUCCESS) {
-            return vulkan_error("Failed to query available validation layers", res);
+            return vulkan_result_code { res, "Failed to query available validation layers" };
         }
         std::vector<VkLayerProperties> props(count);
         res = vkEnumerateInstanceLayerProperties(&count, props.data());
         if (res != VkResult::VK_SUCCESS) {
-            return vulkan_error("Failed to query available validation layers", res);
+            return vulkan_result_code { res, "Failed to query available validation layers" };
         }
 
         return props;
@@ -455,7 +455,7 @@ namespace bbge {
         return props;
     }
 
-    result<std::vector<VkPhysicalDevice>, vulkan_error>
+    result<std::vector<VkPhysicalDevice>, vulkan_result_code>
     vulkan_utils::query_physical_devices(VkInstance inst) {
 
         assert(inst);
@@ -463,12 +463,12 @@ namespace bbge {
         uint32_t count = 0;
         auto res = vkEnumeratePhysicalDevices(inst, &count, nullptr);
         if (res != VkResult::VK_SUCCESS) {
-            return vulkan_error("Failed to query physical devices", res);
+            return vulkan_result_code { res, "Failed to query physical devices" };
         }
         std::vector<VkPhysicalDevice> devices(count);
         res = vkEnumeratePhysicalDevices(inst, &count, devices.data());
         if (res != VkResult::VK_SUCCESS) {
-            return vulkan_error("Failed to query physical devices", res);
+            return vulkan_result_code { res, "Failed to query physical devices" };
         }
 
         return devices;
@@ -494,7 +494,7 @@ namespace bbge {
         return avail;
     }
 
-    result<std::vector<VkSurfaceFormatKHR>, vulkan_error>
+    result<std::vector<VkSurfaceFormatKHR>, vulkan_result_code>
     vulkan_utils::query_surface_formats(VkPhysicalDevice dev, VkSurfaceKHR surface) {
 
         assert(dev);
@@ -503,22 +503,18 @@ namespace bbge {
         uint32_t count = 0;
         auto res = vkGetPhysicalDeviceSurfaceFormatsKHR(dev, surface, &count, nullptr);
         if (res != VkResult::VK_SUCCESS) {
-            VkPhysicalDeviceProperties props;
-            vkGetPhysicalDeviceProperties(dev, &props);
-            return vulkan_error(fmt::format("Failed to query surface formats for '{}'", props.deviceName), res);
+            return vulkan_result_code { res, "Failed to query surface formats" };
         }
         std::vector<VkSurfaceFormatKHR> formats(count);
         res = vkGetPhysicalDeviceSurfaceFormatsKHR(dev, surface, &count, formats.data());
         if (res != VkResult::VK_SUCCESS) {
-            VkPhysicalDeviceProperties props;
-            vkGetPhysicalDeviceProperties(dev, &props);
-            return vulkan_error(fmt::format("Failed to query surface formats for '{}'", props.deviceName), res);
+            return vulkan_result_code { res, "Failed to query surface formats" };
         }
 
         return formats;
     }
 
-    result<std::vector<VkPresentModeKHR>, vulkan_error>
+    result<std::vector<VkPresentModeKHR>, vulkan_result_code>
     vulkan_utils::query_present_modes(VkPhysicalDevice dev, VkSurfaceKHR surface) {
 
         assert(dev);
@@ -527,22 +523,18 @@ namespace bbge {
         uint32_t count = 0;
         auto res = vkGetPhysicalDeviceSurfacePresentModesKHR(dev, surface, &count, nullptr);
         if (res != VkResult::VK_SUCCESS) {
-            VkPhysicalDeviceProperties props;
-            vkGetPhysicalDeviceProperties(dev, &props);
-            return vulkan_error(fmt::format("Failed to query present modes for '{}'", props.deviceName), res);
+            return vulkan_result_code { res, "Failed to query present modes" };
         }
         std::vector<VkPresentModeKHR> modes(count);
         res = vkGetPhysicalDeviceSurfacePresentModesKHR(dev, surface, &count, modes.data());
         if (res != VkResult::VK_SUCCESS) {
-            VkPhysicalDeviceProperties props;
-            vkGetPhysicalDeviceProperties(dev, &props);
-            return vulkan_error(fmt::format("Failed to query present modes for '{}'", props.deviceName), res);
+            return vulkan_result_code { res, "Failed to query present modes" };
         }
 
         return modes;
     }
 
-    result<VkSurfaceCapabilitiesKHR, vulkan_error>
+    result<VkSurfaceCapabilitiesKHR, vulkan_result_code>
     vulkan_utils::query_surface_capabilities(VkPhysicalDevice dev, VkSurfaceKHR surface) {
 
         assert(dev);
@@ -551,14 +543,12 @@ namespace bbge {
         VkSurfaceCapabilitiesKHR capabilities;
         auto res = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(dev, surface, &capabilities);
         if (res != VkResult::VK_SUCCESS) {
-            VkPhysicalDeviceProperties props;
-            vkGetPhysicalDeviceProperties(dev, &props);
-            return vulkan_error(fmt::format("Failed to query surface capabilities of '{}'", props.deviceName), res);
+            return vulkan_result_code { res, "Failed to query surface capabilities" };
         }
         return capabilities;
     }
 
-    result<std::vector<VkExtensionProperties>, vulkan_error>
+    result<std::vector<VkExtensionProperties>, vulkan_result_code>
     vulkan_utils::query_available_device_extensions(VkPhysicalDevice dev) {
 
         assert(dev);
@@ -566,21 +556,17 @@ namespace bbge {
         uint32_t count = 0;
         auto res = vkEnumerateDeviceExtensionProperties(dev, nullptr, &count, nullptr);
         if (res != VkResult::VK_SUCCESS) {
-            VkPhysicalDeviceProperties props;
-            vkGetPhysicalDeviceProperties(dev, &props);
-            return vulkan_error(fmt::format("Failed to query supported extensions for '{}'", props.deviceName), res);
+            return vulkan_result_code { res, "Failed to query supported extensions" };
         }
         std::vector<VkExtensionProperties> exts(count);
         res = vkEnumerateDeviceExtensionProperties(dev, nullptr, &count, exts.data());
         if (res != VkResult::VK_SUCCESS) {
-            VkPhysicalDeviceProperties props;
-            vkGetPhysicalDeviceProperties(dev, &props);
-            return vulkan_error(fmt::format("Failed to query supported extensions for '{}'", props.deviceName), res);
+            return vulkan_result_code { res, "Failed to query supported extensions" };
         }
         return exts;
     }
 
-    result<std::vector<VkImage>, vulkan_error> vulkan_utils::query_swapchain_images(VkDevice dev, VkSwapchainKHR swapchain) {
+    result<std::vector<VkImage>, vulkan_result_code> vulkan_utils::query_swapchain_images(VkDevice dev, VkSwapchainKHR swapchain) {
 
         assert(dev);
         assert(swapchain);
@@ -588,12 +574,12 @@ namespace bbge {
         uint32_t count = 0;
         auto res = vkGetSwapchainImagesKHR(dev, swapchain, &count, nullptr);
         if (res != VkResult::VK_SUCCESS) {
-            return vulkan_error("Failed to query swap chain images", res);
+            return vulkan_result_code { res, "Failed to query swap chain images" };
         }
         std::vector<VkImage> images(count);
         res = vkGetSwapchainImagesKHR(dev, swapchain, &count, images.data());
         if (res != VkResult::VK_SUCCESS) {
-            return vulkan_error("Failed to query swap chain images", res);
+            return vulkan_result_code { res, "Failed to query swap chain images" };
         }
 
         return images;
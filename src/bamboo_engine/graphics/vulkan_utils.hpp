@@ -51,15 +51,15 @@ namespace bbge {
         [[nodiscard]] static VkComponentMapping                 make_identity_component_mapping() noexcept;
 
         // Property queries
-        [[nodiscard]] static result<std::vector<VkExtensionProperties>, vulkan_error>   query_available_instance_extensions();
-        [[nodiscard]] static result<std::vector<VkExtensionProperties>, vulkan_error>   query_available_device_extensions(VkPhysicalDevice dev);
-        [[nodiscard]] static result<std::vector<VkLayerProperties>, vulkan_error>       query_available_layers();
-        [[nodiscard]] static std::vector<VkQueueFamilyProperties>                       query_queue_families(VkPhysicalDevice dev);
-        [[nodiscard]] static result<std::vector<VkPhysicalDevice>, vulkan_error>        query_physical_devices(VkInstance inst);
-        [[nodiscard]] static result<std::vector<VkSurfaceFormatKHR>, vulkan_error>      query_surface_formats(VkPhysicalDevice dev, VkSurfaceKHR surface);
-        [[nodiscard]] static result<std::vector<VkPresentModeKHR>, vulkan_error>        query_present_modes(VkPhysicalDevice dev, VkSurfaceKHR surface);
-        [[nodiscard]] static result<VkSurfaceCapabilitiesKHR, vulkan_error>             query_surface_capabilities(VkPhysicalDevice dev, VkSurfaceKHR surface);
-        [[nodiscard]] static result<std::vector<VkImage>, vulkan_error>                 query_swapchain_images(VkDevice dev, VkSwapchainKHR swapchain);
+        [[nodiscard]] static result<std::vector<VkExtensionProperties>, vulkan_result_code>    query_available_instance_extensions();
+        [[nodiscard]] static result<std::vector<VkExtensionProperties>, vulkan_result_code>    query_available_device_extensions(VkPhysicalDevice dev);
+        [[nodiscard]] static result<std::vector<VkLayerProperties>, vulkan_result_code>        query_available_layers();
+        [[nodiscard]] static std::vector<VkQueueFamilyProperties>                              query_queue_families(VkPhysicalDevice dev);
+        [[nodiscard]] static result<std::vector<VkPhysicalDevice>, vulkan_result_code>         query_physical_devices(VkInstance inst);
+        [[nodiscard]] static result<std::vector<VkSurfaceFormatKHR>, vulkan_result_code>       query_surface_formats(VkPhysicalDevice dev, VkSurfaceKHR surface);
+        [[nodiscard]] static result<std::vector<VkPresentModeKHR>, vulkan_result_code>         query_present_modes(VkPhysicalDevice dev, VkSurfaceKHR surface);
+        [[nodiscard]] static result<VkSurfaceCapabilitiesKHR, vulkan_result_code>              query_surface_capabilities(VkPhysicalDevice dev, VkSurfaceKHR surface);
+        [[nodiscard]] static result<std::vector<VkImage>, vulkan_result_code>                  query_swapchain_images(VkDevice dev, VkSwapchainKHR swapchain);
 
     private:
 
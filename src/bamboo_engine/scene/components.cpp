@@ -0,0 +1,41 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "components.hpp"
+
+namespace bbge {
+
+    glm::mat4 to_matrix(const transform_component& t) noexcept {
+        glm::mat4 m = glm::mat4_cast(t.rotation);
+        m[0] *= t.scale.x;
+        m[1] *= t.scale.y;
+        m[2] *= t.scale.z;
+        m[3] = glm::vec4(t.position, 1.0f);
+        return m;
+    }
+
+    bounding_sphere transform_bounds(const bounding_sphere& local, const glm::mat4& model) noexcept {
+        auto scale_sq = std::max({
+            glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+            glm::dot(glm::vec3(model[1]), glm::vec3(model[1])),
+            glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))
+        });
+        return { glm::vec3(model * glm::vec4(local.center, 1.0f)), local.radius * std::sqrt(scale_sq) };
+    }
+}
@@ -0,0 +1,86 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_COMPONENTS_HPP
+#define BAMBOOENGINE_COMPONENTS_HPP
+
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace bbge {
+
+    /**
+     * @brief Sphere enclosing a mesh.
+     */
+    struct bounding_sphere {
+        glm::vec3 center { 0.0f };
+        float     radius = 0.0f;
+    };
+
+    /**
+     * @brief Position, rotation and scale of an entity.
+     */
+    struct transform_component {
+        glm::vec3 position { 0.0f };
+        glm::quat rotation { 1.0f, 0.0f, 0.0f, 0.0f };
+        glm::vec3 scale    { 1.0f };
+    };
+
+    /**
+     * @brief Attaches an entity to a parent, its transform is then relative to the parent's world transform.
+     */
+    struct parent_component {
+        entt::entity parent = entt::null;
+    };
+
+    /**
+     * @brief World matrix of an entity with a transform, maintained by the transform_hierarchy.
+     */
+    struct world_transform_component {
+        glm::mat4 matrix { 1.0f };
+    };
+
+    /**
+     * @brief Makes an entity drawable. The ids index the renderer's pipeline, material and mesh tables.
+     */
+    struct mesh_component {
+        uint32_t        mesh_id     = 0;
+        uint32_t        material_id = 0;
+        uint32_t        pipeline_id = 0;
+        bounding_sphere bounds;             // in the mesh's local space
+    };
+
+    /**
+     * @brief Build the model matrix of a transform: scale, then rotate, then translate.
+     * @param t Transform
+     * @return Model matrix
+     */
+    [[nodiscard]] glm::mat4 to_matrix(const transform_component& t) noexcept;
+
+    /**
+     * @brief Transform a local bounding sphere into the space of a model matrix.
+     * The radius grows with the largest scale, so the sphere stays conservative for non-uniform scales.
+     * @param local Sphere in local space
+     * @param model Model matrix
+     * @return Transformed sphere
+     */
+    [[nodiscard]] bounding_sphere transform_bounds(const bounding_sphere& local, const glm::mat4& model) noexcept;
+}
+
+#endif //BAMBOOENGINE_COMPONENTS_HPP
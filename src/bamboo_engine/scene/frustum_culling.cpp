@@ -0,0 +1,340 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <fmt/format.h>
+#include "frustum_culling.hpp"
+#include "../util/logging.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BBGE_CULL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+#define BBGE_CULL_NEON
+#include <arm_neon.h>
+#endif
+
+// lets the AVX2 kernel live next to the others without compiling the whole engine for AVX2
+#if defined(BBGE_CULL_X86) && (defined(__GNUC__) || defined(__clang__))
+#define BBGE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define BBGE_TARGET_AVX2
+#endif
+
+namespace bbge {
+
+    namespace {
+
+        uint32_t count_trailing_zeros(uint32_t v) noexcept {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, v);
+            return static_cast<uint32_t>(index);
+#else
+            return static_cast<uint32_t>(__builtin_ctz(v));
+#endif
+        }
+
+        // appends the set bits of a lane mask as indices
+        std::size_t emit_mask(uint32_t mask, std::size_t base, uint32_t* visible) noexcept {
+            std::size_t n = 0;
+            while (mask) {
+                visible[n++] = static_cast<uint32_t>(base + count_trailing_zeros(mask));
+                mask &= mask - 1;
+            }
+            return n;
+        }
+
+        std::size_t cull_range_scalar(const frustum& f, const float* x, const float* y, const float* z, const float* radius,
+                                      std::size_t first, std::size_t last, uint32_t* visible) noexcept {
+            std::size_t n = 0;
+            for (auto i = first; i < last; ++i) {
+                bool inside = true;
+                for (const auto& p : f.planes) {
+                    inside &= p.x * x[i] + p.y * y[i] + p.z * z[i] + p.w >= -radius[i];
+                }
+                // written unconditionally, the count decides whether it stays
+                visible[n] = static_cast<uint32_t>(i);
+                n += inside;
+            }
+            return n;
+        }
+
+#ifdef BBGE_CULL_X86
+
+        std::size_t cull_sse(const frustum& f, const float* x, const float* y, const float* z, const float* radius,
+                             std::size_t count, uint32_t* visible) noexcept {
+
+            __m128 px[6], py[6], pz[6], pw[6];
+            for (std::size_t p = 0; p < 6; ++p) {
+                px[p] = _mm_set1_ps(f.planes[p].x);
+                py[p] = _mm_set1_ps(f.planes[p].y);
+                pz[p] = _mm_set1_ps(f.planes[p].z);
+                pw[p] = _mm_set1_ps(f.planes[p].w);
+            }
+
+            std::size_t n = 0;
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                auto cx = _mm_loadu_ps(x + i);
+                auto cy = _mm_loadu_ps(y + i);
+                auto cz = _mm_loadu_ps(z + i);
+                auto neg_r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+                __m128 inside = _mm_setzero_ps();
+                for (std::size_t p = 0; p < 6; ++p) {
+                    auto d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], cx), _mm_mul_ps(py[p], cy)),
+                                        _mm_add_ps(_mm_mul_ps(pz[p], cz), pw[p]));
+                    auto m = _mm_cmpge_ps(d, neg_r);
+                    inside = p == 0 ? m : _mm_and_ps(inside, m);
+                }
+                n += emit_mask(static_cast<uint32_t>(_mm_movemask_ps(inside)), i, visible + n);
+            }
+            return n + cull_range_scalar(f, x, y, z, radius, i, count, visible + n);
+        }
+
+        BBGE_TARGET_AVX2
+        std::size_t cull_avx2(const frustum& f, const float* x, const float* y, const float* z, const float* radius,
+                              std::size_t count, uint32_t* visible) noexcept {
+
+            __m256 px[6], py[6], pz[6], pw[6];
+            for (std::size_t p = 0; p < 6; ++p) {
+                px[p] = _mm256_set1_ps(f.planes[p].x);
+                py[p] = _mm256_set1_ps(f.planes[p].y);
+                pz[p] = _mm256_set1_ps(f.planes[p].z);
+                pw[p] = _mm256_set1_ps(f.planes[p].w);
+            }
+
+            std::size_t n = 0;
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                auto cx = _mm256_loadu_ps(x + i);
+                auto cy = _mm256_loadu_ps(y + i);
+                auto cz = _mm256_loadu_ps(z + i);
+                auto neg_r = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+
+                __m256 inside = _mm256_setzero_ps();
+                for (std::size_t p = 0; p < 6; ++p) {
+                    auto d = _mm256_fmadd_ps(px[p], cx, _mm256_fmadd_ps(py[p], cy, _mm256_fmadd_ps(pz[p], cz, pw[p])));
+                    auto m = _mm256_cmp_ps(d, neg_r, _CMP_GE_OQ);
+                    inside = p == 0 ? m : _mm256_and_ps(inside, m);
+                }
+                n += emit_mask(static_cast<uint32_t>(_mm256_movemask_ps(inside)), i, visible + n);
+            }
+            return n + cull_range_scalar(f, x, y, z, radius, i, count, visible + n);
+        }
+
+        bool cpu_supports_avx2() noexcept {
+#ifdef _MSC_VER
+            std::array<int, 4> regs { };
+            __cpuid(regs.data(), 0);
+            if (regs[0] < 7) return false;
+            __cpuid(regs.data(), 1);
+            bool fma = (regs[2] & (1 << 12)) != 0;
+            bool os_saves_ymm = (regs[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(regs.data(), 7, 0);
+            bool avx2 = (regs[1] & (1 << 5)) != 0;
+            return fma && os_saves_ymm && avx2;
+#else
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+        }
+
+#endif // BBGE_CULL_X86
+
+#ifdef BBGE_CULL_NEON
+
+        std::size_t cull_neon(const frustum& f, const float* x, const float* y, const float* z, const float* radius,
+                              std::size_t count, uint32_t* visible) noexcept {
+
+            float32x4_t px[6], py[6], pz[6], pw[6];
+            for (std::size_t p = 0; p < 6; ++p) {
+                px[p] = vdupq_n_f32(f.planes[p].x);
+                py[p] = vdupq_n_f32(f.planes[p].y);
+                pz[p] = vdupq_n_f32(f.planes[p].z);
+                pw[p] = vdupq_n_f32(f.planes[p].w);
+            }
+
+            const uint32_t lane_bits_init[4] = { 1, 2, 4, 8 };
+            const uint32x4_t lane_bits = vld1q_u32(lane_bits_init);
+
+            std::size_t n = 0;
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                auto cx = vld1q_f32(x + i);
+                auto cy = vld1q_f32(y + i);
+                auto cz = vld1q_f32(z + i);
+                auto neg_r = vnegq_f32(vld1q_f32(radius + i));
+
+                uint32x4_t inside = vdupq_n_u32(~0u);
+                for (std::size_t p = 0; p < 6; ++p) {
+                    auto d = vmlaq_f32(vmlaq_f32(vmlaq_f32(pw[p], pz[p], cz), py[p], cy), px[p], cx);
+                    inside = vandq_u32(inside, vcgeq_f32(d, neg_r));
+                }
+                auto bits = vandq_u32(inside, lane_bits);
+                auto mask = vgetq_lane_u32(bits, 0) | vgetq_lane_u32(bits, 1) | vgetq_lane_u32(bits, 2) | vgetq_lane_u32(bits, 3);
+                n += emit_mask(mask, i, visible + n);
+            }
+            return n + cull_range_scalar(f, x, y, z, radius, i, count, visible + n);
+        }
+
+#endif // BBGE_CULL_NEON
+
+        glm::vec4 normalize_plane(float a, float b, float c, float d) noexcept {
+            float length = std::sqrt(a * a + b * b + c * c);
+            return glm::vec4(a / length, b / length, c / length, d / length);
+        }
+    }
+
+    frustum frustum::from_view_projection(const glm::mat4& m) noexcept {
+
+        // glm is column major, row i of the matrix is m[0][i], m[1][i], m[2][i], m[3][i]
+        auto combine = [&m](int i, float sign) {
+            return normalize_plane(m[0][3] + sign * m[0][i], m[1][3] + sign * m[1][i],
+                                   m[2][3] + sign * m[2][i], m[3][3] + sign * m[3][i]);
+        };
+
+        frustum f { };
+        f.planes[0] = combine(0, 1.0f);  // left:   w + x >= 0
+        f.planes[1] = combine(0, -1.0f); // right:  w - x >= 0
+        f.planes[2] = combine(1, 1.0f);  // bottom: w + y >= 0
+        f.planes[3] = combine(1, -1.0f); // top:    w - y >= 0
+        f.planes[4] = normalize_plane(m[0][2], m[1][2], m[2][2], m[3][2]); // near: z >= 0
+        f.planes[5] = combine(2, -1.0f); // far:    w - z >= 0
+        return f;
+    }
+
+    bool frustum::intersects(const bounding_sphere& sphere) const noexcept {
+        for (const auto& p : planes) {
+            if (p.x * sphere.center.x + p.y * sphere.center.y + p.z * sphere.center.z + p.w < -sphere.radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string_view to_string(cull_kernel k) noexcept {
+        switch (k) {
+            case cull_kernel::scalar: return "scalar";
+            case cull_kernel::sse:    return "SSE";
+            case cull_kernel::avx2:   return "AVX2";
+            case cull_kernel::neon:   return "NEON";
+        }
+        return "unknown";
+    }
+
+    bool is_supported(cull_kernel k) noexcept {
+        switch (k) {
+            case cull_kernel::scalar:
+                return true;
+#ifdef BBGE_CULL_X86
+            case cull_kernel::sse:
+                return true; // baseline of every x86 CPU we run on
+            case cull_kernel::avx2: {
+                static const bool supported = cpu_supports_avx2();
+                return supported;
+            }
+#endif
+#ifdef BBGE_CULL_NEON
+            case cull_kernel::neon:
+                return true;
+#endif
+            default:
+                return false;
+        }
+    }
+
+    cull_kernel detect_cull_kernel() noexcept {
+        for (auto k : { cull_kernel::avx2, cull_kernel::neon, cull_kernel::sse }) {
+            if (is_supported(k)) return k;
+        }
+        return cull_kernel::scalar;
+    }
+
+    std::size_t cull_spheres(const frustum& f, const float* x, const float* y, const float* z, const float* radius,
+                             std::size_t count, uint32_t* visible, cull_kernel kernel) noexcept {
+        switch (kernel) {
+#ifdef BBGE_CULL_X86
+            case cull_kernel::sse:  return cull_sse(f, x, y, z, radius, count, visible);
+            case cull_kernel::avx2: return cull_avx2(f, x, y, z, radius, count, visible);
+#endif
+#ifdef BBGE_CULL_NEON
+            case cull_kernel::neon: return cull_neon(f, x, y, z, radius, count, visible);
+#endif
+            default:                return cull_range_scalar(f, x, y, z, radius, 0, count, visible);
+        }
+    }
+
+    frustum_culler::frustum_culler(cull_kernel kernel) : m_kernel(kernel) {
+        if (!is_supported(kernel)) {
+            throw std::invalid_argument(fmt::format("The {} culling kernel is not supported on this CPU.", to_string(kernel)));
+        }
+        SPDLOG_DEBUG("Frustum culling uses the {} kernel.", to_string(kernel));
+    }
+
+    void frustum_culler::cull(const frustum& f, const render_list& list, std::vector<uint32_t>& visible,
+                              job_system* jobs, std::size_t parallel_threshold) const {
+
+        auto n = list.size();
+        visible.resize(n);
+
+        if (!jobs || n < std::max<std::size_t>(parallel_threshold, 1)) {
+            auto count = cull_spheres(f, list.bounds_x.data(), list.bounds_y.data(), list.bounds_z.data(), list.bounds_radius.data(),
+                                      n, visible.data(), m_kernel);
+            visible.resize(count);
+            return;
+        }
+
+        // chunks start at multiples of the widest kernel, so only the last one has a scalar tail
+        constexpr std::size_t alignment = 16;
+        auto chunk_count = jobs->get_thread_count() + 1;
+        auto chunk_size = ((n + chunk_count - 1) / chunk_count + alignment - 1) / alignment * alignment;
+        chunk_count = (n + chunk_size - 1) / chunk_size;
+
+        // every chunk writes its indices to the start of its own range, they are compacted afterwards
+        std::vector<std::size_t> counts(chunk_count);
+        jobs->parallel_for(0, chunk_count, 1, [&](std::size_t first, std::size_t last) {
+            for (auto c = first; c < last; ++c) {
+                auto begin = c * chunk_size;
+                auto size = std::min(chunk_size, n - begin);
+                auto* out = visible.data() + begin;
+                counts[c] = cull_spheres(f, list.bounds_x.data() + begin, list.bounds_y.data() + begin, list.bounds_z.data() + begin,
+                                         list.bounds_radius.data() + begin, size, out, m_kernel);
+                for (std::size_t i = 0; i < counts[c]; ++i) {
+                    out[i] += static_cast<uint32_t>(begin);
+                }
+            }
+        });
+
+        auto count = counts[0];
+        for (std::size_t c = 1; c < chunk_count; ++c) {
+            std::memmove(visible.data() + count, visible.data() + c * chunk_size, counts[c] * sizeof(uint32_t));
+            count += counts[c];
+        }
+        visible.resize(count);
+    }
+
+    cull_kernel frustum_culler::get_kernel() const noexcept {
+        return m_kernel;
+    }
+}
@@ -0,0 +1,123 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_FRUSTUM_CULLING_HPP
+#define BAMBOOENGINE_FRUSTUM_CULLING_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <glm/glm.hpp>
+#include "components.hpp"
+#include "render_extraction.hpp"
+#include "../util/job_system.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Six planes pointing inwards, normalized so plane distances are in world units.
+     */
+    struct frustum {
+        std::array<glm::vec4, 6> planes; // left, right, bottom, top, near, far
+
+        /**
+         * @brief Extract the planes of a view projection matrix with Vulkan's [0, 1] clip space depth.
+         * @param view_projection Projection times view matrix
+         * @return The view frustum in world space
+         */
+        [[nodiscard]] static frustum from_view_projection(const glm::mat4& view_projection) noexcept;
+
+        /**
+         * @brief Conservative sphere test, spheres touching the frustum are visible.
+         */
+        [[nodiscard]] bool intersects(const bounding_sphere& sphere) const noexcept;
+    };
+
+    /**
+     * @brief Implementation of the culling loop. Each SIMD kernel only exists on its architecture.
+     */
+    enum class cull_kernel : uint8_t {
+        scalar, // 1 sphere per iteration
+        sse,    // 4 spheres per iteration
+        avx2,   // 8 spheres per iteration
+        neon    // 4 spheres per iteration
+    };
+
+    [[nodiscard]] std::string_view to_string(cull_kernel k) noexcept;
+
+    /**
+     * @brief Check if the CPU and the build support a kernel.
+     */
+    [[nodiscard]] bool is_supported(cull_kernel k) noexcept;
+
+    /**
+     * @brief Pick the widest kernel the CPU supports.
+     */
+    [[nodiscard]] cull_kernel detect_cull_kernel() noexcept;
+
+    /**
+     * @brief Test spheres given as separate coordinate arrays against a frustum.
+     * @param f Frustum
+     * @param x Center x coordinates
+     * @param y Center y coordinates
+     * @param z Center z coordinates
+     * @param radius Radii
+     * @param count Number of spheres
+     * @param visible Receives the indices of visible spheres in ascending order, room for count indices
+     * @param kernel Supported kernel to use
+     * @return Number of visible spheres
+     */
+    [[nodiscard]] std::size_t cull_spheres(const frustum& f,
+                                           const float* x, const float* y, const float* z, const float* radius,
+                                           std::size_t count, uint32_t* visible, cull_kernel kernel) noexcept;
+
+    /**
+     * @brief Culls render lists with a kernel picked once.
+     */
+    class frustum_culler {
+    public:
+
+        static constexpr const std::size_t default_parallel_threshold = 16384;
+
+        /**
+         * @brief Throws a std::invalid_argument if the kernel isn't supported.
+         * @param kernel Kernel to use
+         */
+        explicit frustum_culler(cull_kernel kernel = detect_cull_kernel());
+
+        /**
+         * @brief Emit the indices of the visible draws. They keep the sort order of the render list.
+         * @param f Frustum
+         * @param list Render list
+         * @param visible Receives the visible indices, previous contents are replaced
+         * @param jobs Optional job system large lists are split across
+         * @param parallel_threshold Minimum size of a list before it's split
+         */
+        void cull(const frustum& f, const render_list& list, std::vector<uint32_t>& visible,
+                  job_system* jobs = nullptr, std::size_t parallel_threshold = default_parallel_threshold) const;
+
+        [[nodiscard]] cull_kernel get_kernel() const noexcept;
+
+    private:
+
+        cull_kernel m_kernel;
+    };
+}
+
+#endif //BAMBOOENGINE_FRUSTUM_CULLING_HPP
@@ -0,0 +1,159 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <numeric>
+#include "render_extraction.hpp"
+
+namespace bbge {
+
+    std::size_t render_list::size() const noexcept {
+        return sort_keys.size();
+    }
+
+    bool render_list::empty() const noexcept {
+        return sort_keys.empty();
+    }
+
+    void render_list::clear() noexcept {
+        model_matrices.clear();
+        bounds_x.clear();
+        bounds_y.clear();
+        bounds_z.clear();
+        bounds_radius.clear();
+        pipeline_ids.clear();
+        material_ids.clear();
+        mesh_ids.clear();
+        sort_keys.clear();
+        entities.clear();
+        batches.clear();
+    }
+
+    void render_list::reserve(std::size_t n) {
+        model_matrices.reserve(n);
+        bounds_x.reserve(n);
+        bounds_y.reserve(n);
+        bounds_z.reserve(n);
+        bounds_radius.reserve(n);
+        pipeline_ids.reserve(n);
+        material_ids.reserve(n);
+        mesh_ids.reserve(n);
+        sort_keys.reserve(n);
+        entities.reserve(n);
+    }
+
+    void build_draw_batches(const render_list& list, gsl::span<const uint32_t> draws, std::vector<draw_batch>& batches) {
+
+        batches.clear();
+        for (uint32_t i = 0; i < draws.size(); ++i) {
+            auto d = draws[i];
+            if (!batches.empty()) {
+                auto& last = batches.back();
+                if (last.pipeline_id == list.pipeline_ids[d] && last.material_id == list.material_ids[d] && last.mesh_id == list.mesh_ids[d]) {
+                    ++last.count;
+                    continue;
+                }
+            }
+            batches.push_back({ i, 1, list.pipeline_ids[d], list.material_ids[d], list.mesh_ids[d] });
+        }
+    }
+
+    void render_extractor::extract(const entt::registry& registry, render_list& out,
+                                   job_system* jobs, std::size_t parallel_threshold) {
+
+        m_unsorted.clear();
+        m_unsorted.reserve(registry.size<mesh_component>());
+
+        // one linear pass over the pools, everything after this only touches the packed arrays
+        registry.view<const world_transform_component, const mesh_component>().each(
+            [this](entt::entity e, const world_transform_component& t, const mesh_component& m) {
+                m_unsorted.model_matrices.push_back(t.matrix);
+                auto bounds = transform_bounds(m.bounds, t.matrix);
+                m_unsorted.bounds_x.push_back(bounds.center.x);
+                m_unsorted.bounds_y.push_back(bounds.center.y);
+                m_unsorted.bounds_z.push_back(bounds.center.z);
+                m_unsorted.bounds_radius.push_back(bounds.radius);
+                m_unsorted.pipeline_ids.push_back(m.pipeline_id);
+                m_unsorted.material_ids.push_back(m.material_id);
+                m_unsorted.mesh_ids.push_back(m.mesh_id);
+                m_unsorted.sort_keys.push_back(make_sort_key(m.pipeline_id, m.material_id, m.mesh_id));
+                m_unsorted.entities.push_back(e);
+            }
+        );
+
+        sort_into(out, jobs, parallel_threshold);
+    }
+
+    void render_extractor::sort_into(render_list& out, job_system* jobs, std::size_t parallel_threshold) {
+
+        auto n = m_unsorted.size();
+
+        // sorting keys with indices and gathering afterwards moves every matrix exactly once
+        m_order.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            m_order[i] = { m_unsorted.sort_keys[i], static_cast<uint32_t>(i) };
+        }
+        std::sort(m_order.begin(), m_order.end());
+
+        out.clear();
+        out.model_matrices.resize(n);
+        out.bounds_x.resize(n);
+        out.bounds_y.resize(n);
+        out.bounds_z.resize(n);
+        out.bounds_radius.resize(n);
+        out.pipeline_ids.resize(n);
+        out.material_ids.resize(n);
+        out.mesh_ids.resize(n);
+        out.sort_keys.resize(n);
+        out.entities.resize(n);
+
+        // every draw is written by index, so ranges of the gather are independent
+        if (jobs && n >= std::max<std::size_t>(parallel_threshold, 1)) {
+            jobs->parallel_for(0, n, parallel_threshold / 4, [this, &out](std::size_t first, std::size_t last) {
+                gather(out, first, last);
+            });
+        }
+        else {
+            gather(out, 0, n);
+        }
+
+        // equal keys are adjacent now, but truncated ids may collide, so batches compare the ids
+        // the whole list is batched, the identity indices are kept and only ever grow
+        if (m_all_draws.size() < n) {
+            auto old_size = m_all_draws.size();
+            m_all_draws.resize(n);
+            std::iota(m_all_draws.begin() + old_size, m_all_draws.end(), static_cast<uint32_t>(old_size));
+        }
+        build_draw_batches(out, gsl::span<const uint32_t>(m_all_draws.data(), n), out.batches);
+    }
+
+    void render_extractor::gather(render_list& out, std::size_t first, std::size_t last) const noexcept {
+        for (auto j = first; j < last; ++j) {
+            const auto& [key, i] = m_order[j];
+            out.model_matrices[j] = m_unsorted.model_matrices[i];
+            out.bounds_x[j] = m_unsorted.bounds_x[i];
+            out.bounds_y[j] = m_unsorted.bounds_y[i];
+            out.bounds_z[j] = m_unsorted.bounds_z[i];
+            out.bounds_radius[j] = m_unsorted.bounds_radius[i];
+            out.pipeline_ids[j] = m_unsorted.pipeline_ids[i];
+            out.material_ids[j] = m_unsorted.material_ids[i];
+            out.mesh_ids[j] = m_unsorted.mesh_ids[i];
+            out.sort_keys[j] = key;
+            out.entities[j] = m_unsorted.entities[i];
+        }
+    }
+}
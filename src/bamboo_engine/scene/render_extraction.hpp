@@ -0,0 +1,124 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_RENDER_EXTRACTION_HPP
+#define BAMBOOENGINE_RENDER_EXTRACTION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <gsl/gsl-lite.hpp>
+#include "components.hpp"
+#include "../util/job_system.hpp"
+
+namespace bbge {
+
+    // bits of the sort key, most significant first
+    constexpr const uint32_t sort_key_pipeline_bits = 16;
+    constexpr const uint32_t sort_key_material_bits = 24;
+    constexpr const uint32_t sort_key_mesh_bits     = 24;
+
+    /**
+     * @brief Build a key that orders draws by pipeline, then material, then mesh, so state changes are minimal.
+     * Ids are truncated to their bit count.
+     */
+    [[nodiscard]] constexpr uint64_t make_sort_key(uint32_t pipeline_id, uint32_t material_id, uint32_t mesh_id) noexcept {
+        constexpr uint64_t pipeline_mask = (uint64_t(1) << sort_key_pipeline_bits) - 1;
+        constexpr uint64_t material_mask = (uint64_t(1) << sort_key_material_bits) - 1;
+        constexpr uint64_t mesh_mask     = (uint64_t(1) << sort_key_mesh_bits) - 1;
+        return ((pipeline_id & pipeline_mask) << (sort_key_material_bits + sort_key_mesh_bits))
+             | ((material_id & material_mask) << sort_key_mesh_bits)
+             | (mesh_id & mesh_mask);
+    }
+
+    /**
+     * @brief Consecutive draws of a render list sharing pipeline, material and mesh, drawable as one instanced draw.
+     */
+    struct draw_batch {
+        uint32_t first;         // index of the first draw in the render list
+        uint32_t count;
+        uint32_t pipeline_id;
+        uint32_t material_id;
+        uint32_t mesh_id;
+    };
+
+    /**
+     * @brief Everything the renderer needs from a scene, one array per attribute.
+     * All arrays have the same length and are ordered by sort key.
+     */
+    struct render_list {
+        std::vector<glm::mat4>       model_matrices;
+        std::vector<float>           bounds_x;      // world space bounding spheres, split up for SIMD culling
+        std::vector<float>           bounds_y;
+        std::vector<float>           bounds_z;
+        std::vector<float>           bounds_radius;
+        std::vector<uint32_t>        pipeline_ids;
+        std::vector<uint32_t>        material_ids;
+        std::vector<uint32_t>        mesh_ids;
+        std::vector<uint64_t>        sort_keys;
+        std::vector<entt::entity>    entities;
+        std::vector<draw_batch>      batches;
+
+        [[nodiscard]] std::size_t size() const noexcept;
+        [[nodiscard]] bool empty() const noexcept;
+        void clear() noexcept;
+        void reserve(std::size_t n);
+    };
+
+    /**
+     * @brief Group a subset of a render list's draws, e.g. the visible ones, into batches.
+     * @param list Render list
+     * @param draws Indices into the list in ascending order, batches index into this span
+     * @param batches Receives the batches, previous contents are replaced
+     */
+    void build_draw_batches(const render_list& list, gsl::span<const uint32_t> draws, std::vector<draw_batch>& batches);
+
+    /**
+     * @brief Copies drawable entities out of a registry into a render list.
+     * Keeps its scratch memory between frames, so steady state extraction doesn't allocate.
+     */
+    class render_extractor {
+    public:
+
+        static constexpr const std::size_t default_parallel_threshold = 8192;
+
+        /**
+         * @brief Extract every entity with a world transform and a mesh, sorted by sort key.
+         * World transforms are maintained by the transform_hierarchy, so update it first.
+         * @param registry Scene
+         * @param out Render list, its previous contents are replaced
+         * @param jobs Optional job system the gather after sorting is split across
+         * @param parallel_threshold Minimum number of draws before the gather is split
+         */
+        void extract(const entt::registry& registry, render_list& out,
+                     job_system* jobs = nullptr, std::size_t parallel_threshold = default_parallel_threshold);
+
+    private:
+
+        render_list m_unsorted;
+        std::vector<std::pair<uint64_t, uint32_t>> m_order; // sort key and index into m_unsorted
+        std::vector<uint32_t> m_all_draws;                  // 0..n, batches the whole list
+
+        void sort_into(render_list& out, job_system* jobs, std::size_t parallel_threshold);
+        void gather(render_list& out, std::size_t first, std::size_t last) const noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_RENDER_EXTRACTION_HPP
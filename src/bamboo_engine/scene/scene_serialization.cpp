@@ -0,0 +1,327 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cassert>
+#include <fmt/format.h>
+#include "scene_serialization.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        using entity_id = std::underlying_type_t<entt::entity>;
+
+        // snapshots are read in place, so a changed component layout can't be converted and has to be rejected
+        result<bool, std::runtime_error> check_sizes(const snapshot_schema& schema, const scene_snapshot& snapshot) {
+            for (const auto& section : snapshot.get_sections()) {
+                const auto* c = schema.find(section.component_id);
+                if (c && section.kind == snapshot_section_kind::values && section.element_size != c->size) {
+                    return std::runtime_error(fmt::format(
+                        "Component '{}' has {} bytes, the snapshot stores {} bytes per value.",
+                        c->name, c->size, section.element_size
+                    ));
+                }
+            }
+            return true;
+        }
+
+        void warn_unknown_components(const snapshot_schema& schema, const scene_snapshot& snapshot) {
+            for (const auto& section : snapshot.get_sections()) {
+                if (!schema.find(section.component_id)) {
+                    SPDLOG_WARN("Skipping component {} of the scene snapshot, it's not in the schema.", section.component_id);
+                }
+            }
+        }
+
+        std::vector<entt::entity> get_alive_entities(const entt::registry& registry) {
+            std::vector<entt::entity> entities;
+            entities.reserve(registry.alive());
+            registry.each([&entities](entt::entity e) { entities.push_back(e); });
+            std::sort(entities.begin(), entities.end());
+            return entities;
+        }
+
+        nlohmann::json to_json_id(entt::entity e) {
+            if (e == entt::null) return nullptr;
+            return static_cast<entity_id>(e);
+        }
+    }
+
+    void component_changes::on_changed(entt::registry&, entt::entity e) {
+        changed.insert(e);
+        removed.erase(e);
+    }
+
+    void component_changes::on_removed(entt::registry&, entt::entity e) {
+        changed.erase(e);
+        removed.insert(e);
+    }
+
+    snapshot_schema snapshot_schema::engine_components() {
+        snapshot_schema schema;
+        schema.add<transform_component>(1, "transform")
+              .add<parent_component>(2, "parent")
+              .add<mesh_component>(3, "mesh");
+        return schema;
+    }
+
+    const snapshot_schema::component* snapshot_schema::find(uint32_t id) const noexcept {
+        auto it = std::find_if(m_components.begin(), m_components.end(), [id](const component& c) { return c.id == id; });
+        return it == m_components.end() ? nullptr : &*it;
+    }
+
+    const std::vector<snapshot_schema::component>& snapshot_schema::get_components() const noexcept {
+        return m_components;
+    }
+
+    void snapshot_schema::add(component&& c) {
+        if (find(c.id)) {
+            throw std::invalid_argument(fmt::format("Component '{}' reuses the snapshot id {}.", c.name, c.id));
+        }
+        m_components.push_back(std::move(c));
+    }
+
+    result<uint64_t, std::runtime_error> save_snapshot(
+        const entt::registry& registry, const snapshot_schema& schema, const std::filesystem::path& p) {
+
+        // the pools are written directly, nothing is copied
+        auto entities = get_alive_entities(registry);
+        scene_snapshot_writer writer(snapshot_kind::full, 0);
+        writer.set_entities(entities);
+        for (const auto& c : schema.get_components()) {
+            writer.add_values(c.id, c.size, c.get_entities(registry), c.get_values(registry));
+        }
+        return writer.write(p);
+    }
+
+    result<std::size_t, std::runtime_error> load_snapshot(
+        entt::registry& registry, const snapshot_schema& schema, const scene_snapshot& snapshot) {
+
+        if (!registry.empty()) {
+            throw std::invalid_argument("Snapshots can only be loaded into an empty registry.");
+        }
+        if (snapshot.get_kind() != snapshot_kind::full) {
+            throw std::invalid_argument("Deltas have to be applied on top of a full snapshot.");
+        }
+        auto sizes = check_sizes(schema, snapshot);
+        if (!sizes) return *sizes.err();
+        warn_unknown_components(schema, snapshot);
+
+        for (auto e : snapshot.get_entities()) {
+            [[maybe_unused]] auto created = registry.create(e);
+            assert(created == e);
+        }
+        for (const auto& section : snapshot.get_sections()) {
+            if (const auto* c = schema.find(section.component_id)) {
+                c->insert(registry, section.entities, section.values);
+            }
+        }
+
+        SPDLOG_DEBUG("Loaded {} entities from a scene snapshot.", snapshot.get_entities().size());
+        return snapshot.get_entities().size();
+    }
+
+    result<std::size_t, std::runtime_error> apply_delta(
+        entt::registry& registry, const snapshot_schema& schema, const scene_snapshot& delta, uint64_t expected_sequence) {
+
+        if (delta.get_kind() != snapshot_kind::delta) {
+            throw std::invalid_argument("Full snapshots have to be loaded with load_snapshot.");
+        }
+        if (delta.get_sequence() != expected_sequence) {
+            throw std::invalid_argument(fmt::format(
+                "Delta {} can't be applied, the scene is at {}.", delta.get_sequence(), expected_sequence - 1
+            ));
+        }
+        auto sizes = check_sizes(schema, delta);
+        if (!sizes) return *sizes.err();
+        warn_unknown_components(schema, delta);
+
+        // the delta lists every entity, so destroyed and recreated ones are found by their version
+        auto entities = delta.get_entities();
+        tsl::robin_set<entt::entity> alive(entities.begin(), entities.end());
+        std::vector<entt::entity> destroyed;
+        registry.each([&](entt::entity e) {
+            if (alive.find(e) == alive.end()) destroyed.push_back(e);
+        });
+        registry.destroy(destroyed.begin(), destroyed.end());
+        for (auto e : entities) {
+            if (!registry.valid(e)) {
+                [[maybe_unused]] auto created = registry.create(e);
+                assert(created == e);
+            }
+        }
+
+        std::size_t changes = 0;
+        for (const auto& section : delta.get_sections()) {
+            const auto* c = schema.find(section.component_id);
+            if (!c) continue;
+            if (section.kind == snapshot_section_kind::removed) {
+                c->remove(registry, section.entities);
+            }
+            else {
+                c->assign(registry, section.entities, section.values);
+            }
+            changes += section.entities.size();
+        }
+
+        SPDLOG_DEBUG("Applied scene delta {} with {} changes, {} entities destroyed.", delta.get_sequence(), changes, destroyed.size());
+        return changes;
+    }
+
+    nlohmann::json export_json(const entt::registry& registry, const snapshot_schema& schema) {
+
+        auto entities = nlohmann::json::array();
+        for (auto e : get_alive_entities(registry)) {
+            auto components = nlohmann::json::object();
+            for (const auto& c : schema.get_components()) {
+                if (c.has(registry, e)) {
+                    components[c.name] = c.to_json(registry, e);
+                }
+            }
+            entities.push_back({ { "id", to_json_id(e) }, { "components", std::move(components) } });
+        }
+        return { { "entities", std::move(entities) } };
+    }
+
+    snapshot_tracker::snapshot_tracker(entt::registry& registry, const snapshot_schema& schema, uint64_t sequence)
+      : m_registry(registry), m_schema(schema), m_sequence(sequence) {
+
+        m_changes.reserve(schema.get_components().size());
+        for (const auto& c : schema.get_components()) {
+            m_changes.push_back(std::make_unique<component_changes>());
+            c.connect(m_registry, *m_changes.back());
+        }
+    }
+
+    snapshot_tracker::~snapshot_tracker() {
+        const auto& components = m_schema.get_components();
+        for (std::size_t i = 0; i < m_changes.size(); ++i) {
+            components[i].disconnect(m_registry, *m_changes[i]);
+        }
+    }
+
+    void snapshot_tracker::mark_changed(uint32_t component_id, entt::entity e) {
+        const auto& components = m_schema.get_components();
+        for (std::size_t i = 0; i < components.size(); ++i) {
+            if (components[i].id == component_id) {
+                m_changes[i]->on_changed(m_registry, e);
+                return;
+            }
+        }
+        throw std::invalid_argument(fmt::format("Component {} is not in the schema.", component_id));
+    }
+
+    result<uint64_t, std::runtime_error> snapshot_tracker::save_full(const std::filesystem::path& p) {
+        auto written = save_snapshot(m_registry, m_schema, p);
+        if (written) {
+            m_sequence = 0;
+            clear();
+        }
+        return written;
+    }
+
+    result<uint64_t, std::runtime_error> snapshot_tracker::save_delta(const std::filesystem::path& p) {
+
+        const auto& components = m_schema.get_components();
+        auto entities = get_alive_entities(m_registry);
+
+        // the writer keeps spans, so the arrays live until the delta is written
+        std::vector<std::vector<entt::entity>> changed(components.size());
+        std::vector<std::vector<std::byte>> values(components.size());
+        std::vector<std::vector<entt::entity>> removed(components.size());
+
+        scene_snapshot_writer writer(snapshot_kind::delta, m_sequence + 1);
+        writer.set_entities(entities);
+        for (std::size_t i = 0; i < components.size(); ++i) {
+            const auto& c = components[i];
+            const auto& changes = *m_changes[i];
+
+            if (!changes.changed.empty()) {
+                changed[i].assign(changes.changed.begin(), changes.changed.end());
+                std::sort(changed[i].begin(), changed[i].end());
+                values[i].resize(changed[i].size() * c.size);
+                c.copy_values(m_registry, changed[i], values[i].data());
+                writer.add_values(c.id, c.size, changed[i], values[i]);
+            }
+            if (!changes.removed.empty()) {
+                removed[i].assign(changes.removed.begin(), changes.removed.end());
+                std::sort(removed[i].begin(), removed[i].end());
+                writer.add_removed(c.id, removed[i]);
+            }
+        }
+
+        auto written = writer.write(p);
+        if (written) {
+            ++m_sequence;
+            clear();
+        }
+        return written;
+    }
+
+    uint64_t snapshot_tracker::get_sequence() const noexcept {
+        return m_sequence;
+    }
+
+    std::size_t snapshot_tracker::get_change_count() const noexcept {
+        std::size_t count = 0;
+        for (const auto& changes : m_changes) {
+            count += changes->changed.size() + changes->removed.size();
+        }
+        return count;
+    }
+
+    void snapshot_tracker::clear() noexcept {
+        for (auto& changes : m_changes) {
+            changes->changed.clear();
+            changes->removed.clear();
+        }
+    }
+
+    void to_json(nlohmann::json& j, const transform_component& t) {
+        j = {
+            { "position", { t.position.x, t.position.y, t.position.z } },
+            { "rotation", { t.rotation.w, t.rotation.x, t.rotation.y, t.rotation.z } },
+            { "scale", { t.scale.x, t.scale.y, t.scale.z } }
+        };
+    }
+
+    void to_json(nlohmann::json& j, const parent_component& p) {
+        j = { { "parent", to_json_id(p.parent) } };
+    }
+
+    void to_json(nlohmann::json& j, const mesh_component& m) {
+        j = {
+            { "mesh", m.mesh_id },
+            { "material", m.material_id },
+            { "pipeline", m.pipeline_id },
+            { "bounds", { { "center", { m.bounds.center.x, m.bounds.center.y, m.bounds.center.z } }, { "radius", m.bounds.radius } } }
+        };
+    }
+
+    namespace detail {
+
+        nlohmann::json to_hex_json(gsl::span<const std::byte> bytes) {
+            std::string hex;
+            hex.reserve(bytes.size() * 2);
+            for (auto b : bytes) {
+                hex += fmt::format("{:02x}", std::to_integer<unsigned>(b));
+            }
+            return hex;
+        }
+    }
+}
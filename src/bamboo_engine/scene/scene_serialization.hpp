@@ -0,0 +1,311 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_SCENE_SERIALIZATION_HPP
+#define BAMBOOENGINE_SCENE_SERIALIZATION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <entt/entt.hpp>
+#include <gsl/gsl-lite.hpp>
+#include <nlohmann/json.hpp>
+#include <tsl/robin_set.h>
+#include "components.hpp"
+#include "scene_snapshot.hpp"
+#include "../util/macros.hpp"
+#include "../util/result.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Changes of one component type since the last save, collected from the registry's signals.
+     */
+    struct component_changes {
+        tsl::robin_set<entt::entity> changed;
+        tsl::robin_set<entt::entity> removed;
+
+        void on_changed(entt::registry& registry, entt::entity e);
+        void on_removed(entt::registry& registry, entt::entity e);
+    };
+
+    /**
+     * @brief The components that are saved, with ids that stay the same between builds.
+     * Components are copied byte by byte, so they have to be trivially copyable. Entities stored in components,
+     * like a parent, stay valid because loading restores the exact entity identifiers.
+     */
+    class snapshot_schema {
+    public:
+
+        /**
+         * @brief Type erased operations on one component type.
+         */
+        struct component {
+            uint32_t    id;
+            std::string name;
+            uint32_t    size;
+
+            // pool contents, in the same order
+            gsl::span<const entt::entity> (*get_entities)(const entt::registry& registry);
+            gsl::span<const std::byte> (*get_values)(const entt::registry& registry);
+
+            bool (*has)(const entt::registry& registry, entt::entity e);
+
+            // copy size bytes per entity to out, the entities need the component
+            void (*copy_values)(const entt::registry& registry, gsl::span<const entt::entity> entities, std::byte* out);
+
+            // bulk insert into entities without the component, emplace or replace one by one and remove if present
+            void (*insert)(entt::registry& registry, gsl::span<const entt::entity> entities, gsl::span<const std::byte> values);
+            void (*assign)(entt::registry& registry, gsl::span<const entt::entity> entities, gsl::span<const std::byte> values);
+            void (*remove)(entt::registry& registry, gsl::span<const entt::entity> entities);
+
+            void (*connect)(entt::registry& registry, component_changes& changes);
+            void (*disconnect)(entt::registry& registry, component_changes& changes);
+
+            // for debug exports, components without a to_json overload are exported as hex
+            nlohmann::json (*to_json)(const entt::registry& registry, entt::entity e);
+        };
+
+        /**
+         * @brief Get a schema with the engine's components. World transforms are left out, the hierarchy rebuilds them.
+         *   1 transform_component, 2 parent_component, 3 mesh_component
+         */
+        [[nodiscard]] static snapshot_schema engine_components();
+
+        /**
+         * @brief Add a component type. Throws a std::invalid_argument if the id was added already.
+         * @tparam T Trivially copyable, non empty component
+         * @param id Id in the snapshots, never reuse one for a different type
+         * @param name Name in debug exports
+         * @return this
+         */
+        template <typename T>
+        snapshot_schema& add(uint32_t id, std::string name);
+
+        /**
+         * @brief Look up a component.
+         * @param id Id in the snapshots
+         * @return The component or nullptr if it's not in the schema
+         */
+        [[nodiscard]] const component* find(uint32_t id) const noexcept;
+
+        [[nodiscard]] const std::vector<component>& get_components() const noexcept;
+
+    private:
+
+        std::vector<component> m_components;
+
+        void add(component&& c);
+    };
+
+    /**
+     * @brief Save every component of the schema.
+     * @param registry Scene
+     * @param schema Components to save
+     * @param p Path of the snapshot
+     * @return Size of the snapshot in bytes or an error if it couldn't be written
+     */
+    [[nodiscard]] result<uint64_t, std::runtime_error> save_snapshot(
+        const entt::registry& registry, const snapshot_schema& schema, const std::filesystem::path& p);
+
+    /**
+     * @brief Restore a full snapshot into an empty registry, entities keep their identifiers.
+     * Component arrays are inserted as a whole. Components the schema doesn't know are skipped.
+     * Throws a std::invalid_argument if the registry isn't empty or the snapshot is a delta.
+     * @param registry Empty scene
+     * @param schema Components to load
+     * @param snapshot Full snapshot
+     * @return Number of entities or an error if a component's size changed since the snapshot was written
+     */
+    [[nodiscard]] result<std::size_t, std::runtime_error> load_snapshot(
+        entt::registry& registry, const snapshot_schema& schema, const scene_snapshot& snapshot);
+
+    /**
+     * @brief Apply a delta on top of a loaded snapshot and the deltas before it.
+     * Entities that are missing from the delta are destroyed, new ones are created with their identifiers.
+     * Throws a std::invalid_argument if the snapshot is a full one or out of order.
+     * @param registry Scene
+     * @param schema Components to load
+     * @param delta Delta snapshot
+     * @param expected_sequence Sequence of the previous snapshot plus one
+     * @return Number of changed components or an error if a component's size changed
+     */
+    [[nodiscard]] result<std::size_t, std::runtime_error> apply_delta(
+        entt::registry& registry, const snapshot_schema& schema, const scene_snapshot& delta, uint64_t expected_sequence);
+
+    /**
+     * @brief Export the components of the schema as JSON for debugging. Far too slow for save games.
+     * @param registry Scene
+     * @param schema Components to export
+     * @return Object with an entities array, each with its identifier and components by name
+     */
+    [[nodiscard]] nlohmann::json export_json(const entt::registry& registry, const snapshot_schema& schema);
+
+    /**
+     * @brief Writes deltas that only contain the components changed since the last save.
+     * Emplacing, replacing, patching and removing components are tracked through the registry's signals,
+     * components changed through registry::get have to be marked with mark_changed.
+     */
+    class snapshot_tracker {
+    public:
+
+        BBGE_NO_COPIES(snapshot_tracker);
+        BBGE_NO_MOVES(snapshot_tracker);
+
+        /**
+         * @brief Start tracking a scene that matches its last full snapshot, e.g. right after loading or saving it.
+         * The registry and the schema have to outlive the tracker.
+         * @param registry Scene
+         * @param schema Components to track
+         * @param sequence Sequence of the last snapshot the scene matches
+         */
+        snapshot_tracker(entt::registry& registry, const snapshot_schema& schema, uint64_t sequence = 0);
+
+        ~snapshot_tracker();
+
+        /**
+         * @brief Mark a component as changed.
+         * @param component_id Id of the component in the schema
+         * @param e Entity with the component
+         */
+        void mark_changed(uint32_t component_id, entt::entity e);
+
+        /**
+         * @brief Save the whole scene and start a new save chain.
+         * @param p Path of the snapshot
+         * @return Size of the snapshot in bytes or an error if it couldn't be written
+         */
+        [[nodiscard]] result<uint64_t, std::runtime_error> save_full(const std::filesystem::path& p);
+
+        /**
+         * @brief Save the changes since the last save. The changes are only cleared if the delta was written.
+         * @param p Path of the delta
+         * @return Size of the delta in bytes or an error if it couldn't be written
+         */
+        [[nodiscard]] result<uint64_t, std::runtime_error> save_delta(const std::filesystem::path& p);
+
+        /**
+         * @brief Get the sequence of the last save, 0 after a full save.
+         */
+        [[nodiscard]] uint64_t get_sequence() const noexcept;
+
+        /**
+         * @brief Get the number of changed and removed components since the last save.
+         */
+        [[nodiscard]] std::size_t get_change_count() const noexcept;
+
+    private:
+
+        entt::registry& m_registry;
+        const snapshot_schema& m_schema;
+        uint64_t m_sequence;
+        std::vector<std::unique_ptr<component_changes>> m_changes; // by schema index, the signals point at them
+
+        void clear() noexcept;
+    };
+
+    // debug export of the engine's components
+    void to_json(nlohmann::json& j, const transform_component& t);
+    void to_json(nlohmann::json& j, const parent_component& p);
+    void to_json(nlohmann::json& j, const mesh_component& m);
+
+    namespace detail {
+
+        [[nodiscard]] nlohmann::json to_hex_json(gsl::span<const std::byte> bytes);
+    }
+
+    template <typename T>
+    snapshot_schema& snapshot_schema::add(uint32_t id, std::string name) {
+
+        static_assert(std::is_trivially_copyable_v<T>, "components are saved byte by byte");
+        static_assert(!std::is_empty_v<T>, "entt doesn't store values of empty components");
+        static_assert(alignof(T) <= scene_snapshot::data_alignment, "snapshot arrays aren't aligned enough");
+
+        component c { };
+        c.id = id;
+        c.name = std::move(name);
+        c.size = static_cast<uint32_t>(sizeof(T));
+
+        c.get_entities = [](const entt::registry& registry) {
+            return gsl::span<const entt::entity>(registry.data<T>(), registry.size<T>());
+        };
+        c.get_values = [](const entt::registry& registry) {
+            return gsl::span<const std::byte>(reinterpret_cast<const std::byte*>(registry.raw<T>()), registry.size<T>() * sizeof(T));
+        };
+        c.has = [](const entt::registry& registry, entt::entity e) {
+            return registry.has<T>(e);
+        };
+        c.copy_values = [](const entt::registry& registry, gsl::span<const entt::entity> entities, std::byte* out) {
+            for (auto e : entities) {
+                const auto& value = registry.get<T>(e);
+                std::memcpy(out, &value, sizeof(T));
+                out += sizeof(T);
+            }
+        };
+
+        // the snapshot's arrays are aligned, so the mapped values are used in place
+        c.insert = [](entt::registry& registry, gsl::span<const entt::entity> entities, gsl::span<const std::byte> values) {
+            const auto* first = reinterpret_cast<const T*>(values.data());
+            registry.insert<T>(entities.begin(), entities.end(), first, first + entities.size());
+        };
+        c.assign = [](entt::registry& registry, gsl::span<const entt::entity> entities, gsl::span<const std::byte> values) {
+            const auto* first = reinterpret_cast<const T*>(values.data());
+            for (std::size_t i = 0; i < entities.size(); ++i) {
+                registry.emplace_or_replace<T>(entities[i], first[i]);
+            }
+        };
+        c.remove = [](entt::registry& registry, gsl::span<const entt::entity> entities) {
+            for (auto e : entities) {
+                if (registry.valid(e)) {
+                    registry.remove_if_exists<T>(e);
+                }
+            }
+        };
+
+        c.connect = [](entt::registry& registry, component_changes& changes) {
+            registry.on_construct<T>().template connect<&component_changes::on_changed>(changes);
+            registry.on_update<T>().template connect<&component_changes::on_changed>(changes);
+            registry.on_destroy<T>().template connect<&component_changes::on_removed>(changes);
+        };
+        c.disconnect = [](entt::registry& registry, component_changes& changes) {
+            registry.on_construct<T>().template disconnect<&component_changes::on_changed>(changes);
+            registry.on_update<T>().template disconnect<&component_changes::on_changed>(changes);
+            registry.on_destroy<T>().template disconnect<&component_changes::on_removed>(changes);
+        };
+
+        c.to_json = [](const entt::registry& registry, entt::entity e) {
+            const auto& value = registry.get<T>(e);
+            if constexpr (std::is_constructible_v<nlohmann::json, const T&>) {
+                return nlohmann::json(value);
+            }
+            else {
+                return detail::to_hex_json(gsl::span<const std::byte>(reinterpret_cast<const std::byte*>(&value), sizeof(T)));
+            }
+        };
+
+        add(std::move(c));
+        return *this;
+    }
+}
+
+#endif //BAMBOOENGINE_SCENE_SERIALIZATION_HPP
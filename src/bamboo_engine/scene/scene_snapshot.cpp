@@ -0,0 +1,339 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <fmt/format.h>
+#include "scene_snapshot.hpp"
+#include "../util/logging.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        struct snapshot_header {
+            std::array<char, 4> magic;
+            uint32_t version;
+            uint32_t byte_order;
+            uint32_t kind;
+            uint64_t sequence;
+            uint64_t entity_count;
+            uint64_t entities_offset;
+            uint32_t section_count;
+            uint32_t reserved;
+        };
+        static_assert(sizeof(snapshot_header) == 48);
+
+        struct snapshot_section_record {
+            uint32_t component_id;
+            uint32_t kind;
+            uint32_t element_size;
+            uint32_t reserved;
+            uint64_t count;
+            uint64_t entities_offset;
+            uint64_t values_offset;
+        };
+        static_assert(sizeof(snapshot_section_record) == 40);
+
+        // entities are stored as they are, the file is only valid with the same entity type
+        static_assert(sizeof(entt::entity) == sizeof(uint32_t));
+
+        constexpr uint64_t align_up(uint64_t v, uint64_t alignment) noexcept {
+            return (v + alignment - 1) / alignment * alignment;
+        }
+
+        // records and header are read with memcpy, the arrays are aligned by the writer and checked on open
+        template <typename T>
+        T read_at(gsl::span<const std::byte> bytes, uint64_t offset) noexcept {
+            T v;
+            std::memcpy(&v, bytes.data() + offset, sizeof(T));
+            return v;
+        }
+
+        bool in_bounds(uint64_t offset, uint64_t size, uint64_t total) noexcept {
+            return offset <= total && size <= total - offset;
+        }
+
+        gsl::span<const std::byte> entity_bytes(gsl::span<const entt::entity> entities) noexcept {
+            return { reinterpret_cast<const std::byte*>(entities.data()), entities.size() * sizeof(entt::entity) };
+        }
+
+        bool is_aligned(uint64_t offset) noexcept {
+            return offset % scene_snapshot::data_alignment == 0;
+        }
+    }
+
+    constexpr std::array<std::string_view, 2> snapshot_kind_names {
+        "full", "delta"
+    };
+
+    constexpr std::array<std::string_view, 2> snapshot_section_kind_names {
+        "values", "removed"
+    };
+
+    std::string_view to_string(snapshot_kind k) noexcept {
+        auto v = static_cast<uint32_t>(k);
+        return v < snapshot_kind_names.size() ? snapshot_kind_names[v] : "unknown";
+    }
+
+    std::string_view to_string(snapshot_section_kind k) noexcept {
+        auto v = static_cast<uint32_t>(k);
+        return v < snapshot_section_kind_names.size() ? snapshot_section_kind_names[v] : "unknown";
+    }
+
+    result<scene_snapshot, std::runtime_error> scene_snapshot::open(const std::filesystem::path& p) {
+
+        auto file = mapped_file::open(p);
+        if (!file) {
+            return *file.err();
+        }
+
+        auto bytes = file.ok()->get_contents();
+        auto total = static_cast<uint64_t>(bytes.size());
+        auto malformed = [&p](std::string_view reason) {
+            return std::runtime_error(fmt::format("Malformed scene snapshot '{}': {}.", p.string(), reason));
+        };
+
+        if (total < sizeof(snapshot_header)) {
+            return malformed("too small for the header");
+        }
+        auto header = read_at<snapshot_header>(bytes, 0);
+        if (header.magic != magic) {
+            return malformed("wrong magic");
+        }
+        if (header.version != format_version) {
+            return malformed(fmt::format("unsupported version {}, expected {}", header.version, format_version));
+        }
+        if (header.byte_order != byte_order_mark) {
+            return malformed("written on an architecture with a different byte order");
+        }
+        if (header.kind > static_cast<uint32_t>(snapshot_kind::delta)) {
+            return malformed(fmt::format("unknown kind {}", header.kind));
+        }
+        if (header.kind == static_cast<uint32_t>(snapshot_kind::full) && header.sequence != 0) {
+            return malformed("full snapshots start a save chain, their sequence has to be 0");
+        }
+        if (!in_bounds(sizeof(snapshot_header), uint64_t(header.section_count) * sizeof(snapshot_section_record), total)) {
+            return malformed("section table out of bounds");
+        }
+        if (!is_aligned(header.entities_offset) || header.entity_count > total / sizeof(entt::entity)
+            || !in_bounds(header.entities_offset, header.entity_count * sizeof(entt::entity), total)) {
+            return malformed("entities out of bounds");
+        }
+
+        scene_snapshot snapshot;
+        snapshot.m_kind = static_cast<snapshot_kind>(header.kind);
+        snapshot.m_sequence = header.sequence;
+        snapshot.m_entities = gsl::span<const entt::entity>(
+            reinterpret_cast<const entt::entity*>(bytes.data() + header.entities_offset), header.entity_count
+        );
+        snapshot.m_sections.reserve(header.section_count);
+
+        for (uint32_t i = 0; i < header.section_count; ++i) {
+            auto record = read_at<snapshot_section_record>(bytes, sizeof(snapshot_header) + uint64_t(i) * sizeof(snapshot_section_record));
+
+            if (record.kind > static_cast<uint32_t>(snapshot_section_kind::removed)) {
+                return malformed(fmt::format("unknown kind {} of section {}", record.kind, i));
+            }
+            auto kind = static_cast<snapshot_section_kind>(record.kind);
+            if (kind == snapshot_section_kind::removed && (snapshot.m_kind == snapshot_kind::full || record.element_size != 0)) {
+                return malformed(fmt::format("removals in section {} of a full snapshot or with values", i));
+            }
+            if (kind == snapshot_section_kind::values && record.element_size == 0) {
+                return malformed(fmt::format("empty values in section {}", i));
+            }
+            if (record.count > total / sizeof(entt::entity)
+                || !is_aligned(record.entities_offset)
+                || !in_bounds(record.entities_offset, record.count * sizeof(entt::entity), total)) {
+                return malformed(fmt::format("entities of section {} out of bounds", i));
+            }
+            if (record.element_size != 0 && (record.count > total / record.element_size
+                || !is_aligned(record.values_offset)
+                || !in_bounds(record.values_offset, record.count * record.element_size, total))) {
+                return malformed(fmt::format("values of section {} out of bounds", i));
+            }
+            if (snapshot.find(record.component_id, kind)) {
+                return malformed(fmt::format("duplicate section for component {}", record.component_id));
+            }
+
+            snapshot_section section { };
+            section.component_id = record.component_id;
+            section.kind = kind;
+            section.element_size = record.element_size;
+            section.entities = gsl::span<const entt::entity>(
+                reinterpret_cast<const entt::entity*>(bytes.data() + record.entities_offset), record.count
+            );
+            if (record.element_size != 0) {
+                section.values = bytes.subspan(record.values_offset, record.count * record.element_size);
+            }
+            snapshot.m_sections.push_back(section);
+        }
+
+        snapshot.m_file = std::move(*file.ok());
+        SPDLOG_DEBUG("Opened {} scene snapshot '{}' with {} entities and {} sections ({} bytes).",
+                     to_string(snapshot.m_kind), p.string(), snapshot.m_entities.size(), snapshot.m_sections.size(), total);
+        return snapshot;
+    }
+
+    snapshot_kind scene_snapshot::get_kind() const noexcept {
+        return m_kind;
+    }
+
+    uint64_t scene_snapshot::get_sequence() const noexcept {
+        return m_sequence;
+    }
+
+    gsl::span<const entt::entity> scene_snapshot::get_entities() const noexcept {
+        return m_entities;
+    }
+
+    const std::vector<snapshot_section>& scene_snapshot::get_sections() const noexcept {
+        return m_sections;
+    }
+
+    const snapshot_section* scene_snapshot::find(uint32_t component_id, snapshot_section_kind kind) const noexcept {
+        auto it = std::find_if(m_sections.begin(), m_sections.end(), [component_id, kind](const snapshot_section& s) {
+            return s.component_id == component_id && s.kind == kind;
+        });
+        return it == m_sections.end() ? nullptr : &*it;
+    }
+
+    scene_snapshot_writer::scene_snapshot_writer(snapshot_kind kind, uint64_t sequence) noexcept
+      : m_kind(kind), m_sequence(kind == snapshot_kind::full ? 0 : sequence) { }
+
+    void scene_snapshot_writer::set_entities(gsl::span<const entt::entity> entities) noexcept {
+        m_entities = entities;
+    }
+
+    void scene_snapshot_writer::add_values(uint32_t component_id, uint32_t element_size,
+                                           gsl::span<const entt::entity> entities, gsl::span<const std::byte> values) {
+
+        if (element_size == 0) {
+            throw std::invalid_argument(fmt::format("Component {} has no size.", component_id));
+        }
+        if (values.size() != entities.size() * element_size) {
+            throw std::invalid_argument(fmt::format(
+                "Component {} has {} bytes of values for {} entities of {} bytes.",
+                component_id, values.size(), entities.size(), element_size
+            ));
+        }
+        add_section({ component_id, snapshot_section_kind::values, element_size, entities, values });
+    }
+
+    void scene_snapshot_writer::add_removed(uint32_t component_id, gsl::span<const entt::entity> entities) {
+
+        if (m_kind == snapshot_kind::full) {
+            throw std::invalid_argument("Full snapshots can't contain removals.");
+        }
+        add_section({ component_id, snapshot_section_kind::removed, 0, entities, { } });
+    }
+
+    void scene_snapshot_writer::add_section(const snapshot_section& section) {
+
+        auto duplicate = std::any_of(m_sections.begin(), m_sections.end(), [&section](const snapshot_section& s) {
+            return s.component_id == section.component_id && s.kind == section.kind;
+        });
+        if (duplicate) {
+            throw std::invalid_argument(fmt::format(
+                "The {} of component {} were already added.", to_string(section.kind), section.component_id
+            ));
+        }
+        m_sections.push_back(section);
+    }
+
+    result<uint64_t, std::runtime_error> scene_snapshot_writer::write(const std::filesystem::path& p) const {
+
+        snapshot_header header { };
+        header.magic = scene_snapshot::magic;
+        header.version = scene_snapshot::format_version;
+        header.byte_order = scene_snapshot::byte_order_mark;
+        header.kind = static_cast<uint32_t>(m_kind);
+        header.sequence = m_sequence;
+        header.entity_count = m_entities.size();
+        header.section_count = static_cast<uint32_t>(m_sections.size());
+
+        // every array starts aligned, so the mapped file can be read in place
+        struct block {
+            uint64_t offset;
+            gsl::span<const std::byte> bytes;
+        };
+        std::vector<block> blocks;
+        uint64_t offset = sizeof(snapshot_header) + m_sections.size() * sizeof(snapshot_section_record);
+        const auto place = [&](gsl::span<const std::byte> bytes) {
+            offset = align_up(offset, scene_snapshot::data_alignment);
+            blocks.push_back({ offset, bytes });
+            offset += bytes.size();
+            return blocks.back().offset;
+        };
+
+        header.entities_offset = place(entity_bytes(m_entities));
+        std::vector<snapshot_section_record> records(m_sections.size());
+        for (std::size_t i = 0; i < m_sections.size(); ++i) {
+            const auto& section = m_sections[i];
+            records[i].component_id = section.component_id;
+            records[i].kind = static_cast<uint32_t>(section.kind);
+            records[i].element_size = section.element_size;
+            records[i].count = section.entities.size();
+            records[i].entities_offset = place(entity_bytes(section.entities));
+            records[i].values_offset = section.element_size == 0 ? 0 : place(section.values);
+        }
+
+        std::error_code ec;
+        if (p.has_parent_path()) {
+            std::filesystem::create_directories(p.parent_path(), ec);
+            if (ec) {
+                return std::runtime_error(fmt::format("Failed to create directory for scene snapshot '{}': {}.", p.string(), ec.message()));
+            }
+        }
+
+        // write next to the target and swap it in afterwards
+        auto tmp_path = p;
+        tmp_path += ".tmp";
+        uint64_t written = 0;
+        {
+            std::ofstream os(tmp_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+            if (!os) {
+                return std::runtime_error(fmt::format("Failed to open '{}' for writing: {}.", tmp_path.string(), std::strerror(errno)));
+            }
+
+            static constexpr const std::array<char, scene_snapshot::data_alignment> padding { };
+            os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            os.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(snapshot_section_record)));
+            written = sizeof(header) + records.size() * sizeof(snapshot_section_record);
+            for (const auto& b : blocks) {
+                os.write(padding.data(), static_cast<std::streamsize>(b.offset - written));
+                os.write(reinterpret_cast<const char*>(b.bytes.data()), static_cast<std::streamsize>(b.bytes.size()));
+                written = b.offset + b.bytes.size();
+            }
+            os.flush();
+            if (!os) {
+                return std::runtime_error(fmt::format("Failed to write scene snapshot to '{}'.", tmp_path.string()));
+            }
+        }
+
+        std::filesystem::rename(tmp_path, p, ec);
+        if (ec) {
+            // the rename error is the one worth reporting, a failed cleanup only leaves the temporary file behind
+            std::error_code remove_ec;
+            std::filesystem::remove(tmp_path, remove_ec);
+            return std::runtime_error(fmt::format("Failed to replace scene snapshot '{}': {}.", p.string(), ec.message()));
+        }
+
+        return written;
+    }
+}
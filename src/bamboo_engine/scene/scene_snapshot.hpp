@@ -0,0 +1,189 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_SCENE_SNAPSHOT_HPP
+#define BAMBOOENGINE_SCENE_SNAPSHOT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+#include <entt/entt.hpp>
+#include <gsl/gsl-lite.hpp>
+#include "../util/macros.hpp"
+#include "../util/mapped_file.hpp"
+#include "../util/result.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Whether a snapshot holds a whole scene or the changes since the previous snapshot.
+     */
+    enum class snapshot_kind : uint32_t {
+        full  = 0,
+        delta = 1
+    };
+
+    [[nodiscard]] std::string_view to_string(snapshot_kind k) noexcept;
+
+    /**
+     * @brief Contents of a snapshot section.
+     */
+    enum class snapshot_section_kind : uint32_t {
+        values  = 0,    // entities and their component values
+        removed = 1     // entities the component was removed from, only in deltas
+    };
+
+    [[nodiscard]] std::string_view to_string(snapshot_section_kind k) noexcept;
+
+    /**
+     * @brief One component array of a snapshot. The spans point into the mapped file.
+     */
+    struct snapshot_section {
+        uint32_t                      component_id;
+        snapshot_section_kind         kind;
+        uint32_t                      element_size;   // 0 for removals
+        gsl::span<const entt::entity> entities;
+        gsl::span<const std::byte>    values;         // element_size bytes per entity
+    };
+
+    /**
+     * @brief Read-only, memory mapped snapshot of a scene's components.
+     * Component arrays are stored exactly as they are in memory, so loading copies whole arrays into the
+     * registry's pools without parsing entity by entity. That makes snapshots specific to the architecture and
+     * the component layouts, they are save games and not an exchange format.
+     *
+     * Layout, all integers in native byte order:
+     *   header      magic "BBGS", version, byte order mark, kind, sequence, entity count and offset, section count
+     *   sections    one record per component array
+     *   data        entity and value arrays, each aligned to data_alignment
+     */
+    class scene_snapshot {
+    public:
+
+        static constexpr const std::array<char, 4> magic { 'B', 'B', 'G', 'S' };
+        static constexpr const uint32_t format_version = 1;
+        static constexpr const uint32_t byte_order_mark = 0x01020304;
+        static constexpr const uint64_t data_alignment = 16; // enough for glm vectors and matrices
+
+        BBGE_NO_COPIES(scene_snapshot);
+
+        scene_snapshot() = default;
+        scene_snapshot(scene_snapshot&& other) noexcept = default;
+        scene_snapshot& operator=(scene_snapshot&& other) noexcept = default;
+        ~scene_snapshot() = default;
+
+        /**
+         * @brief Map a snapshot and read its section table.
+         * @param p Path to the snapshot
+         * @return The snapshot or an error if it is missing, malformed or from another architecture
+         */
+        [[nodiscard]] static result<scene_snapshot, std::runtime_error> open(const std::filesystem::path& p);
+
+        [[nodiscard]] snapshot_kind get_kind() const noexcept;
+
+        /**
+         * @brief Get the position in a save chain: 0 for full snapshots, deltas count up from there.
+         */
+        [[nodiscard]] uint64_t get_sequence() const noexcept;
+
+        /**
+         * @brief Get all entities alive when the snapshot was taken, deltas store them too.
+         */
+        [[nodiscard]] gsl::span<const entt::entity> get_entities() const noexcept;
+
+        [[nodiscard]] const std::vector<snapshot_section>& get_sections() const noexcept;
+
+        /**
+         * @brief Look up a section.
+         * @param component_id Id of the component
+         * @param kind Values or removals
+         * @return The section or nullptr if the snapshot has none
+         */
+        [[nodiscard]] const snapshot_section* find(uint32_t component_id, snapshot_section_kind kind) const noexcept;
+
+    private:
+
+        mapped_file m_file;
+        snapshot_kind m_kind = snapshot_kind::full;
+        uint64_t m_sequence = 0;
+        gsl::span<const entt::entity> m_entities;
+        std::vector<snapshot_section> m_sections;
+    };
+
+    /**
+     * @brief Collects component arrays and writes them into a snapshot.
+     * Only spans are kept, the arrays have to stay alive and unchanged until write() returns.
+     */
+    class scene_snapshot_writer {
+    public:
+
+        /**
+         * @brief Start an empty snapshot.
+         * @param kind Full snapshot or delta
+         * @param sequence 0 for full snapshots, the position in the save chain for deltas
+         */
+        scene_snapshot_writer(snapshot_kind kind, uint64_t sequence) noexcept;
+
+        /**
+         * @brief Set the entities alive in the scene.
+         * @param entities Entities
+         */
+        void set_entities(gsl::span<const entt::entity> entities) noexcept;
+
+        /**
+         * @brief Add the values of a component. Throws a std::invalid_argument if the sizes don't match or
+         * the component was added already.
+         * @param component_id Id of the component
+         * @param element_size Size of one value
+         * @param entities Entities in the order of the values
+         * @param values element_size bytes per entity
+         */
+        void add_values(uint32_t component_id, uint32_t element_size,
+                        gsl::span<const entt::entity> entities, gsl::span<const std::byte> values);
+
+        /**
+         * @brief Add the entities a component was removed from. Throws a std::invalid_argument for full snapshots
+         * or if the removals of the component were added already.
+         * @param component_id Id of the component
+         * @param entities Entities
+         */
+        void add_removed(uint32_t component_id, gsl::span<const entt::entity> entities);
+
+        /**
+         * @brief Write the snapshot.
+         * The data goes to a temporary file first which then replaces p, so a crash never leaves a truncated save behind.
+         * @param p Path of the snapshot, replaced if it exists
+         * @return Size of the snapshot in bytes or an error if it couldn't be written
+         */
+        [[nodiscard]] result<uint64_t, std::runtime_error> write(const std::filesystem::path& p) const;
+
+    private:
+
+        snapshot_kind m_kind;
+        uint64_t m_sequence;
+        gsl::span<const entt::entity> m_entities;
+        std::vector<snapshot_section> m_sections;
+
+        void add_section(const snapshot_section& section);
+    };
+}
+
+#endif //BAMBOOENGINE_SCENE_SNAPSHOT_HPP
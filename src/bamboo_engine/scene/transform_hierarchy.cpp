@@ -0,0 +1,187 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include "transform_hierarchy.hpp"
+#include "../util/hot_log.hpp"
+
+namespace bbge {
+
+    transform_hierarchy::transform_hierarchy(entt::registry& registry)
+      : m_registry(registry), m_structure_changed(true), m_last_update_count(0) {
+
+        m_registry.on_construct<transform_component>().connect<&transform_hierarchy::on_structure_changed>(*this);
+        m_registry.on_destroy<transform_component>().connect<&transform_hierarchy::on_structure_changed>(*this);
+        m_registry.on_update<transform_component>().connect<&transform_hierarchy::on_transform_changed>(*this);
+        m_registry.on_construct<parent_component>().connect<&transform_hierarchy::on_structure_changed>(*this);
+        m_registry.on_destroy<parent_component>().connect<&transform_hierarchy::on_structure_changed>(*this);
+        m_registry.on_update<parent_component>().connect<&transform_hierarchy::on_structure_changed>(*this);
+    }
+
+    transform_hierarchy::~transform_hierarchy() {
+        m_registry.on_construct<transform_component>().disconnect<&transform_hierarchy::on_structure_changed>(*this);
+        m_registry.on_destroy<transform_component>().disconnect<&transform_hierarchy::on_structure_changed>(*this);
+        m_registry.on_update<transform_component>().disconnect<&transform_hierarchy::on_transform_changed>(*this);
+        m_registry.on_construct<parent_component>().disconnect<&transform_hierarchy::on_structure_changed>(*this);
+        m_registry.on_destroy<parent_component>().disconnect<&transform_hierarchy::on_structure_changed>(*this);
+        m_registry.on_update<parent_component>().disconnect<&transform_hierarchy::on_structure_changed>(*this);
+    }
+
+    void transform_hierarchy::mark_dirty(entt::entity e) {
+        if (m_structure_changed) return; // everything is recomputed anyway
+        auto it = m_indices.find(e);
+        if (it != m_indices.end()) {
+            m_dirty[it->second] = 1;
+        }
+    }
+
+    void transform_hierarchy::update(job_system* jobs, std::size_t parallel_threshold) {
+
+        if (m_structure_changed) {
+            rebuild();
+        }
+
+        m_last_update_count = 0;
+        for (std::size_t level = 0; level + 1 < m_level_offsets.size(); ++level) {
+            auto first = m_level_offsets[level];
+            auto last = m_level_offsets[level + 1];
+            auto n = last - first;
+
+            if (!jobs || n < std::max<std::size_t>(parallel_threshold, 1)) {
+                m_last_update_count += update_range(first, last);
+                continue;
+            }
+
+            // nodes of one level only read their parents, which were finished with the previous level
+            std::atomic<std::size_t> updated = 0;
+            jobs->parallel_for(first, last, 1, [this, &updated](std::size_t begin, std::size_t end) {
+                updated.fetch_add(update_range(begin, end), std::memory_order_relaxed);
+            });
+            m_last_update_count += updated.load(std::memory_order_relaxed);
+        }
+
+        std::fill(m_dirty.begin(), m_dirty.end(), uint8_t(0));
+    }
+
+    std::size_t transform_hierarchy::get_node_count() const noexcept {
+        return m_entities.size();
+    }
+
+    std::size_t transform_hierarchy::get_depth() const noexcept {
+        return m_level_offsets.empty() ? 0 : m_level_offsets.size() - 1;
+    }
+
+    std::size_t transform_hierarchy::get_last_update_count() const noexcept {
+        return m_last_update_count;
+    }
+
+    void transform_hierarchy::on_transform_changed(entt::registry&, entt::entity e) {
+        mark_dirty(e);
+    }
+
+    void transform_hierarchy::on_structure_changed(entt::registry&, entt::entity) {
+        m_structure_changed = true;
+    }
+
+    entt::entity transform_hierarchy::get_parent(entt::entity e) const {
+        const auto* p = m_registry.try_get<parent_component>(e);
+        if (!p || p->parent == entt::null || !m_registry.valid(p->parent) || !m_registry.has<transform_component>(p->parent)) {
+            return entt::null;
+        }
+        return p->parent;
+    }
+
+    void transform_hierarchy::rebuild() {
+
+        auto view = m_registry.view<transform_component>();
+
+        // depth of every node, each parent chain is only walked once
+        tsl::robin_map<entt::entity, uint32_t> depths;
+        depths.reserve(view.size());
+        std::vector<entt::entity> chain;
+        uint32_t max_depth = 0;
+        for (auto e : view) {
+            chain.clear();
+            auto current = e;
+            while (current != entt::null && depths.find(current) == depths.end()) {
+                if (chain.size() > view.size()) {
+                    throw std::logic_error("The transform hierarchy contains a cycle.");
+                }
+                chain.push_back(current);
+                current = get_parent(current);
+            }
+            uint32_t depth = current == entt::null ? 0 : depths[current] + 1;
+            for (auto it = chain.rbegin(); it != chain.rend(); ++it, ++depth) {
+                depths[*it] = depth;
+                max_depth = std::max(max_depth, depth);
+            }
+        }
+
+        // counting sort by depth
+        m_level_offsets.assign(view.empty() ? 0 : max_depth + 2, 0);
+        for (const auto& [e, depth] : depths) {
+            ++m_level_offsets[depth + 1];
+        }
+        for (std::size_t i = 1; i < m_level_offsets.size(); ++i) {
+            m_level_offsets[i] += m_level_offsets[i - 1];
+        }
+
+        auto n = depths.size();
+        m_entities.resize(n);
+        m_indices.clear();
+        m_indices.reserve(n);
+        std::vector<std::size_t> next(m_level_offsets.begin(), m_level_offsets.end());
+        for (const auto& [e, depth] : depths) {
+            auto i = next[depth]++;
+            m_entities[i] = e;
+            m_indices[e] = static_cast<uint32_t>(i);
+        }
+
+        m_parents.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            auto parent = get_parent(m_entities[i]);
+            m_parents[i] = parent == entt::null ? no_parent : m_indices[parent];
+            m_registry.get_or_emplace<world_transform_component>(m_entities[i]);
+        }
+
+        m_world.resize(n);
+        m_dirty.assign(n, 1);
+        m_structure_changed = false;
+
+        BBGE_HOT_DEBUG("Rebuilt transform hierarchy with {} nodes in {} levels.", n, get_depth());
+    }
+
+    std::size_t transform_hierarchy::update_range(std::size_t first, std::size_t last) noexcept {
+
+        std::size_t updated = 0;
+        for (auto i = first; i < last; ++i) {
+            auto parent = m_parents[i];
+            if (parent != no_parent && m_dirty[parent]) {
+                m_dirty[i] = 1;
+            }
+            if (!m_dirty[i]) continue;
+
+            auto local = to_matrix(m_registry.get<transform_component>(m_entities[i]));
+            m_world[i] = parent == no_parent ? local : m_world[parent] * local;
+            m_registry.get<world_transform_component>(m_entities[i]).matrix = m_world[i];
+            ++updated;
+        }
+        return updated;
+    }
+}
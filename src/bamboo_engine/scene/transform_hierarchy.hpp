@@ -0,0 +1,105 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_TRANSFORM_HIERARCHY_HPP
+#define BAMBOOENGINE_TRANSFORM_HIERARCHY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <tsl/robin_map.h>
+#include "components.hpp"
+#include "../util/macros.hpp"
+#include "../util/job_system.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Keeps the world_transform_component of every entity with a transform_component up to date.
+     * Nodes are stored sorted by depth, so every parent is updated before its children and
+     * the nodes of one depth don't depend on each other. Only dirty nodes and their descendants are recomputed.
+     *
+     * Replacing or patching a transform_component marks it dirty automatically,
+     * transforms changed through registry::get have to be marked with mark_dirty.
+     * Adding, removing or reparenting entities rebuilds the node arrays on the next update.
+     */
+    class transform_hierarchy {
+    public:
+
+        // levels smaller than this are updated on the calling thread
+        static constexpr const std::size_t default_parallel_threshold = 4096;
+
+        BBGE_NO_COPIES(transform_hierarchy);
+        BBGE_NO_MOVES(transform_hierarchy);
+
+        /**
+         * @brief Start tracking a registry. The registry has to outlive the hierarchy.
+         * @param registry Scene
+         */
+        explicit transform_hierarchy(entt::registry& registry);
+
+        ~transform_hierarchy();
+
+        /**
+         * @brief Mark an entity's transform as changed.
+         * @param e Entity with a transform_component
+         */
+        void mark_dirty(entt::entity e);
+
+        /**
+         * @brief Recompute the world matrices of dirty nodes and their descendants.
+         * Throws a std::logic_error if the parents form a cycle.
+         * @param jobs Optional job system wide levels are split across
+         * @param parallel_threshold Minimum size of a level before it's split
+         */
+        void update(job_system* jobs = nullptr, std::size_t parallel_threshold = default_parallel_threshold);
+
+        [[nodiscard]] std::size_t get_node_count() const noexcept;
+        [[nodiscard]] std::size_t get_depth() const noexcept;
+
+        /**
+         * @brief Get the number of world matrices recomputed by the last update.
+         */
+        [[nodiscard]] std::size_t get_last_update_count() const noexcept;
+
+    private:
+
+        static constexpr const uint32_t no_parent = UINT32_MAX;
+
+        entt::registry& m_registry;
+
+        // nodes sorted by depth, parents always precede their children
+        std::vector<entt::entity> m_entities;
+        std::vector<uint32_t> m_parents;
+        std::vector<glm::mat4> m_world;
+        std::vector<uint8_t> m_dirty;
+        std::vector<std::size_t> m_level_offsets; // first node of every level plus the node count
+        tsl::robin_map<entt::entity, uint32_t> m_indices;
+        bool m_structure_changed;
+        std::size_t m_last_update_count;
+
+        void on_transform_changed(entt::registry& registry, entt::entity e);
+        void on_structure_changed(entt::registry& registry, entt::entity e);
+        void rebuild();
+        [[nodiscard]] entt::entity get_parent(entt::entity e) const;
+        [[nodiscard]] std::size_t update_range(std::size_t first, std::size_t last) noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_TRANSFORM_HIERARCHY_HPP
@@ -0,0 +1,48 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdio>
+#include <exception>
+#include <fmt/format.h>
+#include <bamboo_engine/util/asset_archive.hpp>
+
+// Packs a directory into an asset archive: bamboo-engine-asset-packer <directory> <archive>
+int main(int argc, char** argv) {
+
+    if (argc != 3) {
+        fmt::print(stderr, "Usage: {} <directory> <archive>\n", argc > 0 ? argv[0] : "bamboo-engine-asset-packer");
+        return 2;
+    }
+
+    try {
+        bbge::asset_archive_writer writer;
+        writer.add_directory(argv[1]);
+
+        auto written = writer.write(argv[2]);
+        if (!written) {
+            fmt::print(stderr, "{}\n", written.err()->what());
+            return 1;
+        }
+        fmt::print("Packed {} assets from '{}' into '{}' ({} bytes).\n", writer.size(), argv[1], argv[2], *written.ok());
+    }
+    catch (const std::exception& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+
+    return 0;
+}
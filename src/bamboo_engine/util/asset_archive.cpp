@@ -0,0 +1,290 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <fmt/format.h>
+#include "asset_archive.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        struct archive_header {
+            std::array<char, 4> magic;
+            uint32_t version;
+            uint32_t entry_count;
+            uint32_t reserved;
+            uint64_t names_offset;
+            uint64_t names_size;
+        };
+        static_assert(sizeof(archive_header) == 32);
+
+        struct archive_index_record {
+            uint64_t name_offset; // relative to the name table
+            uint64_t offset;
+            uint64_t size;
+            uint64_t uncompressed_size;
+            uint64_t content_hash;
+            uint32_t name_size;
+            uint32_t compression;
+        };
+        static_assert(sizeof(archive_index_record) == 48);
+
+        constexpr const uint64_t fnv1a_offset_basis = 14695981039346656037ull;
+        constexpr const uint64_t fnv1a_prime = 1099511628211ull;
+
+        constexpr uint64_t align_up(uint64_t v, uint64_t alignment) noexcept {
+            return (v + alignment - 1) / alignment * alignment;
+        }
+
+        // records and header are read with memcpy, nothing in the file is trusted to be aligned
+        template <typename T>
+        T read_at(gsl::span<const std::byte> bytes, uint64_t offset) noexcept {
+            T v;
+            std::memcpy(&v, bytes.data() + offset, sizeof(T));
+            return v;
+        }
+
+        bool in_bounds(uint64_t offset, uint64_t size, uint64_t total) noexcept {
+            return offset <= total && size <= total - offset;
+        }
+    }
+
+    std::string_view to_string(asset_compression c) noexcept {
+        switch (c) {
+            case asset_compression::none: return "none";
+            case asset_compression::lz4:  return "lz4";
+            case asset_compression::zstd: return "zstd";
+        }
+        return "unknown";
+    }
+
+    uint64_t fnv1a_64(gsl::span<const std::byte> data) noexcept {
+        uint64_t hash = fnv1a_offset_basis;
+        for (std::byte b : data) {
+            hash ^= std::to_integer<uint64_t>(b);
+            hash *= fnv1a_prime;
+        }
+        return hash;
+    }
+
+    uint64_t fnv1a_64(std::string_view str) noexcept {
+        uint64_t hash = fnv1a_offset_basis;
+        for (char c : str) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= fnv1a_prime;
+        }
+        return hash;
+    }
+
+    std::size_t asset_archive::name_hash::operator()(std::string_view name) const noexcept {
+        return static_cast<std::size_t>(fnv1a_64(name));
+    }
+
+    result<asset_archive, std::runtime_error> asset_archive::open(const std::filesystem::path& p) {
+
+        auto file = mapped_file::open(p);
+        if (!file) {
+            return *file.err();
+        }
+
+        auto bytes = file.ok()->get_contents();
+        auto total = static_cast<uint64_t>(bytes.size());
+        auto malformed = [&p](std::string_view reason) {
+            return std::runtime_error(fmt::format("Malformed asset archive '{}': {}.", p.string(), reason));
+        };
+
+        if (total < sizeof(archive_header)) {
+            return malformed("too small for the header");
+        }
+        auto header = read_at<archive_header>(bytes, 0);
+        if (header.magic != magic) {
+            return malformed("wrong magic");
+        }
+        if (header.version != format_version) {
+            return malformed(fmt::format("unsupported version {}, expected {}", header.version, format_version));
+        }
+        if (!in_bounds(sizeof(archive_header), uint64_t(header.entry_count) * sizeof(archive_index_record), total)) {
+            return malformed("index out of bounds");
+        }
+        if (!in_bounds(header.names_offset, header.names_size, total)) {
+            return malformed("name table out of bounds");
+        }
+
+        asset_archive archive;
+        archive.m_index.reserve(header.entry_count);
+        const auto* names = reinterpret_cast<const char*>(bytes.data() + header.names_offset);
+
+        for (uint32_t i = 0; i < header.entry_count; ++i) {
+            auto record = read_at<archive_index_record>(bytes, sizeof(archive_header) + uint64_t(i) * sizeof(archive_index_record));
+
+            if (!in_bounds(record.name_offset, record.name_size, header.names_size)) {
+                return malformed(fmt::format("name of entry {} out of bounds", i));
+            }
+            if (!in_bounds(record.offset, record.size, total)) {
+                return malformed(fmt::format("data of entry {} out of bounds", i));
+            }
+            if (record.compression > static_cast<uint32_t>(asset_compression::zstd)) {
+                return malformed(fmt::format("unknown compression {} of entry {}", record.compression, i));
+            }
+
+            std::string_view name(names + record.name_offset, record.name_size);
+            asset_entry entry {
+                record.offset, record.size, record.uncompressed_size, record.content_hash,
+                static_cast<asset_compression>(record.compression)
+            };
+            if (!archive.m_index.emplace(name, entry).second) {
+                return malformed(fmt::format("duplicate entry '{}'", name));
+            }
+        }
+
+        archive.m_file = std::move(*file.ok());
+        SPDLOG_DEBUG("Opened asset archive '{}' with {} assets ({} bytes).", p.string(), archive.size(), total);
+        return archive;
+    }
+
+    const asset_entry* asset_archive::find(std::string_view name) const noexcept {
+        auto it = m_index.find(name);
+        return it == m_index.end() ? nullptr : &it->second;
+    }
+
+    result<gsl::span<const std::byte>, std::runtime_error> asset_archive::get_contents(std::string_view name) const {
+
+        const auto* entry = find(name);
+        if (!entry) {
+            return std::runtime_error(fmt::format("Asset '{}' is not in the archive.", name));
+        }
+        if (entry->compression != asset_compression::none) {
+            // the packer only writes uncompressed assets, there is no decompressor in the engine yet
+            return std::runtime_error(fmt::format(
+                "Asset '{}' is compressed with {}, which is not supported.", name, to_string(entry->compression)
+            ));
+        }
+        return m_file.get_contents().subspan(entry->offset, entry->size);
+    }
+
+    bool asset_archive::verify(const asset_entry& entry) const noexcept {
+        if (entry.compression != asset_compression::none) {
+            return false;
+        }
+        return fnv1a_64(m_file.get_contents().subspan(entry.offset, entry.size)) == entry.content_hash;
+    }
+
+    std::size_t asset_archive::size() const noexcept {
+        return m_index.size();
+    }
+
+    void asset_archive_writer::add(std::string name, std::vector<std::byte> contents) {
+
+        if (name.empty()) {
+            throw std::invalid_argument("Asset names must not be empty.");
+        }
+        auto duplicate = std::any_of(m_assets.begin(), m_assets.end(), [&name](const pending_asset& a) {
+            return a.name == name;
+        });
+        if (duplicate) {
+            throw std::invalid_argument(fmt::format("Asset '{}' was already added.", name));
+        }
+
+        m_assets.push_back({ std::move(name), std::move(contents) });
+    }
+
+    void asset_archive_writer::add_directory(const std::filesystem::path& root) {
+
+        for (const auto& it : std::filesystem::recursive_directory_iterator(root)) {
+            if (!it.is_regular_file()) continue;
+
+            std::ifstream is(it.path(), std::ios_base::binary);
+            if (!is) {
+                throw std::runtime_error(fmt::format("Failed to read asset '{}'.", it.path().string()));
+            }
+            std::vector<std::byte> contents(it.file_size());
+            is.read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+            if (is.gcount() != static_cast<std::streamsize>(contents.size())) {
+                throw std::runtime_error(fmt::format("Failed to read asset '{}'.", it.path().string()));
+            }
+
+            add(std::filesystem::relative(it.path(), root).generic_string(), std::move(contents));
+        }
+    }
+
+    result<uint64_t, std::runtime_error> asset_archive_writer::write(const std::filesystem::path& p) const {
+
+        // sorted so that archives of the same assets are byte identical
+        std::vector<const pending_asset*> sorted;
+        sorted.reserve(m_assets.size());
+        for (const auto& a : m_assets) sorted.push_back(&a);
+        std::sort(sorted.begin(), sorted.end(), [](const pending_asset* a, const pending_asset* b) {
+            return a->name < b->name;
+        });
+
+        archive_header header { };
+        header.magic = asset_archive::magic;
+        header.version = asset_archive::format_version;
+        header.entry_count = static_cast<uint32_t>(sorted.size());
+        header.names_offset = sizeof(archive_header) + sorted.size() * sizeof(archive_index_record);
+
+        std::vector<archive_index_record> records(sorted.size());
+        std::string names;
+        for (std::size_t i = 0; i < sorted.size(); ++i) {
+            records[i].name_offset = names.size();
+            records[i].name_size = static_cast<uint32_t>(sorted[i]->name.size());
+            names += sorted[i]->name;
+        }
+        header.names_size = names.size();
+
+        uint64_t offset = header.names_offset + header.names_size;
+        for (std::size_t i = 0; i < sorted.size(); ++i) {
+            const auto& contents = sorted[i]->contents;
+            offset = align_up(offset, asset_archive::data_alignment);
+            records[i].offset = offset;
+            records[i].size = contents.size();
+            records[i].uncompressed_size = contents.size();
+            records[i].content_hash = fnv1a_64(gsl::span<const std::byte>(contents.data(), contents.size()));
+            records[i].compression = static_cast<uint32_t>(asset_compression::none);
+            offset += contents.size();
+        }
+
+        std::ofstream os(p, std::ios_base::binary | std::ios_base::trunc);
+        if (!os) {
+            return std::runtime_error(fmt::format("Failed to open '{}' for writing.", p.string()));
+        }
+
+        static constexpr const std::array<char, asset_archive::data_alignment> padding { };
+        os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        os.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(archive_index_record)));
+        os.write(names.data(), static_cast<std::streamsize>(names.size()));
+        uint64_t written = header.names_offset + header.names_size;
+        for (std::size_t i = 0; i < sorted.size(); ++i) {
+            os.write(padding.data(), static_cast<std::streamsize>(records[i].offset - written));
+            os.write(reinterpret_cast<const char*>(sorted[i]->contents.data()), static_cast<std::streamsize>(records[i].size));
+            written = records[i].offset + records[i].size;
+        }
+
+        if (!os) {
+            return std::runtime_error(fmt::format("Failed to write asset archive '{}'.", p.string()));
+        }
+        return written;
+    }
+
+    std::size_t asset_archive_writer::size() const noexcept {
+        return m_assets.size();
+    }
+}
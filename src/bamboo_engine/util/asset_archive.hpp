@@ -0,0 +1,181 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_ASSET_ARCHIVE_HPP
+#define BAMBOOENGINE_ASSET_ARCHIVE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <gsl/gsl-lite.hpp>
+#include <tsl/robin_map.h>
+#include "macros.hpp"
+#include "mapped_file.hpp"
+#include "result.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Compression of an archived asset.
+     */
+    enum class asset_compression : uint32_t {
+        none = 0,
+        lz4  = 1,
+        zstd = 2
+    };
+
+    [[nodiscard]] std::string_view to_string(asset_compression c) noexcept;
+
+    /**
+     * @brief 64 bit FNV-1a hash.
+     * @param data Bytes to hash
+     * @return The hash
+     */
+    [[nodiscard]] uint64_t fnv1a_64(gsl::span<const std::byte> data) noexcept;
+
+    /**
+     * @brief 64 bit FNV-1a hash of a string.
+     */
+    [[nodiscard]] uint64_t fnv1a_64(std::string_view str) noexcept;
+
+    /**
+     * @brief Location of an asset inside an archive.
+     */
+    struct asset_entry {
+        uint64_t offset;            // from the start of the archive
+        uint64_t size;              // as stored in the archive
+        uint64_t uncompressed_size;
+        uint64_t content_hash;      // FNV-1a of the uncompressed contents
+        asset_compression compression;
+    };
+
+    /**
+     * @brief Read-only, memory mapped archive of many assets.
+     * Opening the archive maps one file and reads its index, so looking up an asset doesn't touch the file system.
+     *
+     * Layout, all integers little endian:
+     *   header      magic "BBGA", version, entry count, offset and size of the name table
+     *   index       one record per asset, sorted by name
+     *   names       asset names, not null terminated
+     *   data        asset contents, each aligned to data_alignment
+     */
+    class asset_archive {
+    public:
+
+        static constexpr const std::array<char, 4> magic { 'B', 'B', 'G', 'A' };
+        static constexpr const uint32_t format_version = 1;
+        static constexpr const uint64_t data_alignment = 16; // enough for SPIR-V and any vertex data
+
+        BBGE_NO_COPIES(asset_archive);
+
+        asset_archive() = default;
+        asset_archive(asset_archive&& other) noexcept = default;
+        asset_archive& operator=(asset_archive&& other) noexcept = default;
+        ~asset_archive() = default;
+
+        /**
+         * @brief Map an archive and read its index.
+         * @param p Path to the archive
+         * @return The archive or an error if it is missing or malformed
+         */
+        [[nodiscard]] static result<asset_archive, std::runtime_error> open(const std::filesystem::path& p);
+
+        /**
+         * @brief Look up an asset.
+         * @param name Name of the asset, a path relative to the packed directory with '/' separators
+         * @return The entry or nullptr if there is no such asset
+         */
+        [[nodiscard]] const asset_entry* find(std::string_view name) const noexcept;
+
+        /**
+         * @brief Get the contents of an uncompressed asset without copying them.
+         * Only valid as long as the archive lives.
+         * @param name Name of the asset
+         * @return The contents or an error if the asset is missing or compressed
+         */
+        [[nodiscard]] result<gsl::span<const std::byte>, std::runtime_error> get_contents(std::string_view name) const;
+
+        /**
+         * @brief Check an uncompressed asset's contents against its content hash.
+         * This touches every page of the asset, so it's meant for tools and debugging.
+         * @param entry Entry of this archive
+         * @return True if the contents match
+         */
+        [[nodiscard]] bool verify(const asset_entry& entry) const noexcept;
+
+        /**
+         * @brief Get the number of assets.
+         */
+        [[nodiscard]] std::size_t size() const noexcept;
+
+    private:
+
+        struct name_hash {
+            std::size_t operator()(std::string_view name) const noexcept;
+        };
+
+        mapped_file m_file;
+        // the keys point into the mapping, which doesn't move when the archive does
+        tsl::robin_map<std::string_view, asset_entry, name_hash> m_index;
+    };
+
+    /**
+     * @brief Collects assets and writes them into an archive.
+     */
+    class asset_archive_writer {
+    public:
+
+        /**
+         * @brief Add an asset. Throws a std::invalid_argument if the name is empty or was already added.
+         * @param name Name of the asset
+         * @param contents Contents of the asset, stored uncompressed
+         */
+        void add(std::string name, std::vector<std::byte> contents);
+
+        /**
+         * @brief Add every regular file of a directory and its subdirectories.
+         * Names are the paths relative to the directory. Throws a std::runtime_error if a file can't be read.
+         * @param root Directory to pack
+         */
+        void add_directory(const std::filesystem::path& root);
+
+        /**
+         * @brief Write the archive.
+         * @param p Path of the archive, overwritten if it exists
+         * @return Size of the archive in bytes or an error if it couldn't be written
+         */
+        [[nodiscard]] result<uint64_t, std::runtime_error> write(const std::filesystem::path& p) const;
+
+        [[nodiscard]] std::size_t size() const noexcept;
+
+    private:
+
+        struct pending_asset {
+            std::string name;
+            std::vector<std::byte> contents;
+        };
+
+        std::vector<pending_asset> m_assets;
+    };
+}
+
+#endif //BAMBOOENGINE_ASSET_ARCHIVE_HPP
@@ -0,0 +1,243 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <fmt/format.h>
+#if __has_include(<fmt/args.h>)
+    #include <fmt/args.h>
+#endif
+#include "hot_log.hpp"
+
+namespace bbge {
+
+    std::atomic<hot_logger*> hot_logger::s_active { nullptr };
+    std::atomic<uint64_t> hot_logger::s_generation { 0 };
+
+    hot_logger::hot_logger(std::size_t queue_capacity, log_overflow overflow, std::chrono::milliseconds poll_interval)
+      : m_queue_capacity(queue_capacity), m_overflow(overflow), m_poll_interval(poll_interval),
+        m_generation(++s_generation), m_dropped(0), m_stopping(false) {
+
+        if (queue_capacity == 0 || (queue_capacity & (queue_capacity - 1)) != 0) {
+            throw std::invalid_argument("The hot log queue capacity has to be a power of two.");
+        }
+
+        m_thread = std::thread(&hot_logger::run, this);
+        s_active.store(this, std::memory_order_release);
+
+        SPDLOG_TRACE("Created hot logger with {} records per thread, overflow policy {}.", queue_capacity, to_string(overflow));
+    }
+
+    hot_logger::~hot_logger() {
+
+        // threads that still log see no logger and discard their messages
+        hot_logger* expected = this;
+        s_active.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+
+        {
+            std::lock_guard lock(m_stop_mutex);
+            m_stopping = true;
+        }
+        m_stop_condition.notify_one();
+        m_thread.join();
+
+        drain();
+        SPDLOG_TRACE("Destroyed hot logger, {} records were dropped.", get_dropped());
+    }
+
+    hot_logger* hot_logger::get() noexcept {
+        return s_active.load(std::memory_order_acquire);
+    }
+
+    void hot_logger::push(const hot_log_record& record) noexcept {
+
+        queue* q;
+        try {
+            q = &get_thread_queue();
+        }
+        catch (...) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        if (q->ring.try_push(record)) {
+            return;
+        }
+
+        if (m_overflow == log_overflow::drop) {
+            q->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        while (!q->ring.try_push(record)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void hot_logger::flush() {
+        drain();
+        spdlog::default_logger_raw()->flush();
+    }
+
+    uint64_t hot_logger::get_dropped() const noexcept {
+        uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+        std::lock_guard lock(m_queues_mutex);
+        for (const auto& q : m_queues) {
+            dropped += q->dropped.load(std::memory_order_relaxed);
+        }
+        return dropped;
+    }
+
+    hot_logger::thread_queue::~thread_queue() {
+        if (q) {
+            q->abandoned.store(true, std::memory_order_release);
+        }
+    }
+
+    hot_logger::queue& hot_logger::get_thread_queue() {
+
+        // the generation tells queues of a previous logger at the same address apart
+        thread_local thread_queue local { };
+        if (local.generation == m_generation) {
+            return *local.q;
+        }
+
+        auto q = std::make_shared<queue>(m_queue_capacity);
+        q->thread = spdlog::details::os::thread_id();
+        {
+            std::lock_guard lock(m_queues_mutex);
+            m_queues.push_back(q);
+        }
+        if (local.q) {
+            local.q->abandoned.store(true, std::memory_order_release);
+        }
+        local.q = std::move(q);
+        local.generation = m_generation;
+        return *local.q;
+    }
+
+    void hot_logger::run() noexcept {
+        std::unique_lock lock(m_stop_mutex);
+        while (!m_stop_condition.wait_for(lock, m_poll_interval, [this]() { return m_stopping; })) {
+            lock.unlock();
+            try {
+                drain();
+            }
+            catch (const std::exception& e) {
+                SPDLOG_ERROR("Failed to forward hot log records: {}", e.what());
+            }
+            lock.lock();
+        }
+    }
+
+    void hot_logger::drain() {
+
+        std::lock_guard drain_lock(m_drain_mutex);
+
+        std::vector<std::shared_ptr<queue>> queues;
+        {
+            std::lock_guard lock(m_queues_mutex);
+            queues = m_queues;
+        }
+
+        hot_log_record record;
+        for (const auto& q : queues) {
+            // an abandoned queue gets no more records, so it is done once it is empty
+            bool abandoned = q->abandoned.load(std::memory_order_acquire);
+            while (q->ring.try_pop(record)) {
+                write(record);
+            }
+
+            auto dropped = q->dropped.exchange(0, std::memory_order_relaxed);
+            if (dropped > 0) {
+                m_dropped.fetch_add(dropped, std::memory_order_relaxed);
+                SPDLOG_WARN("Hot log queue of thread {} was full, dropped {} records.", q->thread, dropped);
+            }
+
+            if (abandoned) {
+                std::lock_guard lock(m_queues_mutex);
+                m_queues.erase(std::remove(m_queues.begin(), m_queues.end(), q), m_queues.end());
+            }
+        }
+    }
+
+    void hot_logger::write(const hot_log_record& record) {
+
+        fmt::dynamic_format_arg_store<fmt::format_context> args;
+        std::size_t offset = 0;
+        auto read = [&](auto& value) {
+            std::memcpy(&value, record.payload.data() + offset, sizeof(value));
+            offset += sizeof(value);
+        };
+
+        for (uint8_t i = 0; i < record.arg_count; ++i) {
+            switch (record.types[i]) {
+                case hot_log_arg_type::int64: {
+                    int64_t v;
+                    read(v);
+                    args.push_back(v);
+                    break;
+                }
+                case hot_log_arg_type::uint64: {
+                    uint64_t v;
+                    read(v);
+                    args.push_back(v);
+                    break;
+                }
+                case hot_log_arg_type::float64: {
+                    double v;
+                    read(v);
+                    args.push_back(v);
+                    break;
+                }
+                case hot_log_arg_type::boolean: {
+                    bool v;
+                    read(v);
+                    args.push_back(v);
+                    break;
+                }
+                case hot_log_arg_type::pointer: {
+                    const void* v;
+                    read(v);
+                    args.push_back(v);
+                    break;
+                }
+                case hot_log_arg_type::string: {
+                    auto length = static_cast<std::size_t>(record.payload[offset]);
+                    const auto* data = reinterpret_cast<const char*>(record.payload.data() + offset + 1);
+                    args.push_back(std::string(data, length));
+                    offset += 1 + length;
+                    break;
+                }
+                case hot_log_arg_type::truncated:
+                    args.push_back(std::string_view("..."));
+                    break;
+            }
+        }
+
+        const auto& site = *record.site;
+        std::string message;
+        try {
+            message = fmt::vformat(site.format, args);
+        }
+        catch (const fmt::format_error& e) {
+            message = fmt::format("Invalid hot log format string \"{}\": {}", site.format, e.what());
+        }
+        spdlog::default_logger_raw()->log(site.location, site.level, message);
+    }
+}
@@ -0,0 +1,274 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_HOT_LOG_HPP
+#define BAMBOOENGINE_HOT_LOG_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "logging.hpp"
+#include "macros.hpp"
+#include "spsc_ring.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief A log call site. Its address identifies the format string of a record.
+     */
+    struct hot_log_site {
+        spdlog::level::level_enum level;
+        const char*               format;
+        spdlog::source_loc        location;
+    };
+
+    enum class hot_log_arg_type : uint8_t {
+        int64, uint64, float64, boolean, pointer, string, truncated
+    };
+
+    /**
+     * @brief Unformatted log message, the arguments are stored back to back in the payload.
+     */
+    struct hot_log_record {
+
+        static constexpr const std::size_t max_args = 8;
+        static constexpr const std::size_t payload_size = 110;
+
+        const hot_log_site*                         site;
+        uint8_t                                     arg_count;
+        uint8_t                                     payload_used;
+        std::array<hot_log_arg_type, max_args>      types;
+        std::array<std::byte, payload_size>         payload;
+    };
+    static_assert(sizeof(hot_log_record) == 128, "Records should fill two cache lines");
+
+    namespace detail {
+
+        template <typename>
+        inline constexpr bool hot_log_unsupported = false;
+
+        inline void encode_hot_log_value(hot_log_record& r, uint8_t index, hot_log_arg_type type,
+                                         const void* data, std::size_t size) noexcept {
+            if (r.payload_used + size > hot_log_record::payload_size) {
+                r.types[index] = hot_log_arg_type::truncated;
+                return;
+            }
+            r.types[index] = type;
+            std::memcpy(r.payload.data() + r.payload_used, data, size);
+            r.payload_used = static_cast<uint8_t>(r.payload_used + size);
+        }
+
+        inline void encode_hot_log_string(hot_log_record& r, uint8_t index, std::string_view s) noexcept {
+            // one length byte, the string is cut to whatever is left
+            std::size_t available = hot_log_record::payload_size - r.payload_used;
+            if (available == 0) {
+                r.types[index] = hot_log_arg_type::truncated;
+                return;
+            }
+            auto length = static_cast<uint8_t>(std::min<std::size_t>({ s.size(), available - 1, 255 }));
+            r.types[index] = hot_log_arg_type::string;
+            r.payload[r.payload_used] = static_cast<std::byte>(length);
+            std::memcpy(r.payload.data() + r.payload_used + 1, s.data(), length);
+            r.payload_used = static_cast<uint8_t>(r.payload_used + 1 + length);
+        }
+
+        template <typename T>
+        void encode_hot_log_arg(hot_log_record& r, uint8_t index, const T& value) noexcept {
+            if constexpr (std::is_same_v<T, bool>) {
+                encode_hot_log_value(r, index, hot_log_arg_type::boolean, &value, sizeof(bool));
+            }
+            else if constexpr (std::is_enum_v<T>) {
+                encode_hot_log_arg(r, index, static_cast<std::underlying_type_t<T>>(value));
+            }
+            else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+                auto v = static_cast<int64_t>(value);
+                encode_hot_log_value(r, index, hot_log_arg_type::int64, &v, sizeof(v));
+            }
+            else if constexpr (std::is_integral_v<T>) {
+                auto v = static_cast<uint64_t>(value);
+                encode_hot_log_value(r, index, hot_log_arg_type::uint64, &v, sizeof(v));
+            }
+            else if constexpr (std::is_floating_point_v<T>) {
+                auto v = static_cast<double>(value);
+                encode_hot_log_value(r, index, hot_log_arg_type::float64, &v, sizeof(v));
+            }
+            else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+                encode_hot_log_string(r, index, std::string_view(value));
+            }
+            else if constexpr (std::is_pointer_v<T>) {
+                auto v = static_cast<const void*>(value);
+                encode_hot_log_value(r, index, hot_log_arg_type::pointer, &v, sizeof(v));
+            }
+            else {
+                static_assert(hot_log_unsupported<T>, "Hot log arguments have to be numbers, strings or pointers");
+            }
+        }
+    }
+
+    /**
+     * @brief Logging for hot loops that never formats or locks on the calling thread.
+     * Every thread gets its own SPSC ring of records on its first message, a background thread formats them
+     * and forwards them to the default spdlog logger. Strings are copied and may be cut short.
+     * Use the BBGE_HOT_* macros, messages are dropped while no hot logger exists.
+     */
+    class hot_logger {
+    public:
+
+        static constexpr const std::size_t default_queue_capacity = 4096;
+        static constexpr const std::chrono::milliseconds default_poll_interval { 1 };
+
+        BBGE_NO_COPIES(hot_logger);
+        BBGE_NO_MOVES(hot_logger);
+
+        /**
+         * @brief Start the background thread and make this the active hot logger.
+         * @param queue_capacity Records per thread, has to be a power of two
+         * @param overflow What a full queue does with new records
+         * @param poll_interval Time the background thread sleeps between passes
+         */
+        explicit hot_logger(std::size_t queue_capacity = default_queue_capacity, log_overflow overflow = log_overflow::drop,
+                            std::chrono::milliseconds poll_interval = default_poll_interval);
+
+        /**
+         * @brief Forwards all queued records and stops the background thread.
+         */
+        ~hot_logger();
+
+        /**
+         * @brief Get the active hot logger.
+         * @return Hot logger or nullptr
+         */
+        [[nodiscard]] static hot_logger* get() noexcept;
+
+        /**
+         * @brief Queue a record on the calling thread's ring.
+         * @param record Record
+         */
+        void push(const hot_log_record& record) noexcept;
+
+        /**
+         * @brief Forward everything queued so far on the calling thread and flush the default logger.
+         */
+        void flush();
+
+        /**
+         * @brief Get the number of records dropped because a queue was full.
+         * @return Dropped records since construction
+         */
+        [[nodiscard]] uint64_t get_dropped() const noexcept;
+
+    private:
+
+        struct queue {
+            explicit queue(std::size_t capacity) : ring(capacity), dropped(0), abandoned(false) { }
+            spsc_ring<hot_log_record> ring;
+            std::atomic<uint64_t> dropped;
+            std::atomic<bool> abandoned;  // the thread exited, removed once empty
+            std::size_t thread;           // OS thread id, as in the log pattern's %t
+        };
+
+        struct thread_queue {
+            uint64_t generation = 0;
+            std::shared_ptr<queue> q;
+            ~thread_queue();
+        };
+
+        static std::atomic<hot_logger*> s_active;
+        static std::atomic<uint64_t> s_generation;
+
+        std::size_t m_queue_capacity;
+        log_overflow m_overflow;
+        std::chrono::milliseconds m_poll_interval;
+        uint64_t m_generation;
+
+        mutable std::mutex m_queues_mutex;
+        std::vector<std::shared_ptr<queue>> m_queues;
+        std::mutex m_drain_mutex;      // the rings have a single consumer
+        std::atomic<uint64_t> m_dropped;
+
+        std::mutex m_stop_mutex;
+        std::condition_variable m_stop_condition;
+        bool m_stopping;
+        std::thread m_thread;
+
+        [[nodiscard]] queue& get_thread_queue();
+        void run() noexcept;
+        void drain();
+        static void write(const hot_log_record& record);
+    };
+
+    /**
+     * @brief Queue a message for the active hot logger. Called by the BBGE_HOT_* macros.
+     * @param site Call site with level and format string
+     * @param args Numbers, strings or pointers
+     */
+    template <typename... Args>
+    void hot_log(const hot_log_site& site, const char* /* format, stored in the site */, const Args&... args) noexcept {
+
+        static_assert(sizeof...(Args) <= hot_log_record::max_args, "Too many hot log arguments");
+
+        auto* logger = hot_logger::get();
+        if (!logger || !spdlog::default_logger_raw()->should_log(site.level)) {
+            return;
+        }
+
+        hot_log_record record;
+        record.site = &site;
+        record.arg_count = static_cast<uint8_t>(sizeof...(Args));
+        record.payload_used = 0;
+        uint8_t index = 0;
+        (detail::encode_hot_log_arg(record, index++, args), ...);
+
+        logger->push(record);
+    }
+}
+
+// the format string is the first variadic argument, so calls without arguments don't need the GNU ##__VA_ARGS__
+#define BBGE_HOT_LOG_FORMAT(format, ...) format
+
+#define BBGE_HOT_LOG(level, ...) \
+    do { \
+        static const ::bbge::hot_log_site bbge_hot_log_site { level, BBGE_HOT_LOG_FORMAT(__VA_ARGS__, unused), spdlog::source_loc { __FILE__, __LINE__, SPDLOG_FUNCTION } }; \
+        ::bbge::hot_log(bbge_hot_log_site, __VA_ARGS__); \
+    } while (false)
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
+    #define BBGE_HOT_TRACE(...) BBGE_HOT_LOG(spdlog::level::trace, __VA_ARGS__)
+#else
+    #define BBGE_HOT_TRACE(...) (void) 0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
+    #define BBGE_HOT_DEBUG(...) BBGE_HOT_LOG(spdlog::level::debug, __VA_ARGS__)
+#else
+    #define BBGE_HOT_DEBUG(...) (void) 0
+#endif
+
+#define BBGE_HOT_WARN(...) BBGE_HOT_LOG(spdlog::level::warn, __VA_ARGS__)
+
+#endif //BAMBOOENGINE_HOT_LOG_HPP
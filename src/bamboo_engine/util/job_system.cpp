@@ -0,0 +1,171 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <spdlog/spdlog.h>
+#include "job_system.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        // identifies the worker a thread is, so jobs pushed by a job go to its own deque
+        thread_local const job_system* t_system = nullptr;
+        thread_local std::size_t t_worker = 0;
+    }
+
+    bool job_counter::is_done() const noexcept {
+        return m_pending.load(std::memory_order_acquire) == 0;
+    }
+
+    job_system::job_system(std::size_t thread_count) : m_queued(0), m_stopping(false) {
+
+        if (thread_count == 0) {
+            // the thread that waits for jobs helps running them
+            thread_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+        }
+
+        m_queues.reserve(thread_count);
+        for (std::size_t i = 0; i < thread_count; ++i) {
+            m_queues.push_back(std::make_unique<job_queue>());
+        }
+
+        m_threads.reserve(thread_count);
+        for (std::size_t i = 0; i < thread_count; ++i) {
+            m_threads.emplace_back(&job_system::run_worker, this, i);
+        }
+
+        SPDLOG_TRACE("Started job system with {} workers.", thread_count);
+    }
+
+    job_system::~job_system() {
+        {
+            std::lock_guard lock(m_sleep_mutex);
+            m_stopping = true;
+        }
+        m_condition.notify_all();
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    void job_system::wait(job_counter& counter) {
+
+        auto self = get_current_worker();
+        while (!counter.is_done()) {
+            if (try_run_one(self)) continue;
+
+            std::unique_lock lock(m_sleep_mutex);
+            m_condition.wait(lock, [this, &counter]() {
+                return counter.is_done() || m_queued.load(std::memory_order_acquire) > 0;
+            });
+        }
+
+        if (counter.m_failed.load(std::memory_order_acquire)) {
+            auto error = std::move(counter.m_error);
+            counter.m_error = nullptr;
+            counter.m_failed.store(false, std::memory_order_relaxed);
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::size_t job_system::get_thread_count() const noexcept {
+        return m_threads.size();
+    }
+
+    void job_system::push(job j) {
+
+        auto self = get_current_worker();
+        auto& queue = self == no_worker ? m_injected : *m_queues[self];
+
+        // counted first, so a thief never sees a job before it was counted
+        m_queued.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard lock(queue.mutex);
+            queue.jobs.push_back(std::move(j));
+        }
+
+        // sleepers check m_queued under the mutex, so taking it here ensures the notification isn't lost
+        { std::lock_guard lock(m_sleep_mutex); }
+        m_condition.notify_one();
+    }
+
+    bool job_system::try_run_one(std::size_t self) {
+
+        job j;
+        bool found = self != no_worker && try_pop(*m_queues[self], true, j);
+        if (!found) {
+            found = try_pop(m_injected, false, j);
+        }
+        // steal from the other workers, starting at the next one so thieves spread out
+        auto start = self == no_worker ? 0 : self + 1;
+        for (std::size_t i = 0; !found && i < m_queues.size(); ++i) {
+            auto victim = (start + i) % m_queues.size();
+            if (victim == self) continue;
+            found = try_pop(*m_queues[victim], false, j);
+        }
+        if (!found) return false;
+
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+        j(); // submitted jobs capture exceptions in their future, counted jobs in their counter
+        return true;
+    }
+
+    bool job_system::try_pop(job_queue& queue, bool back, job& out) {
+
+        std::lock_guard lock(queue.mutex);
+        if (queue.jobs.empty()) return false;
+
+        if (back) {
+            out = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        }
+        else {
+            out = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        }
+        return true;
+    }
+
+    std::size_t job_system::get_current_worker() const noexcept {
+        return t_system == this ? t_worker : no_worker;
+    }
+
+    void job_system::complete(job_counter& counter) {
+
+        // the counter may be destroyed as soon as it reaches zero, so it isn't touched afterwards
+        if (counter.m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            { std::lock_guard lock(m_sleep_mutex); }
+            m_condition.notify_all();
+        }
+    }
+
+    void job_system::run_worker(std::size_t index) noexcept {
+
+        t_system = this;
+        t_worker = index;
+
+        while (true) {
+            if (try_run_one(index)) continue;
+
+            std::unique_lock lock(m_sleep_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || m_queued.load(std::memory_order_acquire) > 0; });
+            if (m_stopping && m_queued.load(std::memory_order_acquire) == 0) {
+                return; // stopping and drained
+            }
+        }
+    }
+}
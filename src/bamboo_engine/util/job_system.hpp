@@ -0,0 +1,228 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_JOB_SYSTEM_HPP
+#define BAMBOOENGINE_JOB_SYSTEM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "macros.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Counts unfinished jobs started with job_system::run(), so a thread can wait for all of them.
+     * Keeps the first exception thrown by one of the jobs. Has to outlive its jobs.
+     */
+    class job_counter {
+    public:
+
+        BBGE_NO_COPIES(job_counter);
+        BBGE_NO_MOVES(job_counter);
+
+        job_counter() = default;
+
+        /**
+         * @brief Check if all jobs finished.
+         * @return True if no job is pending
+         */
+        [[nodiscard]] bool is_done() const noexcept;
+
+    private:
+
+        friend class job_system;
+
+        std::atomic<std::size_t> m_pending { 0 };
+        std::atomic<bool> m_failed { false };
+        std::exception_ptr m_error; // written once by the job that set m_failed
+    };
+
+    /**
+     * @brief Work stealing scheduler shared by everything in the engine that runs in parallel.
+     * Every worker owns a deque. Jobs pushed by a worker go to the back of its own deque and it pops them LIFO,
+     * idle workers steal FIFO from the front of the others. Jobs from other threads go to a shared injection queue.
+     * Threads waiting for jobs run queued jobs meanwhile, so jobs may start and wait for jobs themselves.
+     */
+    class job_system {
+    public:
+
+        BBGE_NO_COPIES(job_system);
+        BBGE_NO_MOVES(job_system);
+
+        /**
+         * @brief Start the workers.
+         * @param thread_count Number of workers, 0 picks one per hardware thread except the calling one
+         */
+        explicit job_system(std::size_t thread_count = 0);
+
+        /**
+         * @brief Finishes all queued jobs and joins the workers.
+         */
+        ~job_system();
+
+        /**
+         * @brief Queue a job with a result.
+         * @tparam F Callable without parameters
+         * @param f Job
+         * @return Future for the job's result, exceptions are rethrown by get()
+         */
+        template <typename F>
+        [[nodiscard]] std::future<std::invoke_result_t<std::decay_t<F>>> submit(F&& f);
+
+        /**
+         * @brief Queue a job tracked by a counter. Cheaper than submit(), there is no shared state.
+         * @tparam F Copyable callable without parameters
+         * @param counter Counter that is decremented once the job finished
+         * @param f Job
+         */
+        template <typename F>
+        void run(job_counter& counter, F&& f);
+
+        /**
+         * @brief Block until all jobs of a counter finished, running queued jobs meanwhile.
+         * Rethrows the first exception of one of the jobs and resets it.
+         * @param counter Counter
+         */
+        void wait(job_counter& counter);
+
+        /**
+         * @brief Split a range into chunks and process them on all workers and the calling thread.
+         * Blocks until every chunk finished. Exceptions are rethrown once all chunks finished.
+         * @tparam F Callable with the parameters (std::size_t first, std::size_t last), called concurrently
+         * @param first First index
+         * @param last One past the last index
+         * @param min_chunk_size Minimum number of indices per chunk, so tiny chunks don't cost more than they save
+         * @param f Processes the indices [first, last) of a chunk
+         */
+        template <typename F>
+        void parallel_for(std::size_t first, std::size_t last, std::size_t min_chunk_size, F&& f);
+
+        /**
+         * @brief Get the number of workers, not counting threads that help while waiting.
+         * @return Number of worker threads
+         */
+        [[nodiscard]] std::size_t get_thread_count() const noexcept;
+
+    private:
+
+        using job = std::function<void()>;
+
+        static constexpr const std::size_t no_worker = SIZE_MAX;
+
+        // a few chunks per thread, so stealing can even out chunks of different cost
+        static constexpr const std::size_t chunks_per_thread = 4;
+
+        struct alignas(64) job_queue {
+            std::mutex mutex;
+            std::deque<job> jobs;
+        };
+
+        std::vector<std::unique_ptr<job_queue>> m_queues; // one per worker
+        job_queue m_injected;                             // jobs pushed by threads outside the system
+        std::vector<std::thread> m_threads;
+        std::atomic<std::size_t> m_queued;                // jobs in all queues, incremented before the push
+        std::mutex m_sleep_mutex;
+        std::condition_variable m_condition;              // jobs were queued, a counter finished or stopping
+        bool m_stopping;
+
+        void push(job j);
+        [[nodiscard]] bool try_run_one(std::size_t self);
+        [[nodiscard]] bool try_pop(job_queue& queue, bool back, job& out);
+        [[nodiscard]] std::size_t get_current_worker() const noexcept;
+        void complete(job_counter& counter);
+        void run_worker(std::size_t index) noexcept;
+    };
+
+    template <typename F>
+    std::future<std::invoke_result_t<std::decay_t<F>>> job_system::submit(F&& f) {
+
+        using result_type = std::invoke_result_t<std::decay_t<F>>;
+
+        // std::function has to be copyable, the packaged task is not
+        auto task = std::make_shared<std::packaged_task<result_type()>>(std::forward<F>(f));
+        auto future = task->get_future();
+        push([task]() { (*task)(); });
+        return future;
+    }
+
+    template <typename F>
+    void job_system::run(job_counter& counter, F&& f) {
+
+        counter.m_pending.fetch_add(1, std::memory_order_relaxed);
+        push([this, &counter, f = std::forward<F>(f)]() mutable {
+            try {
+                f();
+            }
+            catch (...) {
+                if (!counter.m_failed.exchange(true, std::memory_order_relaxed)) {
+                    counter.m_error = std::current_exception();
+                }
+            }
+            complete(counter);
+        });
+    }
+
+    template <typename F>
+    void job_system::parallel_for(std::size_t first, std::size_t last, std::size_t min_chunk_size, F&& f) {
+
+        if (first >= last) return;
+
+        auto n = last - first;
+        min_chunk_size = std::max<std::size_t>(min_chunk_size, 1);
+        auto chunk_count = std::min((n + min_chunk_size - 1) / min_chunk_size, (m_threads.size() + 1) * chunks_per_thread);
+        if (chunk_count <= 1) {
+            f(first, last);
+            return;
+        }
+        auto chunk_size = (n + chunk_count - 1) / chunk_count;
+
+        job_counter counter;
+        for (auto begin = first + chunk_size; begin < last; begin += chunk_size) {
+            auto end = std::min(begin + chunk_size, last);
+            run(counter, [&f, begin, end]() { f(begin, end); });
+        }
+
+        // the jobs reference f, so every one of them has to finish before anything is rethrown
+        std::exception_ptr error;
+        try {
+            f(first, first + chunk_size);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        try {
+            wait(counter);
+        }
+        catch (...) {
+            if (!error) error = std::current_exception();
+        }
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+#endif //BAMBOOENGINE_JOB_SYSTEM_HPP
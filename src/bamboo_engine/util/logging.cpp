@@ -20,15 +20,25 @@
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/async.h>
+#include <array>
 #include "logging.hpp"
+#include "hot_log.hpp"
 
 namespace bbge {
 
+    constexpr std::array<std::string_view, 2> log_overflow_names {
+        "block", "drop"
+    };
 
-    logging::logging() {
+    std::string_view to_string(log_overflow o) {
+        auto v = static_cast<uint8_t>(o);
+        return log_overflow_names[v];
+    }
+
+    logging::logging(const logging_settings& settings) {
 
         // Thread pool for async logging
-        spdlog::init_thread_pool(1024, 2);
+        spdlog::init_thread_pool(settings.queue_size, settings.thread_count);
 
         // Sinks
         auto file_sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>("logs/latest.log");
@@ -38,7 +48,8 @@ namespace bbge {
         // Create logger
         auto logger = std::make_shared<spdlog::async_logger>(
             "aevc", sinks.begin(), sinks.end(),
-            spdlog::thread_pool(), spdlog::async_overflow_policy::block
+            spdlog::thread_pool(),
+            settings.overflow == log_overflow::block ? spdlog::async_overflow_policy::block : spdlog::async_overflow_policy::overrun_oldest
         );
         spdlog::set_default_logger(logger);
 
@@ -62,9 +73,15 @@ namespace bbge {
         // Flush policies
         spdlog::flush_every(std::chrono::seconds(2));
         logger->flush_on(spdlog::level::err);
+
+        // Hot loops log through per thread queues that forward to the default logger
+        m_hot_logger = std::make_unique<hot_logger>(settings.hot_queue_capacity, settings.hot_overflow);
     }
 
     logging::~logging() {
+        // Forward the hot log before spdlog goes away
+        m_hot_logger.reset();
+
         // Make sure everything is flushed and closed.
         spdlog::shutdown();
     }
@@ -27,17 +27,49 @@
     // No trace logging in release
     #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_DEBUG
 #endif
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
 #include <spdlog/spdlog.h>
+#include "macros.hpp"
 
 namespace bbge {
 
+    class hot_logger;
+
+    /**
+     * @brief What a full log queue does with new messages.
+     */
+    enum class log_overflow : uint8_t {
+        block,  // wait for space, nothing is lost
+        drop    // discard messages, spdlog drops the oldest, the hot logger the newest and counts them
+    };
+
+    std::string_view to_string(log_overflow o);
+
+    struct logging_settings {
+        std::size_t  queue_size         = 1024;                 // spdlog async queue
+        std::size_t  thread_count       = 2;                    // spdlog async threads
+        log_overflow overflow           = log_overflow::block;  // spdlog async queue
+        std::size_t  hot_queue_capacity = 4096;                 // records per thread, power of two
+        log_overflow hot_overflow       = log_overflow::drop;
+    };
+
     /**
      * @brief Helper class to set up logging.
      */
     struct logging {
 
-        logging();
+        BBGE_NO_COPIES(logging);
+        BBGE_NO_MOVES(logging);
+
+        explicit logging(const logging_settings& settings = { });
         ~logging();
+
+    private:
+
+        std::unique_ptr<hot_logger> m_hot_logger;
     };
 
 }
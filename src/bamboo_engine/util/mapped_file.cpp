@@ -0,0 +1,163 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <utility>
+#include <fmt/format.h>
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bbge {
+
+    mapped_file::mapped_file(const std::byte* data, std::size_t size) noexcept : m_data(data), m_size(size) {
+
+    }
+
+    mapped_file::mapped_file(mapped_file&& other) noexcept
+      : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)) {
+
+    }
+
+    mapped_file& mapped_file::operator=(mapped_file&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+        }
+        return *this;
+    }
+
+    mapped_file::~mapped_file() {
+        unmap();
+    }
+
+#ifdef _WIN32
+
+    result<mapped_file, std::runtime_error> mapped_file::open(const std::filesystem::path& p) {
+
+        HANDLE file = CreateFileW(p.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return std::runtime_error(fmt::format("Failed to open file '{}' (err={}).", p.string(), GetLastError()));
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            auto err = GetLastError();
+            CloseHandle(file);
+            return std::runtime_error(fmt::format("Failed to query the size of '{}' (err={}).", p.string(), err));
+        }
+        if (size.QuadPart == 0) {
+            CloseHandle(file);
+            return mapped_file();
+        }
+
+        // the view keeps the mapping and the file alive, so both handles can be closed right away
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        auto err = GetLastError();
+        CloseHandle(file);
+        if (!mapping) {
+            return std::runtime_error(fmt::format("Failed to map file '{}' (err={}).", p.string(), err));
+        }
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        err = GetLastError();
+        CloseHandle(mapping);
+        if (!view) {
+            return std::runtime_error(fmt::format("Failed to map a view of file '{}' (err={}).", p.string(), err));
+        }
+
+        return mapped_file(static_cast<const std::byte*>(view), static_cast<std::size_t>(size.QuadPart));
+    }
+
+    void mapped_file::unmap() noexcept {
+        if (m_data) {
+            UnmapViewOfFile(m_data);
+        }
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+#else
+
+    result<mapped_file, std::runtime_error> mapped_file::open(const std::filesystem::path& p) {
+
+        int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return std::runtime_error(fmt::format("Failed to open file '{}': {}.", p.string(), std::strerror(errno)));
+        }
+
+        struct stat st { };
+        if (fstat(fd, &st) != 0) {
+            auto err = errno;
+            ::close(fd);
+            return std::runtime_error(fmt::format("Failed to query the size of '{}': {}.", p.string(), std::strerror(err)));
+        }
+        if (st.st_size == 0) {
+            ::close(fd);
+            return mapped_file(); // mmap rejects empty ranges
+        }
+
+        // the mapping keeps the file alive, the descriptor is not needed anymore
+        auto size = static_cast<std::size_t>(st.st_size);
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        auto err = errno;
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            return std::runtime_error(fmt::format("Failed to map file '{}': {}.", p.string(), std::strerror(err)));
+        }
+
+        return mapped_file(static_cast<const std::byte*>(addr), size);
+    }
+
+    void mapped_file::unmap() noexcept {
+        if (m_data) {
+            munmap(const_cast<std::byte*>(m_data), m_size);
+        }
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+#endif
+
+    gsl::span<const std::byte> mapped_file::get_contents() const noexcept {
+        return gsl::span<const std::byte>(m_data, m_data + m_size);
+    }
+
+    const std::byte* mapped_file::data() const noexcept {
+        return m_data;
+    }
+
+    std::size_t mapped_file::size() const noexcept {
+        return m_size;
+    }
+
+    bool mapped_file::empty() const noexcept {
+        return m_size == 0;
+    }
+}
@@ -0,0 +1,72 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_MAPPED_FILE_HPP
+#define BAMBOOENGINE_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <stdexcept>
+#include <gsl/gsl-lite.hpp>
+#include "macros.hpp"
+#include "result.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Read-only memory mapping of a whole file.
+     * Pages are loaded by the OS on first access, so nothing is copied to the heap.
+     * The contents are page aligned.
+     */
+    class mapped_file {
+    public:
+
+        BBGE_NO_COPIES(mapped_file);
+
+        mapped_file() noexcept = default;
+        mapped_file(mapped_file&& other) noexcept;
+        mapped_file& operator=(mapped_file&& other) noexcept;
+        ~mapped_file();
+
+        /**
+         * @brief Map a file.
+         * @param p Path to the file
+         * @return The mapping or an error if the file cannot be opened or mapped
+         */
+        [[nodiscard]] static result<mapped_file, std::runtime_error> open(const std::filesystem::path& p);
+
+        /**
+         * @brief Get the file contents. Only valid as long as the mapping lives.
+         * @return Contents, empty for empty files
+         */
+        [[nodiscard]] gsl::span<const std::byte> get_contents() const noexcept;
+
+        [[nodiscard]] const std::byte* data() const noexcept;
+        [[nodiscard]] std::size_t size() const noexcept;
+        [[nodiscard]] bool empty() const noexcept;
+
+    private:
+
+        const std::byte* m_data = nullptr;
+        std::size_t m_size = 0;
+
+        mapped_file(const std::byte* data, std::size_t size) noexcept;
+        void unmap() noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_MAPPED_FILE_HPP
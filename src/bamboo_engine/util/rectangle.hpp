@@ -40,8 +40,8 @@ namespace bbge {
     VkRect2D to_vulkan_rect(const rect_t<T>& r) {
         static_assert(std::numeric_limits<T>::is_integer, "Can only convert integer rectangles to VkRect2D.");
         return VkRect2D {
-            { r.x, r.y },
-            { r.width, r.height }
+            { static_cast<int32_t>(r.x), static_cast<int32_t>(r.y) },
+            { static_cast<uint32_t>(r.width), static_cast<uint32_t>(r.height) }
         };
     }
 
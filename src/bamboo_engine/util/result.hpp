@@ -5,6 +5,8 @@
 #ifndef BAMBOOENGINE_RESULT_HPP
 #define BAMBOOENGINE_RESULT_HPP
 
+#include <functional>
+#include <type_traits>
 #include <variant>
 #include <utility>
 #include <experimental/source_location>
@@ -12,10 +14,42 @@
 
 namespace bbge {
 
+    template <typename Result, typename Error>
+    class result;
+
+    namespace detail {
+
+        template <typename Error, typename = void>
+        struct has_raise : std::false_type { };
+
+        template <typename Error>
+        struct has_raise<Error, std::void_t<decltype(std::declval<const Error&>().raise())>> : std::true_type { };
+
+        /**
+         * @brief Throw an error. Lightweight errors that aren't exceptions themselves provide a raise() function.
+         */
+        template <typename Error>
+        [[noreturn]] void throw_error(const Error& e) {
+            if constexpr (has_raise<Error>::value) {
+                e.raise();
+            }
+            else {
+                throw e;
+            }
+        }
+
+        template <typename T>
+        struct is_result : std::false_type { };
+
+        template <typename Result, typename Error>
+        struct is_result<result<Result, Error>> : std::true_type { };
+    }
+
     /**
      * @brief Result class sort of inspired by Rust
      * @tparam Result If successful this type is held
      * @tparam Error If unsuccessful this type is held. Expected to be implement a std::exception like what() function.
+     * Errors that aren't exceptions have to implement a [[noreturn]] raise() function that throws one.
      */
     template <typename Result, typename Error>
     class result {
@@ -96,13 +130,55 @@ namespace bbge {
          * @brief Get the result or throw an error on err
          * @return Result if this is ok
          */
-        const ok_type& or_throw() const;
+        const ok_type& or_throw() const&;
 
         /**
          * @brief Get the result or throw an error on err
          * @return Result if this is ok
          */
-        ok_type& or_throw();
+        ok_type& or_throw() &;
+
+        /**
+         * @brief Take the result out of a temporary or throw an error on err
+         * @return Result moved out of this if this is ok
+         */
+        ok_type or_throw() &&;
+
+        /**
+         * @brief Transform the result, an error is passed on.
+         * @tparam F Callable taking the result
+         * @param f Transformation
+         * @return Result of f or this error
+         */
+        template <typename F>
+        auto map(F&& f) const& -> result<std::invoke_result_t<F, const ok_type&>, err_type>;
+
+        /**
+         * @brief Transform the result of a temporary, the result is moved into f and an error is passed on.
+         * @tparam F Callable taking the result
+         * @param f Transformation
+         * @return Result of f or this error
+         */
+        template <typename F>
+        auto map(F&& f) && -> result<std::invoke_result_t<F, ok_type&&>, err_type>;
+
+        /**
+         * @brief Chain an operation that can fail, an error is passed on.
+         * @tparam F Callable taking the result and returning a result with the same error type
+         * @param f Operation
+         * @return Result of f or this error
+         */
+        template <typename F>
+        auto and_then(F&& f) const& -> std::invoke_result_t<F, const ok_type&>;
+
+        /**
+         * @brief Chain an operation that can fail, the result is moved into f and an error is passed on.
+         * @tparam F Callable taking the result and returning a result with the same error type
+         * @param f Operation
+         * @return Result of f or this error
+         */
+        template <typename F>
+        auto and_then(F&& f) && -> std::invoke_result_t<F, ok_type&&>;
 
         /**
          * @brief Get the optional value.
@@ -153,7 +229,7 @@ namespace bbge {
     };
 
     template <typename Result, typename Error>
-    result<Result, Error>::result(ok_type&& o) : m_variant(o) {
+    result<Result, Error>::result(ok_type&& o) : m_variant(std::in_place_type<ok_type>, std::move(o)) {
 
     }
 
@@ -192,17 +268,59 @@ namespace bbge {
     }
 
     template <typename Result, typename Error>
-    const typename result<Result, Error>::ok_type& result<Result, Error>::or_throw() const {
-        if (is_err()) throw *err();
+    const typename result<Result, Error>::ok_type& result<Result, Error>::or_throw() const& {
+        if (is_err()) detail::throw_error(*err());
         return *ok();
     }
 
     template <typename Result, typename Error>
-    typename result<Result, Error>::ok_type& result<Result, Error>::or_throw() {
-        if (is_err()) throw *err();
+    typename result<Result, Error>::ok_type& result<Result, Error>::or_throw() & {
+        if (is_err()) detail::throw_error(*err());
         return *ok();
     }
 
+    template <typename Result, typename Error>
+    typename result<Result, Error>::ok_type result<Result, Error>::or_throw() && {
+        if (is_err()) detail::throw_error(*err());
+        return std::move(*ok());
+    }
+
+    template <typename Result, typename Error>
+    template <typename F>
+    auto result<Result, Error>::map(F&& f) const& -> result<std::invoke_result_t<F, const ok_type&>, err_type> {
+        using mapped = result<std::invoke_result_t<F, const ok_type&>, err_type>;
+        if (is_err()) return mapped(std::in_place_type<err_type>, *err());
+        return mapped(std::in_place_type<typename mapped::ok_type>, std::invoke(std::forward<F>(f), *ok()));
+    }
+
+    template <typename Result, typename Error>
+    template <typename F>
+    auto result<Result, Error>::map(F&& f) && -> result<std::invoke_result_t<F, ok_type&&>, err_type> {
+        using mapped = result<std::invoke_result_t<F, ok_type&&>, err_type>;
+        if (is_err()) return mapped(std::in_place_type<err_type>, std::move(*err()));
+        return mapped(std::in_place_type<typename mapped::ok_type>, std::invoke(std::forward<F>(f), std::move(*ok())));
+    }
+
+    template <typename Result, typename Error>
+    template <typename F>
+    auto result<Result, Error>::and_then(F&& f) const& -> std::invoke_result_t<F, const ok_type&> {
+        using chained = std::invoke_result_t<F, const ok_type&>;
+        static_assert(detail::is_result<chained>::value, "and_then has to return a result");
+        static_assert(std::is_same_v<typename chained::err_type, err_type>, "and_then can't change the error type");
+        if (is_err()) return chained(std::in_place_type<err_type>, *err());
+        return std::invoke(std::forward<F>(f), *ok());
+    }
+
+    template <typename Result, typename Error>
+    template <typename F>
+    auto result<Result, Error>::and_then(F&& f) && -> std::invoke_result_t<F, ok_type&&> {
+        using chained = std::invoke_result_t<F, ok_type&&>;
+        static_assert(detail::is_result<chained>::value, "and_then has to return a result");
+        static_assert(std::is_same_v<typename chained::err_type, err_type>, "and_then can't change the error type");
+        if (is_err()) return chained(std::in_place_type<err_type>, std::move(*err()));
+        return std::invoke(std::forward<F>(f), std::move(*ok()));
+    }
+
     template <typename Result, typename Error>
     const typename result<Result, Error>::ok_type& result<Result, Error>::or_else(const ok_type& otherwise) const {
         if (is_err()) return otherwise;
@@ -230,7 +348,8 @@ namespace bbge {
     template <typename Result, typename Error>
     const result<typename result<Result, Error>::ok_type, typename result<Result, Error>::err_type>&
     result<Result, Error>::log_err(spdlog::level::level_enum l, const std::experimental::source_location& loc) const {
-        if (is_err()) {
+        // lightweight errors format their message in what(), so skip it if nothing is logged
+        if (is_err() && spdlog::default_logger_raw()->should_log(l)) {
             auto src_loc = spdlog::source_loc(loc.file_name(), loc.line(), loc.function_name());
             spdlog::log(src_loc, l, err()->what());
         }
@@ -240,7 +359,8 @@ namespace bbge {
     template <typename Result, typename Error>
     result<typename result<Result, Error>::ok_type, typename result<Result, Error>::err_type>&
     result<Result, Error>::log_err(spdlog::level::level_enum l, const std::experimental::source_location& loc) {
-        if (is_err()) {
+        // lightweight errors format their message in what(), so skip it if nothing is logged
+        if (is_err() && spdlog::default_logger_raw()->should_log(l)) {
             auto src_loc = spdlog::source_loc(loc.file_name(), loc.line(), loc.function_name());
             spdlog::log(src_loc, l, err()->what());
         }
@@ -265,7 +385,7 @@ namespace bbge {
     }
 
     template <typename Result, typename Error>
-    result<Result, Error>::result(err_type&& e) : m_variant(e) {
+    result<Result, Error>::result(err_type&& e) : m_variant(std::in_place_type<err_type>, std::move(e)) {
 
     }
 }
@@ -0,0 +1,99 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_RETIRE_QUEUE_HPP
+#define BAMBOOENGINE_RETIRE_QUEUE_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace bbge {
+
+    /**
+     * @brief Keeps resources alive until the frames that may still use them are finished.
+     * Counts down once per frame number, however often a frame is begun, e.g. because acquiring a swap chain image
+     * failed and the same frame slot is waited for again.
+     * @tparam T Resource type, destroyed by the callback passed to release()
+     */
+    template <typename T>
+    class retire_queue {
+    public:
+
+        /**
+         * @brief Retire a resource.
+         * @param resource Resource
+         * @param frames Number of frames until the resource is guaranteed to be unused, at least 1
+         */
+        void push(T resource, uint32_t frames) {
+            assert(frames > 0);
+            m_entries.push_back({ std::move(resource), frames });
+        }
+
+        /**
+         * @brief Count down all resources and destroy those that are no longer in use.
+         * Call after waiting for the fence of a frame. Repeated calls for the same frame don't count again.
+         * @param frame_number Number of the frame that is about to be recorded
+         * @param destroy Called with every resource that is no longer in use
+         */
+        template <typename Destroy>
+        void release(uint64_t frame_number, Destroy&& destroy) {
+            if (frame_number == m_last_frame) return;
+            m_last_frame = frame_number;
+
+            for (auto& e : m_entries) {
+                if (--e.frames_left == 0) destroy(e.resource);
+            }
+            m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
+                [] (const entry& e) { return e.frames_left == 0; }), m_entries.end());
+        }
+
+        /**
+         * @brief Destroy all resources right away, e.g. after waiting for the device to be idle.
+         * @param destroy Called with every resource
+         */
+        template <typename Destroy>
+        void release_all(Destroy&& destroy) {
+            for (auto& e : m_entries) destroy(e.resource);
+            m_entries.clear();
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept {
+            return m_entries.size();
+        }
+
+        [[nodiscard]] bool empty() const noexcept {
+            return m_entries.empty();
+        }
+
+    private:
+
+        struct entry {
+            T resource;
+            uint32_t frames_left;
+        };
+
+        std::vector<entry> m_entries;
+        uint64_t m_last_frame = std::numeric_limits<uint64_t>::max(); // frame that was counted last
+    };
+}
+
+#endif //BAMBOOENGINE_RETIRE_QUEUE_HPP
@@ -0,0 +1,72 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include "rolling_statistics.hpp"
+
+namespace bbge {
+
+    rolling_statistics::rolling_statistics(std::size_t window) : m_window(window), m_next(0) {
+        if (window == 0) {
+            throw std::invalid_argument("Rolling statistics need room for at least one sample.");
+        }
+        m_samples.reserve(window);
+    }
+
+    void rolling_statistics::add(double sample) {
+        if (m_samples.size() < m_window) {
+            m_samples.push_back(sample);
+        }
+        else {
+            m_samples[m_next] = sample;
+        }
+        m_next = (m_next + 1) % m_window;
+    }
+
+    rolling_statistics::summary rolling_statistics::get_summary() const {
+
+        summary s { };
+        s.samples = m_samples.size();
+        if (m_samples.empty()) {
+            return s;
+        }
+
+        m_sorted.assign(m_samples.begin(), m_samples.end());
+        std::sort(m_sorted.begin(), m_sorted.end());
+
+        // nearest rank
+        auto rank = static_cast<std::size_t>(std::ceil(0.99 * static_cast<double>(m_sorted.size())));
+        s.min = m_sorted.front();
+        s.max = m_sorted.back();
+        s.p99 = m_sorted[std::max<std::size_t>(rank, 1) - 1];
+        s.avg = std::accumulate(m_sorted.begin(), m_sorted.end(), 0.0) / static_cast<double>(m_sorted.size());
+
+        return s;
+    }
+
+    void rolling_statistics::clear() noexcept {
+        m_samples.clear();
+        m_next = 0;
+    }
+
+    std::size_t rolling_statistics::get_window() const noexcept {
+        return m_window;
+    }
+}
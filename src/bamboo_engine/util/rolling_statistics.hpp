@@ -0,0 +1,71 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_ROLLING_STATISTICS_HPP
+#define BAMBOOENGINE_ROLLING_STATISTICS_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace bbge {
+
+    /**
+     * @brief Summary of the last samples of a measurement, e.g. a frame time.
+     */
+    class rolling_statistics {
+    public:
+
+        struct summary {
+            double      min     = 0.0;
+            double      avg     = 0.0;
+            double      p99     = 0.0;
+            double      max     = 0.0;
+            std::size_t samples = 0;
+        };
+
+        /**
+         * @brief Create empty statistics.
+         * @param window Number of samples kept, older samples are replaced
+         */
+        explicit rolling_statistics(std::size_t window);
+
+        /**
+         * @brief Add a sample, replacing the oldest one once the window is full.
+         * @param sample Sample
+         */
+        void add(double sample);
+
+        /**
+         * @brief Summarize the samples in the window.
+         * @return Summary, all zero without samples
+         */
+        [[nodiscard]] summary get_summary() const;
+
+        void clear() noexcept;
+
+        [[nodiscard]] std::size_t get_window() const noexcept;
+
+    private:
+
+        std::vector<double> m_samples;
+        std::size_t m_window;
+        std::size_t m_next;
+        mutable std::vector<double> m_sorted; // reused by get_summary
+    };
+}
+
+#endif //BAMBOOENGINE_ROLLING_STATISTICS_HPP
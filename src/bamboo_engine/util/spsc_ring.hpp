@@ -0,0 +1,119 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_SPSC_RING_HPP
+#define BAMBOOENGINE_SPSC_RING_HPP
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include "macros.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Bounded lock-free queue for exactly one producer and one consumer thread.
+     * Both sides cache the other side's index, so they only touch the shared cache line when the cached value runs out.
+     * @tparam T Trivially copyable element type
+     */
+    template <typename T>
+    class spsc_ring {
+    public:
+
+        static_assert(std::is_trivially_copyable_v<T>, "Elements are copied without running constructors");
+
+        BBGE_NO_COPIES(spsc_ring);
+        BBGE_NO_MOVES(spsc_ring);
+
+        /**
+         * @brief Allocate the ring.
+         * @param capacity Number of elements, has to be a power of two
+         */
+        explicit spsc_ring(std::size_t capacity)
+          : m_elements(std::make_unique<T[]>(capacity)), m_mask(capacity - 1),
+            m_head(0), m_cached_tail(0), m_tail(0), m_cached_head(0) {
+            assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+        }
+
+        /**
+         * @brief Append an element. Producer only.
+         * @param value Element
+         * @return False if the ring is full
+         */
+        [[nodiscard]] bool try_push(const T& value) noexcept {
+            auto head = m_head.load(std::memory_order_relaxed);
+            if (head - m_cached_tail > m_mask) {
+                m_cached_tail = m_tail.load(std::memory_order_acquire);
+                if (head - m_cached_tail > m_mask) {
+                    return false;
+                }
+            }
+            m_elements[head & m_mask] = value;
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Remove the oldest element. Consumer only.
+         * @param value Receives the element
+         * @return False if the ring is empty
+         */
+        [[nodiscard]] bool try_pop(T& value) noexcept {
+            auto tail = m_tail.load(std::memory_order_relaxed);
+            if (tail == m_cached_head) {
+                m_cached_head = m_head.load(std::memory_order_acquire);
+                if (tail == m_cached_head) {
+                    return false;
+                }
+            }
+            value = m_elements[tail & m_mask];
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Get the number of queued elements. Exact only on the consumer thread while the producer is idle.
+         * @return Number of elements
+         */
+        [[nodiscard]] std::size_t size() const noexcept {
+            return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+        }
+
+        [[nodiscard]] std::size_t capacity() const noexcept {
+            return m_mask + 1;
+        }
+
+    private:
+
+        static constexpr const std::size_t cache_line = 64;
+
+        std::unique_ptr<T[]> m_elements;
+        std::size_t m_mask;
+
+        // producer side
+        alignas(cache_line) std::atomic<std::size_t> m_head;
+        std::size_t m_cached_tail;
+
+        // consumer side
+        alignas(cache_line) std::atomic<std::size_t> m_tail;
+        std::size_t m_cached_head;
+    };
+}
+
+#endif //BAMBOOENGINE_SPSC_RING_HPP
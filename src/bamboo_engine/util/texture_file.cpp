@@ -0,0 +1,174 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fmt/format.h>
+#include "texture_file.hpp"
+#include "../graphics/vulkan_format.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        struct texture_header {
+            std::array<char, 4> magic;
+            uint32_t version;
+            uint32_t format;
+            uint32_t width;
+            uint32_t height;
+            uint32_t mip_count;
+        };
+        static_assert(sizeof(texture_header) == 24);
+
+        struct texture_mip_record {
+            uint64_t offset;
+            uint64_t size;
+        };
+        static_assert(sizeof(texture_mip_record) == 16);
+
+        constexpr uint64_t align_up(uint64_t v, uint64_t alignment) noexcept {
+            return (v + alignment - 1) / alignment * alignment;
+        }
+
+        template <typename T>
+        T read_at(gsl::span<const std::byte> bytes, uint64_t offset) noexcept {
+            T v;
+            std::memcpy(&v, bytes.data() + offset, sizeof(T));
+            return v;
+        }
+
+        template <typename T>
+        void write_at(std::vector<std::byte>& bytes, uint64_t offset, const T& v) noexcept {
+            std::memcpy(bytes.data() + offset, &v, sizeof(T));
+        }
+
+        bool in_bounds(uint64_t offset, uint64_t size, uint64_t total) noexcept {
+            return offset <= total && size <= total - offset;
+        }
+    }
+
+    uint32_t get_full_mip_count(uint32_t width, uint32_t height) noexcept {
+        uint32_t count = 1;
+        for (auto extent = std::max(width, height); extent > 1; extent >>= 1) {
+            ++count;
+        }
+        return count;
+    }
+
+    result<texture_file, std::runtime_error> texture_file::parse(gsl::span<const std::byte> contents) {
+
+        auto total = static_cast<uint64_t>(contents.size());
+        auto malformed = [](std::string_view reason) {
+            return std::runtime_error(fmt::format("Malformed texture: {}.", reason));
+        };
+
+        if (total < sizeof(texture_header)) {
+            return malformed("too small for the header");
+        }
+        auto header = read_at<texture_header>(contents, 0);
+        if (header.magic != magic) {
+            return malformed("wrong magic");
+        }
+        if (header.version != format_version) {
+            return malformed(fmt::format("unsupported version {}, expected {}", header.version, format_version));
+        }
+        if (header.width == 0 || header.height == 0) {
+            return malformed("empty extent");
+        }
+        if (header.mip_count == 0 || header.mip_count > get_full_mip_count(header.width, header.height)) {
+            return malformed(fmt::format("{} mip levels for a {}x{} texture", header.mip_count, header.width, header.height));
+        }
+        if (!in_bounds(sizeof(texture_header), uint64_t(header.mip_count) * sizeof(texture_mip_record), total)) {
+            return malformed("mip table out of bounds");
+        }
+        if (!get_format_block(static_cast<VkFormat>(header.format))) {
+            return malformed(fmt::format("unsupported format {}", header.format));
+        }
+
+        texture_file file;
+        file.m_format = header.format;
+        file.m_width = header.width;
+        file.m_height = header.height;
+        file.m_mips.reserve(header.mip_count);
+
+        for (uint32_t i = 0; i < header.mip_count; ++i) {
+            auto record = read_at<texture_mip_record>(contents, sizeof(texture_header) + uint64_t(i) * sizeof(texture_mip_record));
+            if (!in_bounds(record.offset, record.size, total)) {
+                return malformed(fmt::format("mip level {} out of bounds", i));
+            }
+            // uploads copy as many bytes as the level's extent needs, whatever is stored
+            auto width = std::max(header.width >> i, 1u);
+            auto height = std::max(header.height >> i, 1u);
+            auto expected = *get_image_size(static_cast<VkFormat>(header.format), width, height);
+            if (record.size != expected) {
+                return malformed(fmt::format("mip level {} has {} bytes, {}x{} texels need {}", i, record.size, width, height, expected));
+            }
+            file.m_mips.push_back(contents.subspan(record.offset, record.size));
+        }
+
+        return file;
+    }
+
+    std::vector<std::byte> texture_file::write(uint32_t format, uint32_t width, uint32_t height,
+                                               const std::vector<std::vector<std::byte>>& mips) {
+
+        assert(!mips.empty() && mips.size() <= get_full_mip_count(width, height));
+
+        uint64_t size = sizeof(texture_header) + mips.size() * sizeof(texture_mip_record);
+        std::vector<uint64_t> offsets;
+        offsets.reserve(mips.size());
+        for (const auto& mip : mips) {
+            size = align_up(size, data_alignment);
+            offsets.push_back(size);
+            size += mip.size();
+        }
+
+        std::vector<std::byte> bytes(size);
+        texture_header header { magic, format_version, format, width, height, static_cast<uint32_t>(mips.size()) };
+        write_at(bytes, 0, header);
+        for (std::size_t i = 0; i < mips.size(); ++i) {
+            texture_mip_record record { offsets[i], mips[i].size() };
+            write_at(bytes, sizeof(texture_header) + i * sizeof(texture_mip_record), record);
+            std::copy(mips[i].begin(), mips[i].end(), bytes.begin() + offsets[i]);
+        }
+
+        return bytes;
+    }
+
+    uint32_t texture_file::get_format() const noexcept {
+        return m_format;
+    }
+
+    uint32_t texture_file::get_width() const noexcept {
+        return m_width;
+    }
+
+    uint32_t texture_file::get_height() const noexcept {
+        return m_height;
+    }
+
+    uint32_t texture_file::get_mip_count() const noexcept {
+        return static_cast<uint32_t>(m_mips.size());
+    }
+
+    texture_mip texture_file::get_mip(uint32_t level) const noexcept {
+        assert(level < m_mips.size());
+        return { std::max(m_width >> level, 1u), std::max(m_height >> level, 1u), m_mips[level] };
+    }
+}
@@ -0,0 +1,108 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_TEXTURE_FILE_HPP
+#define BAMBOOENGINE_TEXTURE_FILE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include <gsl/gsl-lite.hpp>
+#include "result.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Number of mip levels of a full mip chain.
+     * @param width Width of the most detailed level
+     * @param height Height of the most detailed level
+     * @return Levels down to 1x1
+     */
+    [[nodiscard]] uint32_t get_full_mip_count(uint32_t width, uint32_t height) noexcept;
+
+    /**
+     * @brief One stored mip level of a texture file.
+     */
+    struct texture_mip {
+        uint32_t width;
+        uint32_t height;
+        gsl::span<const std::byte> texels; // tightly packed
+    };
+
+    /**
+     * @brief View of a texture stored in an asset archive. Parsing doesn't copy, the texels point into the file.
+     * A texture file may store only the most detailed levels of its mip chain, the rest is generated at runtime.
+     *
+     * Layout, all integers little endian:
+     *   header      magic "BBGT", version, VkFormat, width, height, stored mip count
+     *   mips        offset and size of every stored level from the start of the file, most detailed first
+     *   data        texels, each level aligned to data_alignment
+     */
+    class texture_file {
+    public:
+
+        static constexpr const std::array<char, 4> magic { 'B', 'B', 'G', 'T' };
+        static constexpr const uint32_t format_version = 1;
+        static constexpr const uint64_t data_alignment = 16;
+
+        /**
+         * @brief Parse a texture file.
+         * @param contents File contents, have to outlive the texture file
+         * @return The texture or an error if it is malformed
+         */
+        [[nodiscard]] static result<texture_file, std::runtime_error> parse(gsl::span<const std::byte> contents);
+
+        /**
+         * @brief Serialize a texture.
+         * @param format VkFormat of the texels
+         * @param width Width of the most detailed level
+         * @param height Height of the most detailed level
+         * @param mips Tightly packed texels of the stored levels, most detailed first
+         * @return File contents
+         */
+        [[nodiscard]] static std::vector<std::byte> write(uint32_t format, uint32_t width, uint32_t height,
+                                                          const std::vector<std::vector<std::byte>>& mips);
+
+        [[nodiscard]] uint32_t get_format() const noexcept;
+        [[nodiscard]] uint32_t get_width() const noexcept;
+        [[nodiscard]] uint32_t get_height() const noexcept;
+
+        /**
+         * @brief Get the number of levels stored in the file.
+         * @return Stored mip levels, at least one
+         */
+        [[nodiscard]] uint32_t get_mip_count() const noexcept;
+
+        /**
+         * @brief Get a stored level.
+         * @param level Level, less than get_mip_count()
+         * @return The level
+         */
+        [[nodiscard]] texture_mip get_mip(uint32_t level) const noexcept;
+
+    private:
+
+        uint32_t m_format = 0;
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+        std::vector<gsl::span<const std::byte>> m_mips;
+    };
+}
+
+#endif //BAMBOOENGINE_TEXTURE_FILE_HPP
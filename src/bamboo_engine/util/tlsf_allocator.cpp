@@ -0,0 +1,294 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cassert>
+#include <stdexcept>
+#include "tlsf_allocator.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace bbge {
+
+    namespace {
+
+        /// index of the most significant set bit, value must not be 0
+        uint32_t find_last_set(uint64_t value) noexcept {
+            assert(value != 0);
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanReverse64(&index, value);
+            return index;
+#else
+            return 63 - __builtin_clzll(value);
+#endif
+        }
+
+        /// index of the least significant set bit, value must not be 0
+        uint32_t find_first_set(uint64_t value) noexcept {
+            assert(value != 0);
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward64(&index, value);
+            return index;
+#else
+            return __builtin_ctzll(value);
+#endif
+        }
+
+        uint64_t align_up(uint64_t value, uint64_t alignment) noexcept {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+    }
+
+    tlsf_allocator::tlsf_allocator(uint64_t size)
+      : m_size(size), m_used(0), m_allocation_count(0), m_fl_bitmap(0), m_sl_bitmaps { } {
+
+        if (size == 0) {
+            throw std::invalid_argument("TLSF allocator requires a non-empty range.");
+        }
+
+        for (auto& lists : m_free_lists) {
+            lists.fill(invalid_handle);
+        }
+
+        auto h = new_block();
+        m_blocks[h].offset = 0;
+        m_blocks[h].size = size;
+        insert_free(h);
+    }
+
+    std::optional<tlsf_allocator::allocation> tlsf_allocator::allocate(uint64_t size, uint64_t alignment) {
+
+        assert(size > 0);
+        assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+        if (size > m_size || alignment > m_size) {
+            return { };
+        }
+
+        // searching for the worst case padding keeps the search O(1)
+        auto h = find_free_block(size + alignment - 1);
+        if (h == invalid_handle) {
+            return { };
+        }
+        remove_free(h);
+
+        // leading padding becomes its own free block. Its physical predecessor cannot be free,
+        // because free neighbours are always merged.
+        auto aligned_offset = align_up(m_blocks[h].offset, alignment);
+        auto padding = aligned_offset - m_blocks[h].offset;
+        if (padding > 0) {
+            auto rest = split(h, padding);
+            insert_free(h);
+            h = rest;
+        }
+
+        if (m_blocks[h].size - size >= min_split_size) {
+            auto tail = split(h, size);
+            insert_free(tail);
+        }
+
+        m_used += m_blocks[h].size;
+        ++m_allocation_count;
+
+        return allocation { aligned_offset, size, h };
+    }
+
+    void tlsf_allocator::free(handle h) {
+
+        assert(h < m_blocks.size() && m_blocks[h].in_use && !m_blocks[h].free);
+
+        m_used -= m_blocks[h].size;
+        --m_allocation_count;
+
+        auto next = m_blocks[h].next_phys;
+        if (next != invalid_handle && m_blocks[next].free) {
+            remove_free(next);
+            merge_into_prev(next);
+        }
+
+        auto prev = m_blocks[h].prev_phys;
+        if (prev != invalid_handle && m_blocks[prev].free) {
+            remove_free(prev);
+            merge_into_prev(h);
+            h = prev;
+        }
+
+        insert_free(h);
+    }
+
+    uint64_t tlsf_allocator::get_size() const noexcept {
+        return m_size;
+    }
+
+    uint64_t tlsf_allocator::get_used() const noexcept {
+        return m_used;
+    }
+
+    uint32_t tlsf_allocator::get_allocation_count() const noexcept {
+        return m_allocation_count;
+    }
+
+    bool tlsf_allocator::is_empty() const noexcept {
+        return m_allocation_count == 0;
+    }
+
+    std::pair<uint32_t, uint32_t> tlsf_allocator::mapping(uint64_t size) noexcept {
+
+        // small sizes are linearly spread over the first list
+        if (size < sl_count) {
+            return { 0, static_cast<uint32_t>(size) };
+        }
+
+        auto msb = find_last_set(size);
+        auto fl = msb - sl_log2 + 1;
+        auto sl = static_cast<uint32_t>(size >> (msb - sl_log2)) - sl_count;
+        return { fl, sl };
+    }
+
+    tlsf_allocator::handle tlsf_allocator::find_free_block(uint64_t size) const noexcept {
+
+        // round up to the next list, so every block in the found list is large enough
+        if (size >= sl_count) {
+            auto round = (uint64_t(1) << (find_last_set(size) - sl_log2)) - 1;
+            if (size > std::numeric_limits<uint64_t>::max() - round) {
+                return invalid_handle;
+            }
+            size += round;
+        }
+
+        auto [fl, sl] = mapping(size);
+        if (fl >= fl_count) {
+            return invalid_handle;
+        }
+
+        uint32_t sl_map = m_sl_bitmaps[fl] & (~0u << sl);
+        if (sl_map == 0) {
+            uint64_t fl_map = fl + 1 < 64 ? m_fl_bitmap & (~uint64_t(0) << (fl + 1)) : 0;
+            if (fl_map == 0) {
+                return invalid_handle;
+            }
+            fl = find_first_set(fl_map);
+            sl_map = m_sl_bitmaps[fl];
+        }
+
+        return m_free_lists[fl][find_first_set(sl_map)];
+    }
+
+    tlsf_allocator::handle tlsf_allocator::new_block() {
+
+        if (!m_unused_blocks.empty()) {
+            auto h = m_unused_blocks.back();
+            m_unused_blocks.pop_back();
+            m_blocks[h] = block { };
+            m_blocks[h].in_use = true;
+            return h;
+        }
+
+        auto& b = m_blocks.emplace_back();
+        b.in_use = true;
+        return static_cast<handle>(m_blocks.size() - 1);
+    }
+
+    void tlsf_allocator::release_block(handle h) noexcept {
+        m_blocks[h].in_use = false;
+        m_unused_blocks.push_back(h);
+    }
+
+    void tlsf_allocator::insert_free(handle h) noexcept {
+
+        auto [fl, sl] = mapping(m_blocks[h].size);
+        auto& head = m_free_lists[fl][sl];
+
+        auto& b = m_blocks[h];
+        b.free = true;
+        b.prev_free = invalid_handle;
+        b.next_free = head;
+        if (head != invalid_handle) {
+            m_blocks[head].prev_free = h;
+        }
+        head = h;
+
+        m_sl_bitmaps[fl] |= 1u << sl;
+        m_fl_bitmap |= uint64_t(1) << fl;
+    }
+
+    void tlsf_allocator::remove_free(handle h) noexcept {
+
+        auto [fl, sl] = mapping(m_blocks[h].size);
+        auto& b = m_blocks[h];
+
+        if (b.prev_free != invalid_handle) {
+            m_blocks[b.prev_free].next_free = b.next_free;
+        }
+        if (b.next_free != invalid_handle) {
+            m_blocks[b.next_free].prev_free = b.prev_free;
+        }
+
+        auto& head = m_free_lists[fl][sl];
+        if (head == h) {
+            head = b.next_free;
+            if (head == invalid_handle) {
+                m_sl_bitmaps[fl] &= ~(1u << sl);
+                if (m_sl_bitmaps[fl] == 0) {
+                    m_fl_bitmap &= ~(uint64_t(1) << fl);
+                }
+            }
+        }
+
+        b.free = false;
+        b.prev_free = invalid_handle;
+        b.next_free = invalid_handle;
+    }
+
+    tlsf_allocator::handle tlsf_allocator::split(handle h, uint64_t size) {
+
+        assert(size < m_blocks[h].size);
+
+        // may reallocate the block storage, no references before this
+        auto rest = new_block();
+
+        auto next = m_blocks[h].next_phys;
+        m_blocks[rest].offset = m_blocks[h].offset + size;
+        m_blocks[rest].size = m_blocks[h].size - size;
+        m_blocks[rest].prev_phys = h;
+        m_blocks[rest].next_phys = next;
+        if (next != invalid_handle) {
+            m_blocks[next].prev_phys = rest;
+        }
+
+        m_blocks[h].size = size;
+        m_blocks[h].next_phys = rest;
+        return rest;
+    }
+
+    void tlsf_allocator::merge_into_prev(handle h) noexcept {
+
+        auto prev = m_blocks[h].prev_phys;
+        auto next = m_blocks[h].next_phys;
+        assert(prev != invalid_handle);
+
+        m_blocks[prev].size += m_blocks[h].size;
+        m_blocks[prev].next_phys = next;
+        if (next != invalid_handle) {
+            m_blocks[next].prev_phys = prev;
+        }
+        release_block(h);
+    }
+}
@@ -0,0 +1,109 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_TLSF_ALLOCATOR_HPP
+#define BAMBOOENGINE_TLSF_ALLOCATOR_HPP
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace bbge {
+
+    /**
+     * @brief Two-level segregated fit allocator for offsets into an externally owned range.
+     * It never touches the memory it manages, so it can be used for GPU memory blocks or buffer sub-ranges.
+     * Allocation and deallocation run in O(1).
+     */
+    class tlsf_allocator {
+    public:
+
+        using handle = uint32_t;
+        static constexpr const handle invalid_handle = std::numeric_limits<handle>::max();
+
+        struct allocation {
+            uint64_t offset;    // aligned offset into the managed range
+            uint64_t size;      // requested size
+            handle   block;     // pass to free()
+        };
+
+        /**
+         * @brief Manage the range [0, size).
+         * @param size Size of the range
+         */
+        explicit tlsf_allocator(uint64_t size);
+
+        /**
+         * @brief Allocate a sub range.
+         * @param size Size in bytes, has to be greater than 0
+         * @param alignment Alignment of the offset, has to be a power of two
+         * @return The allocation or nothing if there is no free range large enough
+         */
+        [[nodiscard]] std::optional<allocation> allocate(uint64_t size, uint64_t alignment = 1);
+
+        /**
+         * @brief Free an allocation. Neighbouring free ranges are merged.
+         * @param block Block handle of the allocation
+         */
+        void free(handle block);
+
+        [[nodiscard]] uint64_t get_size() const noexcept;
+        [[nodiscard]] uint64_t get_used() const noexcept;
+        [[nodiscard]] uint32_t get_allocation_count() const noexcept;
+        [[nodiscard]] bool is_empty() const noexcept;
+
+    private:
+
+        static constexpr const uint32_t sl_log2 = 5;
+        static constexpr const uint32_t sl_count = 1u << sl_log2;
+        static constexpr const uint32_t fl_count = 64 - sl_log2 + 1;
+        static constexpr const uint64_t min_split_size = 64; // smaller remainders stay part of the allocation
+
+        struct block {
+            uint64_t offset     = 0;
+            uint64_t size       = 0;
+            handle   prev_phys  = invalid_handle;
+            handle   next_phys  = invalid_handle;
+            handle   prev_free  = invalid_handle;
+            handle   next_free  = invalid_handle;
+            bool     free       = false;
+            bool     in_use     = false; // false if the slot is unused and on the recycle list
+        };
+
+        uint64_t m_size;
+        uint64_t m_used;
+        uint32_t m_allocation_count;
+        uint64_t m_fl_bitmap;
+        std::array<uint32_t, fl_count> m_sl_bitmaps;
+        std::array<std::array<handle, sl_count>, fl_count> m_free_lists;
+        std::vector<block> m_blocks;
+        std::vector<handle> m_unused_blocks;
+
+        [[nodiscard]] static std::pair<uint32_t, uint32_t> mapping(uint64_t size) noexcept;
+        [[nodiscard]] handle find_free_block(uint64_t size) const noexcept;
+        [[nodiscard]] handle new_block();
+        void release_block(handle h) noexcept;
+        void insert_free(handle h) noexcept;
+        void remove_free(handle h) noexcept;
+        handle split(handle h, uint64_t size);
+        void merge_into_prev(handle h) noexcept;
+    };
+}
+
+#endif //BAMBOOENGINE_TLSF_ALLOCATOR_HPP
@@ -0,0 +1,114 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <fstream>
+#include <fmt/format.h>
+#include "trace_recorder.hpp"
+
+namespace bbge {
+
+    namespace {
+
+        double to_microseconds(trace_recorder::clock::duration d) {
+            return std::chrono::duration<double, std::micro>(d).count();
+        }
+    }
+
+    trace_recorder::scope::scope(trace_recorder& recorder, std::string name)
+      : m_recorder(recorder), m_name(std::move(name)), m_start(clock::now()) { }
+
+    trace_recorder::scope::~scope() {
+        auto end = clock::now();
+        try {
+            m_recorder.record(std::move(m_name), m_start, end);
+        }
+        catch (...) {
+            // losing an event isn't worth terminating over
+        }
+    }
+
+    trace_recorder::trace_recorder()
+      : m_origin(clock::now()), m_threads { std::this_thread::get_id() } { }
+
+    void trace_recorder::record(std::string name, clock::time_point start, clock::time_point end) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto thread = get_thread_number(std::this_thread::get_id());
+        m_events.push_back({ std::move(name), thread, start - m_origin, end - start });
+    }
+
+    std::vector<trace_recorder::event> trace_recorder::get_events() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_events;
+    }
+
+    nlohmann::json trace_recorder::to_chrome_trace() const {
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto events = nlohmann::json::array();
+        for (std::size_t i = 0; i < m_threads.size(); ++i) {
+            events.push_back({
+                { "name", "thread_name" },
+                { "ph", "M" },
+                { "pid", 1 },
+                { "tid", i },
+                { "args", { { "name", i == 0 ? std::string("Main thread") : fmt::format("Thread {}", i) } } }
+            });
+        }
+        for (const auto& e : m_events) {
+            events.push_back({
+                { "name", e.name },
+                { "ph", "X" },
+                { "pid", 1 },
+                { "tid", e.thread },
+                { "ts", to_microseconds(e.start) },
+                { "dur", to_microseconds(e.duration) }
+            });
+        }
+
+        return { { "traceEvents", std::move(events) }, { "displayTimeUnit", "ms" } };
+    }
+
+    result<std::size_t, std::runtime_error> trace_recorder::write(const std::filesystem::path& p) const {
+
+        auto trace = to_chrome_trace();
+
+        std::error_code ec;
+        if (p.has_parent_path()) {
+            std::filesystem::create_directories(p.parent_path(), ec);
+        }
+
+        std::ofstream out(p);
+        out << trace.dump() << '\n';
+        if (!out) {
+            return std::runtime_error(fmt::format("Failed to write trace '{}'.", p.string()));
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_events.size();
+    }
+
+    uint32_t trace_recorder::get_thread_number(std::thread::id id) {
+        auto it = std::find(m_threads.begin(), m_threads.end(), id);
+        if (it == m_threads.end()) {
+            m_threads.push_back(id);
+            return static_cast<uint32_t>(m_threads.size() - 1);
+        }
+        return static_cast<uint32_t>(it - m_threads.begin());
+    }
+}
@@ -0,0 +1,113 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BAMBOOENGINE_TRACE_RECORDER_HPP
+#define BAMBOOENGINE_TRACE_RECORDER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "macros.hpp"
+#include "result.hpp"
+
+namespace bbge {
+
+    /**
+     * @brief Records timed phases, e.g. of the engine start up, from any thread.
+     * The events can be saved in the Chrome trace event format and opened in chrome://tracing or Perfetto.
+     */
+    class trace_recorder {
+    public:
+
+        using clock = std::chrono::steady_clock;
+
+        struct event {
+            std::string     name;
+            uint32_t        thread;     // 0 is the thread that created the recorder, others are numbered in order of appearance
+            clock::duration start;      // since the recorder was created
+            clock::duration duration;
+        };
+
+        /**
+         * @brief Records the time from construction to destruction as one event.
+         */
+        class scope {
+        public:
+
+            BBGE_NO_COPIES(scope);
+            BBGE_NO_MOVES(scope);
+
+            scope(trace_recorder& recorder, std::string name);
+            ~scope();
+
+        private:
+
+            trace_recorder& m_recorder;
+            std::string m_name;
+            clock::time_point m_start;
+        };
+
+        BBGE_NO_COPIES(trace_recorder);
+        BBGE_NO_MOVES(trace_recorder);
+
+        trace_recorder();
+
+        /**
+         * @brief Record a finished event of the calling thread.
+         * @param name Name of the event
+         * @param start Start of the event
+         * @param end End of the event
+         */
+        void record(std::string name, clock::time_point start, clock::time_point end);
+
+        /**
+         * @brief Get the recorded events.
+         * @return Events in the order they finished
+         */
+        [[nodiscard]] std::vector<event> get_events() const;
+
+        /**
+         * @brief Convert the events to the Chrome trace event format, complete events with microsecond timestamps.
+         * @return JSON object with a traceEvents array
+         */
+        [[nodiscard]] nlohmann::json to_chrome_trace() const;
+
+        /**
+         * @brief Save the events as Chrome trace.
+         * @param p File to write, overwritten if it exists
+         * @return Number of events written or an error if the file couldn't be written
+         */
+        [[nodiscard]] result<std::size_t, std::runtime_error> write(const std::filesystem::path& p) const;
+
+    private:
+
+        clock::time_point m_origin;
+        mutable std::mutex m_mutex;
+        std::vector<event> m_events;
+        std::vector<std::thread::id> m_threads; // index is the thread number
+
+        [[nodiscard]] uint32_t get_thread_number(std::thread::id id);
+    };
+}
+
+#endif //BAMBOOENGINE_TRACE_RECORDER_HPP
@@ -0,0 +1,117 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <gtest/gtest.h>
+#include <bamboo_engine/util/asset_archive.hpp>
+
+using namespace bbge;
+
+namespace {
+
+    std::vector<std::byte> to_bytes(const std::string& str) {
+        std::vector<std::byte> bytes(str.size());
+        std::memcpy(bytes.data(), str.data(), str.size());
+        return bytes;
+    }
+
+    bool equals(gsl::span<const std::byte> bytes, const std::string& str) {
+        return bytes.size() == str.size() && std::memcmp(bytes.data(), str.data(), str.size()) == 0;
+    }
+}
+
+TEST(asset_archive, round_trip) {
+
+    auto p = std::filesystem::temp_directory_path() / "bbge_asset_archive_round_trip.bba";
+
+    asset_archive_writer writer;
+    writer.add("shader/simple.vert.spv", to_bytes("vertex"));
+    writer.add("shader/simple.frag.spv", to_bytes("fragment shader"));
+    writer.add("empty", { });
+    ASSERT_TRUE(writer.write(p).is_ok());
+
+    auto archive = asset_archive::open(p);
+    ASSERT_TRUE(archive.is_ok());
+    ASSERT_EQ(archive.ok()->size(), 3);
+
+    auto vert = archive.ok()->get_contents("shader/simple.vert.spv");
+    ASSERT_TRUE(vert.is_ok());
+    ASSERT_TRUE(equals(*vert.ok(), "vertex"));
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(vert.ok()->data()) % asset_archive::data_alignment, 0);
+
+    auto frag = archive.ok()->get_contents("shader/simple.frag.spv");
+    ASSERT_TRUE(frag.is_ok());
+    ASSERT_TRUE(equals(*frag.ok(), "fragment shader"));
+
+    const auto* empty = archive.ok()->find("empty");
+    ASSERT_NE(empty, nullptr);
+    ASSERT_EQ(empty->size, 0);
+    ASSERT_TRUE(archive.ok()->verify(*empty));
+
+    const auto* entry = archive.ok()->find("shader/simple.frag.spv");
+    ASSERT_NE(entry, nullptr);
+    ASSERT_EQ(entry->compression, asset_compression::none);
+    ASSERT_EQ(entry->content_hash, fnv1a_64(*frag.ok()));
+    ASSERT_TRUE(archive.ok()->verify(*entry));
+
+    std::filesystem::remove(p);
+}
+
+TEST(asset_archive, missing_asset) {
+
+    auto p = std::filesystem::temp_directory_path() / "bbge_asset_archive_missing.bba";
+
+    asset_archive_writer writer;
+    writer.add("a", to_bytes("a"));
+    ASSERT_TRUE(writer.write(p).is_ok());
+
+    auto archive = asset_archive::open(p);
+    ASSERT_TRUE(archive.is_ok());
+    ASSERT_EQ(archive.ok()->find("b"), nullptr);
+    ASSERT_TRUE(archive.ok()->get_contents("b").is_err());
+
+    std::filesystem::remove(p);
+}
+
+TEST(asset_archive, malformed) {
+
+    auto p = std::filesystem::temp_directory_path() / "bbge_asset_archive_malformed.bba";
+    {
+        std::ofstream os(p, std::ios_base::binary | std::ios_base::trunc);
+        os << "this is not an asset archive, but it is long enough for a header";
+    }
+
+    ASSERT_TRUE(asset_archive::open(p).is_err());
+
+    std::filesystem::remove(p);
+}
+
+TEST(asset_archive, duplicate_names) {
+    asset_archive_writer writer;
+    writer.add("a", to_bytes("a"));
+    ASSERT_THROW(writer.add("a", to_bytes("b")), std::invalid_argument);
+    ASSERT_THROW(writer.add("", to_bytes("b")), std::invalid_argument);
+}
+
+TEST(asset_archive, fnv1a) {
+    // reference values of the 64 bit FNV-1a
+    ASSERT_EQ(fnv1a_64(std::string_view("")), 0xcbf29ce484222325ull);
+    ASSERT_EQ(fnv1a_64(std::string_view("a")), 0xaf63dc4c8601ec8cull);
+}
@@ -0,0 +1,109 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include <bamboo_engine/scene/frustum_culling.hpp>
+
+using namespace bbge;
+
+namespace {
+
+    struct spheres {
+        std::vector<float> x, y, z, radius;
+    };
+
+    spheres random_spheres(std::size_t n) {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> position(-3.0f, 3.0f);
+        std::uniform_real_distribution<float> radius(0.0f, 0.5f);
+        spheres s;
+        for (std::size_t i = 0; i < n; ++i) {
+            s.x.push_back(position(rng));
+            s.y.push_back(position(rng));
+            s.z.push_back(position(rng));
+            s.radius.push_back(radius(rng));
+        }
+        return s;
+    }
+}
+
+TEST(frustum_culling, identity_frustum) {
+
+    // the identity's clip space is the box [-1, 1] x [-1, 1] x [0, 1]
+    auto f = frustum::from_view_projection(glm::mat4(1.0f));
+
+    ASSERT_TRUE(f.intersects({ glm::vec3(0.0f, 0.0f, 0.5f), 0.1f }));
+    ASSERT_TRUE(f.intersects({ glm::vec3(1.2f, 0.0f, 0.5f), 0.3f }));
+    ASSERT_FALSE(f.intersects({ glm::vec3(1.2f, 0.0f, 0.5f), 0.1f }));
+    ASSERT_FALSE(f.intersects({ glm::vec3(0.0f, 0.0f, -0.5f), 0.1f }));
+    ASSERT_FALSE(f.intersects({ glm::vec3(0.0f, 0.0f, 1.5f), 0.1f }));
+}
+
+TEST(frustum_culling, kernels_match_scalar) {
+
+    auto f = frustum::from_view_projection(glm::mat4(1.0f));
+    auto s = random_spheres(1003); // not a multiple of any SIMD width
+
+    std::vector<uint32_t> expected(s.x.size());
+    auto expected_count = cull_spheres(f, s.x.data(), s.y.data(), s.z.data(), s.radius.data(), s.x.size(),
+                                       expected.data(), cull_kernel::scalar);
+    expected.resize(expected_count);
+    ASSERT_GT(expected_count, 0);
+    ASSERT_LT(expected_count, s.x.size());
+
+    for (auto kernel : { cull_kernel::sse, cull_kernel::avx2, cull_kernel::neon }) {
+        if (!is_supported(kernel)) continue;
+
+        std::vector<uint32_t> visible(s.x.size());
+        auto count = cull_spheres(f, s.x.data(), s.y.data(), s.z.data(), s.radius.data(), s.x.size(), visible.data(), kernel);
+        visible.resize(count);
+        ASSERT_EQ(visible, expected) << to_string(kernel);
+    }
+
+    for (auto i : expected) {
+        ASSERT_TRUE(f.intersects({ glm::vec3(s.x[i], s.y[i], s.z[i]), s.radius[i] }));
+    }
+}
+
+TEST(frustum_culling, detected_kernel_is_supported) {
+    ASSERT_TRUE(is_supported(detect_cull_kernel()));
+    ASSERT_TRUE(is_supported(cull_kernel::scalar));
+}
+
+TEST(frustum_culling, parallel_matches_serial) {
+
+    auto f = frustum::from_view_projection(glm::mat4(1.0f));
+    auto s = random_spheres(10007);
+
+    render_list list;
+    list.bounds_x = s.x;
+    list.bounds_y = s.y;
+    list.bounds_z = s.z;
+    list.bounds_radius = s.radius;
+    list.sort_keys.resize(s.x.size());
+
+    frustum_culler culler;
+    std::vector<uint32_t> expected;
+    culler.cull(f, list, expected);
+
+    job_system jobs(3);
+    std::vector<uint32_t> visible;
+    culler.cull(f, list, visible, &jobs, 1);
+    ASSERT_EQ(visible, expected);
+}
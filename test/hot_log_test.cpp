@@ -0,0 +1,113 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <gtest/gtest.h>
+#include <spdlog/sinks/ostream_sink.h>
+#include <bamboo_engine/util/hot_log.hpp>
+
+using namespace bbge;
+
+namespace {
+
+    // routes the default logger into a string for the duration of a test
+    class hot_log_test : public ::testing::Test {
+    protected:
+
+        void SetUp() override {
+            m_previous = spdlog::default_logger();
+            auto sink = std::make_shared<spdlog::sinks::ostream_sink_st>(m_output);
+            sink->set_pattern("%l %v");
+            auto logger = std::make_shared<spdlog::logger>("hot_log_test", sink);
+            logger->set_level(spdlog::level::trace);
+            spdlog::set_default_logger(logger);
+        }
+
+        void TearDown() override {
+            spdlog::set_default_logger(m_previous);
+        }
+
+        std::ostringstream m_output;
+        std::shared_ptr<spdlog::logger> m_previous;
+    };
+
+    // the background thread never runs a pass on its own
+    constexpr std::chrono::milliseconds manual_flush { std::chrono::hours(1) };
+}
+
+TEST_F(hot_log_test, formats_arguments) {
+
+    hot_logger logger(16, log_overflow::drop, manual_flush);
+    m_output.str({ });
+    int32_t a = -3;
+    uint16_t b = 7;
+    std::string name = "main";
+    BBGE_HOT_LOG(spdlog::level::info, "{} {} {:.1f} {} {}", a, b, 2.5f, true, name);
+    BBGE_HOT_LOG(spdlog::level::warn, "literal {}", "text");
+    logger.flush();
+
+    ASSERT_EQ(m_output.str(), "info -3 7 2.5 true main\nwarning literal text\n");
+}
+
+TEST_F(hot_log_test, cuts_long_strings) {
+
+    hot_logger logger(16, log_overflow::drop, manual_flush);
+    m_output.str({ });
+    std::string long_string(500, 'x');
+    BBGE_HOT_LOG(spdlog::level::info, "{} {}", long_string, 1);
+    logger.flush();
+
+    auto output = m_output.str();
+    ASSERT_EQ(output.find("xxx..."), std::string::npos);
+    ASSERT_NE(output.find("x ..."), std::string::npos);
+    ASSERT_LT(output.size(), hot_log_record::payload_size + 16);
+}
+
+TEST_F(hot_log_test, drops_and_counts) {
+
+    hot_logger logger(4, log_overflow::drop, manual_flush);
+    m_output.str({ });
+    for (int i = 0; i < 10; ++i) {
+        BBGE_HOT_LOG(spdlog::level::info, "{}", i);
+    }
+    ASSERT_EQ(logger.get_dropped(), 6);
+    logger.flush();
+
+    auto output = m_output.str();
+    ASSERT_EQ(output.find("info 0\ninfo 1\ninfo 2\ninfo 3\n"), 0);
+    ASSERT_NE(output.find("dropped 6 records"), std::string::npos);
+}
+
+TEST_F(hot_log_test, respects_level) {
+
+    hot_logger logger(16, log_overflow::drop, manual_flush);
+    m_output.str({ });
+    spdlog::default_logger_raw()->set_level(spdlog::level::warn);
+    BBGE_HOT_LOG(spdlog::level::info, "hidden");
+    BBGE_HOT_LOG(spdlog::level::err, "shown");
+    logger.flush();
+
+    ASSERT_EQ(m_output.str(), "error shown\n");
+}
+
+TEST(hot_log, discards_without_logger) {
+    ASSERT_EQ(hot_logger::get(), nullptr);
+    BBGE_HOT_LOG(spdlog::level::info, "{}", 1);
+}
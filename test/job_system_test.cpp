@@ -0,0 +1,108 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include <gtest/gtest.h>
+#include <bamboo_engine/util/job_system.hpp>
+
+using namespace bbge;
+
+TEST(job_system, default_thread_count) {
+    job_system jobs;
+    ASSERT_GE(jobs.get_thread_count(), 1);
+}
+
+TEST(job_system, results) {
+
+    job_system jobs(4);
+    std::vector<std::future<int>> futures;
+    for (int i = 0; i < 100; ++i) {
+        futures.push_back(jobs.submit([i]() { return i * i; }));
+    }
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(futures[i].get(), i * i);
+    }
+}
+
+TEST(job_system, exceptions) {
+
+    job_system jobs(2);
+    auto f = jobs.submit([]() -> int { throw std::runtime_error("failed"); });
+    ASSERT_THROW(f.get(), std::runtime_error);
+
+    job_counter counter;
+    jobs.run(counter, []() { throw std::runtime_error("failed"); });
+    jobs.run(counter, []() { });
+    ASSERT_THROW(jobs.wait(counter), std::runtime_error);
+    ASSERT_TRUE(counter.is_done());
+    ASSERT_NO_THROW(jobs.wait(counter));
+}
+
+TEST(job_system, drains_on_destruction) {
+
+    std::atomic<int> counter = 0;
+    {
+        job_system jobs(2);
+        for (int i = 0; i < 1000; ++i) {
+            (void) jobs.submit([&counter]() { ++counter; });
+        }
+    }
+    ASSERT_EQ(counter, 1000);
+}
+
+TEST(job_system, counters) {
+
+    job_system jobs(3);
+    std::atomic<int> sum = 0;
+    job_counter counter;
+    for (int i = 1; i <= 100; ++i) {
+        jobs.run(counter, [&sum, i]() { sum += i; });
+    }
+    jobs.wait(counter);
+    ASSERT_EQ(sum, 5050);
+}
+
+TEST(job_system, parallel_for) {
+
+    job_system jobs(3);
+    std::vector<int> hits(10000, 0);
+    jobs.parallel_for(0, hits.size(), 16, [&hits](std::size_t first, std::size_t last) {
+        for (auto i = first; i < last; ++i) ++hits[i];
+    });
+    for (auto h : hits) {
+        ASSERT_EQ(h, 1);
+    }
+
+    bool called = false;
+    jobs.parallel_for(5, 5, 1, [&called](std::size_t, std::size_t) { called = true; });
+    ASSERT_FALSE(called);
+}
+
+TEST(job_system, nested) {
+
+    // jobs waiting for jobs must not deadlock, waiting threads run queued jobs
+    job_system jobs(2);
+    std::atomic<std::size_t> sum = 0;
+    jobs.parallel_for(0, 16, 1, [&](std::size_t first, std::size_t last) {
+        for (auto i = first; i < last; ++i) {
+            jobs.parallel_for(0, 100, 1, [&](std::size_t a, std::size_t b) { sum += b - a; });
+        }
+    });
+    ASSERT_EQ(sum, 1600);
+}
@@ -0,0 +1,78 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <gtest/gtest.h>
+#include <bamboo_engine/util/mapped_file.hpp>
+
+using namespace bbge;
+
+namespace {
+
+    std::filesystem::path write_temp_file(const std::string& name, const std::string& contents) {
+        auto p = std::filesystem::temp_directory_path() / name;
+        std::ofstream os(p, std::ios_base::binary | std::ios_base::trunc);
+        os << contents;
+        return p;
+    }
+}
+
+TEST(mapped_file, contents) {
+
+    const std::string contents = "bamboo engine mapped file";
+    auto p = write_temp_file("bbge_mapped_file_contents.bin", contents);
+
+    auto file = mapped_file::open(p);
+    ASSERT_TRUE(file.is_ok());
+    ASSERT_EQ(file.ok()->size(), contents.size());
+    ASSERT_EQ(std::memcmp(file.ok()->data(), contents.data(), contents.size()), 0);
+    ASSERT_EQ(file.ok()->get_contents().size(), contents.size());
+
+    std::filesystem::remove(p);
+}
+
+TEST(mapped_file, empty) {
+
+    auto p = write_temp_file("bbge_mapped_file_empty.bin", "");
+
+    auto file = mapped_file::open(p);
+    ASSERT_TRUE(file.is_ok());
+    ASSERT_TRUE(file.ok()->empty());
+
+    std::filesystem::remove(p);
+}
+
+TEST(mapped_file, missing) {
+    auto file = mapped_file::open(std::filesystem::temp_directory_path() / "bbge_mapped_file_missing.bin");
+    ASSERT_TRUE(file.is_err());
+}
+
+TEST(mapped_file, move) {
+
+    auto p = write_temp_file("bbge_mapped_file_move.bin", "abc");
+
+    auto file = mapped_file::open(p);
+    ASSERT_TRUE(file.is_ok());
+    mapped_file moved = std::move(*file.ok());
+    ASSERT_EQ(moved.size(), 3);
+    ASSERT_TRUE(file.ok()->empty());
+
+    std::filesystem::remove(p);
+}
@@ -0,0 +1,88 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <bamboo_engine/scene/render_extraction.hpp>
+#include <bamboo_engine/scene/transform_hierarchy.hpp>
+
+using namespace bbge;
+
+TEST(render_extraction, sort_key_order) {
+    // pipeline dominates material, material dominates mesh
+    ASSERT_LT(make_sort_key(0, 5, 5), make_sort_key(1, 0, 0));
+    ASSERT_LT(make_sort_key(1, 0, 5), make_sort_key(1, 1, 0));
+    ASSERT_LT(make_sort_key(1, 1, 0), make_sort_key(1, 1, 1));
+}
+
+TEST(render_extraction, sorted_and_batched) {
+
+    entt::registry registry;
+
+    auto add = [&registry](uint32_t pipeline, uint32_t material, uint32_t mesh, float x) {
+        auto e = registry.create();
+        transform_component t { };
+        t.position = { x, 0.0f, 0.0f };
+        registry.emplace<transform_component>(e, t);
+        mesh_component m { };
+        m.pipeline_id = pipeline;
+        m.material_id = material;
+        m.mesh_id = mesh;
+        m.bounds = { glm::vec3(0.0f), 1.0f };
+        registry.emplace<mesh_component>(e, m);
+        return e;
+    };
+
+    add(1, 0, 0, 0.0f);
+    auto first = add(0, 2, 3, 1.0f);
+    add(0, 2, 3, 2.0f);
+    add(0, 1, 0, 3.0f);
+
+    // no mesh, not drawn
+    registry.emplace<transform_component>(registry.create());
+
+    transform_hierarchy hierarchy(registry);
+    hierarchy.update();
+
+    render_list list;
+    render_extractor extractor;
+    extractor.extract(registry, list);
+
+    ASSERT_EQ(list.size(), 4);
+    ASSERT_TRUE(std::is_sorted(list.sort_keys.begin(), list.sort_keys.end()));
+    ASSERT_EQ(list.pipeline_ids.front(), 0);
+    ASSERT_EQ(list.material_ids.front(), 1);
+    ASSERT_EQ(list.pipeline_ids.back(), 1);
+
+    ASSERT_EQ(list.batches.size(), 3);
+    ASSERT_EQ(list.batches[1].first, 1);
+    ASSERT_EQ(list.batches[1].count, 2);
+    ASSERT_EQ(list.batches[1].mesh_id, 3);
+
+    // attributes stay together while sorting
+    auto it = std::find(list.entities.begin(), list.entities.end(), first);
+    ASSERT_NE(it, list.entities.end());
+    auto i = static_cast<std::size_t>(it - list.entities.begin());
+    ASSERT_FLOAT_EQ(list.model_matrices[i][3].x, 1.0f);
+    ASSERT_FLOAT_EQ(list.bounds_x[i], 1.0f);
+    ASSERT_FLOAT_EQ(list.bounds_radius[i], 1.0f);
+
+    // extracting again replaces the contents
+    extractor.extract(registry, list);
+    ASSERT_EQ(list.size(), 4);
+    ASSERT_EQ(list.batches.size(), 3);
+}
@@ -0,0 +1,172 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <gtest/gtest.h>
+#include <bamboo_engine/graphics/render_graph.hpp>
+
+using namespace bbge;
+
+namespace {
+
+    render_graph_image_desc make_desc(VkFormat format, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT) {
+        render_graph_image_desc desc;
+        desc.format = format;
+        desc.samples = samples;
+        return desc;
+    }
+
+    render_graph_import make_presented() {
+        render_graph_import import;
+        import.initial_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        import.final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        return import;
+    }
+
+    // x -> y -> w -> output, x and w never live at the same time
+    struct compute_chain {
+        render_graph graph;
+        render_graph::resource x, y, w, output;
+
+        compute_chain() {
+            auto desc = make_desc(VK_FORMAT_R16G16B16A16_SFLOAT);
+            x = graph.create_image("x", desc);
+            y = graph.create_image("y", desc);
+            w = graph.create_image("w", desc);
+            output = graph.import_image("output", desc, make_presented());
+            graph.add_pass("a", render_graph_pass_type::compute).storage_write(x);
+            graph.add_pass("b", render_graph_pass_type::compute).sample(x).storage_write(y);
+            graph.add_pass("c", render_graph_pass_type::compute).sample(y).storage_write(w);
+            graph.add_pass("d", render_graph_pass_type::compute).sample(w).storage_write(output);
+        }
+    };
+}
+
+TEST(render_graph, culls_unused_passes) {
+
+    render_graph graph;
+    auto desc = make_desc(VK_FORMAT_R8G8B8A8_UNORM);
+    auto unused = graph.create_image("unused", desc);
+    auto debug = graph.create_image("debug", desc);
+    auto output = graph.import_image("output", desc, make_presented());
+
+    auto dead = graph.add_pass("dead").color(unused).get();
+    auto kept = graph.add_pass("kept").color(debug).side_effects().get();
+    auto main = graph.add_pass("main").color(output).get();
+    graph.compile();
+
+    ASSERT_TRUE(graph.get_passes()[dead].culled);
+    ASSERT_FALSE(graph.get_passes()[kept].culled);
+    ASSERT_FALSE(graph.get_passes()[main].culled);
+}
+
+TEST(render_graph, merges_subpasses) {
+
+    render_graph graph;
+    auto gbuffer = graph.create_image("gbuffer", make_desc(VK_FORMAT_R8G8B8A8_UNORM));
+    auto depth = graph.create_image("depth", make_desc(VK_FORMAT_D32_SFLOAT));
+    auto output = graph.import_image("output", make_desc(VK_FORMAT_B8G8R8A8_SRGB), make_presented());
+
+    graph.add_pass("geometry").color(gbuffer).depth(depth);
+    graph.add_pass("decals").color(gbuffer, attachment_load::load).depth(depth, attachment_load::load);
+    graph.add_pass("overlay").color(output).depth_read(depth);
+    graph.compile();
+
+    // depth changes its layout between decals and overlay
+    const auto& groups = graph.get_groups();
+    ASSERT_EQ(groups.size(), 2);
+    ASSERT_EQ(groups[0].passes.size(), 2);
+    ASSERT_EQ(graph.get_passes()[1].subpass, 1);
+
+    // the gbuffer never leaves the first render pass
+    ASSERT_TRUE(graph.get_images()[gbuffer].lazy);
+    ASSERT_EQ(groups[0].attachments[0].store, VK_ATTACHMENT_STORE_OP_DONT_CARE);
+    ASSERT_FALSE(graph.get_images()[depth].lazy);
+}
+
+TEST(render_graph, sampling_splits_render_passes) {
+
+    render_graph graph;
+    auto scene = graph.create_image("scene", make_desc(VK_FORMAT_R16G16B16A16_SFLOAT));
+    auto output = graph.import_image("output", make_desc(VK_FORMAT_B8G8R8A8_SRGB), make_presented());
+    graph.add_pass("scene").color(scene);
+    graph.add_pass("tonemap").sample(scene).color(output);
+    graph.compile();
+
+    const auto& groups = graph.get_groups();
+    ASSERT_EQ(groups.size(), 2);
+    ASSERT_EQ(groups[0].attachments[0].store, VK_ATTACHMENT_STORE_OP_STORE);
+
+    // scene and output are transitioned by one batch
+    ASSERT_EQ(groups[1].barriers.size(), 2);
+    const auto& b = groups[1].barriers[0].image == scene ? groups[1].barriers[0] : groups[1].barriers[1];
+    ASSERT_EQ(b.old_layout, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    ASSERT_EQ(b.new_layout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    ASSERT_EQ(b.src_stages, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    ASSERT_EQ(b.dst_stages, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    ASSERT_EQ(graph.get_final_barriers().size(), 1);
+    ASSERT_EQ(graph.get_final_barriers()[0].new_layout, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+}
+
+TEST(render_graph, aliases_disjoint_lifetimes) {
+
+    compute_chain chain;
+    chain.graph.compile();
+
+    const auto& images = chain.graph.get_images();
+    ASSERT_EQ(chain.graph.get_alias_slot_count(), 2);
+    ASSERT_EQ(images[chain.x].alias_slot, images[chain.w].alias_slot);
+    ASSERT_NE(images[chain.x].alias_slot, images[chain.y].alias_slot);
+    ASSERT_EQ(images[chain.output].alias_slot, render_graph::no_alias_slot);
+
+    // w discards x and waits for its last read
+    const auto& groups = chain.graph.get_groups();
+    auto barrier = std::find_if(groups[2].barriers.begin(), groups[2].barriers.end(),
+                                [&] (const render_graph_barrier& b) { return b.image == chain.w; });
+    ASSERT_NE(barrier, groups[2].barriers.end());
+    ASSERT_EQ(barrier->old_layout, VK_IMAGE_LAYOUT_UNDEFINED);
+    ASSERT_EQ(barrier->src_stages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+}
+
+TEST(render_graph, lazy_resolve_source) {
+
+    render_graph graph;
+    auto msaa = graph.create_image("msaa", make_desc(VK_FORMAT_B8G8R8A8_SRGB, VK_SAMPLE_COUNT_4_BIT));
+    auto output = graph.import_image("output", make_desc(VK_FORMAT_B8G8R8A8_SRGB), make_presented());
+    graph.add_pass("forward").color(msaa).resolve(msaa, output);
+    graph.compile();
+
+    const auto& group = graph.get_groups()[0];
+    ASSERT_TRUE(graph.get_images()[msaa].lazy);
+    ASSERT_EQ(group.attachments.size(), 2);
+    ASSERT_EQ(group.attachments[0].store, VK_ATTACHMENT_STORE_OP_DONT_CARE);
+    ASSERT_EQ(group.attachments[1].load, VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+    ASSERT_EQ(group.attachments[1].store, VK_ATTACHMENT_STORE_OP_STORE);
+}
+
+TEST(render_graph, rejects_inconsistent_passes) {
+
+    render_graph graph;
+    auto color = graph.create_image("color", make_desc(VK_FORMAT_B8G8R8A8_SRGB));
+    auto output = graph.import_image("output", make_desc(VK_FORMAT_B8G8R8A8_SRGB), make_presented());
+    graph.add_pass("resolve").color(output).resolve(color, output);
+    ASSERT_THROW(graph.compile(), std::invalid_argument);
+
+    render_graph compute;
+    auto image = compute.create_image("image", make_desc(VK_FORMAT_R8G8B8A8_UNORM));
+    compute.add_pass("compute", render_graph_pass_type::compute).color(image);
+    ASSERT_THROW(compute.compile(), std::invalid_argument);
+}
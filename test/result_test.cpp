@@ -0,0 +1,101 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <bamboo_engine/util/result.hpp>
+
+using namespace bbge;
+
+namespace {
+
+    // error that isn't an exception, like vulkan_result_code
+    struct error_code {
+        int code;
+        [[nodiscard]] std::string what() const { return "error " + std::to_string(code); }
+        [[noreturn]] void raise() const { throw std::runtime_error(what()); }
+    };
+
+    result<std::unique_ptr<int>, error_code> make(int value) {
+        if (value < 0) return error_code { value };
+        return std::make_unique<int>(value);
+    }
+}
+
+TEST(result, or_throw_moves_out_of_temporaries) {
+
+    auto p = make(3).or_throw();
+    ASSERT_EQ(*p, 3);
+
+    std::vector<int> v = result<std::vector<int>, std::runtime_error>(std::vector<int> { 1, 2, 3 }).or_throw();
+    ASSERT_EQ(v.size(), 3);
+}
+
+TEST(result, or_throw_raises_lightweight_errors) {
+
+    auto r = make(-2);
+    ASSERT_TRUE(r.is_err());
+    ASSERT_THROW((void) r.or_throw(), std::runtime_error);
+    try {
+        (void) make(-5).or_throw();
+    }
+    catch (const std::runtime_error& e) {
+        ASSERT_STREQ(e.what(), "error -5");
+    }
+}
+
+TEST(result, or_throw_throws_exceptions) {
+    result<int, std::runtime_error> r = std::runtime_error("failed");
+    ASSERT_THROW((void) r.or_throw(), std::runtime_error);
+}
+
+TEST(result, map) {
+
+    auto doubled = make(4).map([](std::unique_ptr<int> p) { return *p * 2; });
+    ASSERT_TRUE(doubled.is_ok());
+    ASSERT_EQ(*doubled.ok(), 8);
+
+    auto failed = make(-1).map([](std::unique_ptr<int> p) { return *p * 2; });
+    ASSERT_TRUE(failed.is_err());
+    ASSERT_EQ(failed.err()->code, -1);
+
+    const auto r = make(5);
+    auto copied = r.map([](const std::unique_ptr<int>& p) { return *p + 1; });
+    ASSERT_EQ(*copied.ok(), 6);
+    ASSERT_EQ(**r.ok(), 5);
+}
+
+TEST(result, and_then) {
+
+    auto next = [](std::unique_ptr<int> p) { return make(*p - 10); };
+
+    auto ok = make(12).and_then(next);
+    ASSERT_TRUE(ok.is_ok());
+    ASSERT_EQ(**ok.ok(), 2);
+
+    auto failed_later = make(3).and_then(next);
+    ASSERT_TRUE(failed_later.is_err());
+    ASSERT_EQ(failed_later.err()->code, -7);
+
+    bool called = false;
+    auto failed_first = make(-4).and_then([&called](std::unique_ptr<int> p) { called = true; return make(*p); });
+    ASSERT_FALSE(called);
+    ASSERT_EQ(failed_first.err()->code, -4);
+}
@@ -0,0 +1,77 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdint>
+#include <vector>
+#include <gtest/gtest.h>
+#include <bamboo_engine/util/retire_queue.hpp>
+
+using namespace bbge;
+
+TEST(retire_queue, releases_after_frames) {
+
+    retire_queue<int> queue;
+    std::vector<int> destroyed;
+    auto destroy = [&destroyed] (int r) { destroyed.push_back(r); };
+
+    queue.release(0, destroy);
+    queue.push(1, 2);
+    queue.push(2, 3);
+
+    queue.release(1, destroy);
+    ASSERT_TRUE(destroyed.empty());
+    queue.release(2, destroy);
+    ASSERT_EQ(destroyed, std::vector<int>({ 1 }));
+    queue.release(3, destroy);
+    ASSERT_EQ(destroyed, std::vector<int>({ 1, 2 }));
+    ASSERT_TRUE(queue.empty());
+}
+
+TEST(retire_queue, repeated_outdated_acquires_count_once) {
+
+    // what the frame scheduler does while a window is resized: frame 5 is begun on the same slot over and over,
+    // each time the slot's fence is waited for and the acquire reports an outdated swap chain
+    constexpr uint32_t frames_in_flight = 2;
+    retire_queue<int> queue;
+    std::vector<int> destroyed;
+    auto destroy = [&destroyed] (int r) { destroyed.push_back(r); };
+
+    queue.release(5, destroy);
+    queue.push(7, frames_in_flight); // the swap chain was recreated during the first attempt
+    for (int attempt = 0; attempt < 10; ++attempt) {
+        queue.release(5, destroy);
+    }
+    ASSERT_TRUE(destroyed.empty());
+    ASSERT_EQ(queue.size(), 1);
+
+    // the old swap chain is only free once the other slot was waited for as well
+    queue.release(6, destroy);
+    ASSERT_TRUE(destroyed.empty());
+    queue.release(7, destroy);
+    ASSERT_EQ(destroyed, std::vector<int>({ 7 }));
+}
+
+TEST(retire_queue, release_all) {
+
+    retire_queue<int> queue;
+    std::vector<int> destroyed;
+    queue.push(1, 1);
+    queue.push(2, 5);
+    queue.release_all([&destroyed] (int r) { destroyed.push_back(r); });
+    ASSERT_EQ(destroyed, std::vector<int>({ 1, 2 }));
+    ASSERT_TRUE(queue.empty());
+}
@@ -0,0 +1,64 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include <bamboo_engine/util/rolling_statistics.hpp>
+
+using namespace bbge;
+
+TEST(rolling_statistics, empty) {
+
+    ASSERT_THROW(rolling_statistics(0), std::invalid_argument);
+
+    rolling_statistics stats(8);
+    auto s = stats.get_summary();
+    ASSERT_EQ(s.samples, 0);
+    ASSERT_EQ(s.avg, 0.0);
+}
+
+TEST(rolling_statistics, summary) {
+
+    rolling_statistics stats(100);
+    for (int i = 1; i <= 100; ++i) {
+        stats.add(i);
+    }
+
+    auto s = stats.get_summary();
+    ASSERT_EQ(s.samples, 100);
+    ASSERT_DOUBLE_EQ(s.min, 1.0);
+    ASSERT_DOUBLE_EQ(s.max, 100.0);
+    ASSERT_DOUBLE_EQ(s.avg, 50.5);
+    ASSERT_DOUBLE_EQ(s.p99, 99.0);
+}
+
+TEST(rolling_statistics, replaces_oldest) {
+
+    rolling_statistics stats(3);
+    stats.add(100.0);
+    stats.add(1.0);
+    stats.add(2.0);
+    stats.add(3.0);
+
+    auto s = stats.get_summary();
+    ASSERT_EQ(s.samples, 3);
+    ASSERT_DOUBLE_EQ(s.max, 3.0);
+    ASSERT_DOUBLE_EQ(s.avg, 2.0);
+
+    stats.clear();
+    ASSERT_EQ(stats.get_summary().samples, 0);
+}
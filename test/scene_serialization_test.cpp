@@ -0,0 +1,156 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <bamboo_engine/scene/scene_serialization.hpp>
+
+using namespace bbge;
+
+namespace {
+
+    entt::entity add_entity(entt::registry& registry, float x, entt::entity parent = entt::null) {
+        auto e = registry.create();
+        transform_component t { };
+        t.position = { x, 0.0f, 0.0f };
+        registry.emplace<transform_component>(e, t);
+        if (parent != entt::null) {
+            registry.emplace<parent_component>(e, parent_component { parent });
+        }
+        return e;
+    }
+
+    float get_x(const entt::registry& registry, entt::entity e) {
+        return registry.get<transform_component>(e).position.x;
+    }
+
+    std::filesystem::path temp_path(const char* name) {
+        return std::filesystem::temp_directory_path() / name;
+    }
+}
+
+TEST(scene_serialization, round_trip) {
+
+    auto schema = snapshot_schema::engine_components();
+    auto p = temp_path("bbge_scene_serialization_round_trip.bbs");
+
+    entt::registry saved;
+    auto root = add_entity(saved, 1.0f);
+    auto child = add_entity(saved, 2.0f, root);
+    auto gone = add_entity(saved, 3.0f);
+    saved.emplace<mesh_component>(child, mesh_component { 4, 5, 6, { } });
+    saved.destroy(gone);
+    ASSERT_TRUE(save_snapshot(saved, schema, p).is_ok());
+
+    auto snapshot = scene_snapshot::open(p);
+    ASSERT_TRUE(snapshot.is_ok());
+
+    entt::registry loaded;
+    auto count = load_snapshot(loaded, schema, *snapshot.ok());
+    ASSERT_TRUE(count.is_ok());
+    ASSERT_EQ(*count.ok(), 2);
+
+    // identifiers are kept, so references between entities stay valid
+    ASSERT_TRUE(loaded.valid(root));
+    ASSERT_TRUE(loaded.valid(child));
+    ASSERT_FALSE(loaded.valid(gone));
+    ASSERT_FLOAT_EQ(get_x(loaded, root), 1.0f);
+    ASSERT_FLOAT_EQ(get_x(loaded, child), 2.0f);
+    ASSERT_EQ(loaded.get<parent_component>(child).parent, root);
+    ASSERT_EQ(loaded.get<mesh_component>(child).material_id, 5);
+    ASSERT_FALSE(loaded.has<mesh_component>(root));
+
+    ASSERT_THROW((void) load_snapshot(loaded, schema, *snapshot.ok()), std::invalid_argument);
+
+    std::filesystem::remove(p);
+}
+
+TEST(scene_serialization, deltas) {
+
+    auto schema = snapshot_schema::engine_components();
+    auto full = temp_path("bbge_scene_serialization_full.bbs");
+    auto first = temp_path("bbge_scene_serialization_delta_1.bbs");
+    auto second = temp_path("bbge_scene_serialization_delta_2.bbs");
+
+    entt::registry scene;
+    auto a = add_entity(scene, 1.0f);
+    auto b = add_entity(scene, 2.0f, a);
+    auto c = add_entity(scene, 3.0f);
+
+    snapshot_tracker tracker(scene, schema);
+    ASSERT_TRUE(tracker.save_full(full).is_ok());
+    ASSERT_EQ(tracker.get_change_count(), 0);
+
+    // replaced and marked components are tracked, removed components and destroyed entities too
+    scene.replace<transform_component>(a, transform_component { { 10.0f, 0.0f, 0.0f } });
+    scene.get<transform_component>(c).position.x = 30.0f;
+    tracker.mark_changed(1, c);
+    scene.remove<parent_component>(b);
+    ASSERT_EQ(tracker.get_change_count(), 3);
+    ASSERT_TRUE(tracker.save_delta(first).is_ok());
+    ASSERT_EQ(tracker.get_sequence(), 1);
+
+    scene.destroy(c);
+    auto d = add_entity(scene, 4.0f, a);
+    ASSERT_TRUE(tracker.save_delta(second).is_ok());
+    ASSERT_EQ(tracker.get_sequence(), 2);
+
+    entt::registry loaded;
+    ASSERT_TRUE(load_snapshot(loaded, schema, *scene_snapshot::open(full).ok()).is_ok());
+    auto delta_1 = scene_snapshot::open(first);
+    auto delta_2 = scene_snapshot::open(second);
+    ASSERT_TRUE(delta_1.is_ok());
+    ASSERT_TRUE(delta_2.is_ok());
+
+    // only the changed entities are stored
+    const auto* transforms = delta_1.ok()->find(1, snapshot_section_kind::values);
+    ASSERT_NE(transforms, nullptr);
+    ASSERT_EQ(transforms->entities.size(), 2);
+
+    ASSERT_THROW((void) apply_delta(loaded, schema, *delta_2.ok(), 1), std::invalid_argument);
+    ASSERT_TRUE(apply_delta(loaded, schema, *delta_1.ok(), 1).is_ok());
+    ASSERT_TRUE(apply_delta(loaded, schema, *delta_2.ok(), 2).is_ok());
+
+    ASSERT_FLOAT_EQ(get_x(loaded, a), 10.0f);
+    ASSERT_FLOAT_EQ(get_x(loaded, b), 2.0f);
+    ASSERT_FALSE(loaded.has<parent_component>(b));
+    ASSERT_FALSE(loaded.valid(c));
+    ASSERT_TRUE(loaded.valid(d));
+    ASSERT_FLOAT_EQ(get_x(loaded, d), 4.0f);
+    ASSERT_EQ(loaded.get<parent_component>(d).parent, a);
+
+    std::filesystem::remove(full);
+    std::filesystem::remove(first);
+    std::filesystem::remove(second);
+}
+
+TEST(scene_serialization, json_export) {
+
+    auto schema = snapshot_schema::engine_components();
+
+    entt::registry scene;
+    auto root = add_entity(scene, 1.0f);
+    add_entity(scene, 2.0f, root);
+
+    auto json = export_json(scene, schema);
+    ASSERT_EQ(json["entities"].size(), 2);
+
+    const auto& child = json["entities"][1];
+    ASSERT_FLOAT_EQ(child["components"]["transform"]["position"][0].get<float>(), 2.0f);
+    ASSERT_EQ(child["components"]["parent"]["parent"], json["entities"][0]["id"]);
+    ASSERT_FALSE(json["entities"][0]["components"].contains("parent"));
+}
@@ -0,0 +1,141 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <gtest/gtest.h>
+#include <bamboo_engine/scene/scene_snapshot.hpp>
+
+using namespace bbge;
+
+namespace {
+
+    struct test_component {
+        float x;
+        float y;
+    };
+
+    template <typename T>
+    gsl::span<const std::byte> to_bytes(const std::vector<T>& v) {
+        return { reinterpret_cast<const std::byte*>(v.data()), v.size() * sizeof(T) };
+    }
+
+    std::filesystem::path temp_path(const char* name) {
+        return std::filesystem::temp_directory_path() / name;
+    }
+}
+
+TEST(scene_snapshot, round_trip) {
+
+    auto p = temp_path("bbge_scene_snapshot_round_trip.bbs");
+
+    std::vector<entt::entity> entities { entt::entity(0), entt::entity(1), entt::entity(2) };
+    std::vector<entt::entity> owners { entt::entity(2), entt::entity(0) };
+    std::vector<test_component> values { { 1.0f, 2.0f }, { 3.0f, 4.0f } };
+
+    scene_snapshot_writer writer(snapshot_kind::full, 0);
+    writer.set_entities(entities);
+    writer.add_values(7, sizeof(test_component), owners, to_bytes(values));
+    ASSERT_TRUE(writer.write(p).is_ok());
+
+    auto snapshot = scene_snapshot::open(p);
+    ASSERT_TRUE(snapshot.is_ok());
+    ASSERT_EQ(snapshot.ok()->get_kind(), snapshot_kind::full);
+    ASSERT_EQ(snapshot.ok()->get_sequence(), 0);
+    ASSERT_EQ(snapshot.ok()->get_entities().size(), 3);
+    ASSERT_EQ(snapshot.ok()->get_entities()[2], entt::entity(2));
+
+    const auto* section = snapshot.ok()->find(7, snapshot_section_kind::values);
+    ASSERT_NE(section, nullptr);
+    ASSERT_EQ(section->element_size, sizeof(test_component));
+    ASSERT_EQ(section->entities.size(), 2);
+    ASSERT_EQ(section->entities[0], entt::entity(2));
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(section->values.data()) % scene_snapshot::data_alignment, 0);
+
+    // stored as in memory, so the values can be used in place
+    const auto* loaded = reinterpret_cast<const test_component*>(section->values.data());
+    ASSERT_FLOAT_EQ(loaded[1].x, 3.0f);
+    ASSERT_FLOAT_EQ(loaded[1].y, 4.0f);
+
+    ASSERT_EQ(snapshot.ok()->find(7, snapshot_section_kind::removed), nullptr);
+    ASSERT_EQ(snapshot.ok()->find(8, snapshot_section_kind::values), nullptr);
+
+    std::filesystem::remove(p);
+}
+
+TEST(scene_snapshot, delta) {
+
+    auto p = temp_path("bbge_scene_snapshot_delta.bbs");
+
+    std::vector<entt::entity> entities { entt::entity(0) };
+    std::vector<entt::entity> removed { entt::entity(1), entt::entity(5) };
+
+    scene_snapshot_writer writer(snapshot_kind::delta, 3);
+    writer.set_entities(entities);
+    writer.add_removed(7, removed);
+    ASSERT_THROW(writer.add_removed(7, removed), std::invalid_argument);
+    ASSERT_TRUE(writer.write(p).is_ok());
+
+    auto snapshot = scene_snapshot::open(p);
+    ASSERT_TRUE(snapshot.is_ok());
+    ASSERT_EQ(snapshot.ok()->get_kind(), snapshot_kind::delta);
+    ASSERT_EQ(snapshot.ok()->get_sequence(), 3);
+
+    const auto* section = snapshot.ok()->find(7, snapshot_section_kind::removed);
+    ASSERT_NE(section, nullptr);
+    ASSERT_EQ(section->entities.size(), 2);
+    ASSERT_EQ(section->entities[1], entt::entity(5));
+    ASSERT_TRUE(section->values.empty());
+
+    std::filesystem::remove(p);
+}
+
+TEST(scene_snapshot, invalid_input) {
+
+    std::vector<entt::entity> owners { entt::entity(0) };
+    std::vector<test_component> values { { 1.0f, 2.0f }, { 3.0f, 4.0f } };
+
+    scene_snapshot_writer writer(snapshot_kind::full, 0);
+    ASSERT_THROW(writer.add_values(1, sizeof(test_component), owners, to_bytes(values)), std::invalid_argument);
+    ASSERT_THROW(writer.add_removed(1, owners), std::invalid_argument);
+}
+
+TEST(scene_snapshot, malformed) {
+
+    auto p = temp_path("bbge_scene_snapshot_malformed.bbs");
+    ASSERT_TRUE(scene_snapshot::open(p).is_err());
+
+    {
+        std::ofstream os(p, std::ios_base::binary);
+        os << "BBGS";
+    }
+    ASSERT_TRUE(scene_snapshot::open(p).is_err());
+
+    // valid snapshot with a section pointing past the end of the file
+    std::vector<entt::entity> owners { entt::entity(0) };
+    std::vector<test_component> values { { 1.0f, 2.0f } };
+    scene_snapshot_writer writer(snapshot_kind::full, 0);
+    writer.add_values(1, sizeof(test_component), owners, to_bytes(values));
+    auto size = writer.write(p);
+    ASSERT_TRUE(size.is_ok());
+    std::filesystem::resize_file(p, *size.ok() - 4);
+    ASSERT_TRUE(scene_snapshot::open(p).is_err());
+
+    std::filesystem::remove(p);
+}
@@ -0,0 +1,80 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdint>
+#include <thread>
+#include <gtest/gtest.h>
+#include <bamboo_engine/util/spsc_ring.hpp>
+
+using namespace bbge;
+
+TEST(spsc_ring, full_and_empty) {
+
+    spsc_ring<int> ring(4);
+    int value;
+    ASSERT_FALSE(ring.try_pop(value));
+
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(ring.try_push(i));
+    }
+    ASSERT_FALSE(ring.try_push(4));
+    ASSERT_EQ(ring.size(), 4);
+
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(ring.try_pop(value));
+        ASSERT_EQ(value, i);
+    }
+    ASSERT_FALSE(ring.try_pop(value));
+}
+
+TEST(spsc_ring, wraps_around) {
+
+    spsc_ring<int> ring(2);
+    int value;
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_TRUE(ring.try_push(i));
+        ASSERT_TRUE(ring.try_pop(value));
+        ASSERT_EQ(value, i);
+    }
+}
+
+TEST(spsc_ring, preserves_order_across_threads) {
+
+    constexpr uint64_t count = 10000;
+    spsc_ring<uint64_t> ring(64);
+
+    std::thread producer([&ring]() {
+        for (uint64_t i = 0; i < count; ++i) {
+            while (!ring.try_push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint64_t expected = 0;
+    uint64_t value;
+    while (expected < count) {
+        if (ring.try_pop(value)) {
+            ASSERT_EQ(value, expected);
+            ++expected;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+}
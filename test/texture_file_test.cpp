@@ -0,0 +1,76 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+#include <bamboo_engine/util/texture_file.hpp>
+
+using namespace bbge;
+
+namespace {
+
+    std::vector<std::byte> filled(std::size_t size, uint8_t value) {
+        return std::vector<std::byte>(size, std::byte { value });
+    }
+
+    constexpr const uint32_t rgba8 = 37; // VK_FORMAT_R8G8B8A8_UNORM
+}
+
+TEST(texture_file, full_mip_count) {
+    ASSERT_EQ(get_full_mip_count(1, 1), 1);
+    ASSERT_EQ(get_full_mip_count(2, 1), 2);
+    ASSERT_EQ(get_full_mip_count(256, 256), 9);
+    ASSERT_EQ(get_full_mip_count(300, 20), 9);
+}
+
+TEST(texture_file, round_trip) {
+
+    auto bytes = texture_file::write(rgba8, 4, 2, { filled(32, 1), filled(8, 2) });
+    auto file = texture_file::parse(bytes);
+    ASSERT_TRUE(file.is_ok());
+    ASSERT_EQ(file.ok()->get_format(), rgba8);
+    ASSERT_EQ(file.ok()->get_width(), 4);
+    ASSERT_EQ(file.ok()->get_height(), 2);
+    ASSERT_EQ(file.ok()->get_mip_count(), 2);
+
+    auto mip = file.ok()->get_mip(1);
+    ASSERT_EQ(mip.width, 2);
+    ASSERT_EQ(mip.height, 1);
+    ASSERT_EQ(mip.texels.size(), 8);
+    ASSERT_EQ(mip.texels[0], std::byte { 2 });
+    ASSERT_EQ((mip.texels.data() - bytes.data()) % texture_file::data_alignment, 0);
+}
+
+TEST(texture_file, malformed) {
+
+    auto bytes = texture_file::write(rgba8, 2, 2, { filled(16, 1) });
+
+    std::vector<std::byte> header_only(bytes.begin(), bytes.begin() + 8);
+    ASSERT_TRUE(texture_file::parse(header_only).is_err());
+
+    auto wrong_magic = bytes;
+    wrong_magic[0] = std::byte { 'X' };
+    ASSERT_TRUE(texture_file::parse(wrong_magic).is_err());
+
+    auto truncated = bytes;
+    truncated.resize(bytes.size() - 1);
+    ASSERT_TRUE(texture_file::parse(truncated).is_err());
+
+    // the stored texels have to match the level's extent
+    ASSERT_TRUE(texture_file::parse(texture_file::write(rgba8, 2, 2, { filled(12, 1) })).is_err());
+    ASSERT_TRUE(texture_file::parse(texture_file::write(rgba8, 4, 4, { filled(64, 1), filled(4, 1) })).is_err());
+    ASSERT_TRUE(texture_file::parse(texture_file::write(0, 2, 2, { filled(16, 1) })).is_err());
+}
@@ -0,0 +1,120 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include <bamboo_engine/util/tlsf_allocator.hpp>
+
+using namespace bbge;
+
+TEST(tlsf_allocator, empty_range) {
+    ASSERT_THROW(tlsf_allocator(0), std::invalid_argument);
+}
+
+TEST(tlsf_allocator, whole_range) {
+
+    tlsf_allocator allocator(1024);
+    auto a = allocator.allocate(1024);
+    ASSERT_TRUE(a.has_value());
+    ASSERT_EQ(a->offset, 0);
+    ASSERT_FALSE(allocator.allocate(1).has_value());
+
+    allocator.free(a->block);
+    ASSERT_TRUE(allocator.is_empty());
+    ASSERT_EQ(allocator.get_used(), 0);
+    ASSERT_TRUE(allocator.allocate(1024).has_value());
+}
+
+TEST(tlsf_allocator, too_large) {
+
+    tlsf_allocator allocator(1024);
+    ASSERT_FALSE(allocator.allocate(1025).has_value());
+}
+
+TEST(tlsf_allocator, alignment) {
+
+    tlsf_allocator allocator(1 << 20);
+    auto a = allocator.allocate(100);
+    ASSERT_TRUE(a.has_value());
+
+    for (uint64_t alignment : { 256, 4096, 65536 }) {
+        auto b = allocator.allocate(100, alignment);
+        ASSERT_TRUE(b.has_value());
+        ASSERT_EQ(b->offset % alignment, 0);
+        ASSERT_GE(b->offset, a->offset + a->size);
+    }
+}
+
+TEST(tlsf_allocator, merges_neighbours) {
+
+    tlsf_allocator allocator(4096);
+    auto a = allocator.allocate(1024);
+    auto b = allocator.allocate(1024);
+    auto c = allocator.allocate(1024);
+    auto d = allocator.allocate(1024);
+    ASSERT_TRUE(a && b && c && d);
+
+    // freeing in an order that exercises both merge directions
+    allocator.free(b->block);
+    allocator.free(d->block);
+    allocator.free(c->block);
+    ASSERT_FALSE(allocator.allocate(3072 + 1).has_value());
+    allocator.free(a->block);
+
+    auto e = allocator.allocate(4096);
+    ASSERT_TRUE(e.has_value());
+    ASSERT_EQ(e->offset, 0);
+}
+
+TEST(tlsf_allocator, random_no_overlap) {
+
+    constexpr uint64_t size = 16 << 20;
+    tlsf_allocator allocator(size);
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<uint64_t> sizes(1, 64 << 10);
+    std::uniform_int_distribution<uint32_t> alignments(0, 8);
+
+    std::vector<tlsf_allocator::allocation> live;
+    for (int i = 0; i < 10000; ++i) {
+        if (!live.empty() && (rng() % 3 == 0)) {
+            auto idx = rng() % live.size();
+            allocator.free(live[idx].block);
+            live.erase(live.begin() + idx);
+            continue;
+        }
+
+        auto alignment = uint64_t(1) << alignments(rng);
+        auto a = allocator.allocate(sizes(rng), alignment);
+        if (!a) continue;
+        ASSERT_EQ(a->offset % alignment, 0);
+        ASSERT_LE(a->offset + a->size, size);
+        live.push_back(*a);
+    }
+
+    std::sort(live.begin(), live.end(), [](const auto& l, const auto& r) { return l.offset < r.offset; });
+    for (std::size_t i = 1; i < live.size(); ++i) {
+        ASSERT_LE(live[i - 1].offset + live[i - 1].size, live[i].offset);
+    }
+
+    for (const auto& a : live) {
+        allocator.free(a.block);
+    }
+    ASSERT_TRUE(allocator.is_empty());
+    ASSERT_TRUE(allocator.allocate(size).has_value());
+}
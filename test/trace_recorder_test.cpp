@@ -0,0 +1,78 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <chrono>
+#include <thread>
+#include <gtest/gtest.h>
+#include <bamboo_engine/util/trace_recorder.hpp>
+
+using namespace bbge;
+using namespace std::chrono_literals;
+
+TEST(trace_recorder, nested_scopes) {
+
+    trace_recorder recorder;
+    {
+        trace_recorder::scope outer(recorder, "Outer");
+        {
+            trace_recorder::scope inner(recorder, "Inner");
+        }
+    }
+
+    auto events = recorder.get_events();
+    ASSERT_EQ(events.size(), 2);
+    ASSERT_EQ(events[0].name, "Inner");
+    ASSERT_EQ(events[1].name, "Outer");
+    ASSERT_EQ(events[0].thread, 0);
+    ASSERT_LE(events[1].start, events[0].start);
+    ASSERT_GE(events[1].start + events[1].duration, events[0].start + events[0].duration);
+}
+
+TEST(trace_recorder, threads) {
+
+    trace_recorder recorder;
+    auto now = trace_recorder::clock::now();
+    std::thread worker([&] { recorder.record("Worker", now, now + 1ms); });
+    worker.join();
+    recorder.record("Main", now, now + 2ms);
+
+    auto events = recorder.get_events();
+    ASSERT_EQ(events.size(), 2);
+    ASSERT_EQ(events[0].thread, 1);
+    ASSERT_EQ(events[1].thread, 0);
+}
+
+TEST(trace_recorder, chrome_trace) {
+
+    trace_recorder recorder;
+    auto now = trace_recorder::clock::now();
+    recorder.record("Device", now + 1ms, now + 3ms);
+
+    auto trace = recorder.to_chrome_trace();
+    const auto& events = trace["traceEvents"];
+    ASSERT_EQ(events.size(), 2); // main thread name and the event
+
+    ASSERT_EQ(events[0]["ph"], "M");
+    ASSERT_EQ(events[0]["args"]["name"], "Main thread");
+
+    const auto& device = events[1];
+    ASSERT_EQ(device["name"], "Device");
+    ASSERT_EQ(device["ph"], "X");
+    ASSERT_EQ(device["tid"], 0);
+    ASSERT_GE(device["ts"].get<double>(), 1000.0);
+    ASSERT_DOUBLE_EQ(device["dur"].get<double>(), 2000.0);
+}
@@ -0,0 +1,140 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+#include <bamboo_engine/scene/transform_hierarchy.hpp>
+
+using namespace bbge;
+
+namespace {
+
+    entt::entity add_node(entt::registry& registry, entt::entity parent, float x) {
+        auto e = registry.create();
+        transform_component t { };
+        t.position = { x, 0.0f, 0.0f };
+        registry.emplace<transform_component>(e, t);
+        if (parent != entt::null) {
+            registry.emplace<parent_component>(e, parent_component { parent });
+        }
+        return e;
+    }
+
+    float world_x(entt::registry& registry, entt::entity e) {
+        return registry.get<world_transform_component>(e).matrix[3].x;
+    }
+}
+
+TEST(transform_hierarchy, world_matrices) {
+
+    entt::registry registry;
+    transform_hierarchy hierarchy(registry);
+
+    auto root = add_node(registry, entt::null, 1.0f);
+    auto child = add_node(registry, root, 2.0f);
+    auto grandchild = add_node(registry, child, 3.0f);
+    auto other = add_node(registry, entt::null, 10.0f);
+
+    hierarchy.update();
+    ASSERT_EQ(hierarchy.get_node_count(), 4);
+    ASSERT_EQ(hierarchy.get_depth(), 3);
+    ASSERT_EQ(hierarchy.get_last_update_count(), 4);
+    ASSERT_FLOAT_EQ(world_x(registry, root), 1.0f);
+    ASSERT_FLOAT_EQ(world_x(registry, child), 3.0f);
+    ASSERT_FLOAT_EQ(world_x(registry, grandchild), 6.0f);
+    ASSERT_FLOAT_EQ(world_x(registry, other), 10.0f);
+}
+
+TEST(transform_hierarchy, only_dirty_subtrees) {
+
+    entt::registry registry;
+    transform_hierarchy hierarchy(registry);
+
+    auto root = add_node(registry, entt::null, 1.0f);
+    auto child = add_node(registry, root, 2.0f);
+    add_node(registry, entt::null, 10.0f);
+    hierarchy.update();
+
+    // nothing moved
+    hierarchy.update();
+    ASSERT_EQ(hierarchy.get_last_update_count(), 0);
+
+    // replace marks dirty, the child follows its parent
+    transform_component moved { };
+    moved.position = { 5.0f, 0.0f, 0.0f };
+    registry.replace<transform_component>(root, moved);
+    hierarchy.update();
+    ASSERT_EQ(hierarchy.get_last_update_count(), 2);
+    ASSERT_FLOAT_EQ(world_x(registry, child), 7.0f);
+
+    // direct changes have to be marked
+    registry.get<transform_component>(child).position.x = 1.0f;
+    hierarchy.mark_dirty(child);
+    hierarchy.update();
+    ASSERT_EQ(hierarchy.get_last_update_count(), 1);
+    ASSERT_FLOAT_EQ(world_x(registry, child), 6.0f);
+}
+
+TEST(transform_hierarchy, reparenting) {
+
+    entt::registry registry;
+    transform_hierarchy hierarchy(registry);
+
+    auto a = add_node(registry, entt::null, 1.0f);
+    auto b = add_node(registry, entt::null, 2.0f);
+    auto child = add_node(registry, a, 1.0f);
+    hierarchy.update();
+    ASSERT_FLOAT_EQ(world_x(registry, child), 2.0f);
+
+    registry.replace<parent_component>(child, parent_component { b });
+    hierarchy.update();
+    ASSERT_FLOAT_EQ(world_x(registry, child), 3.0f);
+
+    registry.remove<parent_component>(child);
+    hierarchy.update();
+    ASSERT_FLOAT_EQ(world_x(registry, child), 1.0f);
+}
+
+TEST(transform_hierarchy, parallel_levels) {
+
+    entt::registry registry;
+    transform_hierarchy hierarchy(registry);
+    job_system jobs(4);
+
+    auto root = add_node(registry, entt::null, 1.0f);
+    std::vector<entt::entity> children;
+    for (int i = 0; i < 1000; ++i) {
+        children.push_back(add_node(registry, root, static_cast<float>(i)));
+    }
+
+    hierarchy.update(&jobs, 16);
+    ASSERT_EQ(hierarchy.get_last_update_count(), 1001);
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_FLOAT_EQ(world_x(registry, children[i]), 1.0f + static_cast<float>(i));
+    }
+}
+
+TEST(transform_hierarchy, cycle) {
+
+    entt::registry registry;
+    transform_hierarchy hierarchy(registry);
+
+    auto a = add_node(registry, entt::null, 0.0f);
+    auto b = add_node(registry, a, 0.0f);
+    registry.emplace<parent_component>(a, parent_component { b });
+
+    ASSERT_THROW(hierarchy.update(), std::logic_error);
+}
@@ -0,0 +1,123 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+#include <bamboo_engine/graphics/vertex_layout.hpp>
+
+using namespace bbge;
+
+namespace {
+
+    struct mesh_vertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 uv;
+
+        static constexpr std::array<vertex_member, 3> vertex_members() {
+            return {
+                BBGE_VERTEX_MEMBER(mesh_vertex, position),
+                BBGE_VERTEX_MEMBER(mesh_vertex, normal),
+                BBGE_VERTEX_MEMBER(mesh_vertex, uv)
+            };
+        }
+    };
+
+    struct instance_data {
+        glm::vec4 color;
+        uint32_t material;
+
+        static constexpr std::array<vertex_member, 2> vertex_members() {
+            return { BBGE_VERTEX_MEMBER(instance_data, color), BBGE_VERTEX_MEMBER(instance_data, material) };
+        }
+    };
+}
+
+TEST(vertex_layout, attributes_of_struct) {
+    constexpr auto attributes = make_vertex_attributes<mesh_vertex>(2, 3);
+    static_assert(attributes.size() == 3);
+
+    ASSERT_EQ(attributes[0].offset, 0);
+    ASSERT_EQ(attributes[1].offset, 12);
+    ASSERT_EQ(attributes[2].offset, 24);
+    ASSERT_EQ(attributes[0].format, VK_FORMAT_R32G32B32_SFLOAT);
+    ASSERT_EQ(attributes[1].format, VK_FORMAT_R32G32B32_SFLOAT);
+    ASSERT_EQ(attributes[2].format, VK_FORMAT_R32G32_SFLOAT);
+    for (uint32_t i = 0; i < attributes.size(); ++i) {
+        ASSERT_EQ(attributes[i].binding, 2);
+        ASSERT_EQ(attributes[i].location, 3 + i);
+    }
+}
+
+TEST(vertex_layout, attributes_of_single_type) {
+    constexpr auto attributes = make_vertex_attributes<glm::uvec2>(0, 0);
+    static_assert(attributes.size() == 1);
+
+    ASSERT_EQ(attributes[0].offset, 0);
+    ASSERT_EQ(attributes[0].format, VK_FORMAT_R32G32_UINT);
+}
+
+TEST(vertex_layout, interleaved) {
+    vertex_layout layout;
+    layout.add_binding<mesh_vertex>().add_binding<instance_data>(vertex_input_rate::instance);
+
+    const auto& bindings = layout.get_bindings();
+    ASSERT_EQ(bindings.size(), 2);
+    ASSERT_EQ(bindings[0].binding, 0);
+    ASSERT_EQ(bindings[0].stride, sizeof(mesh_vertex));
+    ASSERT_EQ(bindings[0].stride, 32);
+    ASSERT_EQ(bindings[0].inputRate, VK_VERTEX_INPUT_RATE_VERTEX);
+    ASSERT_EQ(bindings[1].binding, 1);
+    ASSERT_EQ(bindings[1].stride, sizeof(instance_data));
+    ASSERT_EQ(bindings[1].inputRate, VK_VERTEX_INPUT_RATE_INSTANCE);
+
+    // locations continue across bindings
+    const auto& attributes = layout.get_attributes();
+    ASSERT_EQ(attributes.size(), 5);
+    for (uint32_t i = 0; i < attributes.size(); ++i) {
+        ASSERT_EQ(attributes[i].location, i);
+        ASSERT_EQ(attributes[i].binding, i < 3 ? 0 : 1);
+    }
+    ASSERT_EQ(attributes[3].offset, 0);
+    ASSERT_EQ(attributes[3].format, VK_FORMAT_R32G32B32A32_SFLOAT);
+    ASSERT_EQ(attributes[4].offset, 16);
+    ASSERT_EQ(attributes[4].format, VK_FORMAT_R32_UINT);
+}
+
+TEST(vertex_layout, deinterleaved) {
+    vertex_layout layout;
+    layout.add_binding<glm::vec3>().add_binding<glm::vec2>();
+
+    const auto& bindings = layout.get_bindings();
+    ASSERT_EQ(bindings.size(), 2);
+    ASSERT_EQ(bindings[0].stride, 12);
+    ASSERT_EQ(bindings[1].stride, 8);
+
+    const auto& attributes = layout.get_attributes();
+    ASSERT_EQ(attributes.size(), 2);
+    ASSERT_EQ(attributes[1].binding, 1);
+    ASSERT_EQ(attributes[1].location, 1);
+    ASSERT_EQ(attributes[1].offset, 0);
+    ASSERT_EQ(attributes[1].format, VK_FORMAT_R32G32_SFLOAT);
+}
+
+TEST(vertex_layout, empty) {
+    vertex_layout layout;
+    ASSERT_TRUE(layout.empty());
+    ASSERT_TRUE(layout.get_attributes().empty());
+    layout.add_binding<float>();
+    ASSERT_FALSE(layout.empty());
+}
@@ -0,0 +1,60 @@
+// Bamboo Engine, a 3D game engine.
+// Copyright (C) 2020 Leon Suchy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+#include <bamboo_engine/graphics/vulkan_format.hpp>
+
+using namespace bbge;
+
+TEST(vulkan_format, texel_sizes) {
+    ASSERT_EQ(get_format_block(VK_FORMAT_R8_UNORM)->size, 1);
+    ASSERT_EQ(get_format_block(VK_FORMAT_B8G8R8_SRGB)->size, 3);
+    ASSERT_EQ(get_format_block(VK_FORMAT_R8G8B8A8_SRGB)->size, 4);
+    ASSERT_EQ(get_format_block(VK_FORMAT_A2B10G10R10_UNORM_PACK32)->size, 4);
+    ASSERT_EQ(get_format_block(VK_FORMAT_R16G16B16_SFLOAT)->size, 6);
+    ASSERT_EQ(get_format_block(VK_FORMAT_R32G32B32_SFLOAT)->size, 12);
+    ASSERT_EQ(get_format_block(VK_FORMAT_R64G64B64A64_SFLOAT)->size, 32);
+    ASSERT_EQ(get_format_block(VK_FORMAT_D32_SFLOAT)->size, 4);
+    ASSERT_EQ(get_format_block(VK_FORMAT_R8G8B8A8_UNORM)->width, 1);
+}
+
+TEST(vulkan_format, compressed_blocks) {
+    auto bc1 = get_format_block(VK_FORMAT_BC1_RGBA_SRGB_BLOCK);
+    ASSERT_EQ(bc1->size, 8);
+    ASSERT_EQ(bc1->width, 4);
+    ASSERT_EQ(get_format_block(VK_FORMAT_BC7_UNORM_BLOCK)->size, 16);
+    ASSERT_EQ(get_format_block(VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK)->size, 8);
+
+    auto astc = get_format_block(VK_FORMAT_ASTC_10x8_SRGB_BLOCK);
+    ASSERT_EQ(astc->size, 16);
+    ASSERT_EQ(astc->width, 10);
+    ASSERT_EQ(astc->height, 8);
+}
+
+TEST(vulkan_format, unknown) {
+    ASSERT_FALSE(get_format_block(VK_FORMAT_UNDEFINED));
+    ASSERT_FALSE(get_format_block(VK_FORMAT_D24_UNORM_S8_UINT));
+    ASSERT_FALSE(get_image_size(VK_FORMAT_UNDEFINED, 4, 4));
+}
+
+TEST(vulkan_format, image_size) {
+    ASSERT_EQ(*get_image_size(VK_FORMAT_R8G8B8A8_UNORM, 4, 2), 32);
+    ASSERT_EQ(*get_image_size(VK_FORMAT_R32G32B32_SFLOAT, 3, 3), 108);
+    // partial blocks at the edges are stored whole
+    ASSERT_EQ(*get_image_size(VK_FORMAT_BC1_RGB_UNORM_BLOCK, 5, 4), 16);
+    ASSERT_EQ(*get_image_size(VK_FORMAT_BC3_UNORM_BLOCK, 1, 1), 16);
+}